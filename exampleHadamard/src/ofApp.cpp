@@ -5,6 +5,8 @@ void ofApp::setup()
 {
     console.init();
     
+    state = 0;
+    
     // Initialise quantum simulator
     quantumSim.init();
     
@@ -15,6 +17,12 @@ void ofApp::setup()
     // This means that it has an equal chance of being a 1 or a 0 when it is measured
     quantumReg->applyGateHad(0);
     
+    // Share the register so it can be drawn without touching the simulation, a separate rendering process could
+    // open the same name
+    statePublisher.open("/ofxQuantumHadamard", quantumReg->size());
+    statePublisher.publish(*quantumReg);
+    stateViewer.open("/ofxQuantumHadamard");
+    
     // Load shader that draws our visualisation
     shader.load("shaders/hadamard");
     
@@ -25,20 +33,43 @@ void ofApp::setup()
 //--------------------------------------------------------------
 void ofApp::update(){
     
-}
-
-//--------------------------------------------------------------
-void ofApp::draw(){
-    
     // If the mouse is not being pressed then measure the state
     // When the mouse is pressed then the state is held
     if( !(ofGetMousePressed()))
     {
         // Measure the qubit and save the measured state
-        state = quantumReg->measureBit(0);
+        int measured = quantumReg->measureBit(0);
         
         // Reapply the hadamard gate so that the qubit is back in the superposition state
         quantumReg->applyGateHad(0);
+        
+        // Publish the new state along with the measurement
+        statePublisher.publish(*quantumReg, measured);
+    }
+}
+
+//--------------------------------------------------------------
+void ofApp::draw(){
+    
+    // Read the newest frame the simulation has published, the amplitudes are used in place in shared memory
+    ofxQuantumStateViewer::Frame frame;
+    
+    if(stateViewer.acquire(frame))
+    {
+        Complex zero(frame.real[0], frame.imag[0]);
+        Complex one( frame.real[1], frame.imag[1]);
+        int     measured = (int)frame.value;
+        
+        // Only keep what was read if the simulation did not overwrite the frame meanwhile
+        if(stateViewer.isCurrent(frame))
+        {
+            stateZero = zero;
+            stateOne  = one;
+            
+            // Nothing is measured until the first update
+            if(measured >= 0)
+                state = measured;
+        }
     }
     
     // Draw quantum bit visualisation in a shader
@@ -54,6 +85,6 @@ void ofApp::draw(){
     shader.end();
     
     // Draw console to the screen
-    console.draw(ofVec2f(10,30), state, seed, quantumReg->getState(0), quantumReg->getState(1));
+    console.draw(ofVec2f(10,30), state, seed, stateZero, stateOne);
 }
 
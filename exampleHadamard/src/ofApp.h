@@ -28,6 +28,13 @@ private:
         ofxQuantum           quantumSim;
         ofxQuantumRegister * quantumReg;
     
+        // The simulation publishes its state to shared memory and draw reads it back from there, the same way a
+        // renderer in another process would
+        ofxQuantumStatePublisher statePublisher;
+        ofxQuantumStateViewer    stateViewer;
+        Complex                  stateZero;
+        Complex                  stateOne;
+    
         ofShader             shader;
         int                  state;
     
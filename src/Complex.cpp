@@ -7,7 +7,7 @@
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include <math.h>
-#include "complex.h"
+#include "Complex.h"
 
 ////////////////////////////////////////////////////
 // Default constructor, initializes to 0 + i0     //
@@ -0,0 +1,254 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  QuantumSeedEmulator.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "QuantumSeedEmulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <chrono>
+#include <vector>
+
+// Seeds written per write() call when streaming as fast as possible
+#define EMULATOR_BATCH_SEEDS 256
+
+// Longest time to wait for room in the terminal before checking if streaming has stopped, in milliseconds
+#define EMULATOR_POLL_TIMEOUT 50
+
+////////////////////////////////////////////////////
+// Next number from a xorshift generator          //
+////////////////////////////////////////////////////
+static uint32_t nextSeed( uint32_t & state )
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Put a seed into the QSPU format. The seed unit skips newlines so a
+// byte that happens to be one is moved to the next value.
+////////////////////////////////////////////////////////////////////////
+static void packSeed( uint32_t seed, unsigned char * out )
+{
+    for(int i = 0; i < 4; i++)
+    {
+        out[i] = (unsigned char)(seed >> (8 * i));
+        if(out[i] == '\n')
+            out[i]++;
+    }
+    out[4] = '\n';
+}
+
+////////////////////////////////////////////////////
+// Default constructor                            //
+////////////////////////////////////////////////////
+QuantumSeedEmulator::QuantumSeedEmulator()
+{
+    mMaster          = -1;
+    mThread          = NULL;
+    mStreaming       = false;
+    mNumSeedsWritten = 0;
+}
+
+////////////////////////////////////////////////////
+// Destructor                                     //
+////////////////////////////////////////////////////
+QuantumSeedEmulator::~QuantumSeedEmulator()
+{
+    close();
+}
+
+////////////////////////////////////////////////////
+// Create the pseudo terminal                     //
+////////////////////////////////////////////////////
+bool QuantumSeedEmulator::open()
+{
+    close();
+    
+    mMaster = posix_openpt(O_RDWR | O_NOCTTY);
+    
+    if(mMaster == -1 || grantpt(mMaster) != 0 || unlockpt(mMaster) != 0)
+    {
+        printf("ERROR! could not create a pseudo terminal: %s\n", strerror(errno));
+        close();
+        return false;
+    }
+    
+    mDevicePath = ptsname(mMaster);
+    
+    // Writes wait in poll() so stop() is never stuck behind a full terminal
+    fcntl(mMaster, F_SETFL, fcntl(mMaster, F_GETFL) | O_NONBLOCK);
+    
+    printf("Quantum seed emulator on %s\n", mDevicePath.c_str());
+    
+    return true;
+}
+
+////////////////////////////////////////////////////
+// Path of the terminal                           //
+////////////////////////////////////////////////////
+const std::string & QuantumSeedEmulator::getDevicePath() const
+{
+    return mDevicePath;
+}
+
+////////////////////////////////////////////////////
+// Start streaming seeds                          //
+////////////////////////////////////////////////////
+void QuantumSeedEmulator::start( double seedsPerSecond, uint32_t seed )
+{
+    stop();
+    
+    if(mMaster == -1)
+    {
+        printf("ERROR! the emulator has not been opened\n");
+        return;
+    }
+    
+    // Xorshift never leaves zero
+    if(seed == 0)
+        seed = 1;
+    
+    mStreaming = true;
+    mThread    = new std::thread(&QuantumSeedEmulator::streamAsThread, this, seedsPerSecond, seed);
+}
+
+////////////////////////////////////////////////////
+// Stop streaming                                 //
+////////////////////////////////////////////////////
+void QuantumSeedEmulator::stop()
+{
+    mStreaming = false;
+    
+    if(mThread != NULL)
+    {
+        mThread->join();
+        delete mThread;
+        mThread = NULL;
+    }
+}
+
+////////////////////////////////////////////////////
+// Write one seed                                 //
+////////////////////////////////////////////////////
+bool QuantumSeedEmulator::writeSeed( uint32_t seed )
+{
+    if(mMaster == -1 || mThread != NULL)
+        return false;
+    
+    unsigned char frame[5];
+    packSeed(seed, frame);
+    
+    // writeAll stops when streaming is cleared, so mark this single write as streaming while it runs
+    mStreaming = true;
+    const bool written = writeAll(frame, sizeof(frame));
+    mStreaming = false;
+    
+    if(written)
+        mNumSeedsWritten++;
+    
+    return written;
+}
+
+////////////////////////////////////////////////////
+// Number of seeds written                        //
+////////////////////////////////////////////////////
+unsigned long long int QuantumSeedEmulator::getNumSeedsWritten() const
+{
+    return mNumSeedsWritten;
+}
+
+////////////////////////////////////////////////////
+// Close the terminal                             //
+////////////////////////////////////////////////////
+void QuantumSeedEmulator::close()
+{
+    stop();
+    
+    if(mMaster != -1)
+    {
+        ::close(mMaster);
+        mMaster = -1;
+    }
+    
+    mDevicePath.clear();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Stream seeds. With no rate set the seeds are written in batches as
+// fast as the reader takes them, otherwise one at a time on a fixed
+// schedule that does not drift with the time spent writing.
+////////////////////////////////////////////////////////////////////////
+void QuantumSeedEmulator::streamAsThread( double seedsPerSecond, uint32_t seed )
+{
+    uint32_t state = seed;
+    
+    const int batch = seedsPerSecond > 0.0 ? 1 : EMULATOR_BATCH_SEEDS;
+    
+    std::vector<unsigned char> buffer(batch * 5);
+    
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    
+    while(mStreaming)
+    {
+        for(int i = 0; i < batch; i++)
+            packSeed(nextSeed(state), &buffer[i * 5]);
+        
+        if(!writeAll(&buffer[0], buffer.size()))
+            break;
+        
+        mNumSeedsWritten += batch;
+        
+        if(seedsPerSecond > 0.0)
+        {
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / seedsPerSecond));
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
+
+////////////////////////////////////////////////////
+// Write a buffer to the terminal                 //
+////////////////////////////////////////////////////
+bool QuantumSeedEmulator::writeAll( const unsigned char * data, size_t length )
+{
+    while(length > 0 && mStreaming)
+    {
+        ssize_t written = write(mMaster, data, length);
+        
+        if(written > 0)
+        {
+            data   += written;
+            length -= written;
+        }
+        else if(written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            // Terminal is full, wait until the reader has made room
+            struct pollfd fd;
+            fd.fd      = mMaster;
+            fd.events  = POLLOUT;
+            fd.revents = 0;
+            
+            poll(&fd, 1, EMULATOR_POLL_TIMEOUT);
+        }
+        else if(written < 0 && errno != EINTR)
+        {
+            printf("ERROR! emulator write failed: %s\n", strerror(errno));
+            return false;
+        }
+    }
+    
+    return length == 0;
+}
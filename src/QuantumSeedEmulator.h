@@ -0,0 +1,83 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  QuantumSeedEmulator.h
+//
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  QuantumSeedEmulator stands in for the Quantum Seed Processing Unit (QSPU) when the hardware is not plugged in. It opens
+//  a pseudo terminal and writes seeds to it in the same format as the QSPU, four bytes then a newline, so a QuantumSeedUnit
+//  can connect to getDevicePath() and run through exactly the same serial path. Seeds can be streamed at a fixed rate or as
+//  fast as the terminal will take them, which makes it useful for testing the throughput of the seed handoff.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef QUANTUM_SEED_EMULATOR_H
+#define QUANTUM_SEED_EMULATOR_H
+
+// Includes
+#include <string>
+#include <thread>
+#include <atomic>
+#include <stdint.h>
+
+class QuantumSeedEmulator
+{
+    
+public:
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public methods
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    // Constructor
+    QuantumSeedEmulator();
+    
+    // Destructor, stops streaming and closes the terminal
+    ~QuantumSeedEmulator();
+    
+    // Create the pseudo terminal, returns false if the system does not have one free
+    bool open();
+    
+    // Path of the terminal for QuantumSeedUnit::connectDevice
+    const std::string & getDevicePath() const;
+    
+    // Start streaming seeds made from a generator started at seed. seedsPerSecond of 0 streams as fast as possible
+    void start( double seedsPerSecond = 0.0, uint32_t seed = 1 );
+    
+    // Stop streaming
+    void stop();
+    
+    // Write a single seed, only while not streaming
+    bool writeSeed( uint32_t seed );
+    
+    // Number of seeds written so far
+    unsigned long long int getNumSeedsWritten() const;
+    
+    // Close the terminal, a connected QuantumSeedUnit sees the device disconnect
+    void close();
+    
+private:
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private methods
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    // Streams seeds until stop() is called
+    void streamAsThread( double seedsPerSecond, uint32_t seed );
+    
+    // Write a whole buffer to the terminal, waiting for room when it is full. Returns false if stopped or on error
+    bool writeAll( const unsigned char * data, size_t length );
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    int                                 mMaster;            // Master side of the pseudo terminal
+    std::string                         mDevicePath;        // Slave side that the seed unit opens
+    std::thread *                       mThread;            // Streaming thread
+    std::atomic<bool>                   mStreaming;         // Cleared to stop streaming
+    std::atomic<unsigned long long int> mNumSeedsWritten;   // Seeds written so far
+};
+
+#endif
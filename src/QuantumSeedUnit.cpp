@@ -14,6 +14,17 @@
 ////////////////////////////////////////////////////
 QuantumSeedUnit::QuantumSeedUnit()
 {
+    mThread        = NULL;
+    mThreadRunning = false;
+    mWakePipe[0]   = -1;
+    mWakePipe[1]   = -1;
+    mRingHead      = 0;
+    mRingTail      = 0;
+    mFrameLength   = 0;
+    mNumBytesRead  = 0;
+    mNumSeeds      = 0;
+    mConnection    = -1;
+    mConnected     = false;
 }
 
 ////////////////////////////////////////////////////
@@ -30,13 +41,38 @@ QuantumSeedUnit::~QuantumSeedUnit()
 ////////////////////////////////////////////////////
 void QuantumSeedUnit::close()
 {
-    printf("Closing serial connection\n");
-
-    // End the background thread and join it together with the main thread so that the application can close cleanly
+    // End the background thread and join it together with the main thread so that the application can close cleanly,
+    // writing to the wake pipe gets it out of poll() straight away
     if(mThread != NULL)
+    {
+        printf("Closing serial connection\n");
+        
+        mThreadRunning = false;
+        
+        const char wake = 0;
+        if(write(mWakePipe[1], &wake, 1) < 0)
+            printf("ERROR! could not wake the serial thread\n");
+        
         mThread->join();
+        delete mThread;
+        mThread = NULL;
+    }
+    
+    if(mWakePipe[0] != -1)
+    {
+        ::close(mWakePipe[0]);
+        ::close(mWakePipe[1]);
+        mWakePipe[0] = -1;
+        mWakePipe[1] = -1;
+    }
     
-    delete mThread;
+    if(mConnection != -1)
+    {
+        ::close(mConnection);
+        mConnection = -1;
+    }
+    
+    mConnected = false;
 }
 
 ////////////////////////////////////////////////////
@@ -53,8 +89,6 @@ void QuantumSeedUnit::init()
     
     string deviceName = "";
     
-    mConnection = -1;
-    
     // If serial connectios are not available
     if(dir == nullptr)
     {
@@ -100,45 +134,68 @@ bool QuantumSeedUnit::connect(int indx, int baud)
     printf("Connecting to serial port: %i\n", indx);
     
     // If indx is valid
-    if( indx <  mDeviceList.size() )
+    if( indx >= 0 && indx < (int)mDeviceList.size() )
+        return connectDevice(mDeviceList[indx]);
+    
+    return false;
+}
+
+////////////////////////////////////////////////////
+// Connect to a serial device by path             //
+////////////////////////////////////////////////////
+bool QuantumSeedUnit::connectDevice( const std::string & path )
+{
+    // Drop any earlier connection first
+    close();
+    
+    // Open connection, reads never block as the thread waits in poll() instead
+    mConnection = open( path.c_str() , O_RDWR | O_NOCTTY | O_NONBLOCK);
+    
+    if (mConnection == -1)
+    {
+        printf("Unable to open port.\n");
+        return false;
+    }
+    
+    printf("Port opened.\n");
+    
+    // Set connection parameters, raw mode so bytes come through as they arrive rather than a line at a time
+    struct termios options;
+    
+    if(tcgetattr(mConnection, &options) == 0)
     {
-        // Open connection
-        mConnection = open( mDeviceList[indx].c_str() , O_RDWR | O_NOCTTY | O_NDELAY);
+        cfmakeraw(&options);
+        cfsetispeed(&options, B9600);
+        cfsetospeed(&options, B9600);
         
-        if (mConnection == -1)
-        {
-            printf("Unable to open port.\n");
-        }
-        else
-        {
-            printf("Port opened.\n");
-            
-            // Set connection parameters
-            struct termios options;
-            
-            cfsetispeed(&options, B9600);
-            cfsetospeed(&options, B9600);
-            
-            options.c_cflag |= (CLOCAL | CREAD);
-            options.c_cflag &= ~PARENB;
-            options.c_cflag &= ~CSTOPB;
-            options.c_cflag &= ~CSIZE;
-            options.c_iflag &= (tcflag_t) ~(INLCR | IGNCR | ICRNL | IGNBRK);
-            options.c_oflag &= (tcflag_t) ~(OPOST);
-            options.c_cflag |= CS8;
-            tcsetattr(mConnection, TCSANOW, &options);
-            
-
-            // Start the update function running in the background so that it does not block the main loop
-            mThread = new std::thread(&QuantumSeedUnit::updateAsThread, this);
-        }
+        options.c_cflag |= (CLOCAL | CREAD);
+        options.c_cflag &= ~PARENB;
+        options.c_cflag &= ~CSTOPB;
+        options.c_cflag &= ~CSIZE;
+        options.c_cflag |= CS8;
+        tcsetattr(mConnection, TCSANOW, &options);
     }
     
-    // Return true if we connected otherwise return false
-    if(mConnection == -1)
+    if(pipe(mWakePipe) != 0)
+    {
+        printf("ERROR! could not create the serial wake pipe\n");
+        ::close(mConnection);
+        mConnection = -1;
         return false;
-    else
-        return true;
+    }
+    
+    mRingHead      = 0;
+    mRingTail      = 0;
+    mFrameLength   = 0;
+    mNumBytesRead  = 0;
+    mNumSeeds      = 0;
+    mConnected     = true;
+    mThreadRunning = true;
+    
+    // Start the update function running in the background so that it does not block the main loop
+    mThread = new std::thread(&QuantumSeedUnit::updateAsThread, this);
+    
+    return true;
 }
 
 ////////////////////////////////////////////////////
@@ -169,53 +226,140 @@ bool QuantumSeedUnit::connectArduino()
     return mConnected;
 }
 
-////////////////////////////////////////////////////
-// Update function that runs in the background    //
-////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+// Update function that runs in the background. It sleeps in poll()
+// until the device has data or close() writes to the wake pipe, then
+// takes everything that is there in as few reads as possible.
+////////////////////////////////////////////////////////////////////////
 void QuantumSeedUnit::updateAsThread()
 {
-    bool threadRunning = true;
-    
-    int bitIndx = 0;
-    
-    // This stores our 32 bit random seed (each unsigned char is 8 bits)
-    unsigned char tmpByte[4];
-    
     // Loop until the thread is closed
-    while(threadRunning)
+    while(mThreadRunning)
     {
-        // Read in some data from the serial connection
-        unsigned char tmp;
-        int nRead = read(mConnection, &tmp, 1);
+        struct pollfd fds[2];
         
-        // If there is some data to read
-        if(nRead > 0  && tmp != '\n')
+        fds[0].fd      = mConnection;
+        fds[0].events  = POLLIN;
+        fds[0].revents = 0;
+        fds[1].fd      = mWakePipe[0];
+        fds[1].events  = POLLIN;
+        fds[1].revents = 0;
+        
+        if(poll(fds, 2, -1) < 0)
         {
-            // Save the data in our array
-            tmpByte[bitIndx] = tmp;
-            bitIndx++;
+            if(errno == EINTR)
+                continue;
+            
+            printf("ERROR! polling the serial connection failed: %s\n", strerror(errno));
+            break;
+        }
+        
+        // Woken up by close()
+        if(fds[1].revents != 0)
+            break;
+        
+        if(fds[0].revents != 0)
+        {
+            const bool open = drainSerial();
+            
+            frameSeeds();
             
-            // Once our array is full we can construct our 32 bit seed
-            if(bitIndx >= 4)
+            if(!open)
             {
-                // Reset the bit indx for the next iteration
-                bitIndx = 0;
-
-                // Pack the 8 bit chars into our 32 bit int
-                mSeed =   tmpByte[0] |
-                        ( tmpByte[1] << 8)  |
-                        ( tmpByte[2] << 16) |
-                        ( tmpByte[3] << 24    );
-                
+                printf("Quantum Seed Processing Unit disconnected\n");
+                break;
             }
         }
+    }
+    
+    mConnected = false;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Read until the device has nothing left. Each read fills as much of
+// the ring as is free in one go, the ring is framed whenever it fills
+// up so a long burst never has to wait on the kernel buffer.
+////////////////////////////////////////////////////////////////////////
+bool QuantumSeedUnit::drainSerial()
+{
+    while(true)
+    {
+        if(mRingHead - mRingTail == SERIAL_RING_SIZE)
+            frameSeeds();
+        
+        const size_t writeIndx  = mRingHead & (SERIAL_RING_SIZE - 1);
+        const size_t free       = SERIAL_RING_SIZE - (mRingHead - mRingTail);
+        const size_t contiguous = free < SERIAL_RING_SIZE - writeIndx ? free : SERIAL_RING_SIZE - writeIndx;
         
-        // Sleep for one second to allow other processes time to run
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        ssize_t nRead = read(mConnection, mRing + writeIndx, contiguous);
         
+        if(nRead > 0)
+        {
+            mRingHead     += nRead;
+            mNumBytesRead += nRead;
+        }
+        else if(nRead == 0)
+        {
+            // End of file, the device has been unplugged
+            return false;
+        }
+        else if(errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            // Nothing left to read
+            return true;
+        }
+        else if(errno != EINTR)
+        {
+            return false;
+        }
     }
 }
 
+////////////////////////////////////////////////////
+// Turn buffered bytes into seeds                 //
+////////////////////////////////////////////////////
+void QuantumSeedUnit::frameSeeds()
+{
+    // Seed bytes are passed on to the entropy pool in batches
+    unsigned char entropy[256];
+    size_t        numEntropy = 0;
+    
+    while(mRingTail != mRingHead)
+    {
+        const unsigned char byte = mRing[mRingTail & (SERIAL_RING_SIZE - 1)];
+        mRingTail++;
+        
+        // Newlines separate the seeds
+        if(byte == '\n')
+            continue;
+        
+        mFrame[mFrameLength++] = byte;
+        
+        entropy[numEntropy++] = byte;
+        if(numEntropy == sizeof(entropy))
+        {
+            mEntropyPool.absorb(entropy, numEntropy);
+            numEntropy = 0;
+        }
+        
+        // Once our array is full we can construct our 32 bit seed
+        if(mFrameLength == SEED_FRAME_SIZE)
+        {
+            // Reset the bit indx for the next iteration
+            mFrameLength = 0;
+            
+            // Pack the 8 bit chars into our 32 bit int and hand it over to the readers
+            mSeedSlot.publish(            mFrame[0]        |
+                              ( (unsigned long int)mFrame[1] << 8)  |
+                              ( (unsigned long int)mFrame[2] << 16) |
+                              ( (unsigned long int)mFrame[3] << 24) );
+            mNumSeeds++;
+        }
+    }
+    
+    mEntropyPool.absorb(entropy, numEntropy);
+}
+
 ////////////////////////////////////////////////////
 // Test if the QSPU is connected                  //
 ////////////////////////////////////////////////////
@@ -224,7 +368,39 @@ bool QuantumSeedUnit::isConnected()
     return mConnected;
 }
 
+////////////////////////////////////////////////////
+// Throughput counters                            //
+////////////////////////////////////////////////////
+unsigned long long int QuantumSeedUnit::getNumBytesRead()
+{
+    return mNumBytesRead;
+}
+
+unsigned long long int QuantumSeedUnit::getNumSeeds()
+{
+    return mNumSeeds;
+}
+
+////////////////////////////////////////////////////
+// Get the current seed                           //
+////////////////////////////////////////////////////
 long  QuantumSeedUnit::getSeed()
 {
-    return mSeed;
+    return mSeedSlot.getSeed();
+}
+
+////////////////////////////////////////////////////
+// Get the slot seeds are published to            //
+////////////////////////////////////////////////////
+ofxQuantumSeedSlot & QuantumSeedUnit::getSeedSlot()
+{
+    return mSeedSlot;
+}
+
+////////////////////////////////////////////////////
+// Get the entropy pool                           //
+////////////////////////////////////////////////////
+ofxQuantumEntropyPool & QuantumSeedUnit::getEntropyPool()
+{
+    return mEntropyPool;
 }
\ No newline at end of file
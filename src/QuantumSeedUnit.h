@@ -7,7 +7,8 @@
 //
 //  QuantumSeedUnit is a class which connects to the Quantum Seed Processing Unit (QSPU) which is a hardware device that 
 //  generates seed numbers to be used in a random number generator, these seeds are created by detecting the decay of 
-//  a radioactive particle
+//  a radioactive particle. A background thread waits on the serial port with poll(), drains every byte that has arrived
+//  into a ring buffer, and publishes each seed as soon as its four bytes are in
 //
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -24,11 +25,15 @@
 #include <fcntl.h>   /* File control definitions */
 #include <errno.h>   /* Error number definitions */
 #include <termios.h> /* POSIX terminal control definitions */
+#include <poll.h>    /* Waiting on the serial port and the wake pipe */
 #include <thread>         // std::thread
+#include <atomic>
 #include "Poco/Thread.h"
 #include "Poco/Runnable.h"
 #include <vector>
 #include <dirent.h>
+#include "ofxQuantumSeedSlot.h"
+#include "ofxQuantumEntropyPool.h"
 
 // serial error codes
 #define SERIAL_NO_DATA 	-2
@@ -37,6 +42,12 @@
 // Transmission rate for connection to QSPU
 #define BAUD_RATE       9600
 
+// Bytes buffered between the serial port and the seed framing, must be a power of two
+#define SERIAL_RING_SIZE 4096
+
+// Bytes that make up one seed
+#define SEED_FRAME_SIZE  4
+
 using namespace std;
 
 class QuantumSeedUnit
@@ -60,17 +71,30 @@ public:
     // Connect to the QSPU
     bool connectArduino();
     
+    // Connect to a serial device by its path, such as the pseudo terminal of a QuantumSeedEmulator
+    bool connectDevice( const std::string & path );
+    
     // Update the QSPU in the background
     void updateAsThread();
     
     // Get the current seed
     long  getSeed();
     
+    // Slot the seeds are published to, threads can check its generation for new seeds without locking
+    ofxQuantumSeedSlot & getSeedSlot();
+    
+    // Pool every byte from the device is absorbed into
+    ofxQuantumEntropyPool & getEntropyPool();
+    
     // Close the connection to the QSPU
     void  close();
     
     // Check if the QSPU is connected
     bool  isConnected();
+    
+    // Totals since connecting, used to measure throughput
+    unsigned long long int getNumBytesRead();
+    unsigned long long int getNumSeeds();
 
 private:
     
@@ -80,16 +104,34 @@ private:
 
     // Connect to a serial device
     bool connect(int indx, int baudRate);
+    
+    // Read everything waiting on the serial port into the ring buffer, returns false once the device has gone
+    bool drainSerial();
+    
+    // Turn the bytes in the ring buffer into seeds
+    void frameSeeds();
 
     //////////////////////////////////////////////////////////////////////////////////////////
     // Private Variables
     //////////////////////////////////////////////////////////////////////////////////////////
  
     std::thread * 			  mThread;			// Thread object
+    std::atomic<bool>         mThreadRunning;   // Cleared to stop the thread
+    int                       mWakePipe[2];     // Written to wake the thread up when closing
+    
+    unsigned char             mRing[SERIAL_RING_SIZE]; // Bytes read but not framed yet
+    size_t                    mRingHead;        // Total bytes written into the ring
+    size_t                    mRingTail;        // Total bytes taken out of the ring
+    unsigned char             mFrame[SEED_FRAME_SIZE]; // Seed being put together
+    int                       mFrameLength;     // Bytes in mFrame so far
+    
+    std::atomic<unsigned long long int> mNumBytesRead; // Bytes read from the device
+    std::atomic<unsigned long long int> mNumSeeds;     // Seeds published
     std::vector <std::string> mDeviceList;	    // List of available serial devices
-    unsigned long int         mSeed;			// Current seed
+    ofxQuantumSeedSlot        mSeedSlot;		// Current seed, written by the serial thread and read by anyone
+    ofxQuantumEntropyPool     mEntropyPool;     // Whitened random words made from the device bytes
     int                       mConnection;		// Which serial port to connect to
-    bool                      mConnected;		// Connection status
+    std::atomic<bool>         mConnected;		// Connection status
     
 };
 
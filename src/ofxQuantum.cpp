@@ -14,7 +14,7 @@
 ////////////////////////////////////////////////////
 ofxQuantum::ofxQuantum()
 {
-    
+    mNextStream = 0;
 }
 
 ////////////////////////////////////////////////////
@@ -22,7 +22,6 @@ ofxQuantum::ofxQuantum()
 ////////////////////////////////////////////////////
 ofxQuantum::~ofxQuantum()
 {
-    mThreadRunning = false;
 }
 
 /////////////////////////////////////////////////////
@@ -33,59 +32,95 @@ void ofxQuantum::init()
     
     printf("Connecting to Quantum Seed Processing Unit\n");
     
-    // Connect to quantum seed processing unit (QSPU) via serial
+    // Seed random number generator with pseudo random seed until the first one comes in
+    setSeed( ofGetSystemTime() );
+    
+    // Connect to quantum seed processing unit (QSPU) via serial, it publishes new seeds as they arrive
     mSeedUnit.init();
     mSeedUnit.connectArduino();
-    
-    // Set the random seed
-    mLastTimeChecked = ofGetElapsedTimef();
-    mSeed            = ofGetSystemTime();
-    
-    // Seed random number generator with pseudo random seed
-    srand( mSeed );
-    
-    // Start the background thread which updates the QSPU
-    startThread(false, false);
 }
 
 /////////////////////////////////////////////////////
-// Get a random float 0.0-1.0                      //
+// Get a random number 0.0-1.0                     //
+/////////////////////////////////////////////////////
+double ofxQuantum::getRandom()
+{
+    return getThreadRandom().nextDouble();
+}
+
+/////////////////////////////////////////////////////
+// Get 64 random bits                              //
 /////////////////////////////////////////////////////
-float ofxQuantum::getRandom()
+unsigned long long int ofxQuantum::getRandomInt()
 {
-    return static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
+    return getThreadRandom().nextInt();
 }
 
-///////////////////////////////////////////////////////////////////////////////
-// Function that runs in background and checks for new random seed from QSPU //
-///////////////////////////////////////////////////////////////////////////////
-void ofxQuantum::threadedFunction()
+/////////////////////////////////////////////////////
+// Fill a batch of random numbers                  //
+/////////////////////////////////////////////////////
+void ofxQuantum::fillRandom( double * values, size_t count )
 {
-    // start
-    mThreadRunning = true;
+    getThreadRandom().fill(values, count);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Each thread keeps its own generator. The generation of the seed slot
+// is one atomic load, when it has moved on since the generator was made
+// (or the thread has switched to a different simulator) the seed is
+// read from the slot and the generator restarts on a new stream.
+////////////////////////////////////////////////////////////////////////
+ofxQuantumRandom & ofxQuantum::getThreadRandom()
+{
+    struct ThreadStream
+    {
+        const ofxQuantum *     owner;
+        unsigned long long int generation;
+        ofxQuantumRandom       random;
+    };
+    
+    static thread_local ThreadStream stream = { NULL, 0, ofxQuantumRandom() };
+    
+    ofxQuantumSeedSlot & slot = mSeedUnit.getSeedSlot();
     
-    while(mThreadRunning)
+    if(stream.owner != this || stream.generation != slot.getGeneration())
     {
-        // If the QSPU is connected then check for a new seed
-        if(mSeedUnit.isConnected())
-        {
-            if(ofGetElapsedTimef() - mLastTimeChecked > TIME_BETWEEN_SEED_UPDATES)
-            {
-                long seed = mSeedUnit.getSeed();
-                
-                if(seed != mSeed)
-                {
-                    srand(seed);
-                    mSeed=seed;
-                }
-                
-                mLastTimeChecked = ofGetElapsedTimef();
-            }
-        }
+        unsigned long long int seed, entropy;
+        slot.read(seed, stream.generation);
         
-        // This thread doesn't need much cpu time so sleep for 200ms
-        sleep(200);
+        if(mSeedUnit.getEntropyPool().extract(&entropy, 1) == 1)
+            seed ^= entropy;
+        
+        // Stream numbers keep counting up so a thread never reuses one, even across seeds
+        stream.owner = this;
+        stream.random.setSeed(seed, mNextStream++);
     }
+    
+    return stream.random;
+}
+
+/////////////////////////////////////////////////////
+// Fill from the entropy pool                      //
+/////////////////////////////////////////////////////
+void ofxQuantum::fillEntropy( double * values, size_t count )
+{
+    mSeedUnit.getEntropyPool().fillRandom(values, count);
+}
+
+/////////////////////////////////////////////////////
+// Get the entropy pool                            //
+/////////////////////////////////////////////////////
+ofxQuantumEntropyPool & ofxQuantum::getEntropyPool()
+{
+    return mSeedUnit.getEntropyPool();
+}
+
+/////////////////////////////////////////////////////
+// Set a new seed                                  //
+/////////////////////////////////////////////////////
+void ofxQuantum::setSeed( unsigned long long int seed )
+{
+    mSeedUnit.getSeedSlot().publish(seed);
 }
 
 /////////////////////////////////////////////////////
@@ -94,5 +129,32 @@ void ofxQuantum::threadedFunction()
 
 long long ofxQuantum::getSeed()
 {
-    return mSeed;
+    return mSeedUnit.getSeedSlot().getSeed();
+}
+
+/////////////////////////////////////////////////////
+// Get the number of times the seed has changed    //
+/////////////////////////////////////////////////////
+
+unsigned long long int ofxQuantum::getSeedGeneration()
+{
+    return mSeedUnit.getSeedSlot().getGeneration();
+}
+
+/////////////////////////////////////////////////////
+// Get the thread pool used by the registers       //
+/////////////////////////////////////////////////////
+
+ofxQuantumThreadPool & ofxQuantum::getThreadPool()
+{
+    return mThreadPool;
+}
+
+/////////////////////////////////////////////////////
+// Set the number of threads used by the registers //
+/////////////////////////////////////////////////////
+
+void ofxQuantum::setNumThreads( int numThreads )
+{
+    mThreadPool.setNumThreads(numThreads);
 }
@@ -6,7 +6,9 @@
 //
 //  ofxQuantum is the quantum simulator object, it provides random numbers to the quantum register and gate functions
 //  The class connects to a Quantum State Processing Unit (QSPU) which creates seeds for the random number generator
-//  based on the quantum effects of decay of a radioactive isotope
+//  based on the quantum effects of decay of a radioactive isotope. Random numbers come from a counter based generator keyed
+//  by the current seed, every thread that asks for them gets its own stream so callers on different threads never contend.
+//  New seeds from the QSPU are picked up on the next random number by checking the generation of the seed slot
 //
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -14,13 +16,22 @@
 #define OFXQUANTUM_H
 
 #include "ofxQuantumRegister.h"
+#include "ofxQuantumCircuit.h"
+#include "ofxQuantumStabilizerRegister.h"
+#include "ofxQuantumMPSRegister.h"
+#include "ofxQuantumBatchRegister.h"
+#include "ofxQuantumTrajectories.h"
+#include "ofxQuantumDistributedRegister.h"
+#include "ofxQuantumSharedState.h"
 #include "QuantumSeedUnit.h"
+#include "ofxQuantumThreadPool.h"
+#include "ofxQuantumRandom.h"
 
-#include "ofThread.h"
+#include <atomic>
 
-#define TIME_BETWEEN_SEED_UPDATES 5.0
+#include "ofUtils.h"
 
-class ofxQuantum : public ofThread
+class ofxQuantum
 {
 public:
     
@@ -37,26 +48,52 @@ public:
     // Initialise the quantum simulator
     void  init();
     
-    // Get a random number from the simulator
-    float getRandom();
+    // Get a random number 0.0-1.0 from the calling thread's stream
+    double getRandom();
     
-    // Thread running in background
-    void threadedFunction();
+    // Get 64 random bits from the calling thread's stream, used to seed streams of random numbers
+    unsigned long long int getRandomInt();
+    
+    // Fill values with random numbers 0.0-1.0 from the calling thread's stream
+    void fillRandom( double * values, size_t count );
+    
+    // Fill values with random numbers 0.0-1.0 taken from the whitened QSPU output while there is any
+    void fillEntropy( double * values, size_t count );
+    
+    // Pool of whitened random words made from every byte the QSPU sends
+    ofxQuantumEntropyPool & getEntropyPool();
+    
+    // Generator used by the calling thread, its seed, stream and position can be read back to replay the numbers it gives.
+    // A thread gets a new stream the first time it asks and again whenever the seed changes, the key is the seed mixed
+    // with a word from the entropy pool when it has one
+    ofxQuantumRandom & getThreadRandom();
+    
+    // Replace the seed, every thread starts a new stream from it
+    void setSeed( unsigned long long int seed );
     
     // Get the current seed being used by the Quantum Simulator
     long long getSeed();
     
+    // Number of times the seed has changed, compare against an earlier value to see if there is a new seed
+    unsigned long long int getSeedGeneration();
+    
+    // Worker threads shared by the registers linked to this simulator
+    ofxQuantumThreadPool & getThreadPool();
+    
+    // Set how many threads the registers use, 0 uses every core and 1 keeps everything on the calling thread
+    void setNumThreads( int numThreads );
+    
 private:
     
     //////////////////////////////////////////////////////////////////////////////////////////
     // Private Variables
     //////////////////////////////////////////////////////////////////////////////////////////
     
-    long            mSeed;              // Current seed being used
+    std::atomic<unsigned long long int> mNextStream;      // Next stream to hand to a thread
+    
+    QuantumSeedUnit mSeedUnit;          // Seed unit object that connects to external Quantum State Processing Unit (QSPU), holds the current seed
     
-    bool            mThreadRunning;     // Is the thread running
-    QuantumSeedUnit mSeedUnit;          // Seed unit object that connects to external Quantum State Processing Unit (QSPU)
-    float           mLastTimeChecked;   // Times since last checked for a new seed from QSPU
+    ofxQuantumThreadPool mThreadPool;   // Workers used by the registers for large loops
 };
 
 
@@ -0,0 +1,551 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumBatchRegister.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumBatchRegister.h"
+#include "ofxQuantum.h"
+#include "ofxQuantumKernels.h"
+
+#include <math.h>
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+
+template<typename T>
+ofxQuantumBatchRegisterT<T>::ofxQuantumBatchRegisterT( size_t numRegisters, unsigned long long int size, ofxQuantum *quantumSim )
+{
+    mQuantumSim = quantumSim;
+    mThreadPool = NULL;
+
+    if(size > QUANTUM_BATCH_MAX_QUBITS)
+    {
+        printf("ERROR! batched registers are limited to %d qubits\n", QUANTUM_BATCH_MAX_QUBITS);
+        size = 0;
+    }
+
+    // Round the lanes up to a cache line so every state of the batch starts on an aligned boundary
+    const size_t lanesPerLine = QUANTUM_STATE_ALIGNMENT / sizeof(T);
+
+    mNumRegisters = numRegisters;
+    mNumLanes     = (numRegisters + lanesPerLine - 1) / lanesPerLine * lanesPerLine;
+    mRegSize      = size;
+    mNumStates    = 1ULL << mRegSize;
+
+    mState.allocate(mNumStates * mNumLanes);
+    reset();
+
+    setSeed(mQuantumSim != NULL ? mQuantumSim->getRandomInt() : 0);
+}
+
+////////////////////////////////////////////////////
+// Reset every register to |0...0>                //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::reset()
+{
+    mState.zero();
+
+    // State 0 is the first row of lanes
+    for(size_t r = 0; r < mNumRegisters; r++)
+        mState.set(r, 1, 0);
+}
+
+////////////////////////////////////////////////////
+// Random streams                                 //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::setSeed( unsigned long long int seed )
+{
+    mSeed = seed;
+    mRandom.resize(mNumRegisters);
+
+    for(size_t r = 0; r < mNumRegisters; r++)
+        mRandom[r].setSeed(seed, r);
+}
+
+template<typename T>
+unsigned long long int ofxQuantumBatchRegisterT<T>::getSeed() const
+{
+    return mSeed;
+}
+
+////////////////////////////////////////////////////
+// Sizes                                          //
+////////////////////////////////////////////////////
+
+template<typename T>
+size_t ofxQuantumBatchRegisterT<T>::getNumRegisters() const
+{
+    return mNumRegisters;
+}
+
+template<typename T>
+int ofxQuantumBatchRegisterT<T>::size() const
+{
+    return (int)mRegSize;
+}
+
+template<typename T>
+unsigned long long int ofxQuantumBatchRegisterT<T>::getNumStates() const
+{
+    return mNumStates;
+}
+
+////////////////////////////////////////////////////
+// Get and set the amplitudes of one register     //
+////////////////////////////////////////////////////
+
+template<typename T>
+Complex ofxQuantumBatchRegisterT<T>::getState( size_t reg, unsigned long long int stateIndx ) const
+{
+    if(reg >= mNumRegisters || stateIndx >= mNumStates)
+    {
+        printf("ERROR! state %llu of register %zu is out of range\n", stateIndx, reg);
+        return Complex(0, 0);
+    }
+
+    return mState.get(stateIndx * mNumLanes + reg);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::setState( size_t reg, const Complex * new_state )
+{
+    if(reg >= mNumRegisters)
+    {
+        printf("ERROR! register %zu is out of range, the batch has %zu\n", reg, mNumRegisters);
+        return;
+    }
+
+    for(unsigned long long int i = 0; i < mNumStates; i++)
+        mState.set(i * mNumLanes + reg, new_state[i]);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure a qubit of every register. The probabilities of all lanes are
+// summed in one pass over the states, each register draws its outcome
+// from its own stream, then one more pass collapses every lane
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+std::vector<int> ofxQuantumBatchRegisterT<T>::measureBit( unsigned long long int bitIndx )
+{
+    std::vector<int> outcomes(mNumRegisters, 0);
+
+    if(bitIndx >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return outcomes;
+    }
+
+    std::vector<double> total, one;
+    laneProbs(bitIndx, total, one);
+
+    std::vector<double> probs(mNumRegisters, 0.0);
+
+    for(size_t r = 0; r < mNumRegisters; r++)
+    {
+        const double probOne = total[r] > 0.0 ? one[r] / total[r] : 0.0;
+
+        outcomes[r] = mRandom[r].nextDouble() < probOne ? 1 : 0;
+        probs[r]    = (outcomes[r] == 1 ? one[r] : total[r] - one[r]);
+    }
+
+    collapse(bitIndx, outcomes, probs);
+
+    return outcomes;
+}
+
+template<typename T>
+int ofxQuantumBatchRegisterT<T>::measureBit( size_t reg, unsigned long long int bitIndx )
+{
+    if(reg >= mNumRegisters || bitIndx >= mRegSize)
+    {
+        printf("ERROR! bit %llu of register %zu is out of range\n", bitIndx, reg);
+        return 0;
+    }
+
+    const unsigned long long int mask = bitMask(bitIndx);
+
+    double total = 0.0;
+    double one   = 0.0;
+
+    for(unsigned long long int i = 0; i < mNumStates; i++)
+    {
+        const double re = mState.real()[i * mNumLanes + reg];
+        const double im = mState.imag()[i * mNumLanes + reg];
+        const double a  = re * re + im * im;
+
+        total += a;
+
+        if(i & mask)
+            one += a;
+    }
+
+    const double probOne = total > 0.0 ? one / total : 0.0;
+
+    // Every other lane keeps its state
+    std::vector<int>    outcomes(mNumRegisters, -1);
+    std::vector<double> probs(mNumRegisters, 0.0);
+
+    outcomes[reg] = mRandom[reg].nextDouble() < probOne ? 1 : 0;
+    probs[reg]    = outcomes[reg] == 1 ? one : total - one;
+
+    collapse(bitIndx, outcomes, probs);
+
+    return outcomes[reg];
+}
+
+template<typename T>
+std::vector<unsigned long long int> ofxQuantumBatchRegisterT<T>::decimalMeasure()
+{
+    std::vector<unsigned long long int> values(mNumRegisters, 0);
+
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        const std::vector<int> bits = measureBit(q);
+
+        for(size_t r = 0; r < mNumRegisters; r++)
+            values[r] = (values[r] << 1) | (unsigned long long int)bits[r];
+    }
+
+    return values;
+}
+
+template<typename T>
+std::vector<double> ofxQuantumBatchRegisterT<T>::getBitProbs( unsigned long long int bitIndx ) const
+{
+    std::vector<double> probs(mNumRegisters, 0.0);
+
+    if(bitIndx >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return probs;
+    }
+
+    std::vector<double> total, one;
+    laneProbs(bitIndx, total, one);
+
+    for(size_t r = 0; r < mNumRegisters; r++)
+        probs[r] = total[r] > 0.0 ? one[r] / total[r] : 0.0;
+
+    return probs;
+}
+
+////////////////////////////////////////////////////
+// Single qubit gates                             //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGate( unsigned long long int bit, const Complex matrix[4] )
+{
+    applyControlledGate(std::vector<unsigned long long int>(), bit, matrix);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateX( unsigned long long int bit )
+{
+    apply(ofxQuantumGateX(), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateY( unsigned long long int bit )
+{
+    apply(ofxQuantumGateY(), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateZ( unsigned long long int bit )
+{
+    apply(ofxQuantumGateZ(), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateS( unsigned long long int bit )
+{
+    apply(ofxQuantumGateS(), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateT( unsigned long long int bit )
+{
+    apply(ofxQuantumGateT(), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateHad( unsigned long long int bit )
+{
+    apply(ofxQuantumGateHad(), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGatePhase( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGatePhase(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateRx( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRx(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateRy( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRy(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateRz( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRz(theta), bit);
+}
+
+////////////////////////////////////////////////////
+// Controlled gates                               //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyControlledGate( const std::vector<unsigned long long int> & controls,
+                                                       unsigned long long int target,
+                                                       const Complex matrix[4],
+                                                       unsigned long long int controlValues )
+{
+    const ofxQuantumGateMatrixT<T> m = ofxQuantumKernels::makeMatrix<T>(matrix);
+
+    T * re = mState.real();
+    T * im = mState.imag();
+
+    forEachControlledRun(controls, target, controlValues, [=, &m](size_t a0, size_t a1, size_t count)
+    {
+        ofxQuantumKernels::applyPairs(re, im, a0, a1, count, m);
+    });
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit )
+{
+    applyControlled(ofxQuantumGateX(), std::vector<unsigned long long int>(1, controlBit), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateToffoli( unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit )
+{
+    std::vector<unsigned long long int> controls;
+    controls.push_back(controlBit1);
+    controls.push_back(controlBit2);
+
+    applyControlled(ofxQuantumGateX(), controls, bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta )
+{
+    applyControlled(ofxQuantumGatePhase(theta), std::vector<unsigned long long int>(1, controlBit), bit);
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::setThreadPool( ofxQuantumThreadPool * threadPool )
+{
+    mThreadPool = threadPool;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Gate classes, as in ofxQuantumRegister but every run of states covers all the lanes, so
+// a permutation is one swap of two blocks, a diagonal gate one phase multiply per block
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateClass( const ofxQuantumPermutationGate &,
+                                                  const std::vector<unsigned long long int> & controls,
+                                                  unsigned long long int target,
+                                                  unsigned long long int controlValues,
+                                                  ofxQuantumPermutationClass )
+{
+    T * re = mState.real();
+    T * im = mState.imag();
+
+    forEachControlledRun(controls, target, controlValues, [=](size_t a0, size_t a1, size_t count)
+    {
+        ofxQuantumKernels::swapPairs(re, im, a0, a1, count);
+    });
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateClass( const ofxQuantumDiagonalGate & gate,
+                                                  const std::vector<unsigned long long int> & controls,
+                                                  unsigned long long int target,
+                                                  unsigned long long int controlValues,
+                                                  ofxQuantumDiagonalClass )
+{
+    T *                          re = mState.real();
+    T *                          im = mState.imag();
+    const ofxQuantumDiagonalGate d  = gate;
+
+    const bool skip0 = d.phase0Re == 1.0 && d.phase0Im == 0.0;
+    const bool skip1 = d.phase1Re == 1.0 && d.phase1Im == 0.0;
+
+    forEachControlledRun(controls, target, controlValues, [=](size_t a0, size_t a1, size_t count)
+    {
+        if(!skip0)
+            ofxQuantumKernels::multiplyPhase(re + a0, im + a0, count, d.phase0Re, d.phase0Im);
+        if(!skip1)
+            ofxQuantumKernels::multiplyPhase(re + a1, im + a1, count, d.phase1Re, d.phase1Im);
+    });
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::applyGateClass( const ofxQuantumDenseGate & gate,
+                                                  const std::vector<unsigned long long int> & controls,
+                                                  unsigned long long int target,
+                                                  unsigned long long int controlValues,
+                                                  ofxQuantumDenseClass )
+{
+    Complex matrix[4];
+    gate.getMatrix(matrix);
+
+    applyControlledGate(controls, target, matrix, controlValues);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Visit the runs of target pairs whose controls hold their values, as the register does.
+// A run of states is contiguous in the state index so with the lanes interleaved it is a
+// single block of runLength * lanes amplitudes
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumBatchRegisterT<T>::forEachControlledRun( const std::vector<unsigned long long int> & controls,
+                                                        unsigned long long int target,
+                                                        unsigned long long int controlValues,
+                                                        const std::function<void (size_t, size_t, size_t)> & fn )
+{
+    if(target >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return false;
+    }
+
+    unsigned long long int controlMask = 0;
+    unsigned long long int controlBits = 0;
+
+    for(size_t j = 0; j < controls.size(); j++)
+    {
+        if(controls[j] >= mRegSize || ((controlMask | bitMask(target)) & bitMask(controls[j])) != 0)
+        {
+            printf("ERROR! invalid control bit %llu for target %llu\n", controls[j], target);
+            return false;
+        }
+
+        controlMask |= bitMask(controls[j]);
+
+        if((controlValues >> j) & 1)
+            controlBits |= bitMask(controls[j]);
+    }
+
+    const unsigned long long int fixedMask  = controlMask | bitMask(target);
+    const unsigned long long int targetMask = bitMask(target);
+    const unsigned long long int numPairs   = mNumStates >> (controls.size() + 1);
+    const unsigned long long int runLength  = fixedMask & (~fixedMask + 1);
+    const size_t                 lanes      = mNumLanes;
+
+    std::function<void (size_t, size_t)> runs = [&](size_t begin, size_t end)
+    {
+        for(unsigned long long int run = begin; run < end; run++)
+        {
+            const unsigned long long int i0 = ofxQuantumKernels::insertZeroBits(run * runLength, fixedMask) | controlBits;
+
+            fn(i0 * lanes, (i0 | targetMask) * lanes, runLength * lanes);
+        }
+    };
+
+    // Split the runs between threads once the batch is large enough, keeping about a grain of amplitudes per chunk
+    const size_t           numRuns = numPairs / runLength;
+    const size_t           work    = mNumStates * mNumLanes;
+    ofxQuantumThreadPool * pool    = mThreadPool != NULL ? mThreadPool : (mQuantumSim != NULL ? &mQuantumSim->getThreadPool() : NULL);
+
+    if(pool != NULL && work >= QUANTUM_PARALLEL_THRESHOLD)
+    {
+        const size_t grain = QUANTUM_PARALLEL_GRAIN / (runLength * lanes) + 1;
+        pool->parallelFor(0, numRuns, grain, runs);
+    }
+    else
+    {
+        runs(0, numRuns);
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Collapse each lane on its outcome, the kept half is renormalised by
+// that lane's own factor and the other half is zeroed. The factors are
+// per lane so the inner loop runs straight across the registers
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::collapse( unsigned long long int bitIndx, const std::vector<int> & outcomes, const std::vector<double> & probs )
+{
+    std::vector<T> factor0(mNumLanes, (T)1);
+    std::vector<T> factor1(mNumLanes, (T)1);
+
+    for(size_t r = 0; r < mNumRegisters; r++)
+    {
+        if(outcomes[r] < 0)
+            continue;
+
+        const T keep = probs[r] > 0.0 ? (T)(1.0 / sqrt(probs[r])) : (T)0;
+
+        factor0[r] = outcomes[r] == 0 ? keep : (T)0;
+        factor1[r] = outcomes[r] == 1 ? keep : (T)0;
+    }
+
+    const unsigned long long int mask = bitMask(bitIndx);
+
+    for(unsigned long long int i = 0; i < mNumStates; i++)
+    {
+        T *       re     = mState.real() + i * mNumLanes;
+        T *       im     = mState.imag() + i * mNumLanes;
+        const T * factor = (i & mask) ? &factor1[0] : &factor0[0];
+
+        for(size_t r = 0; r < mNumLanes; r++)
+        {
+            re[r] *= factor[r];
+            im[r] *= factor[r];
+        }
+    }
+}
+
+template<typename T>
+void ofxQuantumBatchRegisterT<T>::laneProbs( unsigned long long int bitIndx, std::vector<double> & total, std::vector<double> & one ) const
+{
+    total.assign(mNumLanes, 0.0);
+    one.assign(mNumLanes, 0.0);
+
+    const unsigned long long int mask = bitMask(bitIndx);
+
+    for(unsigned long long int i = 0; i < mNumStates; i++)
+    {
+        const T * re = mState.real() + i * mNumLanes;
+        const T * im = mState.imag() + i * mNumLanes;
+
+        for(size_t r = 0; r < mNumLanes; r++)
+            total[r] += (double)re[r] * re[r] + (double)im[r] * im[r];
+
+        if(i & mask)
+        {
+            for(size_t r = 0; r < mNumLanes; r++)
+                one[r] += (double)re[r] * re[r] + (double)im[r] * im[r];
+        }
+    }
+}
+
+// Single and double precision batches
+template class ofxQuantumBatchRegisterT<float>;
+template class ofxQuantumBatchRegisterT<double>;
@@ -0,0 +1,173 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumBatchRegister.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumBatchRegister holds many small independent registers of the same size in one buffer and applies the same
+//  gates to all of them at once. The amplitudes are interleaved, amplitude i of register r sits at i * lanes + r, so the
+//  registers are the lanes of each state and every gate becomes a few long sweeps of the ordinary vector kernels across
+//  all the registers instead of hundreds of tiny loops on separate heap objects. The number of lanes is rounded up to a
+//  whole cache line, the spare lanes hold zeros and are never measured.
+//
+//  Every register keeps its own random stream, numbered by the register, so measurements collapse each register on its
+//  own outcome and a batch with the same seed repeats exactly.
+//
+//  ofxQuantumBatchRegister batch( 500, 3, &quantumSim );
+//  batch.applyGateHad(0);
+//  batch.applyGateControlledNot(0, 1);
+//  std::vector<unsigned long long int> values = batch.decimalMeasure();
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMBATCHREGISTER_H
+#define OFXQUANTUMBATCHREGISTER_H
+
+// Includes
+#include <stddef.h>
+#include <vector>
+#include <functional>
+#include "Complex.h"
+#include "ofxQuantumGates.h"
+#include "ofxQuantumStateBuffer.h"
+#include "ofxQuantumRandom.h"
+
+// Largest register size in a batch, a batch is meant for many small registers
+#define QUANTUM_BATCH_MAX_QUBITS 24
+
+// Forward declarations
+class ofxQuantum;
+class ofxQuantumThreadPool;
+
+template<typename T>
+class ofxQuantumBatchRegisterT
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, numRegisters registers of size qubits, each in the state |0...0>. The seed of the random streams is
+    // taken from the quantum simulator
+    ofxQuantumBatchRegisterT( size_t numRegisters, unsigned long long int size, ofxQuantum *quantumSim );
+
+    // Put every register back in the state |0...0>
+    void reset();
+
+    // Restart the random streams from a seed, register r uses stream r
+    void                   setSeed( unsigned long long int seed );
+    unsigned long long int getSeed() const;
+
+    // Number of registers and number of qubits in each
+    size_t getNumRegisters() const;
+    int    size() const;
+
+    // Get the number of states in each register
+    unsigned long long int getNumStates() const;
+
+    // Amplitude of a state of one register
+    Complex getState( size_t reg, unsigned long long int stateIndx ) const;
+
+    // Set every amplitude of one register, new_state holds getNumStates() values
+    void setState( size_t reg, const Complex * new_state );
+
+    // Measure a qubit of every register, each collapses on its own outcome. Returns one value per register
+    std::vector<int> measureBit( unsigned long long int bitIndx );
+
+    // Measure a qubit of a single register
+    int measureBit( size_t reg, unsigned long long int bitIndx );
+
+    // Measure every qubit of every register, qubit 0 is the most significant bit of each value
+    std::vector<unsigned long long int> decimalMeasure();
+
+    // Chance of measuring 1 on a qubit of every register, without collapsing them
+    std::vector<double> getBitProbs( unsigned long long int bitIndx ) const;
+
+    // Same gates as ofxQuantumRegister, applied to every register
+    void applyGate(      unsigned long long int bit, const Complex matrix[4] );
+    void applyGateX(     unsigned long long int bit );
+    void applyGateY(     unsigned long long int bit );
+    void applyGateZ(     unsigned long long int bit );
+    void applyGateS(     unsigned long long int bit );
+    void applyGateT(     unsigned long long int bit );
+    void applyGateHad(   unsigned long long int bit );
+    void applyGatePhase( unsigned long long int bit, double theta );
+    void applyGateRx(    unsigned long long int bit, double theta );
+    void applyGateRy(    unsigned long long int bit, double theta );
+    void applyGateRz(    unsigned long long int bit, double theta );
+
+    void applyControlledGate(      const std::vector<unsigned long long int> & controls,
+                                   unsigned long long int target,
+                                   const Complex matrix[4],
+                                   unsigned long long int controlValues = ~0ULL );
+    void applyGateControlledNot(   unsigned long long int controlBit, unsigned long long int bit );
+    void applyGateToffoli(         unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit );
+    void applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta );
+
+    // Apply a gate type from ofxQuantumGates.h, the kernel is chosen from the class of the gate as in ofxQuantumRegister
+    template<typename Gate>
+    void apply( const Gate & gate, unsigned long long int bit )
+    {
+        applyGateClass(gate, std::vector<unsigned long long int>(), bit, ~0ULL, typename Gate::GateClass());
+    }
+
+    template<typename Gate>
+    void applyControlled( const Gate & gate,
+                          const std::vector<unsigned long long int> & controls,
+                          unsigned long long int target,
+                          unsigned long long int controlValues = ~0ULL )
+    {
+        applyGateClass(gate, controls, target, controlValues, typename Gate::GateClass());
+    }
+
+    // Run the gate loops on a specific thread pool, by default the pool of the linked ofxQuantum is used
+    void setThreadPool( ofxQuantumThreadPool * threadPool );
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Kernel for each class of gate, picked by overload on the GateClass tag
+    void applyGateClass( const ofxQuantumPermutationGate & gate, const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumPermutationClass );
+    void applyGateClass( const ofxQuantumDiagonalGate & gate,    const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumDiagonalClass );
+    void applyGateClass( const ofxQuantumDenseGate & gate,       const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumDenseClass );
+
+    // Call fn(a0, a1, count) for every run of target pairs whose controls hold their values. a0 and a1 are amplitude
+    // offsets and count is a number of amplitudes, each run already covers every lane
+    bool forEachControlledRun( const std::vector<unsigned long long int> & controls, unsigned long long int target,
+                               unsigned long long int controlValues, const std::function<void (size_t, size_t, size_t)> & fn );
+
+    // Collapse each lane of a qubit on its outcome, lanes with an outcome of -1 are left as they are
+    void collapse( unsigned long long int bitIndx, const std::vector<int> & outcomes, const std::vector<double> & probs );
+
+    // Sum of |a|^2 of each lane, and of the states where a qubit is 1
+    void laneProbs( unsigned long long int bitIndx, std::vector<double> & total, std::vector<double> & one ) const;
+
+    // Mask of the state index bit that holds a qubit, qubit 0 is the most significant bit
+    unsigned long long int bitMask( unsigned long long int bit ) const { return 1ULL << (mRegSize - 1 - bit); }
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantumStateBufferT<T>      mState;          // Interleaved amplitudes, state major and register minor
+    std::vector<ofxQuantumRandom>  mRandom;         // Random stream of each register
+    ofxQuantum *                   mQuantumSim;     // Quantum simulator the seed and the threads come from
+    ofxQuantumThreadPool *         mThreadPool;     // Thread pool to use instead of the simulator's, can be NULL
+    unsigned long long int         mSeed;           // Seed of the random streams
+    size_t                         mNumRegisters;   // Number of registers in the batch
+    size_t                         mNumLanes;       // Registers rounded up to a cache line of amplitudes
+    unsigned long long int         mRegSize;        // Qubits in each register
+    unsigned long long int         mNumStates;      // States in each register, 2 ^ mRegSize
+};
+
+// Double precision batch, the default
+typedef ofxQuantumBatchRegisterT<double> ofxQuantumBatchRegister;
+
+#endif
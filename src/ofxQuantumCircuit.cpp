@@ -0,0 +1,821 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumCircuit.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumCircuit.h"
+#include "ofxQuantumRegister.h"
+
+#include <algorithm>
+#include <math.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////
+// Constructor, links to the register             //
+////////////////////////////////////////////////////
+template<typename T>
+ofxQuantumCircuitT<T>::ofxQuantumCircuitT( ofxQuantumRegisterT<T> * reg )
+{
+    mRegister        = reg;
+    mMaxFusedQubits  = QUANTUM_DEFAULT_FUSED_QUBITS;
+    mLastFlushPasses = 0;
+    mLastFlushGates  = 0;
+
+    if(mRegister != NULL)
+    {
+        // Only one circuit records into a register at a time
+        if(mRegister->mCircuit != NULL)
+        {
+            mRegister->mCircuit->flush();
+            mRegister->mCircuit->detach();
+        }
+
+        mRegister->mCircuit = this;
+    }
+}
+
+////////////////////////////////////////////////////
+// Destructor                                     //
+////////////////////////////////////////////////////
+template<typename T>
+ofxQuantumCircuitT<T>::~ofxQuantumCircuitT()
+{
+    flush();
+
+    if(mRegister != NULL)
+        mRegister->mCircuit = NULL;
+}
+
+////////////////////////////////////////////////////
+// Unlink from the register                       //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::detach()
+{
+    mPending.clear();
+    mRegister = NULL;
+}
+
+////////////////////////////////////////////////////
+// Add a gate to the queue                        //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::record( const Operation & op )
+{
+    if(mRegister == NULL)
+    {
+        printf("ERROR! circuit is not linked to a register\n");
+        return;
+    }
+
+    if(checkOperation(op))
+        mPending.push_back(op);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Check the qubits of an operation are in the register and distinct,
+// printing the same errors the register does. Fusion and the pass
+// planner index tables by qubit, so nothing unchecked reaches them
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+bool ofxQuantumCircuitT<T>::checkOperation( const Operation & op ) const
+{
+    const unsigned long long int regSize = mRegister->mRegSize;
+    const size_t                 k       = op.qubits.size();
+
+    if(op.numControls > 0 || k == 1)
+    {
+        const unsigned long long int target = op.qubits[k - 1];
+
+        if(target >= regSize)
+        {
+            printf("ERROR! bit indx out of range, max indx: %llu\n", regSize);
+            return false;
+        }
+
+        for(size_t c = 0; c + 1 < k; c++)
+        {
+            bool repeated = op.qubits[c] == target;
+
+            for(size_t d = 0; d < c; d++)
+                repeated = repeated || op.qubits[d] == op.qubits[c];
+
+            if(op.qubits[c] >= regSize || repeated)
+            {
+                printf("ERROR! invalid control bit %llu for target %llu\n", op.qubits[c], target);
+                return false;
+            }
+        }
+    }
+    else
+    {
+        if(k == 0 || k > regSize)
+        {
+            printf("ERROR! invalid number of qubits %zu for a register of %llu\n", k, regSize);
+            return false;
+        }
+
+        for(size_t j = 0; j < k; j++)
+        {
+            bool repeated = false;
+
+            for(size_t d = 0; d < j; d++)
+                repeated = repeated || op.qubits[d] == op.qubits[j];
+
+            if(op.qubits[j] >= regSize || repeated)
+            {
+                printf("ERROR! invalid qubit %llu in multi qubit gate\n", op.qubits[j]);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////
+// Record an arbitrary single qubit gate          //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGate( unsigned long long int bit, const Complex matrix[4] )
+{
+    Operation op;
+    op.qubits.push_back(bit);
+    op.numControls   = 0;
+    op.controlValues = 0;
+
+    for(int i = 0; i < 4; i++)
+        op.matrix.push_back(Amplitude(matrix[i].getReal(), matrix[i].getImag()));
+
+    record(op);
+}
+
+////////////////////////////////////////////////////
+// Record single qubit gates                      //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateX( unsigned long long int bit )
+{
+    recordGate(ofxQuantumGateX(), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateY( unsigned long long int bit )
+{
+    recordGate(ofxQuantumGateY(), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateZ( unsigned long long int bit )
+{
+    recordGate(ofxQuantumGateZ(), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateS( unsigned long long int bit )
+{
+    recordGate(ofxQuantumGateS(), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateT( unsigned long long int bit )
+{
+    recordGate(ofxQuantumGateT(), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateHad( unsigned long long int bit )
+{
+    recordGate(ofxQuantumGateHad(), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGatePhase( unsigned long long int bit, double theta )
+{
+    recordGate(ofxQuantumGatePhase(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateRx( unsigned long long int bit, double theta )
+{
+    recordGate(ofxQuantumGateRx(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateRy( unsigned long long int bit, double theta )
+{
+    recordGate(ofxQuantumGateRy(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateRz( unsigned long long int bit, double theta )
+{
+    recordGate(ofxQuantumGateRz(theta), bit);
+}
+
+////////////////////////////////////////////////////
+// Record a controlled gate                       //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::applyControlledGate( const std::vector<unsigned long long int> & controls,
+                                             unsigned long long int target,
+                                             const Complex matrix[4],
+                                             unsigned long long int controlValues )
+{
+    Operation op;
+    op.qubits        = controls;
+    op.qubits.push_back(target);
+    op.numControls   = controls.size();
+    op.controlValues = controlValues;
+
+    for(int i = 0; i < 4; i++)
+        op.matrix.push_back(Amplitude(matrix[i].getReal(), matrix[i].getImag()));
+
+    record(op);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit )
+{
+    Complex pauliX[4];
+    ofxQuantumGateX().getMatrix(pauliX);
+
+    applyControlledGate(std::vector<unsigned long long int>(1, controlBit), bit, pauliX);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateToffoli( unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit )
+{
+    Complex pauliX[4];
+    ofxQuantumGateX().getMatrix(pauliX);
+
+    std::vector<unsigned long long int> controls;
+    controls.push_back(controlBit1);
+    controls.push_back(controlBit2);
+
+    applyControlledGate(controls, bit, pauliX);
+}
+
+template<typename T>
+void ofxQuantumCircuitT<T>::applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta )
+{
+    Complex phase[4];
+    ofxQuantumGatePhase(theta).getMatrix(phase);
+
+    applyControlledGate(std::vector<unsigned long long int>(1, controlBit), bit, phase);
+}
+
+////////////////////////////////////////////////////
+// Record a dense multi qubit gate                //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::applyMultiQubitGate( const std::vector<unsigned long long int> & qubits, const Complex * matrix )
+{
+    Operation op;
+    op.qubits        = qubits;
+    op.numControls   = 0;
+    op.controlValues = 0;
+
+    const size_t dim = (size_t)1 << qubits.size();
+    for(size_t i = 0; i < dim * dim; i++)
+        op.matrix.push_back(Amplitude(matrix[i].getReal(), matrix[i].getImag()));
+
+    record(op);
+}
+
+////////////////////////////////////////////////////
+// Pending gate count                             //
+////////////////////////////////////////////////////
+template<typename T>
+size_t ofxQuantumCircuitT<T>::getNumPending() const
+{
+    return mPending.size();
+}
+
+////////////////////////////////////////////////////
+// Fusion settings and statistics                 //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::setMaxFusedQubits( int maxQubits )
+{
+    mMaxFusedQubits = maxQubits < 1 ? 1 : maxQubits;
+}
+
+template<typename T>
+int ofxQuantumCircuitT<T>::getMaxFusedQubits() const
+{
+    return mMaxFusedQubits;
+}
+
+template<typename T>
+size_t ofxQuantumCircuitT<T>::getLastFlushPasses() const
+{
+    return mLastFlushPasses;
+}
+
+template<typename T>
+size_t ofxQuantumCircuitT<T>::getLastFlushGates() const
+{
+    return mLastFlushGates;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Fuse the pending gates and apply them. The first pass folds each
+// single qubit gate into the previous gate on the same qubit when that
+// gate is also a single qubit gate and nothing in between touches the
+// qubit. The second pass walks the result in order and grows a dense
+// block for as long as the union of qubits fits in mMaxFusedQubits.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::flush()
+{
+    if(mRegister == NULL || mPending.empty())
+        return;
+
+    // Take the queue first, applying gates to the register calls back into flush
+    std::vector<Operation> ops;
+    ops.swap(mPending);
+
+    mLastFlushGates  = ops.size();
+    mLastFlushPasses = 0;
+
+    // Merge runs of single qubit gates on the same qubit
+    std::vector<Operation> merged;
+
+    for(size_t i = 0; i < ops.size(); i++)
+    {
+        const Operation & op = ops[i];
+
+        // Recorded against the register as it was, check again in case it has changed size since
+        if(!checkOperation(op))
+            continue;
+
+        if(op.numControls == 0 && op.qubits.size() == 1)
+        {
+            // Find the last gate that touches this qubit
+            size_t j = merged.size();
+            while(j > 0)
+            {
+                const std::vector<unsigned long long int> & q = merged[j - 1].qubits;
+                if(std::find(q.begin(), q.end(), op.qubits[0]) != q.end())
+                    break;
+                j--;
+            }
+
+            if(j > 0 && merged[j - 1].numControls == 0 && merged[j - 1].qubits.size() == 1)
+            {
+                merged[j - 1].matrix = multiply(op.matrix, merged[j - 1].matrix);
+                continue;
+            }
+        }
+
+        merged.push_back(op);
+    }
+
+    Pass pass;
+    pass.enabled = mRegister->getPassLayout(pass.chunkQubits, pass.maxPassQubits);
+
+    if(pass.enabled)
+        arrangeQubits(merged, pass);
+
+    // Grow dense blocks over neighbouring gates
+    std::vector<unsigned long long int> blockQubits;
+    std::vector<Amplitude>              blockMatrix;
+    size_t                              blockCount = 0;
+    size_t                              blockFirst = 0;
+
+    for(size_t i = 0; i <= merged.size(); i++)
+    {
+        bool fits = false;
+        std::vector<unsigned long long int> unionQubits = blockQubits;
+
+        if(i < merged.size())
+        {
+            for(size_t j = 0; j < merged[i].qubits.size(); j++)
+            {
+                if(std::find(unionQubits.begin(), unionQubits.end(), merged[i].qubits[j]) == unionQubits.end())
+                    unionQubits.push_back(merged[i].qubits[j]);
+            }
+
+            fits = (int)unionQubits.size() <= mMaxFusedQubits;
+        }
+
+        // Extend the current block
+        if(fits && blockCount > 0)
+        {
+            blockMatrix = multiply(expandMatrix(denseMatrix(merged[i]), merged[i].qubits, unionQubits),
+                                   expandMatrix(blockMatrix, blockQubits, unionQubits));
+            blockQubits = unionQubits;
+            blockCount++;
+            continue;
+        }
+
+        // Otherwise apply the finished block
+        if(blockCount == 1)
+        {
+            queueOperation(merged[blockFirst], pass);
+        }
+        else if(blockCount > 1)
+        {
+            Operation block;
+            block.qubits        = blockQubits;
+            block.matrix        = blockMatrix;
+            block.numControls   = 0;
+            block.controlValues = ~0ULL;
+
+            queueOperation(block, pass);
+        }
+
+        blockQubits.clear();
+        blockMatrix.clear();
+        blockCount = 0;
+
+        if(i == merged.size())
+        {
+            applyPass(pass);
+            break;
+        }
+
+        // Start a new block, gates that are too wide on their own are applied as they are
+        if((int)merged[i].qubits.size() <= mMaxFusedQubits)
+        {
+            blockQubits = merged[i].qubits;
+            blockMatrix = denseMatrix(merged[i]);
+            blockCount  = 1;
+            blockFirst  = i;
+        }
+        else
+        {
+            queueOperation(merged[i], pass);
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Count the passes a list of operations takes with the qubits stored at
+// the given positions, grouped the same way as queueOperation
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+size_t ofxQuantumCircuitT<T>::countPasses( const std::vector<Operation> & ops, const std::vector<unsigned long long int> & layout,
+                                           unsigned long long int firstLow, unsigned long long int maxPassQubits )
+{
+    size_t                              passes = 0;
+    std::vector<unsigned long long int> passPositions;
+
+    for(size_t i = 0; i < ops.size(); i++)
+    {
+        std::vector<unsigned long long int> positions = passPositions;
+
+        for(size_t j = 0; j < ops[i].qubits.size(); j++)
+        {
+            const unsigned long long int position = layout[ops[i].qubits[j]];
+
+            if(position < firstLow && std::find(positions.begin(), positions.end(), position) == positions.end())
+                positions.push_back(position);
+        }
+
+        if(positions.size() > maxPassQubits && i > 0)
+        {
+            passes++;
+
+            positions.clear();
+            for(size_t j = 0; j < ops[i].qubits.size(); j++)
+            {
+                const unsigned long long int position = layout[ops[i].qubits[j]];
+
+                if(position < firstLow && std::find(positions.begin(), positions.end(), position) == positions.end())
+                    positions.push_back(position);
+            }
+        }
+
+        passPositions.swap(positions);
+    }
+
+    return ops.empty() ? 0 : passes + 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Decide whether to move the amplitudes so the most used qubits sit in
+// the chunk, where any number of them fit in one pass. Each qubit moved
+// in costs one sweep over the state, so the new layout is only taken
+// when it saves more passes than that
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::arrangeQubits( const std::vector<Operation> & ops, const Pass & pass )
+{
+    const unsigned long long int regSize  = mRegister->mRegSize;
+    const unsigned long long int firstLow = regSize > pass.chunkQubits ? regSize - pass.chunkQubits : 0;
+
+    if(firstLow == 0)
+        return;
+
+    const std::vector<unsigned long long int> layout = mRegister->getQubitLayout();
+
+    std::vector<size_t> uses(regSize, 0);
+
+    for(size_t i = 0; i < ops.size(); i++)
+    {
+        for(size_t j = 0; j < ops[i].qubits.size(); j++)
+            uses[ops[i].qubits[j]]++;
+    }
+
+    // Most used first, a qubit already in the chunk wins a tie so nothing moves for nothing
+    std::vector<unsigned long long int> byUse(regSize);
+    for(unsigned long long int q = 0; q < regSize; q++)
+        byUse[q] = q;
+
+    std::stable_sort(byUse.begin(), byUse.end(), [&](unsigned long long int a, unsigned long long int b)
+    {
+        if(uses[a] != uses[b])
+            return uses[a] > uses[b];
+        return layout[a] > layout[b];
+    });
+
+    // Qubits that belong in the chunk but are above it, and chunk qubits that make room for them
+    std::vector<bool>                   inChunk(regSize, false);
+    std::vector<unsigned long long int> movingIn, movingOut;
+
+    for(unsigned long long int k = 0; k < regSize - firstLow; k++)
+    {
+        inChunk[byUse[k]] = true;
+        if(layout[byUse[k]] < firstLow)
+            movingIn.push_back(byUse[k]);
+    }
+
+    for(unsigned long long int q = 0; q < regSize; q++)
+    {
+        if(!inChunk[q] && layout[q] >= firstLow)
+            movingOut.push_back(q);
+    }
+
+    if(movingIn.empty())
+        return;
+
+    std::vector<unsigned long long int> arranged = layout;
+
+    for(size_t k = 0; k < movingIn.size(); k++)
+        std::swap(arranged[movingIn[k]], arranged[movingOut[k]]);
+
+    const size_t before = countPasses(ops, layout,   firstLow, pass.maxPassQubits);
+    const size_t after  = countPasses(ops, arranged, firstLow, pass.maxPassQubits);
+
+    if(before > after + movingIn.size())
+    {
+        mRegister->setQubitLayout(arranged);
+        mLastFlushPasses += movingIn.size();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Apply an operation, or queue it in the pass. The pass qubits are the
+// ones above the chunk, a pass that would need more of them than fit in
+// a tile is applied first. An operation wider than a pass on its own
+// still gets a pass to itself, its tile is just larger
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::queueOperation( const Operation & op, Pass & pass )
+{
+    if(!pass.enabled)
+    {
+        applyOperation(op, *mRegister);
+        mLastFlushPasses++;
+        return;
+    }
+
+    const unsigned long long int regSize  = mRegister->mRegSize;
+    const unsigned long long int firstLow = regSize > pass.chunkQubits ? regSize - pass.chunkQubits : 0;
+
+    std::vector<unsigned long long int> passQubits = pass.passQubits;
+
+    for(size_t j = 0; j < op.qubits.size(); j++)
+    {
+        if(mRegister->mQubitMap[op.qubits[j]] < firstLow && std::find(passQubits.begin(), passQubits.end(), op.qubits[j]) == passQubits.end())
+            passQubits.push_back(op.qubits[j]);
+    }
+
+    if(passQubits.size() > pass.maxPassQubits && !pass.ops.empty())
+    {
+        applyPass(pass);
+
+        passQubits.clear();
+        for(size_t j = 0; j < op.qubits.size(); j++)
+        {
+            if(mRegister->mQubitMap[op.qubits[j]] < firstLow && std::find(passQubits.begin(), passQubits.end(), op.qubits[j]) == passQubits.end())
+                passQubits.push_back(op.qubits[j]);
+        }
+    }
+
+    for(size_t j = 0; j < op.qubits.size(); j++)
+    {
+        if(std::find(pass.qubits.begin(), pass.qubits.end(), op.qubits[j]) == pass.qubits.end())
+            pass.qubits.push_back(op.qubits[j]);
+    }
+
+    pass.ops.push_back(op);
+    pass.passQubits.swap(passQubits);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Apply a pass. The operations are renumbered onto the qubits of the
+// tile register once, then every tile gets the same list
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::applyPass( Pass & pass )
+{
+    if(pass.ops.empty())
+        return;
+
+    const std::vector<unsigned long long int> local = mRegister->getPassLocalQubits(pass.qubits, pass.chunkQubits);
+
+    std::vector<Operation> & ops = pass.ops;
+
+    for(size_t i = 0; i < ops.size(); i++)
+    {
+        for(size_t j = 0; j < ops[i].qubits.size(); j++)
+            ops[i].qubits[j] = local[ops[i].qubits[j]];
+    }
+
+    mRegister->applyPass(pass.qubits, pass.chunkQubits, [&](ofxQuantumRegisterT<T> & tile)
+    {
+        for(size_t i = 0; i < ops.size(); i++)
+            applyOperation(ops[i], tile);
+    });
+
+    mLastFlushPasses++;
+
+    pass.ops.clear();
+    pass.qubits.clear();
+    pass.passQubits.clear();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Apply one operation as it was recorded. A 2x2 matrix, on its own or
+// as the target of controls, is checked for the cheaper gate classes.
+// The test is exact, a fused product that only comes close to diagonal
+// stays on the dense kernel.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumCircuitT<T>::applyOperation( const Operation & op, ofxQuantumRegisterT<T> & reg )
+{
+    if(op.matrix.size() == 4)
+    {
+        const std::vector<unsigned long long int> controls(op.qubits.begin(), op.qubits.begin() + op.numControls);
+        const unsigned long long int              target = op.qubits.back();
+        const Amplitude *                         u      = &op.matrix[0];
+        const Amplitude                           zero(0, 0);
+        const Amplitude                           one(1, 0);
+
+        if(u[1] == zero && u[2] == zero)
+        {
+            reg.applyControlled(ofxQuantumDiagonalGate(u[0].real(), u[0].imag(), u[3].real(), u[3].imag()),
+                                       controls, target, op.controlValues);
+        }
+        else if(u[0] == zero && u[3] == zero && u[1] == one && u[2] == one)
+        {
+            reg.applyControlled(ofxQuantumGateX(), controls, target, op.controlValues);
+        }
+        else
+        {
+            reg.applyControlled(ofxQuantumDenseGate(u[0].real(), u[0].imag(), u[1].real(), u[1].imag(),
+                                                           u[2].real(), u[2].imag(), u[3].real(), u[3].imag()),
+                                       controls, target, op.controlValues);
+        }
+        return;
+    }
+
+    std::vector<Complex> matrix(op.matrix.size());
+    for(size_t j = 0; j < op.matrix.size(); j++)
+        matrix[j] = Complex(op.matrix[j].real(), op.matrix[j].imag());
+
+    reg.applyMultiQubitGate(op.qubits, &matrix[0]);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Dense matrix of an operation. For a controlled gate the target is the
+// lowest local bit, the matrix is the identity except on the rows and
+// columns where every control holds its required value.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+std::vector<typename ofxQuantumCircuitT<T>::Amplitude> ofxQuantumCircuitT<T>::denseMatrix( const Operation & op )
+{
+    if(op.numControls == 0)
+        return op.matrix;
+
+    const size_t k   = op.qubits.size();
+    const size_t dim = (size_t)1 << k;
+
+    // Local pattern the control bits must match
+    size_t pattern = 0;
+    for(size_t j = 0; j < op.numControls; j++)
+    {
+        if((op.controlValues >> j) & 1)
+            pattern |= (size_t)1 << (k - 1 - j);
+    }
+
+    std::vector<Amplitude> m(dim * dim, Amplitude(0, 0));
+
+    for(size_t r = 0; r < dim; r++)
+    {
+        for(size_t c = 0; c < dim; c++)
+        {
+            if((r >> 1) != (c >> 1))
+                continue;
+
+            if((r & ~(size_t)1) == pattern)
+                m[r * dim + c] = op.matrix[(r & 1) * 2 + (c & 1)];
+            else if(r == c)
+                m[r * dim + c] = Amplitude(1, 0);
+        }
+    }
+
+    return m;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Embed a matrix over qubits into the space of target qubits, which must
+// contain all of them. Entries are only non zero where the bits of the
+// extra qubits are the same in the row and column.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+std::vector<typename ofxQuantumCircuitT<T>::Amplitude> ofxQuantumCircuitT<T>::expandMatrix( const std::vector<Amplitude> & matrix,
+                                                                           const std::vector<unsigned long long int> & qubits,
+                                                                           const std::vector<unsigned long long int> & target )
+{
+    const size_t k      = qubits.size();
+    const size_t kt     = target.size();
+    const size_t dim    = (size_t)1 << k;
+    const size_t dimT   = (size_t)1 << kt;
+
+    if(k == kt && qubits == target)
+        return matrix;
+
+    // Local bit in the target space of each of our qubits
+    std::vector<size_t> bits(k);
+    size_t              used = 0;
+
+    for(size_t j = 0; j < k; j++)
+    {
+        const size_t pos = std::find(target.begin(), target.end(), qubits[j]) - target.begin();
+        bits[j] = kt - 1 - pos;
+        used   |= (size_t)1 << bits[j];
+    }
+
+    std::vector<Amplitude> m(dimT * dimT, Amplitude(0, 0));
+
+    for(size_t r = 0; r < dimT; r++)
+    {
+        size_t rq = 0;
+        for(size_t j = 0; j < k; j++)
+            rq |= ((r >> bits[j]) & 1) << (k - 1 - j);
+
+        for(size_t c = 0; c < dimT; c++)
+        {
+            if((r & ~used) != (c & ~used))
+                continue;
+
+            size_t cq = 0;
+            for(size_t j = 0; j < k; j++)
+                cq |= ((c >> bits[j]) & 1) << (k - 1 - j);
+
+            m[r * dimT + c] = matrix[rq * dim + cq];
+        }
+    }
+
+    return m;
+}
+
+////////////////////////////////////////////////////
+// Square matrix product a * b                    //
+////////////////////////////////////////////////////
+template<typename T>
+std::vector<typename ofxQuantumCircuitT<T>::Amplitude> ofxQuantumCircuitT<T>::multiply( const std::vector<Amplitude> & a, const std::vector<Amplitude> & b )
+{
+    size_t dim = 1;
+    while(dim * dim < a.size())
+        dim++;
+
+    std::vector<Amplitude> m(dim * dim, Amplitude(0, 0));
+
+    for(size_t r = 0; r < dim; r++)
+    {
+        for(size_t i = 0; i < dim; i++)
+        {
+            const Amplitude ari = a[r * dim + i];
+            if(ari == Amplitude(0, 0))
+                continue;
+
+            for(size_t c = 0; c < dim; c++)
+                m[r * dim + c] += ari * b[i * dim + c];
+        }
+    }
+
+    return m;
+}
+
+// Circuits for single and double precision registers
+template class ofxQuantumCircuitT<float>;
+template class ofxQuantumCircuitT<double>;
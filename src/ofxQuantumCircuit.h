@@ -0,0 +1,186 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumCircuit.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumCircuit records gates for a quantum register instead of applying them straight away. When the circuit is
+//  flushed, runs of single qubit gates on the same qubit are multiplied into one 2x2 matrix and neighbouring gates that
+//  together touch only a few qubits are merged into one small dense matrix, so a long sequence of gates costs far fewer
+//  passes over the state. A gate left on its own whose matrix is diagonal or a pauli-X still gets the cheaper diagonal or
+//  permutation kernel. Measuring or reading the register flushes the circuit automatically. Fused matrices are always
+//  built in double precision, ofxQuantumCircuitT<float> only rounds them when they reach a single precision register.
+//
+//  On a large dense register the operations are further grouped into passes, see ofxQuantumRegister::applyPass. A pass
+//  holds consecutive operations that between them touch only a few qubits above a chunk of the state. The state is
+//  worked through one small tile at a time, every operation of the pass is applied to the tile while it is in cache, or
+//  in memory for a register backed by a file, so a pass costs one trip through memory or the file however long it is.
+//  Qubits above the chunk are swapped into the tile as it is gathered, a pass ends when it would need too many of them.
+//  When the gates of a flush keep coming back to a few qubits above the chunk, the register's qubit layout is changed so
+//  they are stored inside it instead, if that saves more passes than moving the amplitudes costs.
+//
+//  ofxQuantumCircuit circuit( quantumReg );
+//  circuit.applyGateHad(0);
+//  circuit.applyGateControlledNot(0, 1);
+//  quantumReg->measureBit(1);      // gates are fused and applied here
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMCIRCUIT_H
+#define OFXQUANTUMCIRCUIT_H
+
+// Includes
+#include <vector>
+#include <complex>
+#include "Complex.h"
+#include "ofxQuantumGates.h"
+
+// Default largest number of qubits merged into one dense block
+#define QUANTUM_DEFAULT_FUSED_QUBITS 4
+
+// Forward declarations
+template<typename T> class ofxQuantumRegisterT;
+
+template<typename T>
+class ofxQuantumCircuitT
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, links the circuit to a register. A register has at most one circuit, linking a new one flushes the old
+    ofxQuantumCircuitT( ofxQuantumRegisterT<T> * reg );
+
+    // Destructor, applies anything still pending
+    ~ofxQuantumCircuitT();
+
+    // Record gates, these mirror the gate functions of ofxQuantumRegister
+    void applyGate(                unsigned long long int bit, const Complex matrix[4] );
+    void applyGateX(               unsigned long long int bit );
+    void applyGateY(               unsigned long long int bit );
+    void applyGateZ(               unsigned long long int bit );
+    void applyGateS(               unsigned long long int bit );
+    void applyGateT(               unsigned long long int bit );
+    void applyGateHad(             unsigned long long int bit );
+    void applyGatePhase(           unsigned long long int bit, double theta );
+    void applyGateRx(              unsigned long long int bit, double theta );
+    void applyGateRy(              unsigned long long int bit, double theta );
+    void applyGateRz(              unsigned long long int bit, double theta );
+    void applyControlledGate(      const std::vector<unsigned long long int> & controls,
+                                   unsigned long long int target,
+                                   const Complex matrix[4],
+                                   unsigned long long int controlValues = ~0ULL );
+    void applyGateControlledNot(   unsigned long long int controlBit, unsigned long long int bit );
+    void applyGateToffoli(         unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit );
+    void applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta );
+    void applyMultiQubitGate(      const std::vector<unsigned long long int> & qubits, const Complex * matrix );
+
+    // Fuse the recorded gates and apply them to the register
+    void flush();
+
+    // Number of gates waiting to be applied
+    size_t getNumPending() const;
+
+    // Largest number of qubits merged into one dense block, 1 only merges gates on the same qubit
+    void setMaxFusedQubits( int maxQubits );
+    int  getMaxFusedQubits() const;
+
+    // Passes over the state made by the last flush, compared with the number of gates recorded
+    size_t getLastFlushPasses() const;
+    size_t getLastFlushGates()  const;
+
+private:
+
+    // Registers unlink themselves when they are destroyed
+    friend class ofxQuantumRegisterT<T>;
+
+    typedef std::complex<double> Amplitude;
+
+    // A recorded gate. Controlled gates keep their controls separately so a gate that is not fused
+    // can still use the controlled kernel, which only touches the states that match the controls
+    struct Operation
+    {
+        std::vector<unsigned long long int> qubits;         // Dense gates: all qubits. Controlled gates: the controls then the target
+        std::vector<Amplitude>              matrix;         // Dense gates: 2^k x 2^k. Controlled gates: the 2x2 target matrix
+        size_t                              numControls;
+        unsigned long long int              controlValues;
+    };
+
+    // Operations waiting to be applied together in one pass over the state
+    struct Pass
+    {
+        bool                                enabled;        // The register is worked through in passes, see getPassLayout
+        unsigned long long int              chunkQubits;
+        unsigned long long int              maxPassQubits;
+        std::vector<Operation>              ops;
+        std::vector<unsigned long long int> qubits;         // Every qubit the operations touch
+        std::vector<unsigned long long int> passQubits;     // The ones above the chunk
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Called by the register when it is destroyed
+    void detach();
+
+    // Add a gate to the queue
+    void record( const Operation & op );
+
+    // Check the qubits of an operation are in range and distinct, printing the problem when they are not
+    bool checkOperation( const Operation & op ) const;
+
+    // Apply a single operation to a register without fusing. Single qubit and controlled matrices that are exactly
+    // diagonal or a pauli-X go through the register's diagonal and permutation kernels
+    static void applyOperation( const Operation & op, ofxQuantumRegisterT<T> & reg );
+
+    // Apply an operation to the register, or add it to the pass when the register is worked through in passes. An
+    // operation that would take the pass over its limit of qubits above the chunk applies the pass and starts a new one
+    void queueOperation( const Operation & op, Pass & pass );
+
+    // Apply the operations of a pass in one sweep over the state and empty it
+    void applyPass( Pass & pass );
+
+    // Move the most used qubits of a flush into the chunk of the register when that saves passes
+    void arrangeQubits( const std::vector<Operation> & ops, const Pass & pass );
+
+    // Passes a list of operations takes with the qubits at the positions in layout
+    static size_t countPasses( const std::vector<Operation> & ops, const std::vector<unsigned long long int> & layout,
+                               unsigned long long int firstLow, unsigned long long int maxPassQubits );
+
+    // Record a gate type from ofxQuantumGates.h by its matrix
+    template<typename Gate>
+    void recordGate( const Gate & gate, unsigned long long int bit )
+    {
+        Complex matrix[4];
+        gate.getMatrix(matrix);
+        applyGate(bit, matrix);
+    }
+
+    // Dense matrix of an operation over its own qubits
+    static std::vector<Amplitude> denseMatrix( const Operation & op );
+
+    // Embed a matrix over qubits into a larger set of qubits, acting as the identity on the rest
+    static std::vector<Amplitude> expandMatrix( const std::vector<Amplitude> & matrix,
+                                                const std::vector<unsigned long long int> & qubits,
+                                                const std::vector<unsigned long long int> & target );
+
+    // Product of two square matrices of the same size
+    static std::vector<Amplitude> multiply( const std::vector<Amplitude> & a, const std::vector<Amplitude> & b );
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantumRegisterT<T> * mRegister;       // Register the gates are applied to
+    std::vector<Operation>   mPending;          // Gates waiting to be applied, in order
+    int                      mMaxFusedQubits;   // Largest dense block
+    size_t                   mLastFlushPasses;  // Statistics from the last flush
+    size_t                   mLastFlushGates;
+};
+
+typedef ofxQuantumCircuitT<double> ofxQuantumCircuit;
+
+#endif
@@ -0,0 +1,328 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumComm.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumComm.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+// Control block shared by all ranks
+struct ofxQuantumComm::Shared
+{
+    std::atomic<int> arrived;                                           // Ranks waiting at the current barrier
+    std::atomic<int> generation;                                        // Barriers completed so far
+    std::atomic<int> aborted;                                           // Set when a rank failed
+    double           values[QUANTUM_COMM_MAX_RANKS][QUANTUM_COMM_MAX_VALUES]; // Contribution of each rank to a sum
+    char             bytes[QUANTUM_COMM_MAX_BYTES];                     // Data being broadcast
+};
+
+////////////////////////////////////////////////////////////////////////
+// Fork the ranks and wait for them. The control block is mapped shared
+// before the fork so every rank sees the same one. If a rank fails the
+// rest are told to leave at their next barrier.
+////////////////////////////////////////////////////////////////////////
+
+int ofxQuantumComm::launch( int numRanks, const std::function<int (ofxQuantumComm &)> & fn )
+{
+    if(numRanks < 1 || numRanks > QUANTUM_COMM_MAX_RANKS)
+    {
+        printf("ERROR! number of ranks must be between 1 and %d\n", QUANTUM_COMM_MAX_RANKS);
+        return -1;
+    }
+
+    void * block = mmap(NULL, sizeof(Shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+    if(block == MAP_FAILED)
+    {
+        printf("ERROR! unable to map the communication block: %s\n", strerror(errno));
+        return -1;
+    }
+
+    Shared * shared = new (block) Shared();
+    shared->arrived    = 0;
+    shared->generation = 0;
+    shared->aborted    = 0;
+
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "/ofxq-%d", (int)getpid());
+
+    // Anything still buffered would otherwise be written once by every rank
+    fflush(stdout);
+    fflush(stderr);
+
+    std::vector<pid_t> pids;
+    int                result = 0;
+
+    for(int rank = 0; rank < numRanks; rank++)
+    {
+        pid_t pid = fork();
+
+        if(pid == 0)
+        {
+            ofxQuantumComm comm(shared, rank, numRanks, prefix);
+            int            code = fn(comm);
+
+            fflush(stdout);
+            fflush(stderr);
+            _exit(code);
+        }
+
+        if(pid < 0)
+        {
+            printf("ERROR! unable to start rank %d: %s\n", rank, strerror(errno));
+            shared->aborted = 1;
+            result          = -1;
+            break;
+        }
+
+        pids.push_back(pid);
+    }
+
+    // Wait in whatever order the ranks finish, so a failure is passed on while the others are still running
+    for(size_t i = 0; i < pids.size(); i++)
+    {
+        int   status = 0;
+        pid_t pid    = waitpid(-1, &status, 0);
+
+        if(pid < 0)
+            break;
+
+        int code = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+        if(code != 0)
+        {
+            shared->aborted = 1;
+
+            if(result == 0)
+                result = code;
+        }
+    }
+
+    shared->~Shared();
+    munmap(block, sizeof(Shared));
+
+    return result;
+}
+
+////////////////////////////////////////////////////
+// Constructor, made by launch for each rank      //
+////////////////////////////////////////////////////
+
+ofxQuantumComm::ofxQuantumComm( Shared * shared, int rank, int numRanks, const std::string & prefix )
+{
+    mShared      = shared;
+    mRank        = rank;
+    mNumRanks    = numRanks;
+    mPrefix      = prefix;
+    mNumSegments = 0;
+}
+
+int ofxQuantumComm::getRank() const
+{
+    return mRank;
+}
+
+int ofxQuantumComm::getNumRanks() const
+{
+    return mNumRanks;
+}
+
+////////////////////////////////////////////////////
+// Leave if another rank has failed               //
+////////////////////////////////////////////////////
+
+void ofxQuantumComm::checkAborted()
+{
+    if(mShared->aborted.load())
+    {
+        printf("ERROR! rank %d stopping, another rank failed\n", mRank);
+        fflush(stdout);
+        _exit(1);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Barrier on a generation count, the last rank to arrive resets the
+// count and starts the next generation. The ranks usually arrive close
+// together, so waiting yields rather than sleeping.
+////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumComm::barrier()
+{
+    if(mNumRanks == 1)
+        return;
+
+    const int generation = mShared->generation.load();
+
+    if(mShared->arrived.fetch_add(1) + 1 == mNumRanks)
+    {
+        mShared->arrived.store(0);
+        mShared->generation.fetch_add(1);
+        return;
+    }
+
+    while(mShared->generation.load() == generation)
+    {
+        checkAborted();
+        sched_yield();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Sum over the ranks, each rank writes its own row then adds up every
+// row in rank order. The second barrier stops a rank writing the next
+// sum before the others have read this one.
+////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumComm::sum( double * values, size_t count )
+{
+    for(size_t first = 0; first < count; first += QUANTUM_COMM_MAX_VALUES)
+    {
+        const size_t num = std::min(count - first, (size_t)QUANTUM_COMM_MAX_VALUES);
+
+        memcpy(mShared->values[mRank], values + first, num * sizeof(double));
+        barrier();
+
+        for(size_t v = 0; v < num; v++)
+        {
+            double total = 0.0;
+
+            for(int r = 0; r < mNumRanks; r++)
+                total += mShared->values[r][v];
+
+            values[first + v] = total;
+        }
+
+        barrier();
+    }
+}
+
+double ofxQuantumComm::sum( double value )
+{
+    sum(&value, 1);
+    return value;
+}
+
+////////////////////////////////////////////////////
+// Copy data from the root to every rank          //
+////////////////////////////////////////////////////
+
+void ofxQuantumComm::broadcast( void * data, size_t bytes, int root )
+{
+    char * dst = (char *)data;
+
+    for(size_t first = 0; first < bytes; first += QUANTUM_COMM_MAX_BYTES)
+    {
+        const size_t num = std::min(bytes - first, (size_t)QUANTUM_COMM_MAX_BYTES);
+
+        if(mRank == root)
+            memcpy(mShared->bytes, dst + first, num);
+
+        barrier();
+
+        if(mRank != root)
+            memcpy(dst + first, mShared->bytes, num);
+
+        barrier();
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Each rank creates its own segment, then maps everyone else's once all
+// exist. Whether every rank succeeded is agreed with a sum so the ranks
+// either all have the segments or all give up together.
+////////////////////////////////////////////////////////////////////////
+
+bool ofxQuantumComm::mapSegments( size_t bytes, std::vector<void *> & segments )
+{
+    const unsigned int number = mNumSegments++;
+
+    segments.assign(mNumRanks, NULL);
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s-%u-%d", mPrefix.c_str(), number, mRank);
+
+    // Sized without writing it, so the pages start as zeros
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if(fd >= 0)
+    {
+        void * block = MAP_FAILED;
+
+        if(ftruncate(fd, (off_t)bytes) == 0)
+            block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if(block != MAP_FAILED)
+            segments[mRank] = block;
+
+        close(fd);
+    }
+
+    if(segments[mRank] == NULL)
+        printf("ERROR! rank %d unable to create shared memory segment %s: %s\n", mRank, name, strerror(errno));
+
+    bool ok = sum(segments[mRank] != NULL ? 1.0 : 0.0) == mNumRanks;
+
+    for(int r = 0; ok && r < mNumRanks; r++)
+    {
+        if(r == mRank)
+            continue;
+
+        char peerName[128];
+        snprintf(peerName, sizeof(peerName), "%s-%u-%d", mPrefix.c_str(), number, r);
+
+        int peerFd = shm_open(peerName, O_RDWR, 0600);
+
+        if(peerFd < 0)
+        {
+            printf("ERROR! rank %d unable to open shared memory segment %s: %s\n", mRank, peerName, strerror(errno));
+            ok = false;
+            break;
+        }
+
+        void * block = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, peerFd, 0);
+        close(peerFd);
+
+        if(block == MAP_FAILED)
+        {
+            printf("ERROR! rank %d unable to map shared memory segment %s: %s\n", mRank, peerName, strerror(errno));
+            ok = false;
+            break;
+        }
+
+        segments[r] = block;
+    }
+
+    ok = sum(ok ? 1.0 : 0.0) == mNumRanks;
+
+    // Every rank has its mappings now, the names are no longer needed
+    if(segments[mRank] != NULL)
+        shm_unlink(name);
+
+    if(!ok)
+    {
+        for(int r = 0; r < mNumRanks; r++)
+        {
+            if(segments[r] != NULL)
+                munmap(segments[r], bytes);
+        }
+
+        segments.assign(mNumRanks, NULL);
+    }
+
+    return ok;
+}
@@ -0,0 +1,100 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumComm.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumComm connects a group of processes on one machine that together hold a distributed register, see
+//  ofxQuantumDistributedRegister.h. Each process is a rank numbered from 0. The ranks share a small control block for
+//  barriers, sums and broadcasts, and map each other's amplitude segments through POSIX shared memory, so an exchange of
+//  amplitudes between two ranks is a plain copy with no serialisation.
+//
+//  launch forks the ranks from the calling process and stands in for a cluster launcher when testing. It returns 0 when
+//  every rank returned 0. Every function other than getRank and getNumRanks is collective, all ranks must call it in the
+//  same order. If a rank exits early the others leave at their next barrier instead of waiting forever.
+//
+//  ofxQuantumComm::launch( 4, [](ofxQuantumComm & comm)
+//  {
+//      ofxQuantumDistributedRegister reg( 20, comm, NULL );
+//      reg.applyGateHad(0);
+//      return 0;
+//  });
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMCOMM_H
+#define OFXQUANTUMCOMM_H
+
+// Includes
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+// Largest number of ranks in a group
+#define QUANTUM_COMM_MAX_RANKS  64
+
+// Largest number of values in one sum
+#define QUANTUM_COMM_MAX_VALUES 8
+
+// Largest broadcast in bytes
+#define QUANTUM_COMM_MAX_BYTES  4096
+
+class ofxQuantumComm
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Fork numRanks processes that each run fn with their own connection, and wait for them. Returns 0 when every rank
+    // returned 0, otherwise the first non zero code
+    static int launch( int numRanks, const std::function<int (ofxQuantumComm &)> & fn );
+
+    // Rank of this process and the number of ranks in the group
+    int getRank() const;
+    int getNumRanks() const;
+
+    // Wait until every rank has reached the barrier
+    void barrier();
+
+    // Add count values element wise over all ranks, every rank gets the totals. The ranks are added in order so every
+    // rank sees the same rounding
+    void   sum( double * values, size_t count );
+    double sum( double value );
+
+    // Copy bytes from the root rank to every other rank
+    void broadcast( void * data, size_t bytes, int root = 0 );
+
+    // Create a shared memory segment of bytes for this rank and map the segment of every rank, segments[r] is rank r's.
+    // The names are removed once every rank has mapped them, the segments go with the last mapping. Unmapping them is up
+    // to the caller
+    bool mapSegments( size_t bytes, std::vector<void *> & segments );
+
+private:
+
+    // Control block shared by all ranks, lives in an anonymous shared mapping made before the fork
+    struct Shared;
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantumComm( Shared * shared, int rank, int numRanks, const std::string & prefix );
+
+    // Leave the process if another rank has failed
+    void checkAborted();
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    Shared *     mShared;       // Control block
+    int          mRank;         // Rank of this process
+    int          mNumRanks;     // Number of ranks
+    std::string  mPrefix;       // Start of the shared memory names of this group
+    unsigned int mNumSegments;  // Segments mapped so far, numbers the names
+};
+
+#endif
@@ -0,0 +1,771 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumDistributedRegister.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumDistributedRegister.h"
+#include "ofxQuantumKernels.h"
+#include "ofxQuantum.h"
+
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+
+////////////////////////////////////////////////////
+// Qubits that pick the rank, -1 if the number of //
+// ranks is not a power of two                    //
+////////////////////////////////////////////////////
+
+static int countGlobalQubits( int numRanks )
+{
+    if(numRanks < 1 || (numRanks & (numRanks - 1)) != 0)
+        return -1;
+
+    return __builtin_ctz(numRanks);
+}
+
+////////////////////////////////////////////////////
+// Qubits in the slice of each rank, 0 for a      //
+// register that can not be split. Every rank     //
+// needs at least one local qubit, a gate on a    //
+// global target is exchanged with one            //
+////////////////////////////////////////////////////
+
+static unsigned long long int countLocalQubits( unsigned long long int size, int numRanks )
+{
+    const int numGlobal = countGlobalQubits(numRanks);
+
+    if(numGlobal < 0 || (unsigned long long int)numGlobal >= size || size > QUANTUM_MAX_QUBITS)
+        return 0;
+
+    return size - numGlobal;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Constructor. Every rank maps its slice into shared memory and maps
+// the slices of the other ranks, so exchanges can copy directly between
+// them. The seed is sent from rank 0 so every rank measures alike.
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+ofxQuantumDistributedRegisterT<T>::ofxQuantumDistributedRegisterT( unsigned long long int size, ofxQuantumComm & comm, ofxQuantum *quantumSim )
+    : mComm(comm),
+      mLocal(countLocalQubits(size, comm.getNumRanks()), quantumSim),
+      mPool(std::max(1, (int)std::thread::hardware_concurrency() / comm.getNumRanks()))
+{
+    mQuantumSim = quantumSim;
+
+    const int numGlobal = countGlobalQubits(mComm.getNumRanks());
+
+    if(numGlobal < 0 || (unsigned long long int)numGlobal >= size || size > QUANTUM_MAX_QUBITS)
+    {
+        printf("ERROR! a distributed register needs a power of two ranks, fewer than 2 ^ size, and at most %d qubits\n", QUANTUM_MAX_QUBITS);
+        size = 0;
+    }
+
+    mRegSize   = size;
+    mNumGlobal = size > 0 ? numGlobal : 0;
+    mNumStates = 1ULL << mRegSize;
+
+    mLocal.setThreadPool(&mPool);
+
+    // Each slice lives in a shared segment the other ranks can reach
+    const size_t        numLocal = getNumLocalStates();
+    const size_t        numBytes = ofxQuantumStateBufferT<T>::mappedBytes(numLocal);
+    std::vector<void *> segments;
+
+    if(mComm.mapSegments(numBytes, segments))
+    {
+        mPeers.resize(mComm.getNumRanks());
+
+        for(int r = 0; r < mComm.getNumRanks(); r++)
+        {
+            if(r == mComm.getRank())
+                mLocal.mState.adopt(segments[r], numBytes, numLocal);
+            else
+                mPeers[r].adopt(segments[r], numBytes, numLocal);
+        }
+    }
+    else
+    {
+        printf("ERROR! unable to share the distributed register between ranks\n");
+        mRegSize   = 0;
+        mNumGlobal = 0;
+        mNumStates = 1;
+    }
+
+    // The slice is always dense, the layout of the whole register is kept here
+    mLocal.mSparse.clear();
+    mLocal.mIsSparse = false;
+    mLocal.mStorage  = ofxQuantumRegisterT<T>::STORAGE_DENSE;
+
+    reset();
+
+    unsigned long long int seed = (mComm.getRank() == 0 && mQuantumSim != NULL) ? mQuantumSim->getRandomInt() : 0;
+    mComm.broadcast(&seed, sizeof(seed), 0);
+    setSeed(seed);
+}
+
+template<typename T>
+ofxQuantumDistributedRegisterT<T>::~ofxQuantumDistributedRegisterT()
+{
+    // The slices are unmapped by their buffers, a segment goes once every rank has let go of it
+}
+
+////////////////////////////////////////////////////
+// Reset the register to |0...0>                  //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::reset()
+{
+    mLocal.mState.zero();
+
+    if(mComm.getRank() == 0 && mLocal.mState.size() > 0)
+        mLocal.mState.set(0, 1, 0);
+
+    mQubitMap.resize(mRegSize);
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+        mQubitMap[q] = q;
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::setSeed( unsigned long long int seed )
+{
+    mSeed = seed;
+    mRandom.setSeed(seed);
+}
+
+template<typename T>
+unsigned long long int ofxQuantumDistributedRegisterT<T>::getSeed() const
+{
+    return mSeed;
+}
+
+template<typename T>
+int ofxQuantumDistributedRegisterT<T>::size() const
+{
+    return (int)mRegSize;
+}
+
+template<typename T>
+unsigned long long int ofxQuantumDistributedRegisterT<T>::getNumStates() const
+{
+    return mNumStates;
+}
+
+template<typename T>
+unsigned long long int ofxQuantumDistributedRegisterT<T>::getNumLocalStates() const
+{
+    return mNumStates >> mNumGlobal;
+}
+
+template<typename T>
+unsigned long long int ofxQuantumDistributedRegisterT<T>::getNumGlobalQubits() const
+{
+    return mNumGlobal;
+}
+
+template<typename T>
+std::vector<unsigned long long int> ofxQuantumDistributedRegisterT<T>::getQubitLayout() const
+{
+    return mQubitMap;
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::setThreadPool( ofxQuantumThreadPool * threadPool )
+{
+    mLocal.setThreadPool(threadPool != NULL ? threadPool : &mPool);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Amplitude of a state. The state index is moved to the qubit layout,
+// its top bits name the rank that holds it and that rank sends it on.
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+Complex ofxQuantumDistributedRegisterT<T>::getState( unsigned long long int stateIndx )
+{
+    if(stateIndx >= mNumStates)
+    {
+        printf("ERROR! state indx out of range, max indx: %llu\n", mNumStates - 1);
+        return Complex(0, 0);
+    }
+
+    unsigned long long int stored = 0;
+
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        if((stateIndx >> (mRegSize - 1 - q)) & 1)
+            stored |= 1ULL << (mRegSize - 1 - mQubitMap[q]);
+    }
+
+    const int    owner = (int)(stored >> (mRegSize - mNumGlobal));
+    const size_t indx  = (size_t)(stored & (getNumLocalStates() - 1));
+    double       value[2] = { 0.0, 0.0 };
+
+    if(owner == mComm.getRank())
+    {
+        value[0] = mLocal.mState.real()[indx];
+        value[1] = mLocal.mState.imag()[indx];
+    }
+
+    mComm.broadcast(value, sizeof(value), owner);
+
+    return Complex(value[0], value[1]);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure a bit. Each rank sums the chance of 0 and 1 over its slice,
+// the sums are added over the ranks and every rank draws the same
+// random number, so they all collapse on the same outcome. A global
+// qubit has one value in the whole slice, which is either kept and
+// scaled or cleared.
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+int ofxQuantumDistributedRegisterT<T>::measureBit( unsigned long long int bitIndx )
+{
+    if(bitIndx >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return -1;
+    }
+
+    const unsigned long long int pos      = mQubitMap[bitIndx];
+    const size_t                 numLocal = getNumLocalStates();
+
+    T * re = mLocal.mState.real();
+    T * im = mLocal.mState.imag();
+
+    // Chance of a zero state and of a one state
+    double prob[2] = { 0.0, 0.0 };
+
+    if(pos < mNumGlobal)
+    {
+        prob[rankBit(pos)] = mLocal.sumChunks(numLocal, [=](size_t begin, size_t end)
+        {
+            return ofxQuantumKernels::sumSquares(re + begin, im + begin, end - begin);
+        });
+    }
+    else
+    {
+        const size_t mask = (size_t)1 << (mRegSize - 1 - pos);
+
+        mLocal.sumChunks(numLocal / 2, 2, [=](size_t begin, size_t end, double * partials)
+        {
+            ofxQuantumKernels::sumSquaresPairs(re, im, mask, begin, end, partials[0], partials[1]);
+        }, prob);
+    }
+
+    mComm.sum(prob, 2);
+
+    // Check our probabilities against the random number, an outcome with no chance is never picked
+    int result = (prob[0] / (prob[0] + prob[1]) >= mRandom.nextDouble()) ? 0 : 1;
+
+    if(prob[result] <= 0.0)
+        result = 1 - result;
+
+    // Collapse onto the result and normalise the remaining states in the same pass
+    const double factor = 1.0 / sqrt(prob[result]);
+
+    if(pos < mNumGlobal)
+    {
+        if(rankBit(pos) != result)
+        {
+            mLocal.mState.zero();
+        }
+        else
+        {
+            mLocal.forEachChunk(numLocal, [=](size_t begin, size_t end)
+            {
+                ofxQuantumKernels::scale(re + begin, im + begin, end - begin, factor);
+            });
+        }
+    }
+    else
+    {
+        const size_t mask = (size_t)1 << (mRegSize - 1 - pos);
+
+        mLocal.forEachChunk(numLocal / 2, [=](size_t begin, size_t end)
+        {
+            ofxQuantumKernels::collapsePairs(re, im, mask, begin, end, result, factor);
+        });
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////
+// Measure every bit, qubit 0 is the most         //
+// significant bit of the result                  //
+////////////////////////////////////////////////////
+
+template<typename T>
+unsigned long long int ofxQuantumDistributedRegisterT<T>::decimalMeasure()
+{
+    unsigned long long int result = 0;
+
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        if(measureBit(q) == 1)
+            result |= 1ULL << (mRegSize - 1 - q);
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Chance of a bit being 1, the same sums measureBit makes
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+double ofxQuantumDistributedRegisterT<T>::getBitProb( unsigned long long int bitIndx )
+{
+    if(bitIndx >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return 0.0;
+    }
+
+    const unsigned long long int pos      = mQubitMap[bitIndx];
+    const size_t                 numLocal = getNumLocalStates();
+
+    const T * re = mLocal.mState.real();
+    const T * im = mLocal.mState.imag();
+
+    double prob[2] = { 0.0, 0.0 };
+
+    if(pos < mNumGlobal)
+    {
+        prob[rankBit(pos)] = mLocal.sumChunks(numLocal, [=](size_t begin, size_t end)
+        {
+            return ofxQuantumKernels::sumSquares(re + begin, im + begin, end - begin);
+        });
+    }
+    else
+    {
+        const size_t mask = (size_t)1 << (mRegSize - 1 - pos);
+
+        mLocal.sumChunks(numLocal / 2, 2, [=](size_t begin, size_t end, double * partials)
+        {
+            ofxQuantumKernels::sumSquaresPairs(re, im, mask, begin, end, partials[0], partials[1]);
+        }, prob);
+    }
+
+    mComm.sum(prob, 2);
+
+    return prob[1] / (prob[0] + prob[1]);
+}
+
+////////////////////////////////////////////////////
+// Normalize over every slice                     //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::norm()
+{
+    T * re = mLocal.mState.real();
+    T * im = mLocal.mState.imag();
+
+    double b = mLocal.sumChunks(getNumLocalStates(), [=](size_t begin, size_t end)
+    {
+        return ofxQuantumKernels::sumSquares(re + begin, im + begin, end - begin);
+    });
+
+    b = pow(mComm.sum(b), -.5);
+
+    mLocal.forEachChunk(getNumLocalStates(), [=](size_t begin, size_t end)
+    {
+        ofxQuantumKernels::scale(re + begin, im + begin, end - begin, b);
+    });
+}
+
+////////////////////////////////////////////////////
+// Single qubit gates                             //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGate( unsigned long long int bit, const Complex matrix[4] )
+{
+    applyControlledGate(std::vector<unsigned long long int>(), bit, matrix);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateX( unsigned long long int bit )
+{
+    apply(ofxQuantumGateX(), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateY( unsigned long long int bit )
+{
+    apply(ofxQuantumGateY(), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateZ( unsigned long long int bit )
+{
+    apply(ofxQuantumGateZ(), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateS( unsigned long long int bit )
+{
+    apply(ofxQuantumGateS(), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateT( unsigned long long int bit )
+{
+    apply(ofxQuantumGateT(), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateHad( unsigned long long int bit )
+{
+    apply(ofxQuantumGateHad(), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGatePhase( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGatePhase(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateRx( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRx(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateRy( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRy(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateRz( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRz(theta), bit);
+}
+
+////////////////////////////////////////////////////
+// Controlled gates                               //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyControlledGate( const std::vector<unsigned long long int> & controls,
+                                                             unsigned long long int target,
+                                                             const Complex matrix[4],
+                                                             unsigned long long int controlValues )
+{
+    const ofxQuantumDenseGate gate(matrix[0].getReal(), matrix[0].getImag(), matrix[1].getReal(), matrix[1].getImag(),
+                                   matrix[2].getReal(), matrix[2].getImag(), matrix[3].getReal(), matrix[3].getImag());
+
+    applyControlled(gate, controls, target, controlValues);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit )
+{
+    applyControlled(ofxQuantumGateX(), std::vector<unsigned long long int>(1, controlBit), bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateToffoli( unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit )
+{
+    std::vector<unsigned long long int> controls;
+    controls.push_back(controlBit1);
+    controls.push_back(controlBit2);
+
+    applyControlled(ofxQuantumGateX(), controls, bit);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta )
+{
+    applyControlled(ofxQuantumGatePhase(theta), std::vector<unsigned long long int>(1, controlBit), bit);
+}
+
+////////////////////////////////////////////////////
+// Swap two qubits by relabelling them            //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateSwap( unsigned long long int bit1, unsigned long long int bit2 )
+{
+    if(bit1 >= mRegSize || bit2 >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return;
+    }
+
+    std::swap(mQubitMap[bit1], mQubitMap[bit2]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Gate classes. Permutation and dense gates need both amplitudes of each pair on one rank,
+// so a global target is made local first. A diagonal gate on a global target is a single
+// phase over the slice, picked by the rank.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateClass( const ofxQuantumPermutationGate & gate,
+                                                        const std::vector<unsigned long long int> & controls,
+                                                        unsigned long long int target,
+                                                        unsigned long long int controlValues,
+                                                        ofxQuantumPermutationClass )
+{
+    if(!checkQubits(controls, target))
+        return;
+
+    if(mQubitMap[target] < mNumGlobal)
+        makeLocal(controls, target);
+
+    std::vector<unsigned long long int> local;
+    unsigned long long int              localValues = 0;
+
+    if(!localControls(controls, controlValues, local, localValues))
+        return;
+
+    mLocal.applyControlled(gate, local, mQubitMap[target] - mNumGlobal, localValues);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateClass( const ofxQuantumDiagonalGate & gate,
+                                                        const std::vector<unsigned long long int> & controls,
+                                                        unsigned long long int target,
+                                                        unsigned long long int controlValues,
+                                                        ofxQuantumDiagonalClass )
+{
+    if(!checkQubits(controls, target))
+        return;
+
+    std::vector<unsigned long long int> local;
+    unsigned long long int              localValues = 0;
+
+    if(!localControls(controls, controlValues, local, localValues))
+        return;
+
+    const unsigned long long int pos = mQubitMap[target];
+
+    if(pos >= mNumGlobal)
+    {
+        mLocal.applyControlled(gate, local, pos - mNumGlobal, localValues);
+        return;
+    }
+
+    // The target has the same value over the whole slice
+    const double phaseRe = rankBit(pos) ? gate.phase1Re : gate.phase0Re;
+    const double phaseIm = rankBit(pos) ? gate.phase1Im : gate.phase0Im;
+
+    if(phaseRe == 1.0 && phaseIm == 0.0)
+        return;
+
+    if(local.empty())
+    {
+        T * re = mLocal.mState.real();
+        T * im = mLocal.mState.imag();
+
+        mLocal.forEachChunk(getNumLocalStates(), [=](size_t begin, size_t end)
+        {
+            ofxQuantumKernels::multiplyPhase(re + begin, im + begin, end - begin, phaseRe, phaseIm);
+        });
+        return;
+    }
+
+    // Otherwise the last local control becomes the target, with the phase on the value it requires
+    const unsigned long long int last    = local.back();
+    const bool                   wantOne = (localValues >> (local.size() - 1)) & 1;
+
+    local.pop_back();
+
+    const ofxQuantumDiagonalGate phase = wantOne ? ofxQuantumDiagonalGate(1, 0, phaseRe, phaseIm)
+                                                 : ofxQuantumDiagonalGate(phaseRe, phaseIm, 1, 0);
+
+    mLocal.applyControlled(phase, local, last, localValues);
+}
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::applyGateClass( const ofxQuantumDenseGate & gate,
+                                                        const std::vector<unsigned long long int> & controls,
+                                                        unsigned long long int target,
+                                                        unsigned long long int controlValues,
+                                                        ofxQuantumDenseClass )
+{
+    if(!checkQubits(controls, target))
+        return;
+
+    if(mQubitMap[target] < mNumGlobal)
+        makeLocal(controls, target);
+
+    std::vector<unsigned long long int> local;
+    unsigned long long int              localValues = 0;
+
+    if(!localControls(controls, controlValues, local, localValues))
+        return;
+
+    mLocal.applyControlled(gate, local, mQubitMap[target] - mNumGlobal, localValues);
+}
+
+////////////////////////////////////////////////////
+// Check the qubits of a gate                     //
+////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumDistributedRegisterT<T>::checkQubits( const std::vector<unsigned long long int> & controls, unsigned long long int target ) const
+{
+    if(target >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return false;
+    }
+
+    for(size_t j = 0; j < controls.size(); j++)
+    {
+        if(controls[j] >= mRegSize || controls[j] == target || std::count(controls.begin(), controls.end(), controls[j]) > 1)
+        {
+            printf("ERROR! control bits must be distinct qubits in the register other than the target\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Exchange a global target with the most significant free local
+// position. The halves traded are then the two halves of each slice,
+// one contiguous block each. When the controls hold every local
+// position one of them is exchanged instead, it becomes global and
+// is then settled by the rank like any other global control.
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::makeLocal( const std::vector<unsigned long long int> & controls, unsigned long long int target )
+{
+    unsigned long long int localPos = mNumGlobal;
+
+    for(unsigned long long int pos = mNumGlobal; pos < mRegSize; pos++)
+    {
+        bool used = false;
+
+        for(size_t j = 0; j < controls.size(); j++)
+            used = used || mQubitMap[controls[j]] == pos;
+
+        if(!used)
+        {
+            localPos = pos;
+            break;
+        }
+    }
+
+    const unsigned long long int globalPos = mQubitMap[target];
+
+    exchange(globalPos, localPos);
+
+    // The amplitudes have moved, relabel the two qubits to match
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        if(mQubitMap[q] == localPos)
+            mQubitMap[q] = globalPos;
+    }
+
+    mQubitMap[target] = localPos;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Swap the amplitudes of a global and a local position. Rank pairs that
+// differ only in the global bit trade the states where the local bit
+// disagrees with their own rank bit: ours at i with the partner's at i
+// with the local bit flipped. Each rank of a pair copies half of them,
+// straight between the two shared slices. The barriers make sure both
+// slices are finished with before and after.
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumDistributedRegisterT<T>::exchange( unsigned long long int globalPos, unsigned long long int localPos )
+{
+    const int    shift   = (int)(mNumGlobal - 1 - globalPos);
+    const int    partner = mComm.getRank() ^ (1 << shift);
+    const int    bit     = rankBit(globalPos);
+    const size_t mask    = (size_t)1 << (mRegSize - 1 - localPos);
+    const size_t half    = getNumLocalStates() / 2;
+    const size_t first   = bit ? half / 2 : 0;
+    const size_t last    = bit ? half     : half / 2;
+    const size_t ours    = bit ? 0    : mask;
+    const size_t theirs  = bit ? mask : 0;
+
+    T * re  = mLocal.mState.real();
+    T * im  = mLocal.mState.imag();
+    T * pRe = mPeers[partner].real();
+    T * pIm = mPeers[partner].imag();
+
+    mComm.barrier();
+
+    mLocal.forEachChunk(last - first, [=](size_t begin, size_t end)
+    {
+        // Runs of states between the local bit stay contiguous
+        for(size_t k = first + begin; k < first + end; )
+        {
+            const size_t run  = std::min(mask - (k & (mask - 1)), first + end - k);
+            const size_t base = ofxQuantumKernels::insertZeroBits(k, mask);
+
+            std::swap_ranges(re + (base | ours), re + (base | ours) + run, pRe + (base | theirs));
+            std::swap_ranges(im + (base | ours), im + (base | ours) + run, pIm + (base | theirs));
+
+            k += run;
+        }
+    });
+
+    mComm.barrier();
+}
+
+////////////////////////////////////////////////////
+// Split the controls into local and global ones  //
+////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumDistributedRegisterT<T>::localControls( const std::vector<unsigned long long int> & controls,
+                                                       unsigned long long int controlValues,
+                                                       std::vector<unsigned long long int> & local,
+                                                       unsigned long long int & localValues ) const
+{
+    local.clear();
+    localValues = 0;
+
+    for(size_t j = 0; j < controls.size(); j++)
+    {
+        const unsigned long long int pos  = mQubitMap[controls[j]];
+        const int                    want = (controlValues >> j) & 1;
+
+        if(pos < mNumGlobal)
+        {
+            if(rankBit(pos) != want)
+                return false;
+        }
+        else
+        {
+            localValues |= (unsigned long long int)want << local.size();
+            local.push_back(pos - mNumGlobal);
+        }
+    }
+
+    return true;
+}
+
+template<typename T>
+int ofxQuantumDistributedRegisterT<T>::rankBit( unsigned long long int pos ) const
+{
+    return (mComm.getRank() >> (mNumGlobal - 1 - pos)) & 1;
+}
+
+// Single and double precision distributed registers
+template class ofxQuantumDistributedRegisterT<float>;
+template class ofxQuantumDistributedRegisterT<double>;
@@ -0,0 +1,199 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumDistributedRegister.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumDistributedRegister splits the state vector of one register across the ranks of an ofxQuantumComm, so a
+//  register can be larger than a single process can hold. With 2 ^ r ranks each rank owns a slice of 2 ^ (n - r)
+//  amplitudes. The r most significant positions of the state index pick the rank and are the global qubits, the rest are
+//  local and index the slice.
+//
+//  A gate on a local qubit is applied by every rank to its own slice with the ordinary register kernels and needs no
+//  communication. Diagonal gates and controls on a global qubit need none either, each rank knows the value of the global
+//  qubits from its rank number. A permutation or dense gate on a global qubit first exchanges that qubit with a local one:
+//  each rank trades the half of its slice where the local qubit disagrees with its rank bit with the matching half of its
+//  partner, reading and writing the partner's slice directly through shared memory, then the two qubits swap labels as in
+//  ofxQuantumRegister::applyGateSwap. The qubit stays local afterwards, so following gates on it are free.
+//
+//  Every function is collective, all ranks must make the same calls in the same order. Measurements draw from a random
+//  stream whose seed is shared by all ranks, so every rank collapses on the same outcome.
+//
+//  This is a separate class rather than a storage mode of ofxQuantumRegister, because every call has to be made by every
+//  rank and the register API has no notion of ranks. It mirrors the gate and measurement functions of ofxQuantumRegister
+//  and ofxQuantumBatchRegister so code moves across by changing the type, but it does not support circuits, sample,
+//  measureBits, applyMultiQubitGate, setState, save or load, and getState is collective rather than a local read.
+//
+//  ofxQuantumComm::launch( 4, [&](ofxQuantumComm & comm)
+//  {
+//      ofxQuantumDistributedRegister reg( 30, comm, &quantumSim );
+//      reg.applyGateHad(0);
+//      reg.applyGateControlledNot(0, 29);
+//      printf("rank %d measured %llu\n", comm.getRank(), reg.decimalMeasure());
+//      return 0;
+//  });
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMDISTRIBUTEDREGISTER_H
+#define OFXQUANTUMDISTRIBUTEDREGISTER_H
+
+// Includes
+#include <stddef.h>
+#include <vector>
+#include "Complex.h"
+#include "ofxQuantumGates.h"
+#include "ofxQuantumStateBuffer.h"
+#include "ofxQuantumRegister.h"
+#include "ofxQuantumRandom.h"
+#include "ofxQuantumThreadPool.h"
+#include "ofxQuantumComm.h"
+
+// Forward declarations
+class ofxQuantum;
+
+template<typename T>
+class ofxQuantumDistributedRegisterT
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, a register of size qubits in the state |0...0> split over the ranks of comm. The number of ranks must
+    // be a power of two smaller than 2 ^ size, so every rank keeps at least one local qubit. The seed of the measurements
+    // is taken from the quantum simulator of rank 0
+    ofxQuantumDistributedRegisterT( unsigned long long int size, ofxQuantumComm & comm, ofxQuantum *quantumSim );
+    ~ofxQuantumDistributedRegisterT();
+
+    // Put the register back in the state |0...0> with the identity qubit layout
+    void reset();
+
+    // Restart the random stream of the measurements
+    void                   setSeed( unsigned long long int seed );
+    unsigned long long int getSeed() const;
+
+    // Return the size of the register
+    int size() const;
+
+    // Get the number of states in the whole register, and in the slice held by this rank
+    unsigned long long int getNumStates() const;
+    unsigned long long int getNumLocalStates() const;
+
+    // Number of qubits that pick the rank
+    unsigned long long int getNumGlobalQubits() const;
+
+    // Amplitude of a state, the rank holding it sends it to every rank
+    Complex getState( unsigned long long int stateIndx );
+
+    // Measure a qubit, every rank gets the same result
+    int measureBit( unsigned long long int bitIndx );
+
+    // Measure every qubit, qubit 0 is the most significant bit of the result
+    unsigned long long int decimalMeasure();
+
+    // Chance of measuring 1 on a qubit, without collapsing the register
+    double getBitProb( unsigned long long int bitIndx );
+
+    // Normalize the state amplitudes
+    void norm();
+
+    // Same gates as ofxQuantumRegister
+    void applyGate(      unsigned long long int bit, const Complex matrix[4] );
+    void applyGateX(     unsigned long long int bit );
+    void applyGateY(     unsigned long long int bit );
+    void applyGateZ(     unsigned long long int bit );
+    void applyGateS(     unsigned long long int bit );
+    void applyGateT(     unsigned long long int bit );
+    void applyGateHad(   unsigned long long int bit );
+    void applyGatePhase( unsigned long long int bit, double theta );
+    void applyGateRx(    unsigned long long int bit, double theta );
+    void applyGateRy(    unsigned long long int bit, double theta );
+    void applyGateRz(    unsigned long long int bit, double theta );
+
+    void applyControlledGate(      const std::vector<unsigned long long int> & controls,
+                                   unsigned long long int target,
+                                   const Complex matrix[4],
+                                   unsigned long long int controlValues = ~0ULL );
+    void applyGateControlledNot(   unsigned long long int controlBit, unsigned long long int bit );
+    void applyGateToffoli(         unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit );
+    void applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta );
+
+    // Exchange two qubits. Only the labels change, no amplitudes are moved and no rank communicates
+    void applyGateSwap( unsigned long long int bit1, unsigned long long int bit2 );
+
+    // Apply a gate type from ofxQuantumGates.h, the kernel is chosen from the class of the gate as in ofxQuantumRegister
+    template<typename Gate>
+    void apply( const Gate & gate, unsigned long long int bit )
+    {
+        applyGateClass(gate, std::vector<unsigned long long int>(), bit, ~0ULL, typename Gate::GateClass());
+    }
+
+    template<typename Gate>
+    void applyControlled( const Gate & gate,
+                          const std::vector<unsigned long long int> & controls,
+                          unsigned long long int target,
+                          unsigned long long int controlValues = ~0ULL )
+    {
+        applyGateClass(gate, controls, target, controlValues, typename Gate::GateClass());
+    }
+
+    // Position of each qubit in the global state index, positions below getNumGlobalQubits() pick the rank
+    std::vector<unsigned long long int> getQubitLayout() const;
+
+    // Run the local gate loops on a specific thread pool. By default each rank has its own pool with its share of the cores
+    void setThreadPool( ofxQuantumThreadPool * threadPool );
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Kernel for each class of gate, picked by overload on the GateClass tag
+    void applyGateClass( const ofxQuantumPermutationGate & gate, const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumPermutationClass );
+    void applyGateClass( const ofxQuantumDiagonalGate & gate,    const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumDiagonalClass );
+    void applyGateClass( const ofxQuantumDenseGate & gate,       const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumDenseClass );
+
+    // Check the qubits of a gate are in range and distinct
+    bool checkQubits( const std::vector<unsigned long long int> & controls, unsigned long long int target ) const;
+
+    // Make the target local by exchanging it with a local qubit, one the controls do not use when there is one
+    void makeLocal( const std::vector<unsigned long long int> & controls, unsigned long long int target );
+
+    // Trade amplitudes with the partner rank so the qubits at a global and a local position swap places
+    void exchange( unsigned long long int globalPos, unsigned long long int localPos );
+
+    // Split the controls into local ones, as qubits of the slice, and global ones checked against the rank. Returns false
+    // when a global control rules out every state of this rank
+    bool localControls( const std::vector<unsigned long long int> & controls, unsigned long long int controlValues,
+                        std::vector<unsigned long long int> & local, unsigned long long int & localValues ) const;
+
+    // Value of a global position in this rank's states
+    int rankBit( unsigned long long int pos ) const;
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantumComm &                       mComm;       // Ranks sharing the register
+    ofxQuantumRegisterT<T>                 mLocal;      // Slice of this rank, its amplitudes live in a shared segment
+    std::vector<ofxQuantumStateBufferT<T>> mPeers;      // Slices of the other ranks, mapped from their segments
+    ofxQuantumThreadPool                   mPool;       // Threads of this rank
+    ofxQuantumRandom                       mRandom;     // Random stream of the measurements, the same on every rank
+    std::vector<unsigned long long int>    mQubitMap;   // Position in the global state index of each qubit
+    ofxQuantum *                           mQuantumSim; // Quantum simulator the seed comes from
+    unsigned long long int                 mSeed;       // Seed of the random stream
+    unsigned long long int                 mRegSize;    // Size of the register
+    unsigned long long int                 mNumGlobal;  // Qubits that pick the rank
+    unsigned long long int                 mNumStates;  // Number of states in the register, equals 2 ^ mRegSize
+};
+
+// Double precision distributed register, the default
+typedef ofxQuantumDistributedRegisterT<double> ofxQuantumDistributedRegister;
+
+#endif
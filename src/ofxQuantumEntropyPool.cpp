@@ -0,0 +1,279 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumEntropyPool.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumEntropyPool.h"
+
+#include <string.h>
+#include <random>
+
+// Words of debiased input in one block
+#define ENTROPY_BLOCK_WORDS (ENTROPY_BLOCK_BITS / 64)
+
+// Seed of the stream the Toeplitz key is drawn from, the key does not need to be secret, only fixed
+#define ENTROPY_TOEPLITZ_SEED 0x51A7E5EEDULL
+
+////////////////////////////////////////////////////////////////////////
+// Von Neumann extractor for one byte. Each pair of bits gives the first
+// bit if the pair differs and nothing otherwise, bits holds the output
+// (first pair in the highest bit) and count how many there are.
+////////////////////////////////////////////////////////////////////////
+struct VonNeumannEntry
+{
+    unsigned char bits;
+    unsigned char count;
+};
+
+static VonNeumannEntry sVonNeumann[256];
+
+static bool buildVonNeumannTable()
+{
+    for(int b = 0; b < 256; b++)
+    {
+        VonNeumannEntry entry = { 0, 0 };
+        
+        for(int pair = 3; pair >= 0; pair--)
+        {
+            const int first  = (b >> (2 * pair + 1)) & 1;
+            const int second = (b >> (2 * pair))     & 1;
+            
+            if(first != second)
+            {
+                entry.bits = (unsigned char)((entry.bits << 1) | first);
+                entry.count++;
+            }
+        }
+        
+        sVonNeumann[b] = entry;
+    }
+    
+    return true;
+}
+
+////////////////////////////////////////////////////
+// 64 bits of a bit string from any offset        //
+////////////////////////////////////////////////////
+static uint64_t bitsAt( const uint64_t * words, size_t offset )
+{
+    const size_t w = offset / 64;
+    const size_t s = offset % 64;
+    
+    return s == 0 ? words[w] : (words[w] >> s) | (words[w + 1] << (64 - s));
+}
+
+////////////////////////////////////////////////////
+// Mix a word into a key (splitmix64 finaliser)   //
+////////////////////////////////////////////////////
+static uint64_t mixKey( uint64_t key, uint64_t word )
+{
+    uint64_t z = key ^ (word + 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+////////////////////////////////////////////////////
+// Top 52 bits of a word as a double in [0, 1)    //
+////////////////////////////////////////////////////
+static inline double wordToDouble( uint64_t word )
+{
+    const uint64_t bits = (word >> 12) | 0x3FF0000000000000ULL;
+    
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    
+    return value - 1.0;
+}
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+ofxQuantumEntropyPool::ofxQuantumEntropyPool()
+{
+    // Built once by whichever pool is made first
+    static const bool vonNeumannBuilt = buildVonNeumannTable();
+    (void)vonNeumannBuilt;
+    
+    // Toeplitz key of block + output - 1 bits, plus a spare word for bitsAt to read past the end
+    const size_t keyWords = (ENTROPY_BLOCK_BITS + ENTROPY_OUTPUT_BITS) / 64 + 1;
+    uint64_t     key[keyWords];
+    
+    ofxQuantumRandom keyStream(ENTROPY_TOEPLITZ_SEED);
+    for(size_t w = 0; w < keyWords; w++)
+        key[w] = keyStream.nextInt();
+    
+    for(int row = 0; row < ENTROPY_OUTPUT_BITS; row++)
+    {
+        for(int w = 0; w < ENTROPY_BLOCK_WORDS; w++)
+            mToeplitz[row][w] = bitsAt(key, row + 64 * w);
+    }
+    
+    mBits             = 0;
+    mNumBits          = 0;
+    mBlockWords       = 0;
+    mPoolHead         = 0;
+    mPoolTail         = 0;
+    mNumBytesAbsorbed = 0;
+    mNumWordsProduced = 0;
+    
+    // Until the device has sent anything the fallback stream is keyed by the operating system
+    std::random_device device;
+    mFallbackKey    = ((uint64_t)device() << 32) ^ device();
+    mFallbackStream = 0;
+    mFallback.setSeed(mFallbackKey, mFallbackStream);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Absorb raw bytes. Each byte is debiased with one table lookup and the
+// output bits are packed into words, every full block is then hashed.
+////////////////////////////////////////////////////////////////////////
+void ofxQuantumEntropyPool::absorb( const unsigned char * bytes, size_t count )
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    mNumBytesAbsorbed += count;
+    
+    for(size_t i = 0; i < count; i++)
+    {
+        const VonNeumannEntry entry = sVonNeumann[bytes[i]];
+        
+        if(entry.count == 0)
+            continue;
+        
+        // Split the output over two words when it does not fit in this one
+        const int room = 64 - mNumBits;
+        const int head = entry.count < room ? entry.count : room;
+        const int tail = entry.count - head;
+        
+        mBits     = (mBits << head) | (entry.bits >> tail);
+        mNumBits += head;
+        
+        if(mNumBits == 64)
+        {
+            mBlock[mBlockWords++] = mBits;
+            mBits    = entry.bits & ((1U << tail) - 1);
+            mNumBits = tail;
+            
+            if(mBlockWords == ENTROPY_BLOCK_WORDS)
+                whitenBlock();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Toeplitz hash of one block. Output bit i is the parity of row i of
+// the matrix anded with the block, the rows are laid out as whole words
+// so each bit is a few ands and a popcount.
+////////////////////////////////////////////////////////////////////////
+void ofxQuantumEntropyPool::whitenBlock()
+{
+    uint64_t output[ENTROPY_OUTPUT_BITS / 64] = { 0 };
+    
+    for(int row = 0; row < ENTROPY_OUTPUT_BITS; row++)
+    {
+        uint64_t product = 0;
+        for(int w = 0; w < ENTROPY_BLOCK_WORDS; w++)
+            product ^= mToeplitz[row][w] & mBlock[w];
+        
+        output[row / 64] |= (uint64_t)(__builtin_popcountll(product) & 1) << (row % 64);
+    }
+    
+    mBlockWords = 0;
+    
+    // Every block changes the fallback key, whether or not there is room for it in the pool
+    for(int w = 0; w < ENTROPY_OUTPUT_BITS / 64; w++)
+    {
+        mFallbackKey = mixKey(mFallbackKey, output[w]);
+        
+        if(mPoolHead - mPoolTail < ENTROPY_POOL_WORDS)
+        {
+            mPool[mPoolHead % ENTROPY_POOL_WORDS] = output[w];
+            mPoolHead++;
+        }
+    }
+    
+    mFallback.setSeed(mFallbackKey, ++mFallbackStream);
+    
+    mNumWordsProduced += ENTROPY_OUTPUT_BITS / 64;
+}
+
+////////////////////////////////////////////////////
+// Take whitened words from the pool              //
+////////////////////////////////////////////////////
+size_t ofxQuantumEntropyPool::extract( unsigned long long int * words, size_t count )
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    size_t taken = 0;
+    
+    while(taken < count && mPoolTail != mPoolHead)
+    {
+        words[taken++] = mPool[mPoolTail % ENTROPY_POOL_WORDS];
+        mPoolTail++;
+    }
+    
+    return taken;
+}
+
+////////////////////////////////////////////////////
+// Fill with random words                         //
+////////////////////////////////////////////////////
+void ofxQuantumEntropyPool::fillRandom( unsigned long long int * words, size_t count )
+{
+    const size_t taken = extract(words, count);
+    
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    for(size_t i = taken; i < count; i++)
+        words[i] = mFallback.nextInt();
+}
+
+////////////////////////////////////////////////////
+// Fill with random doubles                       //
+////////////////////////////////////////////////////
+void ofxQuantumEntropyPool::fillRandom( double * values, size_t count )
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    size_t i = 0;
+    
+    for(; i < count && mPoolTail != mPoolHead; i++)
+    {
+        values[i] = wordToDouble(mPool[mPoolTail % ENTROPY_POOL_WORDS]);
+        mPoolTail++;
+    }
+    
+    // The rest comes from the fallback stream in one batch
+    mFallback.fill(values + i, count - i);
+}
+
+////////////////////////////////////////////////////
+// Words waiting in the pool                      //
+////////////////////////////////////////////////////
+size_t ofxQuantumEntropyPool::getNumAvailable()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    return mPoolHead - mPoolTail;
+}
+
+////////////////////////////////////////////////////
+// Totals                                         //
+////////////////////////////////////////////////////
+unsigned long long int ofxQuantumEntropyPool::getNumBytesAbsorbed()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    return mNumBytesAbsorbed;
+}
+
+unsigned long long int ofxQuantumEntropyPool::getNumWordsProduced()
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    
+    return mNumWordsProduced;
+}
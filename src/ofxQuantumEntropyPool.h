@@ -0,0 +1,93 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumEntropyPool.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumEntropyPool collects the raw bytes that arrive from the Quantum Seed Processing Unit (QSPU) and turns them into
+//  unbiased random words. The bytes first go through a von Neumann extractor, a lookup table handles a whole byte at a
+//  time, then every 512 debiased bits are compressed to 256 with a Toeplitz hash to smooth out any correlation left between
+//  them. The hardware gives far fewer bits than a simulation uses, so fillRandom hands out pool words while there are any
+//  and then carries on from a Philox stream whose key is mixed with every new block of pool output.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMENTROPYPOOL_H
+#define OFXQUANTUMENTROPYPOOL_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <mutex>
+#include "ofxQuantumRandom.h"
+
+// Debiased bits that go into one Toeplitz hash, and the bits that come out
+#define ENTROPY_BLOCK_BITS  512
+#define ENTROPY_OUTPUT_BITS 256
+
+// Whitened 64 bit words the pool holds before new output is only mixed into the fallback key
+#define ENTROPY_POOL_WORDS  4096
+
+class ofxQuantumEntropyPool
+{
+public:
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    // Constructor, builds the Toeplitz matrix
+    ofxQuantumEntropyPool();
+    
+    // Add raw bytes from the device
+    void absorb( const unsigned char * bytes, size_t count );
+    
+    // Take up to count whitened words straight from the pool, returns how many there were
+    size_t extract( unsigned long long int * words, size_t count );
+    
+    // Fill with random words or doubles 0.0-1.0, pool words first then the fallback stream keyed from the pool
+    void fillRandom( unsigned long long int * words, size_t count );
+    void fillRandom( double * values, size_t count );
+    
+    // Whitened words waiting in the pool
+    size_t getNumAvailable();
+    
+    // Totals since construction
+    unsigned long long int getNumBytesAbsorbed();
+    unsigned long long int getNumWordsProduced();
+    
+private:
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    // Hash a full block of debiased bits and store the result, called with mMutex held
+    void whitenBlock();
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    std::mutex             mMutex;                                      // Guards everything below
+    
+    uint64_t               mToeplitz[ENTROPY_OUTPUT_BITS][ENTROPY_BLOCK_BITS / 64]; // Row i is the key shifted by i bits
+    
+    uint64_t               mBits;                                       // Debiased bits not yet in a whole word
+    int                    mNumBits;                                    // Number of bits in mBits
+    uint64_t               mBlock[ENTROPY_BLOCK_BITS / 64];             // Debiased words waiting to be hashed
+    int                    mBlockWords;                                 // Words in mBlock
+    
+    uint64_t               mPool[ENTROPY_POOL_WORDS];                   // Ring of whitened words
+    size_t                 mPoolHead;                                   // Total words added to the ring
+    size_t                 mPoolTail;                                   // Total words taken from the ring
+    
+    ofxQuantumRandom       mFallback;                                   // Stream used once the pool is empty
+    uint64_t               mFallbackKey;                                // Key of mFallback, every new block is mixed into it
+    unsigned long long int mFallbackStream;                             // Incremented each time the key changes
+    
+    unsigned long long int mNumBytesAbsorbed;
+    unsigned long long int mNumWordsProduced;
+};
+
+#endif
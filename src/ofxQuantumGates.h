@@ -0,0 +1,127 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumGates.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumGates describes single qubit gates as small types tagged with the class of matrix they are. Permutation gates
+//  (X, and CNOT / Toffoli once controls are added) only swap amplitudes, diagonal gates (Z, S, T, phase, Rz) only multiply
+//  each amplitude by a phase, and everything else is a dense 2x2 matrix. ofxQuantumRegister::apply reads the GateClass of a
+//  gate at compile time and runs the matching kernel, so only dense gates pay for the full pair multiply.
+//
+//  quantumReg->apply(ofxQuantumGateT(), 0);
+//  quantumReg->applyControlled(ofxQuantumGatePhase(PI / 4), controls, 2);
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMGATES_H
+#define OFXQUANTUMGATES_H
+
+// Includes
+#include <math.h>
+#include "Complex.h"
+
+// 1 / sqrt(2)
+#define QUANTUM_INV_SQRT2 0.70710678118654752440
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Gate classes
+//////////////////////////////////////////////////////////////////////////////////////////
+
+struct ofxQuantumPermutationClass {};   // Swaps the two amplitudes of each pair
+struct ofxQuantumDiagonalClass    {};   // Multiplies each amplitude by a phase picked by the qubit value
+struct ofxQuantumDenseClass       {};   // Mixes the two amplitudes of each pair
+
+// The pauli-X permutation, the only single qubit gate that moves amplitudes without changing them
+struct ofxQuantumPermutationGate
+{
+    typedef ofxQuantumPermutationClass GateClass;
+
+    constexpr ofxQuantumPermutationGate() {}
+
+    void getMatrix( Complex matrix[4] ) const
+    {
+        matrix[0] = Complex(0, 0); matrix[1] = Complex(1, 0);
+        matrix[2] = Complex(1, 0); matrix[3] = Complex(0, 0);
+    }
+};
+
+// diag(phase0, phase1)
+struct ofxQuantumDiagonalGate
+{
+    typedef ofxQuantumDiagonalClass GateClass;
+
+    constexpr ofxQuantumDiagonalGate( double re0, double im0, double re1, double im1 )
+        : phase0Re(re0), phase0Im(im0), phase1Re(re1), phase1Im(im1) {}
+
+    void getMatrix( Complex matrix[4] ) const
+    {
+        matrix[0] = Complex(phase0Re, phase0Im); matrix[1] = Complex(0, 0);
+        matrix[2] = Complex(0, 0);               matrix[3] = Complex(phase1Re, phase1Im);
+    }
+
+    double phase0Re, phase0Im;
+    double phase1Re, phase1Im;
+};
+
+// Any 2x2 unitary, in row major order { u00, u01, u10, u11 }
+struct ofxQuantumDenseGate
+{
+    typedef ofxQuantumDenseClass GateClass;
+
+    constexpr ofxQuantumDenseGate( double re00, double im00, double re01, double im01,
+                                   double re10, double im10, double re11, double im11 )
+        : re{ re00, re01, re10, re11 }, im{ im00, im01, im10, im11 } {}
+
+    void getMatrix( Complex matrix[4] ) const
+    {
+        for(int i = 0; i < 4; i++)
+            matrix[i] = Complex(re[i], im[i]);
+    }
+
+    double re[4];
+    double im[4];
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Gates, see https://en.wikipedia.org/wiki/Quantum_gate
+//////////////////////////////////////////////////////////////////////////////////////////
+
+struct ofxQuantumGateX   : ofxQuantumPermutationGate { constexpr ofxQuantumGateX() {} };
+
+struct ofxQuantumGateZ   : ofxQuantumDiagonalGate    { constexpr ofxQuantumGateZ()   : ofxQuantumDiagonalGate(1, 0, -1, 0) {} };
+struct ofxQuantumGateS   : ofxQuantumDiagonalGate    { constexpr ofxQuantumGateS()   : ofxQuantumDiagonalGate(1, 0,  0, 1) {} };
+struct ofxQuantumGateT   : ofxQuantumDiagonalGate    { constexpr ofxQuantumGateT()   : ofxQuantumDiagonalGate(1, 0, QUANTUM_INV_SQRT2, QUANTUM_INV_SQRT2) {} };
+
+struct ofxQuantumGateY   : ofxQuantumDenseGate       { constexpr ofxQuantumGateY()   : ofxQuantumDenseGate(0, 0, 0, -1,
+                                                                                                           0, 1, 0,  0) {} };
+struct ofxQuantumGateHad : ofxQuantumDenseGate       { constexpr ofxQuantumGateHad() : ofxQuantumDenseGate(QUANTUM_INV_SQRT2, 0,  QUANTUM_INV_SQRT2, 0,
+                                                                                                           QUANTUM_INV_SQRT2, 0, -QUANTUM_INV_SQRT2, 0) {} };
+
+// diag(1, e^(i theta))
+struct ofxQuantumGatePhase : ofxQuantumDiagonalGate
+{
+    explicit ofxQuantumGatePhase( double theta ) : ofxQuantumDiagonalGate(1, 0, cos(theta), sin(theta)) {}
+};
+
+// Rotation by theta about the z axis, diag(e^(-i theta/2), e^(i theta/2))
+struct ofxQuantumGateRz : ofxQuantumDiagonalGate
+{
+    explicit ofxQuantumGateRz( double theta ) : ofxQuantumDiagonalGate(cos(theta / 2), -sin(theta / 2), cos(theta / 2), sin(theta / 2)) {}
+};
+
+// Rotation by theta about the x axis
+struct ofxQuantumGateRx : ofxQuantumDenseGate
+{
+    explicit ofxQuantumGateRx( double theta ) : ofxQuantumDenseGate(cos(theta / 2), 0,               0, -sin(theta / 2),
+                                                                    0,              -sin(theta / 2), cos(theta / 2), 0) {}
+};
+
+// Rotation by theta about the y axis
+struct ofxQuantumGateRy : ofxQuantumDenseGate
+{
+    explicit ofxQuantumGateRy( double theta ) : ofxQuantumDenseGate(cos(theta / 2), 0, -sin(theta / 2), 0,
+                                                                    sin(theta / 2), 0,  cos(theta / 2), 0) {}
+};
+
+#endif
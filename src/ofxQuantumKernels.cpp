@@ -0,0 +1,796 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumKernels.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumKernels.h"
+
+#include <atomic>
+#include <string.h>
+
+// The vector kernels are compiled with per function target attributes so the addon itself can be built for a
+// baseline cpu, the right version is only called once the cpu has been checked at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUANTUM_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Scalar kernels
+//////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+static inline void applyPairScalar( T * re, T * im, size_t i0, size_t i1, const ofxQuantumGateMatrixT<T> & m )
+{
+    const T a0r = re[i0], a0i = im[i0];
+    const T a1r = re[i1], a1i = im[i1];
+
+    re[i0] = m.re[0] * a0r - m.im[0] * a0i + m.re[1] * a1r - m.im[1] * a1i;
+    im[i0] = m.re[0] * a0i + m.im[0] * a0r + m.re[1] * a1i + m.im[1] * a1r;
+    re[i1] = m.re[2] * a0r - m.im[2] * a0i + m.re[3] * a1r - m.im[3] * a1i;
+    im[i1] = m.re[2] * a0i + m.im[2] * a0r + m.re[3] * a1i + m.im[3] * a1r;
+}
+
+template<typename T>
+static void applyPairsScalar( T * re, T * im, size_t o0, size_t o1, size_t count, const ofxQuantumGateMatrixT<T> & m )
+{
+    for(size_t j = 0; j < count; j++)
+        applyPairScalar(re, im, o0 + j, o1 + j, m);
+}
+
+template<typename T>
+static double sumSquaresScalar( const T * re, const T * im, size_t count )
+{
+    double total = 0.0;
+    for(size_t j = 0; j < count; j++)
+        total += (double)re[j] * re[j] + (double)im[j] * im[j];
+    return total;
+}
+
+template<typename T>
+static void scaleScalar( T * re, T * im, size_t count, double factor )
+{
+    const T f = (T)factor;
+
+    for(size_t j = 0; j < count; j++)
+    {
+        re[j] *= f;
+        im[j] *= f;
+    }
+}
+
+template<typename T>
+static void swapPairsScalar( T * re, T * im, size_t o0, size_t o1, size_t count )
+{
+    for(size_t j = 0; j < count; j++)
+    {
+        const T a0r = re[o0 + j], a0i = im[o0 + j];
+
+        re[o0 + j] = re[o1 + j];
+        im[o0 + j] = im[o1 + j];
+        re[o1 + j] = a0r;
+        im[o1 + j] = a0i;
+    }
+}
+
+template<typename T>
+static void phaseScalar( T * re, T * im, size_t count, double phaseRe, double phaseIm )
+{
+    const T pr = (T)phaseRe, pi = (T)phaseIm;
+
+    for(size_t j = 0; j < count; j++)
+    {
+        const T ar = re[j], ai = im[j];
+
+        re[j] = pr * ar - pi * ai;
+        im[j] = pr * ai + pi * ar;
+    }
+}
+
+#ifdef QUANTUM_X86_KERNELS
+
+#define QUANTUM_SSE2   __attribute__((target("sse2")))
+#define QUANTUM_AVX2   __attribute__((target("avx2,fma")))
+#define QUANTUM_AVX512 __attribute__((target("avx512f")))
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Vector operations for each instruction set and precision. V holds amplitudes, D holds
+// double precision partial sums. addSquares loads one V of each plane and adds |a|^2 to
+// the sum, single precision lanes are widened to double first.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T> struct SSE2Ops;
+template<typename T> struct AVX2Ops;
+template<typename T> struct AVX512Ops;
+
+template<> struct SSE2Ops<double>
+{
+    typedef __m128d V;
+    typedef __m128d D;
+    static const size_t width = 2;
+
+    QUANTUM_SSE2 static inline V    set1(   double x )               { return _mm_set1_pd(x); }
+    QUANTUM_SSE2 static inline V    load(   const double * p )       { return _mm_loadu_pd(p); }
+    QUANTUM_SSE2 static inline void store(  double * p, V v )        { _mm_storeu_pd(p, v); }
+    QUANTUM_SSE2 static inline V    mul(    V a, V b )               { return _mm_mul_pd(a, b); }
+    QUANTUM_SSE2 static inline V    fmadd(  V a, V b, V c )          { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+    QUANTUM_SSE2 static inline V    fnmadd( V a, V b, V c )          { return _mm_sub_pd(c, _mm_mul_pd(a, b)); }
+    QUANTUM_SSE2 static inline D    zero()                           { return _mm_setzero_pd(); }
+    QUANTUM_SSE2 static inline D    addSquares( D acc, const double * r, const double * i )
+    {
+        const V a = _mm_loadu_pd(r), b = _mm_loadu_pd(i);
+        return _mm_add_pd(acc, _mm_add_pd(_mm_mul_pd(a, a), _mm_mul_pd(b, b)));
+    }
+    QUANTUM_SSE2 static inline double sum( D acc )
+    {
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        return lanes[0] + lanes[1];
+    }
+};
+
+template<> struct SSE2Ops<float>
+{
+    typedef __m128  V;
+    typedef __m128d D;
+    static const size_t width = 4;
+
+    QUANTUM_SSE2 static inline V    set1(   float x )                { return _mm_set1_ps(x); }
+    QUANTUM_SSE2 static inline V    load(   const float * p )        { return _mm_loadu_ps(p); }
+    QUANTUM_SSE2 static inline void store(  float * p, V v )         { _mm_storeu_ps(p, v); }
+    QUANTUM_SSE2 static inline V    mul(    V a, V b )               { return _mm_mul_ps(a, b); }
+    QUANTUM_SSE2 static inline V    fmadd(  V a, V b, V c )          { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    QUANTUM_SSE2 static inline V    fnmadd( V a, V b, V c )          { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+    QUANTUM_SSE2 static inline D    zero()                           { return _mm_setzero_pd(); }
+    QUANTUM_SSE2 static inline D    addSquares( D acc, const float * r, const float * i )
+    {
+        const V a = _mm_loadu_ps(r), b = _mm_loadu_ps(i);
+        const D a0 = _mm_cvtps_pd(a), a1 = _mm_cvtps_pd(_mm_movehl_ps(a, a));
+        const D b0 = _mm_cvtps_pd(b), b1 = _mm_cvtps_pd(_mm_movehl_ps(b, b));
+        acc = _mm_add_pd(acc, _mm_add_pd(_mm_mul_pd(a0, a0), _mm_mul_pd(b0, b0)));
+        return _mm_add_pd(acc, _mm_add_pd(_mm_mul_pd(a1, a1), _mm_mul_pd(b1, b1)));
+    }
+    QUANTUM_SSE2 static inline double sum( D acc )
+    {
+        double lanes[2];
+        _mm_storeu_pd(lanes, acc);
+        return lanes[0] + lanes[1];
+    }
+};
+
+template<> struct AVX2Ops<double>
+{
+    typedef __m256d V;
+    typedef __m256d D;
+    static const size_t width = 4;
+
+    QUANTUM_AVX2 static inline V    set1(   double x )               { return _mm256_set1_pd(x); }
+    QUANTUM_AVX2 static inline V    load(   const double * p )       { return _mm256_loadu_pd(p); }
+    QUANTUM_AVX2 static inline void store(  double * p, V v )        { _mm256_storeu_pd(p, v); }
+    QUANTUM_AVX2 static inline V    mul(    V a, V b )               { return _mm256_mul_pd(a, b); }
+    QUANTUM_AVX2 static inline V    fmadd(  V a, V b, V c )          { return _mm256_fmadd_pd(a, b, c); }
+    QUANTUM_AVX2 static inline V    fnmadd( V a, V b, V c )          { return _mm256_fnmadd_pd(a, b, c); }
+    QUANTUM_AVX2 static inline D    zero()                           { return _mm256_setzero_pd(); }
+    QUANTUM_AVX2 static inline D    addSquares( D acc, const double * r, const double * i )
+    {
+        const V a = _mm256_loadu_pd(r), b = _mm256_loadu_pd(i);
+        return _mm256_fmadd_pd(b, b, _mm256_fmadd_pd(a, a, acc));
+    }
+    QUANTUM_AVX2 static inline double sum( D acc )
+    {
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+};
+
+template<> struct AVX2Ops<float>
+{
+    typedef __m256  V;
+    typedef __m256d D;
+    static const size_t width = 8;
+
+    QUANTUM_AVX2 static inline V    set1(   float x )                { return _mm256_set1_ps(x); }
+    QUANTUM_AVX2 static inline V    load(   const float * p )        { return _mm256_loadu_ps(p); }
+    QUANTUM_AVX2 static inline void store(  float * p, V v )         { _mm256_storeu_ps(p, v); }
+    QUANTUM_AVX2 static inline V    mul(    V a, V b )               { return _mm256_mul_ps(a, b); }
+    QUANTUM_AVX2 static inline V    fmadd(  V a, V b, V c )          { return _mm256_fmadd_ps(a, b, c); }
+    QUANTUM_AVX2 static inline V    fnmadd( V a, V b, V c )          { return _mm256_fnmadd_ps(a, b, c); }
+    QUANTUM_AVX2 static inline D    zero()                           { return _mm256_setzero_pd(); }
+    QUANTUM_AVX2 static inline D    addSquares( D acc, const float * r, const float * i )
+    {
+        const V a = _mm256_loadu_ps(r), b = _mm256_loadu_ps(i);
+        const D a0 = _mm256_cvtps_pd(_mm256_castps256_ps128(a)), a1 = _mm256_cvtps_pd(_mm256_extractf128_ps(a, 1));
+        const D b0 = _mm256_cvtps_pd(_mm256_castps256_ps128(b)), b1 = _mm256_cvtps_pd(_mm256_extractf128_ps(b, 1));
+        acc = _mm256_fmadd_pd(b0, b0, _mm256_fmadd_pd(a0, a0, acc));
+        return _mm256_fmadd_pd(b1, b1, _mm256_fmadd_pd(a1, a1, acc));
+    }
+    QUANTUM_AVX2 static inline double sum( D acc )
+    {
+        double lanes[4];
+        _mm256_storeu_pd(lanes, acc);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+};
+
+template<> struct AVX512Ops<double>
+{
+    typedef __m512d V;
+    typedef __m512d D;
+    static const size_t width = 8;
+
+    QUANTUM_AVX512 static inline V    set1(   double x )             { return _mm512_set1_pd(x); }
+    QUANTUM_AVX512 static inline V    load(   const double * p )     { return _mm512_loadu_pd(p); }
+    QUANTUM_AVX512 static inline void store(  double * p, V v )      { _mm512_storeu_pd(p, v); }
+    QUANTUM_AVX512 static inline V    mul(    V a, V b )             { return _mm512_mul_pd(a, b); }
+    QUANTUM_AVX512 static inline V    fmadd(  V a, V b, V c )        { return _mm512_fmadd_pd(a, b, c); }
+    QUANTUM_AVX512 static inline V    fnmadd( V a, V b, V c )        { return _mm512_fnmadd_pd(a, b, c); }
+    QUANTUM_AVX512 static inline D    zero()                         { return _mm512_setzero_pd(); }
+    QUANTUM_AVX512 static inline D    addSquares( D acc, const double * r, const double * i )
+    {
+        const V a = _mm512_loadu_pd(r), b = _mm512_loadu_pd(i);
+        return _mm512_fmadd_pd(b, b, _mm512_fmadd_pd(a, a, acc));
+    }
+    QUANTUM_AVX512 static inline double sum( D acc )
+    {
+        double lanes[8];
+        _mm512_storeu_pd(lanes, acc);
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+};
+
+template<> struct AVX512Ops<float>
+{
+    typedef __m512  V;
+    typedef __m512d D;
+    static const size_t width = 16;
+
+    QUANTUM_AVX512 static inline V    set1(   float x )              { return _mm512_set1_ps(x); }
+    QUANTUM_AVX512 static inline V    load(   const float * p )      { return _mm512_loadu_ps(p); }
+    QUANTUM_AVX512 static inline void store(  float * p, V v )       { _mm512_storeu_ps(p, v); }
+    QUANTUM_AVX512 static inline V    mul(    V a, V b )             { return _mm512_mul_ps(a, b); }
+    QUANTUM_AVX512 static inline V    fmadd(  V a, V b, V c )        { return _mm512_fmadd_ps(a, b, c); }
+    QUANTUM_AVX512 static inline V    fnmadd( V a, V b, V c )        { return _mm512_fnmadd_ps(a, b, c); }
+    QUANTUM_AVX512 static inline D    zero()                         { return _mm512_setzero_pd(); }
+    QUANTUM_AVX512 static inline D    addSquares( D acc, const float * r, const float * i )
+    {
+        // The zero masked conversion has no undefined source operand for GCC to warn about
+        const D a0 = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(r)), a1 = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(r + 8));
+        const D b0 = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(i)), b1 = _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(i + 8));
+        acc = _mm512_fmadd_pd(b0, b0, _mm512_fmadd_pd(a0, a0, acc));
+        return _mm512_fmadd_pd(b1, b1, _mm512_fmadd_pd(a1, a1, acc));
+    }
+    QUANTUM_AVX512 static inline double sum( D acc )
+    {
+        double lanes[8];
+        _mm512_storeu_pd(lanes, acc);
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    }
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Vector kernels. The target attribute has to be on each function so there is one copy
+// of the body per instruction set, each a template over the amplitude type.
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#define QUANTUM_APPLY_PAIRS_BODY(Ops)                                                                   \
+    typedef typename Ops::V V;                                                                          \
+                                                                                                        \
+    const V u00r = Ops::set1(m.re[0]), u00i = Ops::set1(m.im[0]);                                       \
+    const V u01r = Ops::set1(m.re[1]), u01i = Ops::set1(m.im[1]);                                       \
+    const V u10r = Ops::set1(m.re[2]), u10i = Ops::set1(m.im[2]);                                       \
+    const V u11r = Ops::set1(m.re[3]), u11i = Ops::set1(m.im[3]);                                       \
+                                                                                                        \
+    size_t j = 0;                                                                                       \
+    for(; j + Ops::width <= count; j += Ops::width)                                                     \
+    {                                                                                                   \
+        const V a0r = Ops::load(re + o0 + j), a0i = Ops::load(im + o0 + j);                             \
+        const V a1r = Ops::load(re + o1 + j), a1i = Ops::load(im + o1 + j);                             \
+                                                                                                        \
+        V n0r = Ops::mul(u00r, a0r);                                                                    \
+        n0r   = Ops::fnmadd(u00i, a0i, n0r);                                                            \
+        n0r   = Ops::fmadd( u01r, a1r, n0r);                                                            \
+        n0r   = Ops::fnmadd(u01i, a1i, n0r);                                                            \
+        V n0i = Ops::mul(u00r, a0i);                                                                    \
+        n0i   = Ops::fmadd( u00i, a0r, n0i);                                                            \
+        n0i   = Ops::fmadd( u01r, a1i, n0i);                                                            \
+        n0i   = Ops::fmadd( u01i, a1r, n0i);                                                            \
+        V n1r = Ops::mul(u10r, a0r);                                                                    \
+        n1r   = Ops::fnmadd(u10i, a0i, n1r);                                                            \
+        n1r   = Ops::fmadd( u11r, a1r, n1r);                                                            \
+        n1r   = Ops::fnmadd(u11i, a1i, n1r);                                                            \
+        V n1i = Ops::mul(u10r, a0i);                                                                    \
+        n1i   = Ops::fmadd( u10i, a0r, n1i);                                                            \
+        n1i   = Ops::fmadd( u11r, a1i, n1i);                                                            \
+        n1i   = Ops::fmadd( u11i, a1r, n1i);                                                            \
+                                                                                                        \
+        Ops::store(re + o0 + j, n0r); Ops::store(im + o0 + j, n0i);                                     \
+        Ops::store(re + o1 + j, n1r); Ops::store(im + o1 + j, n1i);                                     \
+    }                                                                                                   \
+                                                                                                        \
+    applyPairsScalar(re, im, o0 + j, o1 + j, count - j, m);
+
+#define QUANTUM_SUM_SQUARES_BODY(Ops)                                                                   \
+    typename Ops::D acc = Ops::zero();                                                                  \
+                                                                                                        \
+    size_t j = 0;                                                                                       \
+    for(; j + Ops::width <= count; j += Ops::width)                                                     \
+        acc = Ops::addSquares(acc, re + j, im + j);                                                     \
+                                                                                                        \
+    return Ops::sum(acc) + sumSquaresScalar(re + j, im + j, count - j);
+
+#define QUANTUM_SCALE_BODY(Ops)                                                                         \
+    const typename Ops::V f = Ops::set1((T)factor);                                                     \
+                                                                                                        \
+    size_t j = 0;                                                                                       \
+    for(; j + Ops::width <= count; j += Ops::width)                                                     \
+    {                                                                                                   \
+        Ops::store(re + j, Ops::mul(Ops::load(re + j), f));                                             \
+        Ops::store(im + j, Ops::mul(Ops::load(im + j), f));                                             \
+    }                                                                                                   \
+                                                                                                        \
+    scaleScalar(re + j, im + j, count - j, factor);
+
+#define QUANTUM_SWAP_BODY(Ops)                                                                          \
+    typedef typename Ops::V V;                                                                          \
+                                                                                                        \
+    size_t j = 0;                                                                                       \
+    for(; j + Ops::width <= count; j += Ops::width)                                                     \
+    {                                                                                                   \
+        const V a0r = Ops::load(re + o0 + j), a0i = Ops::load(im + o0 + j);                             \
+        const V a1r = Ops::load(re + o1 + j), a1i = Ops::load(im + o1 + j);                             \
+                                                                                                        \
+        Ops::store(re + o0 + j, a1r); Ops::store(im + o0 + j, a1i);                                     \
+        Ops::store(re + o1 + j, a0r); Ops::store(im + o1 + j, a0i);                                     \
+    }                                                                                                   \
+                                                                                                        \
+    swapPairsScalar(re, im, o0 + j, o1 + j, count - j);
+
+#define QUANTUM_PHASE_BODY(Ops)                                                                         \
+    typedef typename Ops::V V;                                                                          \
+                                                                                                        \
+    const V pr = Ops::set1((T)phaseRe), pi = Ops::set1((T)phaseIm);                                     \
+                                                                                                        \
+    size_t j = 0;                                                                                       \
+    for(; j + Ops::width <= count; j += Ops::width)                                                     \
+    {                                                                                                   \
+        const V ar = Ops::load(re + j), ai = Ops::load(im + j);                                         \
+                                                                                                        \
+        Ops::store(re + j, Ops::fnmadd(pi, ai, Ops::mul(pr, ar)));                                      \
+        Ops::store(im + j, Ops::fmadd( pi, ar, Ops::mul(pr, ai)));                                      \
+    }                                                                                                   \
+                                                                                                        \
+    phaseScalar(re + j, im + j, count - j, phaseRe, phaseIm);
+
+template<typename T> QUANTUM_SSE2
+static void   applyPairsSSE2(   T * re, T * im, size_t o0, size_t o1, size_t count, const ofxQuantumGateMatrixT<T> & m ) { QUANTUM_APPLY_PAIRS_BODY(SSE2Ops<T>) }
+template<typename T> QUANTUM_SSE2
+static double sumSquaresSSE2(   const T * re, const T * im, size_t count )                                                { QUANTUM_SUM_SQUARES_BODY(SSE2Ops<T>) }
+template<typename T> QUANTUM_SSE2
+static void   scaleSSE2(        T * re, T * im, size_t count, double factor )                                             { QUANTUM_SCALE_BODY(SSE2Ops<T>) }
+template<typename T> QUANTUM_SSE2
+static void   swapPairsSSE2(    T * re, T * im, size_t o0, size_t o1, size_t count )                                      { QUANTUM_SWAP_BODY(SSE2Ops<T>) }
+template<typename T> QUANTUM_SSE2
+static void   phaseSSE2(        T * re, T * im, size_t count, double phaseRe, double phaseIm )                            { QUANTUM_PHASE_BODY(SSE2Ops<T>) }
+
+template<typename T> QUANTUM_AVX2
+static void   applyPairsAVX2(   T * re, T * im, size_t o0, size_t o1, size_t count, const ofxQuantumGateMatrixT<T> & m ) { QUANTUM_APPLY_PAIRS_BODY(AVX2Ops<T>) }
+template<typename T> QUANTUM_AVX2
+static double sumSquaresAVX2(   const T * re, const T * im, size_t count )                                                { QUANTUM_SUM_SQUARES_BODY(AVX2Ops<T>) }
+template<typename T> QUANTUM_AVX2
+static void   scaleAVX2(        T * re, T * im, size_t count, double factor )                                             { QUANTUM_SCALE_BODY(AVX2Ops<T>) }
+template<typename T> QUANTUM_AVX2
+static void   swapPairsAVX2(    T * re, T * im, size_t o0, size_t o1, size_t count )                                      { QUANTUM_SWAP_BODY(AVX2Ops<T>) }
+template<typename T> QUANTUM_AVX2
+static void   phaseAVX2(        T * re, T * im, size_t count, double phaseRe, double phaseIm )                            { QUANTUM_PHASE_BODY(AVX2Ops<T>) }
+
+template<typename T> QUANTUM_AVX512
+static void   applyPairsAVX512( T * re, T * im, size_t o0, size_t o1, size_t count, const ofxQuantumGateMatrixT<T> & m ) { QUANTUM_APPLY_PAIRS_BODY(AVX512Ops<T>) }
+template<typename T> QUANTUM_AVX512
+static double sumSquaresAVX512( const T * re, const T * im, size_t count )                                                { QUANTUM_SUM_SQUARES_BODY(AVX512Ops<T>) }
+template<typename T> QUANTUM_AVX512
+static void   scaleAVX512(      T * re, T * im, size_t count, double factor )                                             { QUANTUM_SCALE_BODY(AVX512Ops<T>) }
+template<typename T> QUANTUM_AVX512
+static void   swapPairsAVX512(  T * re, T * im, size_t o0, size_t o1, size_t count )                                      { QUANTUM_SWAP_BODY(AVX512Ops<T>) }
+template<typename T> QUANTUM_AVX512
+static void   phaseAVX512(      T * re, T * im, size_t count, double phaseRe, double phaseIm )                            { QUANTUM_PHASE_BODY(AVX512Ops<T>) }
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Dispatch
+//////////////////////////////////////////////////////////////////////////////////////////
+
+// Set of kernels for one instruction set and precision
+template<typename T>
+struct KernelTable
+{
+    size_t  width;                                                                              // Amplitudes per vector register
+    void   (*applyPairs)( T *, T *, size_t, size_t, size_t, const ofxQuantumGateMatrixT<T> & );
+    double (*sumSquares)( const T *, const T *, size_t );
+    void   (*scale)     ( T *, T *, size_t, double );
+    void   (*swapPairs) ( T *, T *, size_t, size_t, size_t );
+    void   (*phase)     ( T *, T *, size_t, double, double );
+};
+
+// Table for a given level, built once for each precision
+template<typename T>
+static const KernelTable<T> * tableForLevel( ofxQuantumKernels::SimdLevel level )
+{
+    static const KernelTable<T> scalarTable = { 1, applyPairsScalar<T>, sumSquaresScalar<T>, scaleScalar<T>, swapPairsScalar<T>, phaseScalar<T> };
+
+#ifdef QUANTUM_X86_KERNELS
+    static const KernelTable<T> sse2Table   = { SSE2Ops<T>::width,   applyPairsSSE2<T>,   sumSquaresSSE2<T>,   scaleSSE2<T>,   swapPairsSSE2<T>,   phaseSSE2<T>   };
+    static const KernelTable<T> avx2Table   = { AVX2Ops<T>::width,   applyPairsAVX2<T>,   sumSquaresAVX2<T>,   scaleAVX2<T>,   swapPairsAVX2<T>,   phaseAVX2<T>   };
+    static const KernelTable<T> avx512Table = { AVX512Ops<T>::width, applyPairsAVX512<T>, sumSquaresAVX512<T>, scaleAVX512<T>, swapPairsAVX512<T>, phaseAVX512<T> };
+#endif
+
+    switch(level)
+    {
+#ifdef QUANTUM_X86_KERNELS
+        case ofxQuantumKernels::SIMD_AVX512: return &avx512Table;
+        case ofxQuantumKernels::SIMD_AVX2:   return &avx2Table;
+        case ofxQuantumKernels::SIMD_SSE2:   return &sse2Table;
+#endif
+        default:                             return &scalarTable;
+    }
+}
+
+// Active level, chosen the first time any kernel runs. -1 until then
+static std::atomic<int> sActiveLevel( -1 );
+
+static ofxQuantumKernels::SimdLevel activeLevel()
+{
+    int level = sActiveLevel.load(std::memory_order_acquire);
+
+    if(level < 0)
+    {
+        level = ofxQuantumKernels::getSupportedSimdLevel();
+        sActiveLevel.store(level, std::memory_order_release);
+    }
+
+    return (ofxQuantumKernels::SimdLevel)level;
+}
+
+template<typename T>
+static const KernelTable<T> * activeTable()
+{
+    return tableForLevel<T>(activeLevel());
+}
+
+////////////////////////////////////////////////////
+// Check which instruction sets the cpu supports  //
+////////////////////////////////////////////////////
+ofxQuantumKernels::SimdLevel ofxQuantumKernels::getSupportedSimdLevel()
+{
+#ifdef QUANTUM_X86_KERNELS
+    __builtin_cpu_init();
+
+    if(__builtin_cpu_supports("avx512f"))
+        return SIMD_AVX512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return SIMD_AVX2;
+    if(__builtin_cpu_supports("sse2"))
+        return SIMD_SSE2;
+#endif
+
+    return SIMD_SCALAR;
+}
+
+////////////////////////////////////////////////////
+// Get the level in use                           //
+////////////////////////////////////////////////////
+ofxQuantumKernels::SimdLevel ofxQuantumKernels::getSimdLevel()
+{
+    return activeLevel();
+}
+
+////////////////////////////////////////////////////
+// Set the level in use                           //
+////////////////////////////////////////////////////
+void ofxQuantumKernels::setSimdLevel( SimdLevel level )
+{
+    SimdLevel supported = getSupportedSimdLevel();
+
+    if(level > supported)
+        level = supported;
+
+    sActiveLevel.store(level, std::memory_order_release);
+}
+
+////////////////////////////////////////////////////
+// Printable name of a level                      //
+////////////////////////////////////////////////////
+const char * ofxQuantumKernels::getSimdLevelName( SimdLevel level )
+{
+    switch(level)
+    {
+        case SIMD_AVX512: return "AVX-512";
+        case SIMD_AVX2:   return "AVX2";
+        case SIMD_SSE2:   return "SSE2";
+        default:          return "scalar";
+    }
+}
+
+////////////////////////////////////////////////////
+// Apply a matrix to runs of amplitude pairs      //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::applyPairs( T * real, T * imag, size_t offset0, size_t offset1, size_t count, const ofxQuantumGateMatrixT<T> & m )
+{
+    activeTable<T>()->applyPairs(real, imag, offset0, offset1, count, m);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Apply a matrix to a single qubit. When the stride is at least one
+// vector wide each run of stride pairs is contiguous in both halves and
+// goes through the vector kernel, low order qubits use the scalar loop.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::applyGate( T * real, T * imag, size_t stride, size_t pairBegin, size_t pairEnd, const ofxQuantumGateMatrixT<T> & m )
+{
+    const KernelTable<T> * table = activeTable<T>();
+
+    if(stride < table->width)
+    {
+        for(size_t k = pairBegin; k < pairEnd; k++)
+        {
+            const size_t i0 = pairIndex(k, stride);
+            applyPairScalar(real, imag, i0, i0 + stride, m);
+        }
+    }
+    else
+    {
+        size_t k = pairBegin;
+
+        while(k < pairEnd)
+        {
+            const size_t i0  = pairIndex(k, stride);
+            size_t       run = stride - (k & (stride - 1));
+
+            if(run > pairEnd - k)
+                run = pairEnd - k;
+
+            table->applyPairs(real, imag, i0, i0 + stride, run, m);
+            k += run;
+        }
+    }
+}
+
+////////////////////////////////////////////////////
+// Swap runs of amplitude pairs                   //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::swapPairs( T * real, T * imag, size_t offset0, size_t offset1, size_t count )
+{
+    activeTable<T>()->swapPairs(real, imag, offset0, offset1, count);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Swap the amplitudes of a qubit. Same runs as applyGate, but there is
+// no arithmetic, each run is just exchanged with its partner.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::applyPermutation( T * real, T * imag, size_t stride, size_t pairBegin, size_t pairEnd )
+{
+    const KernelTable<T> * table = activeTable<T>();
+
+    if(stride < table->width)
+    {
+        for(size_t k = pairBegin; k < pairEnd; k++)
+        {
+            const size_t i0 = pairIndex(k, stride);
+            swapPairsScalar(real, imag, i0, i0 + stride, 1);
+        }
+    }
+    else
+    {
+        size_t k = pairBegin;
+
+        while(k < pairEnd)
+        {
+            const size_t i0  = pairIndex(k, stride);
+            size_t       run = stride - (k & (stride - 1));
+
+            if(run > pairEnd - k)
+                run = pairEnd - k;
+
+            table->swapPairs(real, imag, i0, i0 + stride, run);
+            k += run;
+        }
+    }
+}
+
+////////////////////////////////////////////////////
+// Multiply amplitudes by a phase                 //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::multiplyPhase( T * real, T * imag, size_t count, double phaseRe, double phaseIm )
+{
+    activeTable<T>()->phase(real, imag, count, phaseRe, phaseIm);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Apply a diagonal gate in one pass over the states. The amplitudes are
+// walked in index order, every run of mask states shares a value of the
+// qubit and so a phase, no amplitude is paired with another.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::applyDiagonal( T * real, T * imag, size_t mask, size_t begin, size_t end,
+                                       double phase0Re, double phase0Im, double phase1Re, double phase1Im )
+{
+    const KernelTable<T> * table = activeTable<T>();
+
+    const bool skip0 = phase0Re == 1.0 && phase0Im == 0.0;
+    const bool skip1 = phase1Re == 1.0 && phase1Im == 0.0;
+
+    if(mask < table->width)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            if(i & mask)
+            {
+                if(!skip1)
+                    phaseScalar(real + i, imag + i, 1, phase1Re, phase1Im);
+            }
+            else if(!skip0)
+            {
+                phaseScalar(real + i, imag + i, 1, phase0Re, phase0Im);
+            }
+        }
+    }
+    else
+    {
+        size_t i = begin;
+
+        while(i < end)
+        {
+            size_t run = mask - (i & (mask - 1));
+
+            if(run > end - i)
+                run = end - i;
+
+            if(i & mask)
+            {
+                if(!skip1)
+                    table->phase(real + i, imag + i, run, phase1Re, phase1Im);
+            }
+            else if(!skip0)
+            {
+                table->phase(real + i, imag + i, run, phase0Re, phase0Im);
+            }
+
+            i += run;
+        }
+    }
+}
+
+////////////////////////////////////////////////////
+// Sum of squared amplitudes                      //
+////////////////////////////////////////////////////
+template<typename T>
+double ofxQuantumKernels::sumSquares( const T * real, const T * imag, size_t count )
+{
+    return activeTable<T>()->sumSquares(real, imag, count);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Probability of each value of a qubit over a range of pairs. Runs of
+// at least one vector go through the vector sum, low order qubits are
+// summed one pair at a time.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::sumSquaresPairs( const T * real, const T * imag, size_t stride, size_t pairBegin, size_t pairEnd,
+                                         double & sum0, double & sum1 )
+{
+    const KernelTable<T> * table = activeTable<T>();
+
+    if(stride < table->width)
+    {
+        double total0 = 0.0, total1 = 0.0;
+
+        for(size_t k = pairBegin; k < pairEnd; k++)
+        {
+            const size_t i0 = pairIndex(k, stride);
+            const size_t i1 = i0 + stride;
+
+            total0 += (double)real[i0] * real[i0] + (double)imag[i0] * imag[i0];
+            total1 += (double)real[i1] * real[i1] + (double)imag[i1] * imag[i1];
+        }
+
+        sum0 += total0;
+        sum1 += total1;
+    }
+    else
+    {
+        size_t k = pairBegin;
+
+        while(k < pairEnd)
+        {
+            const size_t i0  = pairIndex(k, stride);
+            size_t       run = stride - (k & (stride - 1));
+
+            if(run > pairEnd - k)
+                run = pairEnd - k;
+
+            sum0 += table->sumSquares(real + i0,          imag + i0,          run);
+            sum1 += table->sumSquares(real + i0 + stride, imag + i0 + stride, run);
+            k += run;
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Collapse a qubit in a single write pass over a range of pairs
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::collapsePairs( T * real, T * imag, size_t stride, size_t pairBegin, size_t pairEnd,
+                                       int keep, double factor )
+{
+    const KernelTable<T> * table = activeTable<T>();
+
+    const size_t keepOffset  = keep ? stride : 0;
+    const size_t clearOffset = keep ? 0 : stride;
+
+    if(stride < table->width)
+    {
+        for(size_t k = pairBegin; k < pairEnd; k++)
+        {
+            const size_t i0 = pairIndex(k, stride);
+
+            real[i0 + keepOffset]  *= (T)factor;
+            imag[i0 + keepOffset]  *= (T)factor;
+            real[i0 + clearOffset]  = 0;
+            imag[i0 + clearOffset]  = 0;
+        }
+    }
+    else
+    {
+        size_t k = pairBegin;
+
+        while(k < pairEnd)
+        {
+            const size_t i0  = pairIndex(k, stride);
+            size_t       run = stride - (k & (stride - 1));
+
+            if(run > pairEnd - k)
+                run = pairEnd - k;
+
+            table->scale(real + i0 + keepOffset, imag + i0 + keepOffset, run, factor);
+            memset(real + i0 + clearOffset, 0, run * sizeof(T));
+            memset(imag + i0 + clearOffset, 0, run * sizeof(T));
+            k += run;
+        }
+    }
+}
+
+////////////////////////////////////////////////////
+// Scale amplitudes                               //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumKernels::scale( T * real, T * imag, size_t count, double factor )
+{
+    activeTable<T>()->scale(real, imag, count, factor);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Single and double precision versions of every kernel
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#define QUANTUM_INSTANTIATE_KERNELS(T)                                                                                              \
+    template void   ofxQuantumKernels::applyPairs<T>(      T *, T *, size_t, size_t, size_t, const ofxQuantumGateMatrixT<T> & );        \
+    template void   ofxQuantumKernels::applyGate<T>(       T *, T *, size_t, size_t, size_t, const ofxQuantumGateMatrixT<T> & );        \
+    template void   ofxQuantumKernels::swapPairs<T>(       T *, T *, size_t, size_t, size_t );                                          \
+    template void   ofxQuantumKernels::applyPermutation<T>( T *, T *, size_t, size_t, size_t );                                         \
+    template void   ofxQuantumKernels::multiplyPhase<T>(   T *, T *, size_t, double, double );                                          \
+    template void   ofxQuantumKernels::applyDiagonal<T>(   T *, T *, size_t, size_t, size_t, double, double, double, double );          \
+    template double ofxQuantumKernels::sumSquares<T>(      const T *, const T *, size_t );                                              \
+    template void   ofxQuantumKernels::scale<T>(           T *, T *, size_t, double );                                                  \
+    template void   ofxQuantumKernels::sumSquaresPairs<T>( const T *, const T *, size_t, size_t, size_t, double &, double & );          \
+    template void   ofxQuantumKernels::collapsePairs<T>(   T *, T *, size_t, size_t, size_t, int, double );
+
+QUANTUM_INSTANTIATE_KERNELS(float)
+QUANTUM_INSTANTIATE_KERNELS(double)
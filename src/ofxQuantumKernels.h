@@ -0,0 +1,134 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumKernels.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumKernels are the inner loops that operate on the amplitude planes of an ofxQuantumStateBuffer. Each kernel has a
+//  scalar version plus SSE2, AVX2 and AVX-512 versions on x86, the fastest one supported by the cpu is picked the first time
+//  the kernels are used. The active level can be lowered with setSimdLevel, e.g. to compare results against the scalar path.
+//  Every kernel is a template over the amplitude type and is compiled for both float and double, so single precision
+//  registers get twice as many amplitudes per vector register. Sums of squares are always accumulated in double.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMKERNELS_H
+#define OFXQUANTUMKERNELS_H
+
+// Includes
+#include <stddef.h>
+#include "Complex.h"
+
+// A 2x2 complex matrix in row major order { u00, u01, u10, u11 }, split into real and imaginary parts
+template<typename T>
+struct ofxQuantumGateMatrixT
+{
+    T re[4];
+    T im[4];
+};
+
+typedef ofxQuantumGateMatrixT<double> ofxQuantumGateMatrix;
+
+class ofxQuantumKernels
+{
+public:
+
+    // Instruction set used by the kernels
+    enum SimdLevel
+    {
+        SIMD_SCALAR = 0,
+        SIMD_SSE2,
+        SIMD_AVX2,
+        SIMD_AVX512
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Highest level the cpu supports, and the level currently in use
+    static SimdLevel    getSupportedSimdLevel();
+    static SimdLevel    getSimdLevel();
+
+    // Change the active level, requests above the supported level are clamped
+    static void         setSimdLevel( SimdLevel level );
+
+    // Name of a level for printing
+    static const char * getSimdLevelName( SimdLevel level );
+
+    // Build a kernel matrix from four complex numbers in row major order
+    template<typename T = double>
+    static ofxQuantumGateMatrixT<T> makeMatrix( const Complex matrix[4] )
+    {
+        ofxQuantumGateMatrixT<T> m;
+
+        for(int i = 0; i < 4; i++)
+        {
+            m.re[i] = (T)matrix[i].getReal();
+            m.im[i] = (T)matrix[i].getImag();
+        }
+
+        return m;
+    }
+
+    // Apply a matrix to the amplitude pairs (offset0 + j, offset1 + j) for j = 0 .. count-1
+    template<typename T>
+    static void   applyPairs( T * real, T * imag, size_t offset0, size_t offset1, size_t count, const ofxQuantumGateMatrixT<T> & m );
+
+    // Apply a matrix to a single qubit whose index bit is stride. Pairs are numbered 0 .. numStates/2-1 in index
+    // order and only the pairs in [pairBegin, pairEnd) are processed, so the work can be split into ranges
+    template<typename T>
+    static void   applyGate( T * real, T * imag, size_t stride, size_t pairBegin, size_t pairEnd, const ofxQuantumGateMatrixT<T> & m );
+
+    // Swap the amplitude pairs (offset0 + j, offset1 + j) for j = 0 .. count-1
+    template<typename T>
+    static void   swapPairs( T * real, T * imag, size_t offset0, size_t offset1, size_t count );
+
+    // Swap the two amplitudes of pairs [pairBegin, pairEnd) of a qubit, a pauli-X that only moves memory
+    template<typename T>
+    static void   applyPermutation( T * real, T * imag, size_t stride, size_t pairBegin, size_t pairEnd );
+
+    // Multiply count amplitudes by a complex phase
+    template<typename T>
+    static void   multiplyPhase( T * real, T * imag, size_t count, double phaseRe, double phaseIm );
+
+    // Multiply amplitudes [begin, end) by phase0 where the qubit whose index bit is mask is 0 and by phase1 where it is 1.
+    // A phase of exactly 1 is skipped, so gates like Z, S and T only touch half of the states
+    template<typename T>
+    static void   applyDiagonal( T * real, T * imag, size_t mask, size_t begin, size_t end,
+                                 double phase0Re, double phase0Im, double phase1Re, double phase1Im );
+
+    // Sum of |a|^2 over count amplitudes
+    template<typename T>
+    static double sumSquares( const T * real, const T * imag, size_t count );
+
+    // Multiply count amplitudes by a real factor
+    template<typename T>
+    static void   scale( T * real, T * imag, size_t count, double factor );
+
+    // Add the |a|^2 of the first and second amplitude of pairs [pairBegin, pairEnd) of a qubit to sum0 and sum1
+    template<typename T>
+    static void   sumSquaresPairs( const T * real, const T * imag, size_t stride, size_t pairBegin, size_t pairEnd,
+                                   double & sum0, double & sum1 );
+
+    // Collapse pairs [pairBegin, pairEnd) of a qubit onto one value, the kept half is scaled by factor and the other is zeroed
+    template<typename T>
+    static void   collapsePairs( T * real, T * imag, size_t stride, size_t pairBegin, size_t pairEnd,
+                                 int keep, double factor );
+
+    // Index of the first amplitude of pair k for a qubit whose index bit is stride
+    static size_t pairIndex( size_t k, size_t stride ) { return ((k & ~(stride - 1)) << 1) | (k & (stride - 1)); }
+
+    // Spread the bits of k around the set bits of fixedMask, leaving a zero at every fixed position
+    static size_t insertZeroBits( size_t k, size_t fixedMask )
+    {
+        for(size_t f = fixedMask; f != 0; f &= f - 1)
+        {
+            const size_t low = (f & (~f + 1)) - 1;
+            k = ((k & ~low) << 1) | (k & low);
+        }
+        return k;
+    }
+};
+
+#endif
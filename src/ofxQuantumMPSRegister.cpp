@@ -0,0 +1,828 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumMPSRegister.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumMPSRegister.h"
+#include "ofxQuantum.h"
+
+#include <algorithm>
+#include <iostream>
+#include <math.h>
+
+using namespace std;
+
+// Largest number of sweeps of Jacobi rotations, they converge in well under 20 for the matrices we split
+#define QUANTUM_MPS_MAX_SWEEPS 60
+
+typedef ofxQuantumMPSRegister::Amplitude Amplitude;
+
+// Complex products for the inner loops, std::complex multiplication also handles infinities and NaN which makes it a
+// library call unless the compiler is told complex arithmetic can ignore them
+static inline Amplitude multiply( const Amplitude & a, const Amplitude & b )
+{
+    return Amplitude(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+// conj(a) * b
+static inline Amplitude multiplyConj( const Amplitude & a, const Amplitude & b )
+{
+    return Amplitude(a.real() * b.real() + a.imag() * b.imag(), a.real() * b.imag() - a.imag() * b.real());
+}
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+
+ofxQuantumMPSRegister::ofxQuantumMPSRegister( unsigned long long int size, ofxQuantum *quantumSim, size_t maxBondDim )
+{
+    mQuantumSim     = quantumSim;
+    mRegSize        = size;
+    mCentre         = 0;
+    mMaxBondDim     = std::max<size_t>(maxBondDim, 1);
+    mFidelity       = 1.0;
+    mLastTruncation = 0.0;
+
+    // A product state has bonds of dimension 1, each tensor is just the amplitudes of its qubit
+    mSites.resize((size_t)mRegSize);
+
+    for(size_t q = 0; q < mSites.size(); q++)
+    {
+        mSites[q].left  = 1;
+        mSites[q].right = 1;
+        mSites[q].data.assign(2, Amplitude(0, 0));
+        mSites[q].data[0] = 1;
+    }
+}
+
+////////////////////////////////////////////////////
+// Check a qubit index                            //
+////////////////////////////////////////////////////
+
+bool ofxQuantumMPSRegister::checkBit( unsigned long long int bit ) const
+{
+    if(bit >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure a single qubit. With the centre on the qubit the chance of
+// each value is the weight of its half of the centre tensor, the other
+// half is cleared and the rest renormalised.
+////////////////////////////////////////////////////////////////////////
+
+int ofxQuantumMPSRegister::measureBit( unsigned long long int bitIndx )
+{
+    if(!checkBit(bitIndx))
+        return -1;
+
+    moveCentre((size_t)bitIndx);
+
+    Site & site = mSites[(size_t)bitIndx];
+
+    double prob[2] = { 0.0, 0.0 };
+
+    for(size_t l = 0; l < site.left; l++)
+        for(int s = 0; s < 2; s++)
+            for(size_t r = 0; r < site.right; r++)
+                prob[s] += norm(site.at(l, s, r));
+
+    // Check our probabilities against the random number, an outcome with no chance is never picked
+    double quantumRandomNum = mQuantumSim->getRandom();
+
+    int result = (prob[0] / (prob[0] + prob[1]) >= quantumRandomNum) ? 0 : 1;
+
+    if(prob[result] <= 0.0)
+        result = 1 - result;
+
+    const double factor = 1.0 / sqrt(prob[result]);
+
+    for(size_t l = 0; l < site.left; l++)
+    {
+        for(size_t r = 0; r < site.right; r++)
+        {
+            site.at(l, result, r)     *= factor;
+            site.at(l, 1 - result, r)  = 0;
+        }
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure several bits, one after another
+////////////////////////////////////////////////////////////////////////
+
+unsigned long long int ofxQuantumMPSRegister::measureBits( unsigned long long int qubitMask )
+{
+    if(mRegSize < 64 && (qubitMask >> mRegSize) != 0)
+    {
+        printf("ERROR! qubit mask selects bits outside the register\n");
+        return 0;
+    }
+
+    unsigned long long int result = 0;
+
+    for(unsigned long long int q = 0; q < mRegSize && q < 64; q++)
+    {
+        if(((qubitMask >> q) & 1) && measureBit(q) == 1)
+            result |= 1ULL << q;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure every qubit from the left, the centre only moves one site at
+// a time so the whole register costs one sweep
+////////////////////////////////////////////////////////////////////////
+
+unsigned long long int ofxQuantumMPSRegister::decimalMeasure()
+{
+    if(mRegSize > 64)
+    {
+        printf("ERROR! a register of %llu qubits does not fit in a decimal value\n", mRegSize);
+        return ~0ULL;
+    }
+
+    unsigned long long int decVal = 0;
+
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+        decVal = (decVal << 1) | (unsigned long long int)measureBit(q);
+
+    return decVal;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Amplitude of a state, the product of the matrices each qubit picks
+////////////////////////////////////////////////////////////////////////
+
+Complex ofxQuantumMPSRegister::getState( unsigned long long int stateIndx ) const
+{
+    if(mRegSize > 64)
+    {
+        printf("ERROR! a register of %llu qubits does not fit in a state indx, use getAmplitude\n", mRegSize);
+        return Complex(0, 0);
+    }
+
+    std::vector<int> bits((size_t)mRegSize);
+
+    for(size_t q = 0; q < bits.size(); q++)
+        bits[q] = (int)((stateIndx >> (mRegSize - 1 - q)) & 1);
+
+    return getAmplitude(bits);
+}
+
+Complex ofxQuantumMPSRegister::getAmplitude( const std::vector<int> & bits ) const
+{
+    if(bits.size() != mSites.size())
+    {
+        printf("ERROR! %zu bit values given for a register of %llu qubits\n", bits.size(), mRegSize);
+        return Complex(0, 0);
+    }
+
+    std::vector<Amplitude> vec(1, Amplitude(1, 0));
+
+    for(size_t q = 0; q < mSites.size(); q++)
+    {
+        const Site &           site = mSites[q];
+        const int              s    = bits[q] != 0;
+        std::vector<Amplitude> next(site.right, Amplitude(0, 0));
+
+        for(size_t l = 0; l < site.left; l++)
+            for(size_t r = 0; r < site.right; r++)
+                next[r] += multiply(vec[l], site.at(l, s, r));
+
+        vec.swap(next);
+    }
+
+    return Complex(vec[0].real(), vec[0].imag());
+}
+
+////////////////////////////////////////////////////
+// Get number of qubits in register               //
+////////////////////////////////////////////////////
+
+int ofxQuantumMPSRegister::size() const
+{
+    return (int)mRegSize;
+}
+
+////////////////////////////////////////////////////
+// Print the bond dimensions                      //
+////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::printInfo() const
+{
+    cout << "MPS register of " << mRegSize << " qubits, max bond dimension " << mMaxBondDim << endl;
+    cout << "Bond dimensions:";
+
+    for(size_t q = 0; q + 1 < mSites.size(); q++)
+        cout << " " << mSites[q].right;
+
+    cout << endl << "Truncation error " << getTruncationError() << endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Single qubit gates only mix the two halves of one tensor, the bonds and the canonical form
+// are unchanged
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::applyGate( unsigned long long int bit, const Complex matrix[4] )
+{
+    if(!checkBit(bit))
+        return;
+
+    Site & site = mSites[(size_t)bit];
+
+    Amplitude m[4];
+    for(int i = 0; i < 4; i++)
+        m[i] = Amplitude(matrix[i].getReal(), matrix[i].getImag());
+
+    for(size_t l = 0; l < site.left; l++)
+    {
+        for(size_t r = 0; r < site.right; r++)
+        {
+            const Amplitude a0 = site.at(l, 0, r);
+            const Amplitude a1 = site.at(l, 1, r);
+
+            site.at(l, 0, r) = multiply(m[0], a0) + multiply(m[1], a1);
+            site.at(l, 1, r) = multiply(m[2], a0) + multiply(m[3], a1);
+        }
+    }
+}
+
+void ofxQuantumMPSRegister::applyGateX(   unsigned long long int bit ) { apply(ofxQuantumGateX(),   bit); }
+void ofxQuantumMPSRegister::applyGateY(   unsigned long long int bit ) { apply(ofxQuantumGateY(),   bit); }
+void ofxQuantumMPSRegister::applyGateZ(   unsigned long long int bit ) { apply(ofxQuantumGateZ(),   bit); }
+void ofxQuantumMPSRegister::applyGateS(   unsigned long long int bit ) { apply(ofxQuantumGateS(),   bit); }
+void ofxQuantumMPSRegister::applyGateT(   unsigned long long int bit ) { apply(ofxQuantumGateT(),   bit); }
+void ofxQuantumMPSRegister::applyGateHad( unsigned long long int bit ) { apply(ofxQuantumGateHad(), bit); }
+
+void ofxQuantumMPSRegister::applyGatePhase( unsigned long long int bit, double theta ) { apply(ofxQuantumGatePhase(theta), bit); }
+void ofxQuantumMPSRegister::applyGateRx(    unsigned long long int bit, double theta ) { apply(ofxQuantumGateRx(theta),    bit); }
+void ofxQuantumMPSRegister::applyGateRy(    unsigned long long int bit, double theta ) { apply(ofxQuantumGateRy(theta),    bit); }
+void ofxQuantumMPSRegister::applyGateRz(    unsigned long long int bit, double theta ) { apply(ofxQuantumGateRz(theta),    bit); }
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Two qubit gates are built as 4x4 matrices over (control, target)
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::applyControlledGate( const std::vector<unsigned long long int> & controls,
+                                                 unsigned long long int target,
+                                                 const Complex matrix[4],
+                                                 unsigned long long int controlValues )
+{
+    if(controls.size() != 1)
+    {
+        printf("ERROR! MPS registers only apply gates with a single control, %zu given\n", controls.size());
+        return;
+    }
+
+    const int active = (int)(controlValues & 1);
+
+    Amplitude m[16];
+
+    for(int c = 0; c < 2; c++)
+    {
+        for(int t = 0; t < 4; t++)
+        {
+            const int row = c * 2 + (t >> 1);
+            const int col = c * 2 + (t & 1);
+
+            m[row * 4 + col] = (c == active) ? Amplitude(matrix[t].getReal(), matrix[t].getImag())
+                                             : Amplitude((t >> 1) == (t & 1) ? 1 : 0, 0);
+        }
+    }
+
+    applyTwoQubit(controls[0], target, m);
+}
+
+void ofxQuantumMPSRegister::applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit )
+{
+    Complex matrix[4];
+    ofxQuantumGateX().getMatrix(matrix);
+
+    applyControlledGate(std::vector<unsigned long long int>(1, controlBit), bit, matrix);
+}
+
+void ofxQuantumMPSRegister::applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta )
+{
+    Complex matrix[4];
+    ofxQuantumGatePhase(theta).getMatrix(matrix);
+
+    applyControlledGate(std::vector<unsigned long long int>(1, controlBit), bit, matrix);
+}
+
+void ofxQuantumMPSRegister::applyGateSwap( unsigned long long int bit1, unsigned long long int bit2 )
+{
+    Amplitude m[16];
+    m[0] = m[6] = m[9] = m[15] = 1;
+
+    applyTwoQubit(bit1, bit2, m);
+}
+
+void ofxQuantumMPSRegister::applyMultiQubitGate( const std::vector<unsigned long long int> & qubits, const Complex * matrix )
+{
+    if(qubits.size() == 1)
+    {
+        applyGate(qubits[0], matrix);
+        return;
+    }
+
+    if(qubits.size() != 2)
+    {
+        printf("ERROR! MPS registers only apply gates on one or two qubits, %zu given\n", qubits.size());
+        return;
+    }
+
+    Amplitude m[16];
+    for(int i = 0; i < 16; i++)
+        m[i] = Amplitude(matrix[i].getReal(), matrix[i].getImag());
+
+    applyTwoQubit(qubits[0], qubits[1], m);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Gates on qubits that are not neighbours swap the far qubit along the chain until it is
+// next to the other one, apply the gate and swap it back
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::applyTwoQubit( unsigned long long int bit1, unsigned long long int bit2, const Amplitude matrix[16] )
+{
+    if(!checkBit(bit1) || !checkBit(bit2))
+        return;
+
+    if(bit1 == bit2)
+    {
+        printf("ERROR! invalid control bit %llu for target %llu\n", bit1, bit2);
+        return;
+    }
+
+    // Order the matrix so the lower qubit is the most significant bit of the local index
+    Amplitude ordered[16];
+
+    for(int row = 0; row < 4; row++)
+    {
+        for(int col = 0; col < 4; col++)
+        {
+            if(bit1 < bit2)
+                ordered[row * 4 + col] = matrix[row * 4 + col];
+            else
+                ordered[row * 4 + col] = matrix[((row & 1) * 2 + (row >> 1)) * 4 + (col & 1) * 2 + (col >> 1)];
+        }
+    }
+
+    const size_t lo = (size_t)std::min(bit1, bit2);
+    const size_t hi = (size_t)std::max(bit1, bit2);
+
+    Amplitude swapGate[16];
+    swapGate[0] = swapGate[6] = swapGate[9] = swapGate[15] = 1;
+
+    for(size_t s = hi - 1; s > lo; s--)
+        applyAdjacent(s, swapGate);
+
+    applyAdjacent(lo, ordered);
+
+    for(size_t s = lo + 1; s < hi; s++)
+        applyAdjacent(s, swapGate);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Merge the tensors of two neighbouring qubits, multiply by the gate and split them again
+// keeping at most mMaxBondDim singular values. The centre is moved to the pair first so the
+// singular values are those of the whole state and the dropped weight is the real error.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::applyAdjacent( size_t site, const Amplitude matrix[16] )
+{
+    moveCentre(site);
+
+    Site &       a     = mSites[site];
+    Site &       b     = mSites[site + 1];
+    const size_t left  = a.left;
+    const size_t bond  = a.right;
+    const size_t right = b.right;
+
+    // theta[l][s1][s2][r], the pair as one tensor
+    std::vector<Amplitude> theta(left * 4 * right, Amplitude(0, 0));
+
+    for(size_t l = 0; l < left; l++)
+        for(int s1 = 0; s1 < 2; s1++)
+            for(size_t m = 0; m < bond; m++)
+            {
+                const Amplitude am = a.at(l, s1, m);
+                if(am == Amplitude(0, 0))
+                    continue;
+
+                for(int s2 = 0; s2 < 2; s2++)
+                    for(size_t r = 0; r < right; r++)
+                        theta[((l * 2 + s1) * 2 + s2) * right + r] += multiply(am, b.at(m, s2, r));
+            }
+
+    // Multiply by the gate, the result is already laid out as a (left * 2) x (2 * right) matrix
+    std::vector<Amplitude> gated(theta.size(), Amplitude(0, 0));
+
+    for(size_t l = 0; l < left; l++)
+        for(int t = 0; t < 4; t++)
+            for(int s = 0; s < 4; s++)
+            {
+                const Amplitude g = matrix[t * 4 + s];
+                if(g == Amplitude(0, 0))
+                    continue;
+
+                for(size_t r = 0; r < right; r++)
+                    gated[(l * 4 + t) * right + r] += multiply(g, theta[(l * 4 + s) * right + r]);
+            }
+
+    size_t rank;
+    const double dropped = split(gated, left * 2, 2 * right, mMaxBondDim, true, a.data, b.data, rank);
+
+    a.right = rank;
+    b.left  = rank;
+    mCentre = site + 1;
+
+    mLastTruncation = dropped;
+    mFidelity      *= 1.0 - dropped;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Move the centre one site at a time. The centre tensor is factored into an orthonormal part
+// that stays behind and a remainder that is multiplied into the next tensor along. This keeps
+// every singular value so a QR factorisation is enough, which is far cheaper than the SVD.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::moveCentre( size_t site )
+{
+    while(mCentre < site)
+    {
+        Site & a = mSites[mCentre];
+        Site & b = mSites[mCentre + 1];
+
+        std::vector<Amplitude> q, carry;
+        size_t                 rank;
+        factorQR(a.data, a.left * 2, a.right, q, carry, rank);
+
+        // b becomes carry (rank x a.right) times b (a.right x 2 * b.right)
+        std::vector<Amplitude> next(rank * 2 * b.right, Amplitude(0, 0));
+
+        for(size_t k = 0; k < rank; k++)
+            for(size_t m = 0; m < a.right; m++)
+            {
+                const Amplitude c = carry[k * a.right + m];
+                for(size_t j = 0; j < 2 * b.right; j++)
+                    next[k * 2 * b.right + j] += multiply(c, b.data[m * 2 * b.right + j]);
+            }
+
+        a.data.swap(q);
+        a.right = rank;
+        b.data.swap(next);
+        b.left  = rank;
+        mCentre++;
+    }
+
+    while(mCentre > site)
+    {
+        Site & a = mSites[mCentre];
+        Site & p = mSites[mCentre - 1];
+
+        // a = carry * q with q having orthonormal rows, from the QR factorisation of the conjugate transpose of a
+        const size_t           cols = 2 * a.right;
+        std::vector<Amplitude> adjoint(cols * a.left);
+
+        for(size_t r = 0; r < a.left; r++)
+            for(size_t c = 0; c < cols; c++)
+                adjoint[c * a.left + r] = conj(a.data[r * cols + c]);
+
+        std::vector<Amplitude> qAdj, rAdj;
+        size_t                 rank;
+        factorQR(adjoint, cols, a.left, qAdj, rAdj, rank);
+
+        std::vector<Amplitude> q(rank * cols);
+        for(size_t k = 0; k < rank; k++)
+            for(size_t c = 0; c < cols; c++)
+                q[k * cols + c] = conj(qAdj[c * rank + k]);
+
+        // p becomes p (2 * p.left x a.left) times carry (a.left x rank), carry being rAdj^H
+        std::vector<Amplitude> next(p.left * 2 * rank, Amplitude(0, 0));
+
+        for(size_t i = 0; i < p.left * 2; i++)
+            for(size_t m = 0; m < a.left; m++)
+            {
+                const Amplitude c = p.data[i * a.left + m];
+                for(size_t k = 0; k < rank; k++)
+                    next[i * rank + k] += multiply(c, conj(rAdj[k * a.left + m]));
+            }
+
+        a.data.swap(q);
+        a.left  = rank;
+        p.data.swap(next);
+        p.right = rank;
+        mCentre--;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Thin QR factorisation by modified Gram Schmidt, run twice per column so the columns of q
+// stay orthonormal to rounding error. Columns that are already spanned by the earlier ones
+// are left out, so rank can be less than cols and the bond shrinks with it.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::factorQR( const std::vector<Amplitude> & matrix, size_t rows, size_t cols,
+                                      std::vector<Amplitude> & q, std::vector<Amplitude> & r, size_t & rank )
+{
+    // Orthonormal columns, stored contiguously
+    std::vector<Amplitude> basis;
+    std::vector<Amplitude> column(rows);
+    basis.reserve(rows * std::min(rows, cols));
+
+    double scale = 0.0;
+    for(size_t i = 0; i < matrix.size(); i++)
+        scale = std::max(scale, abs(matrix[i]));
+
+    rank = 0;
+
+    for(size_t c = 0; c < cols && rank < rows; c++)
+    {
+        for(size_t i = 0; i < rows; i++)
+            column[i] = matrix[i * cols + c];
+
+        for(int pass = 0; pass < 2; pass++)
+        {
+            for(size_t k = 0; k < rank; k++)
+            {
+                const Amplitude * b   = &basis[k * rows];
+                Amplitude         dot = 0;
+
+                for(size_t i = 0; i < rows; i++)
+                    dot += multiplyConj(b[i], column[i]);
+                for(size_t i = 0; i < rows; i++)
+                    column[i] -= multiply(dot, b[i]);
+            }
+        }
+
+        double length = 0.0;
+        for(size_t i = 0; i < rows; i++)
+            length += norm(column[i]);
+        length = sqrt(length);
+
+        if(length <= 1e-13 * scale * sqrt((double)rows))
+            continue;
+
+        for(size_t i = 0; i < rows; i++)
+            basis.push_back(column[i] / length);
+        rank++;
+    }
+
+    // A zero matrix still keeps a bond of one
+    if(rank == 0)
+    {
+        basis.assign(rows, Amplitude(0, 0));
+        basis[0] = 1;
+        rank     = 1;
+    }
+
+    q.resize(rows * rank);
+    for(size_t k = 0; k < rank; k++)
+        for(size_t i = 0; i < rows; i++)
+            q[i * rank + k] = basis[k * rows + i];
+
+    // r = q^H * matrix
+    r.assign(rank * cols, Amplitude(0, 0));
+    for(size_t k = 0; k < rank; k++)
+        for(size_t i = 0; i < rows; i++)
+        {
+            const Amplitude b = conj(basis[k * rows + i]);
+            for(size_t c = 0; c < cols; c++)
+                r[k * cols + c] += multiply(b, matrix[i * cols + c]);
+        }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Split a matrix with its singular value decomposition. Values below the cutoff are always
+// dropped, then at most maxRank are kept and scaled back up to the weight of the whole
+// matrix so the state stays normalised.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+double ofxQuantumMPSRegister::split( const std::vector<Amplitude> & matrix, size_t rows, size_t cols, size_t maxRank, bool centreRight,
+                                     std::vector<Amplitude> & left, std::vector<Amplitude> & right, size_t & rank )
+{
+    std::vector<Amplitude> u, v;
+    std::vector<double>    sigma;
+    svd(matrix, rows, cols, u, sigma, v);
+
+    const size_t k = sigma.size();
+
+    double total = 0.0;
+    for(size_t i = 0; i < k; i++)
+        total += sigma[i] * sigma[i];
+
+    rank = 1;
+    while(rank < k && rank < maxRank && sigma[rank] * sigma[rank] > QUANTUM_MPS_CUTOFF * total)
+        rank++;
+
+    double kept = 0.0;
+    for(size_t i = 0; i < rank; i++)
+        kept += sigma[i] * sigma[i];
+
+    const double scale = kept > 0.0 ? sqrt(total / kept) : 1.0;
+
+    left.assign(rows * rank, Amplitude(0, 0));
+    right.assign(rank * cols, Amplitude(0, 0));
+
+    for(size_t i = 0; i < rank; i++)
+    {
+        const double s  = sigma[i] * scale;
+        const double sl = centreRight ? 1.0 : s;
+        const double sr = centreRight ? s : 1.0;
+
+        for(size_t r = 0; r < rows; r++)
+            left[r * rank + i] = u[r * k + i] * sl;
+
+        for(size_t c = 0; c < cols; c++)
+            right[i * cols + c] = conj(v[c * k + i]) * sr;
+    }
+
+    return total > 0.0 ? (total - kept) / total : 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// One sided Jacobi SVD. Pairs of columns are rotated until every pair is orthogonal, the
+// column norms are then the singular values and the rotations make up v. Each rotation first
+// turns the inner product of the pair real with a phase, then uses the real Jacobi rotation
+// that zeroes it. A wide matrix is decomposed through its conjugate transpose.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::svd( const std::vector<Amplitude> & a, size_t rows, size_t cols,
+                                 std::vector<Amplitude> & u, std::vector<double> & sigma, std::vector<Amplitude> & v )
+{
+    if(rows < cols)
+    {
+        std::vector<Amplitude> adjoint(cols * rows);
+
+        for(size_t r = 0; r < rows; r++)
+            for(size_t c = 0; c < cols; c++)
+                adjoint[c * rows + r] = conj(a[r * cols + c]);
+
+        svd(adjoint, cols, rows, v, sigma, u);
+        return;
+    }
+
+    // Columns are stored contiguously while rotating
+    std::vector<Amplitude> w(rows * cols);
+    std::vector<Amplitude> vt(cols * cols, Amplitude(0, 0));
+
+    for(size_t r = 0; r < rows; r++)
+        for(size_t c = 0; c < cols; c++)
+            w[c * rows + r] = a[r * cols + c];
+
+    for(size_t c = 0; c < cols; c++)
+        vt[c * cols + c] = 1;
+
+    for(int sweep = 0; sweep < QUANTUM_MPS_MAX_SWEEPS; sweep++)
+    {
+        bool rotated = false;
+
+        for(size_t p = 0; p + 1 < cols; p++)
+        {
+            for(size_t q = p + 1; q < cols; q++)
+            {
+                Amplitude * wp = &w[p * rows];
+                Amplitude * wq = &w[q * rows];
+
+                double    alpha = 0.0;
+                double    beta  = 0.0;
+                Amplitude gamma(0, 0);
+
+                for(size_t r = 0; r < rows; r++)
+                {
+                    alpha += norm(wp[r]);
+                    beta  += norm(wq[r]);
+                    gamma += multiplyConj(wp[r], wq[r]);
+                }
+
+                const double absGamma = abs(gamma);
+
+                if(absGamma <= 1e-15 * sqrt(alpha * beta) || absGamma < 1e-300)
+                    continue;
+
+                rotated = true;
+
+                const Amplitude phase = conj(gamma / absGamma);
+                const double    zeta  = (beta - alpha) / (2.0 * absGamma);
+                const double    t     = (zeta >= 0 ? 1.0 : -1.0) / (fabs(zeta) + sqrt(1.0 + zeta * zeta));
+                const double    c     = 1.0 / sqrt(1.0 + t * t);
+                const double    s     = c * t;
+
+                for(size_t r = 0; r < rows; r++)
+                {
+                    const Amplitude x = wp[r];
+                    const Amplitude y = multiply(wq[r], phase);
+                    wp[r] = c * x - s * y;
+                    wq[r] = s * x + c * y;
+                }
+
+                Amplitude * vp = &vt[p * cols];
+                Amplitude * vq = &vt[q * cols];
+
+                for(size_t r = 0; r < cols; r++)
+                {
+                    const Amplitude x = vp[r];
+                    const Amplitude y = multiply(vq[r], phase);
+                    vp[r] = c * x - s * y;
+                    vq[r] = s * x + c * y;
+                }
+            }
+        }
+
+        if(!rotated)
+            break;
+    }
+
+    // Sort the columns by their norm
+    std::vector<double> norms(cols);
+    std::vector<size_t> order(cols);
+
+    for(size_t c = 0; c < cols; c++)
+    {
+        double sum = 0.0;
+        for(size_t r = 0; r < rows; r++)
+            sum += norm(w[c * rows + r]);
+
+        norms[c] = sqrt(sum);
+        order[c] = c;
+    }
+
+    std::sort(order.begin(), order.end(), [&norms](size_t x, size_t y) { return norms[x] > norms[y]; });
+
+    u.assign(rows * cols, Amplitude(0, 0));
+    v.assign(cols * cols, Amplitude(0, 0));
+    sigma.resize(cols);
+
+    for(size_t i = 0; i < cols; i++)
+    {
+        const size_t c = order[i];
+        sigma[i] = norms[c];
+
+        if(norms[c] > 0.0)
+        {
+            for(size_t r = 0; r < rows; r++)
+                u[r * cols + i] = w[c * rows + r] / norms[c];
+        }
+
+        for(size_t r = 0; r < cols; r++)
+            v[r * cols + i] = vt[c * cols + r];
+    }
+}
+
+////////////////////////////////////////////////////
+// Bond dimensions                                //
+////////////////////////////////////////////////////
+
+void ofxQuantumMPSRegister::setMaxBondDimension( size_t maxBondDim )
+{
+    mMaxBondDim = std::max<size_t>(maxBondDim, 1);
+}
+
+size_t ofxQuantumMPSRegister::getMaxBondDimension() const
+{
+    return mMaxBondDim;
+}
+
+size_t ofxQuantumMPSRegister::getBondDimension( unsigned long long int bond ) const
+{
+    if(bond + 1 >= mRegSize)
+    {
+        printf("ERROR! bond indx out of range, max indx: %llu\n", mRegSize - 2);
+        return 0;
+    }
+
+    return mSites[(size_t)bond].right;
+}
+
+////////////////////////////////////////////////////
+// Truncation error                               //
+////////////////////////////////////////////////////
+
+double ofxQuantumMPSRegister::getTruncationError() const
+{
+    return 1.0 - mFidelity;
+}
+
+double ofxQuantumMPSRegister::getLastTruncationError() const
+{
+    return mLastTruncation;
+}
+
+void ofxQuantumMPSRegister::resetTruncationError()
+{
+    mFidelity       = 1.0;
+    mLastTruncation = 0.0;
+}
@@ -0,0 +1,184 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumMPSRegister.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumMPSRegister stores a register as a matrix product state, a chain of small tensors, one for each qubit, joined by
+//  bonds of at most a chosen dimension. A state with little entanglement between the two halves of the chain needs only a
+//  small bond, so memory and time grow linearly with the number of qubits instead of as 2^n. See
+//  https://arxiv.org/abs/1008.3477 for the details.
+//
+//  Single qubit gates act on one tensor. Two qubit gates act on neighbouring tensors, the pair is merged, multiplied by the
+//  gate and split again with a singular value decomposition that keeps at most maxBondDim values. The weight of the dropped
+//  values is the truncation error, getTruncationError() gives an estimate of the fidelity lost so far, so a larger bond can
+//  be traded for speed. Gates on qubits further apart are moved next to each other with swaps first.
+//
+//  ofxQuantumMPSRegister reg( 200, &quantumSim, 32 );
+//  reg.applyGateHad(0);
+//  for(int q = 1; q < 200; q++) reg.applyGateControlledNot(q - 1, q);
+//  reg.measureBit(199);
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMMPSREGISTER_H
+#define OFXQUANTUMMPSREGISTER_H
+
+// Includes
+#include <stddef.h>
+#include <vector>
+#include <complex>
+#include "Complex.h"
+#include "ofxQuantumGates.h"
+
+// Default largest bond dimension
+#define QUANTUM_MPS_DEFAULT_BOND_DIM 64
+
+// Singular values whose weight is below this fraction of the total are always dropped
+#define QUANTUM_MPS_CUTOFF           1e-20
+
+// Forward declarations
+class ofxQuantum;
+
+class ofxQuantumMPSRegister
+{
+public:
+
+    typedef std::complex<double> Amplitude;
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, the register starts in the state |0...0>
+    ofxQuantumMPSRegister( unsigned long long int size, ofxQuantum *quantumSim, size_t maxBondDim = QUANTUM_MPS_DEFAULT_BOND_DIM );
+
+    // Measure a single qubit, collapsing the register
+    int measureBit( unsigned long long int bitIndx );
+
+    // Measure the qubits selected by qubitMask, bit q selects qubit q and holds its value in the result
+    unsigned long long int measureBits( unsigned long long int qubitMask );
+
+    // Measure every qubit and return the state as a number, qubit 0 is the most significant bit. Registers of at most 64 qubits
+    unsigned long long int decimalMeasure();
+
+    // Amplitude of a state, qubit 0 is the most significant bit of the index. Registers of at most 64 qubits
+    Complex getState( unsigned long long int stateIndx ) const;
+
+    // Amplitude of a state given the value of every qubit
+    Complex getAmplitude( const std::vector<int> & bits ) const;
+
+    // Number of qubits
+    int size() const;
+
+    // Print the bond dimensions and the truncation error
+    void printInfo() const;
+
+    // Single qubit gates
+    void applyGate(     unsigned long long int bit, const Complex matrix[4] );
+    void applyGateX(    unsigned long long int bit );
+    void applyGateY(    unsigned long long int bit );
+    void applyGateZ(    unsigned long long int bit );
+    void applyGateS(    unsigned long long int bit );
+    void applyGateT(    unsigned long long int bit );
+    void applyGateHad(  unsigned long long int bit );
+    void applyGatePhase( unsigned long long int bit, double theta );
+    void applyGateRx(    unsigned long long int bit, double theta );
+    void applyGateRy(    unsigned long long int bit, double theta );
+    void applyGateRz(    unsigned long long int bit, double theta );
+
+    // Any gate type from ofxQuantumGates.h
+    template<typename Gate>
+    void apply( const Gate & gate, unsigned long long int bit )
+    {
+        Complex matrix[4];
+        gate.getMatrix(matrix);
+        applyGate(bit, matrix);
+    }
+
+    // Two qubit gates, a single control only
+    void applyControlledGate(      const std::vector<unsigned long long int> & controls,
+                                   unsigned long long int target,
+                                   const Complex matrix[4],
+                                   unsigned long long int controlValues = ~0ULL );
+    void applyGateControlledNot(   unsigned long long int controlBit, unsigned long long int bit );
+    void applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta );
+    void applyGateSwap(            unsigned long long int bit1, unsigned long long int bit2 );
+
+    // Dense 4x4 gate on two qubits, row major with qubits[0] the most significant bit of the local index
+    void applyMultiQubitGate( const std::vector<unsigned long long int> & qubits, const Complex * matrix );
+
+    // Largest bond dimension kept by two qubit gates, lowering it truncates on the next gates
+    void   setMaxBondDimension( size_t maxBondDim );
+    size_t getMaxBondDimension() const;
+
+    // Dimension of the bond between qubit bond and qubit bond + 1
+    size_t getBondDimension( unsigned long long int bond ) const;
+
+    // Estimated fidelity lost to truncation since the register was made or the error was reset, 1 - product of (1 - w)
+    // over the weight w dropped by each split
+    double getTruncationError() const;
+
+    // Weight dropped by the most recent two qubit gate
+    double getLastTruncationError() const;
+
+    void   resetTruncationError();
+
+private:
+
+    // The tensor of one qubit, indexed [left][bit][right] in row major order
+    struct Site
+    {
+        size_t                 left;
+        size_t                 right;
+        std::vector<Amplitude> data;
+
+        Amplitude & at( size_t l, int s, size_t r )       { return data[(l * 2 + s) * right + r]; }
+        Amplitude   at( size_t l, int s, size_t r ) const { return data[(l * 2 + s) * right + r]; }
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Check a qubit index, printing an error when it is out of range
+    bool checkBit( unsigned long long int bit ) const;
+
+    // Move the orthogonality centre to a site, every site left of it is left orthonormal and every site right of it is
+    // right orthonormal, so the norm and the probabilities of the centre qubit can be read off the centre tensor alone
+    void moveCentre( size_t site );
+
+    // Apply a 4x4 matrix, row major over (bit of site, bit of site + 1), and split the pair again
+    void applyAdjacent( size_t site, const Amplitude matrix[16] );
+
+    // Apply a 4x4 matrix to any two qubits, row major with bit1 the most significant bit of the local index
+    void applyTwoQubit( unsigned long long int bit1, unsigned long long int bit2, const Amplitude matrix[16] );
+
+    // Split a rows x cols matrix into left * right keeping at most maxRank singular values, the singular values are
+    // multiplied into right when centreRight is true and into left otherwise. Returns the weight dropped
+    static double split( const std::vector<Amplitude> & matrix, size_t rows, size_t cols, size_t maxRank, bool centreRight,
+                         std::vector<Amplitude> & left, std::vector<Amplitude> & right, size_t & rank );
+
+    // Thin QR factorisation matrix = q * r, q is rows x rank with orthonormal columns and r is rank x cols
+    static void factorQR( const std::vector<Amplitude> & matrix, size_t rows, size_t cols,
+                          std::vector<Amplitude> & q, std::vector<Amplitude> & r, size_t & rank );
+
+    // Singular value decomposition a = u * diag(sigma) * v^H by one sided Jacobi rotations, values in decreasing order.
+    // u is rows x k, v is cols x k with k = min(rows, cols), both row major
+    static void svd( const std::vector<Amplitude> & a, size_t rows, size_t cols,
+                     std::vector<Amplitude> & u, std::vector<double> & sigma, std::vector<Amplitude> & v );
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantum *           mQuantumSim;         // Quantum simulator the random numbers come from
+    unsigned long long int mRegSize;            // Number of qubits
+    std::vector<Site>      mSites;              // One tensor for each qubit
+    size_t                 mCentre;             // Site holding the norm of the state
+    size_t                 mMaxBondDim;         // Largest bond kept by a split
+    double                 mFidelity;           // Product of (1 - w) over every split
+    double                 mLastTruncation;     // Weight dropped by the last split of a gate
+};
+
+#endif
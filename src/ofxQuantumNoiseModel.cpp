@@ -0,0 +1,128 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumNoiseModel.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumNoiseModel.h"
+
+#include <stdio.h>
+
+////////////////////////////////////////////////////
+// Check a probability is in 0-1                  //
+////////////////////////////////////////////////////
+
+static bool checkProbability( double probability )
+{
+    if(probability < 0.0 || probability > 1.0)
+    {
+        printf("ERROR! noise probability %f is outside 0-1\n", probability);
+        return false;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+
+ofxQuantumNoiseModel::ofxQuantumNoiseModel()
+{
+    clear();
+}
+
+////////////////////////////////////////////////////
+// Add channels                                   //
+////////////////////////////////////////////////////
+
+void ofxQuantumNoiseModel::addGateNoise( GateType type, const ofxQuantumNoiseChannel & channel )
+{
+    if(type < 0 || type >= NUM_GATE_TYPES)
+    {
+        printf("ERROR! unknown gate type %d\n", (int)type);
+        return;
+    }
+
+    if(!checkProbability(channel.probability))
+        return;
+
+    mGateNoise[type].push_back(channel);
+}
+
+void ofxQuantumNoiseModel::addQubitNoise( unsigned long long int qubit, const ofxQuantumNoiseChannel & channel )
+{
+    if(!checkProbability(channel.probability))
+        return;
+
+    mQubitNoise[qubit].push_back(channel);
+}
+
+////////////////////////////////////////////////////
+// Readout errors                                 //
+////////////////////////////////////////////////////
+
+void ofxQuantumNoiseModel::setReadoutError( double prob0to1, double prob1to0 )
+{
+    if(!checkProbability(prob0to1) || !checkProbability(prob1to0))
+        return;
+
+    mReadout[0] = prob0to1;
+    mReadout[1] = prob1to0;
+}
+
+void ofxQuantumNoiseModel::setReadoutError( unsigned long long int qubit, double prob0to1, double prob1to0 )
+{
+    if(!checkProbability(prob0to1) || !checkProbability(prob1to0))
+        return;
+
+    mQubitReadout[qubit] = std::make_pair(prob0to1, prob1to0);
+}
+
+double ofxQuantumNoiseModel::getReadoutError( unsigned long long int qubit, int value ) const
+{
+    std::map<unsigned long long int, std::pair<double, double> >::const_iterator it = mQubitReadout.find(qubit);
+
+    if(it != mQubitReadout.end())
+        return value == 0 ? it->second.first : it->second.second;
+
+    return mReadout[value != 0];
+}
+
+////////////////////////////////////////////////////
+// Look up channels                               //
+////////////////////////////////////////////////////
+
+const std::vector<ofxQuantumNoiseChannel> & ofxQuantumNoiseModel::getGateNoise( GateType type ) const
+{
+    return mGateNoise[type];
+}
+
+const std::vector<ofxQuantumNoiseChannel> & ofxQuantumNoiseModel::getQubitNoise( unsigned long long int qubit ) const
+{
+    std::map<unsigned long long int, std::vector<ofxQuantumNoiseChannel> >::const_iterator it = mQubitNoise.find(qubit);
+
+    return it != mQubitNoise.end() ? it->second : mNoNoise;
+}
+
+bool ofxQuantumNoiseModel::isNoiseFree() const
+{
+    for(size_t i = 0; i < mGateNoise.size(); i++)
+    {
+        if(!mGateNoise[i].empty())
+            return false;
+    }
+
+    return mQubitNoise.empty() && mQubitReadout.empty() && mReadout[0] == 0.0 && mReadout[1] == 0.0;
+}
+
+void ofxQuantumNoiseModel::clear()
+{
+    mGateNoise.assign(NUM_GATE_TYPES, std::vector<ofxQuantumNoiseChannel>());
+    mQubitNoise.clear();
+    mQubitReadout.clear();
+    mReadout[0] = 0.0;
+    mReadout[1] = 0.0;
+}
@@ -0,0 +1,112 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumNoiseModel.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumNoiseModel describes the noise of a quantum computer as channels that act after gates, chosen by the type of
+//  gate or by the qubit it touches, and as readout errors that flip measured bits. It does not act on a register itself,
+//  ofxQuantumTrajectories samples the channels one trajectory at a time so a noisy register needs 2^n amplitudes rather
+//  than the 4^n of a density matrix.
+//
+//  ofxQuantumNoiseModel noise;
+//  noise.addGateNoise(ofxQuantumNoiseModel::GATE_CNOT, ofxQuantumNoiseChannel::depolarizing(0.01));
+//  noise.addQubitNoise(3, ofxQuantumNoiseChannel::amplitudeDamping(0.02));
+//  noise.setReadoutError(0.01, 0.03);
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMNOISEMODEL_H
+#define OFXQUANTUMNOISEMODEL_H
+
+// Includes
+#include <vector>
+#include <map>
+
+// A single qubit noise channel
+struct ofxQuantumNoiseChannel
+{
+    enum Type
+    {
+        NOISE_DEPOLARIZING = 0,     // With chance p an X, Y or Z, each equally likely
+        NOISE_AMPLITUDE_DAMPING,    // |1> decays to |0> with chance p
+        NOISE_DEPHASING             // With chance p a Z
+    };
+
+    Type   type;
+    double probability;
+
+    static ofxQuantumNoiseChannel depolarizing(     double p ) { ofxQuantumNoiseChannel c = { NOISE_DEPOLARIZING,      p }; return c; }
+    static ofxQuantumNoiseChannel amplitudeDamping( double p ) { ofxQuantumNoiseChannel c = { NOISE_AMPLITUDE_DAMPING, p }; return c; }
+    static ofxQuantumNoiseChannel dephasing(        double p ) { ofxQuantumNoiseChannel c = { NOISE_DEPHASING,         p }; return c; }
+};
+
+class ofxQuantumNoiseModel
+{
+public:
+
+    // Gate types noise can be attached to
+    enum GateType
+    {
+        GATE_X = 0,
+        GATE_Y,
+        GATE_Z,
+        GATE_S,
+        GATE_T,
+        GATE_HAD,
+        GATE_PHASE,
+        GATE_RX,
+        GATE_RY,
+        GATE_RZ,
+        GATE_MATRIX,            // applyGate with any 2x2 matrix
+        GATE_CNOT,
+        GATE_TOFFOLI,
+        GATE_CONTROLLED_PHASE,
+        GATE_CONTROLLED,        // applyControlledGate with any 2x2 matrix
+        NUM_GATE_TYPES
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, a noise free model
+    ofxQuantumNoiseModel();
+
+    // Act on every qubit a gate of this type touches, after the gate
+    void addGateNoise( GateType type, const ofxQuantumNoiseChannel & channel );
+
+    // Act on a qubit after every gate that touches it
+    void addQubitNoise( unsigned long long int qubit, const ofxQuantumNoiseChannel & channel );
+
+    // Chance a measured 0 is read as 1 and a measured 1 is read as 0, for every qubit or for one qubit
+    void setReadoutError( double prob0to1, double prob1to0 );
+    void setReadoutError( unsigned long long int qubit, double prob0to1, double prob1to0 );
+
+    // Channels after a gate of a type and on a qubit
+    const std::vector<ofxQuantumNoiseChannel> & getGateNoise( GateType type ) const;
+    const std::vector<ofxQuantumNoiseChannel> & getQubitNoise( unsigned long long int qubit ) const;
+
+    // Chance that a qubit measured as value is read as the other value
+    double getReadoutError( unsigned long long int qubit, int value ) const;
+
+    // True when nothing has been added
+    bool isNoiseFree() const;
+
+    // Remove every channel and readout error
+    void clear();
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    std::vector< std::vector<ofxQuantumNoiseChannel> >                        mGateNoise;     // Indexed by GateType
+    std::map<unsigned long long int, std::vector<ofxQuantumNoiseChannel> >    mQubitNoise;    // Only qubits with noise
+    std::vector<ofxQuantumNoiseChannel>                                       mNoNoise;       // Returned for quiet qubits
+    double                                                                    mReadout[2];    // For every qubit
+    std::map<unsigned long long int, std::pair<double, double> >              mQubitReadout;  // Qubits set on their own
+};
+
+#endif
@@ -0,0 +1,262 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumRandom.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumRandom.h"
+#include "ofxQuantumKernels.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define QUANTUM_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// Philox4x32 multipliers and key increments (Salmon et al, "Parallel random numbers: as easy as 1, 2, 3")
+#define PHILOX_M0     0xD2511F53U
+#define PHILOX_M1     0xCD9E8D57U
+#define PHILOX_W0     0x9E3779B9U
+#define PHILOX_W1     0xBB67AE85U
+#define PHILOX_ROUNDS 10
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Block functions
+//////////////////////////////////////////////////////////////////////////////////////////
+
+// Turn the top 52 bits of a word into a double in [0, 1) by putting them under the exponent of 1.0
+static inline double wordToDouble( unsigned long long int word )
+{
+    const unsigned long long int bits = (word >> 12) | 0x3FF0000000000000ULL;
+
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value - 1.0;
+}
+
+// Ten rounds of Philox4x32 on one counter
+static inline void philoxScalar( uint32_t k0, uint32_t k1, uint32_t c[4] )
+{
+    for(int r = 0; r < PHILOX_ROUNDS; r++)
+    {
+        const uint64_t p0 = (uint64_t)PHILOX_M0 * c[0];
+        const uint64_t p1 = (uint64_t)PHILOX_M1 * c[2];
+
+        const uint32_t c1 = c[1];
+        const uint32_t c3 = c[3];
+
+        c[0] = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c[1] = (uint32_t)p1;
+        c[2] = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c[3] = (uint32_t)p0;
+
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+}
+
+// Two doubles for each of count blocks starting at firstBlock
+static void fillBlocksScalar( unsigned long long int seed, unsigned long long int stream, unsigned long long int firstBlock,
+                              size_t count, double * out )
+{
+    for(size_t b = 0; b < count; b++)
+    {
+        uint32_t words[4];
+        ofxQuantumRandom::generateBlock(seed, stream, firstBlock + b, words);
+
+        out[2 * b]     = wordToDouble(((unsigned long long int)words[1] << 32) | words[0]);
+        out[2 * b + 1] = wordToDouble(((unsigned long long int)words[3] << 32) | words[2]);
+    }
+}
+
+#ifdef QUANTUM_X86_KERNELS
+
+// Four blocks at a time, each 32 bit word sits in the low half of a 64 bit lane so _mm256_mul_epu32 gives the full product
+__attribute__((target("avx2")))
+static void fillBlocksAVX2( unsigned long long int seed, unsigned long long int stream, unsigned long long int firstBlock,
+                            size_t count, double * out )
+{
+    const __m256i low32 = _mm256_set1_epi64x(0xFFFFFFFFLL);
+    const __m256i m0    = _mm256_set1_epi64x(PHILOX_M0);
+    const __m256i m1    = _mm256_set1_epi64x(PHILOX_M1);
+    const __m256i one   = _mm256_set1_epi64x(0x3FF0000000000000LL);
+    const __m256d unit  = _mm256_set1_pd(1.0);
+
+    size_t b = 0;
+
+    for(; b + 4 <= count; b += 4)
+    {
+        const unsigned long long int n = firstBlock + b;
+
+        __m256i c0 = _mm256_set_epi64x((uint32_t)(n + 3),         (uint32_t)(n + 2),         (uint32_t)(n + 1),         (uint32_t)n);
+        __m256i c1 = _mm256_set_epi64x((uint32_t)((n + 3) >> 32), (uint32_t)((n + 2) >> 32), (uint32_t)((n + 1) >> 32), (uint32_t)(n >> 32));
+        __m256i c2 = _mm256_set1_epi64x((uint32_t)stream);
+        __m256i c3 = _mm256_set1_epi64x((uint32_t)(stream >> 32));
+
+        uint32_t k0 = (uint32_t)seed;
+        uint32_t k1 = (uint32_t)(seed >> 32);
+
+        for(int r = 0; r < PHILOX_ROUNDS; r++)
+        {
+            const __m256i p0 = _mm256_mul_epu32(c0, m0);
+            const __m256i p1 = _mm256_mul_epu32(c2, m1);
+
+            const __m256i next0 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p1, 32), c1), _mm256_set1_epi64x(k0));
+            const __m256i next2 = _mm256_xor_si256(_mm256_xor_si256(_mm256_srli_epi64(p0, 32), c3), _mm256_set1_epi64x(k1));
+
+            c1 = _mm256_and_si256(p1, low32);
+            c3 = _mm256_and_si256(p0, low32);
+            c0 = next0;
+            c2 = next2;
+
+            k0 += PHILOX_W0;
+            k1 += PHILOX_W1;
+        }
+
+        // Build the two 64 bit words of each block, then convert them the same way as wordToDouble
+        const __m256i w0 = _mm256_or_si256(_mm256_slli_epi64(c1, 32), c0);
+        const __m256i w1 = _mm256_or_si256(_mm256_slli_epi64(c3, 32), c2);
+
+        const __m256d d0 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(w0, 12), one)), unit);
+        const __m256d d1 = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(w1, 12), one)), unit);
+
+        // Interleave so each block's two doubles are next to each other
+        const __m256d lo = _mm256_unpacklo_pd(d0, d1);
+        const __m256d hi = _mm256_unpackhi_pd(d0, d1);
+
+        _mm256_storeu_pd(out + 2 * b,     _mm256_permute2f128_pd(lo, hi, 0x20));
+        _mm256_storeu_pd(out + 2 * b + 4, _mm256_permute2f128_pd(lo, hi, 0x31));
+    }
+
+    fillBlocksScalar(seed, stream, firstBlock + b, count - b, out + 2 * b);
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////
+// Generator
+//////////////////////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+ofxQuantumRandom::ofxQuantumRandom( unsigned long long int seed, unsigned long long int stream )
+{
+    setSeed(seed, stream);
+}
+
+////////////////////////////////////////////////////
+// Set the seed and stream                        //
+////////////////////////////////////////////////////
+void ofxQuantumRandom::setSeed( unsigned long long int seed, unsigned long long int stream )
+{
+    mSeed      = seed;
+    mStream    = stream;
+    mBlock     = 0;
+    mBuffer[0] = 0;
+    mBuffer[1] = 0;
+    mBufferPos = 2;
+}
+
+////////////////////////////////////////////////////
+// Jump to a position in the stream               //
+////////////////////////////////////////////////////
+void ofxQuantumRandom::seek( unsigned long long int position )
+{
+    mBlock     = position / 2;
+    mBufferPos = 2;
+
+    // Half way through a block, generate it and skip its first word
+    if(position % 2 == 1)
+    {
+        nextInt();
+    }
+}
+
+////////////////////////////////////////////////////
+// Number of outputs used                         //
+////////////////////////////////////////////////////
+unsigned long long int ofxQuantumRandom::getPosition() const
+{
+    return mBlock * 2 - (2 - mBufferPos);
+}
+
+unsigned long long int ofxQuantumRandom::getSeed() const
+{
+    return mSeed;
+}
+
+unsigned long long int ofxQuantumRandom::getStream() const
+{
+    return mStream;
+}
+
+////////////////////////////////////////////////////
+// Next 64 random bits                            //
+////////////////////////////////////////////////////
+unsigned long long int ofxQuantumRandom::nextInt()
+{
+    if(mBufferPos == 2)
+    {
+        uint32_t words[4];
+        generateBlock(mSeed, mStream, mBlock++, words);
+
+        mBuffer[0] = ((unsigned long long int)words[1] << 32) | words[0];
+        mBuffer[1] = ((unsigned long long int)words[3] << 32) | words[2];
+        mBufferPos = 0;
+    }
+
+    return mBuffer[mBufferPos++];
+}
+
+////////////////////////////////////////////////////
+// Next double in [0, 1)                          //
+////////////////////////////////////////////////////
+double ofxQuantumRandom::nextDouble()
+{
+    return wordToDouble(nextInt());
+}
+
+////////////////////////////////////////////////////////////////////////
+// Fill a batch of doubles. Whole blocks are generated straight into
+// the output, only the ends go through the one word buffer.
+////////////////////////////////////////////////////////////////////////
+void ofxQuantumRandom::fill( double * values, size_t count )
+{
+    while(count > 0 && mBufferPos < 2)
+    {
+        *values++ = nextDouble();
+        count--;
+    }
+
+    const size_t numBlocks = count / 2;
+
+#ifdef QUANTUM_X86_KERNELS
+    if(ofxQuantumKernels::getSimdLevel() >= ofxQuantumKernels::SIMD_AVX2)
+        fillBlocksAVX2(mSeed, mStream, mBlock, numBlocks, values);
+    else
+#endif
+        fillBlocksScalar(mSeed, mStream, mBlock, numBlocks, values);
+
+    mBlock += numBlocks;
+
+    if(count % 2 == 1)
+        values[count - 1] = nextDouble();
+}
+
+////////////////////////////////////////////////////
+// Philox4x32-10 on one block                     //
+////////////////////////////////////////////////////
+void ofxQuantumRandom::generateBlock( unsigned long long int seed, unsigned long long int stream, unsigned long long int block, uint32_t out[4] )
+{
+    out[0] = (uint32_t)block;
+    out[1] = (uint32_t)(block >> 32);
+    out[2] = (uint32_t)stream;
+    out[3] = (uint32_t)(stream >> 32);
+
+    philoxScalar((uint32_t)seed, (uint32_t)(seed >> 32), out);
+}
@@ -0,0 +1,69 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumRandom.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumRandom is a counter based random number generator (Philox4x32-10). Every block of output is a pure function
+//  of a key, made from the seed, and a counter, made from a stream number and a block number. Each thread can have its own
+//  stream without sharing any state, any point of a stream can be jumped to directly, and a sequence can be replayed
+//  exactly from its (seed, stream, position). Large batches of doubles are filled four blocks at a time with AVX2.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMRANDOM_H
+#define OFXQUANTUMRANDOM_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+
+class ofxQuantumRandom
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, starts at the beginning of the given stream
+    ofxQuantumRandom( unsigned long long int seed = 0, unsigned long long int stream = 0 );
+
+    // Switch to a seed and stream and go back to the start
+    void setSeed( unsigned long long int seed, unsigned long long int stream = 0 );
+
+    // Jump to a position in the stream, counted in 64 bit outputs from the start
+    void seek( unsigned long long int position );
+
+    // Number of 64 bit outputs used so far, seeking to it replays everything that follows
+    unsigned long long int getPosition() const;
+
+    unsigned long long int getSeed()   const;
+    unsigned long long int getStream() const;
+
+    // Next 64 random bits
+    unsigned long long int nextInt();
+
+    // Next double in [0, 1), 52 random bits
+    double nextDouble();
+
+    // Fill values with doubles in [0, 1), the same numbers nextDouble would give one at a time
+    void fill( double * values, size_t count );
+
+    // Philox4x32-10 block function, out is filled with four 32 bit words
+    static void generateBlock( unsigned long long int seed, unsigned long long int stream, unsigned long long int block, uint32_t out[4] );
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    unsigned long long int mSeed;       // Key of the generator
+    unsigned long long int mStream;     // High half of the counter
+    unsigned long long int mBlock;      // Next block to generate
+    unsigned long long int mBuffer[2];  // Current block as two 64 bit words
+    int                    mBufferPos;  // Next word of mBuffer to hand out, 2 when it is used up
+};
+
+#endif
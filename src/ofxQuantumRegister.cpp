@@ -7,6 +7,14 @@
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 #include "ofxQuantumRegister.h"
+#include "ofxQuantumCircuit.h"
+#include "ofxQuantumRandom.h"
+#include "ofxQuantumSnapshot.h"
+
+#include <algorithm>
+#include <string.h>
+#include <unistd.h>
+
 
 using namespace std;
 
@@ -14,85 +22,112 @@ using namespace std;
 // Default constructor                            //
 ////////////////////////////////////////////////////
 
-ofxQuantumRegister::ofxQuantumRegister()
+template<typename T>
+ofxQuantumRegisterT<T>::ofxQuantumRegisterT()
 {
     // Empty register
-    mRegSize = 0;
-    mState   = NULL;
+    mRegSize    = 0;
+    mNumStates  = 0;
+    mQuantumSim = NULL;
+    mThreadPool = NULL;
+    mCircuit    = NULL;
+    mIsSparse   = false;
+    mStorage    = STORAGE_AUTO;
+    mMaxFill    = QUANTUM_SPARSE_MAX_FILL;
+    mHugePages  = false;
 }
 
 ////////////////////////////////////////////////////
 // Constructor that sets num bits                 //
 ////////////////////////////////////////////////////
 
-ofxQuantumRegister::ofxQuantumRegister(unsigned long long int numBits, ofxQuantum *quantumSim)
+template<typename T>
+ofxQuantumRegisterT<T>::ofxQuantumRegisterT(unsigned long long int numBits, ofxQuantum *quantumSim, bool useHugePages)
 {
-    // Store reference to quantum simulator
+    // Store reference to quantum simulator, by default the register uses the simulator's thread pool
     mQuantumSim = quantumSim;
+    mThreadPool = NULL;
+    mCircuit    = NULL;
+    mStorage    = STORAGE_AUTO;
+    mMaxFill    = QUANTUM_SPARSE_MAX_FILL;
+    mHugePages  = useHugePages;
     
-    // Allocate the states and bits
-    mRegSize    = numBits;
-    mNumStates  = pow(2, mRegSize);
-    mState      = new Complex[mNumStates];
-    
-    // Create our quantum bits
-    mBits = new short*[(int)pow(2,mRegSize)];
-    for(int i = 0; i < pow(2,mRegSize);i++)
+    if(numBits > QUANTUM_MAX_QUBITS)
     {
-        mBits[i] = new short[mRegSize];
-        
-        int mask = 1;
-        for(int j = 0; j < mRegSize; j++)
-        {
-            if ((mask & i) != 0)
-                mBits[i][mRegSize-1-j] = 1;
-            else
-                mBits[i][mRegSize-1-j] = 0;
-            mask<<=1;
-        }
+        printf("ERROR! registers are limited to %d qubits\n", QUANTUM_MAX_QUBITS);
+        numBits = 0;
     }
     
-    // Set first state
-    mState[0] = Complex(1,0);
+    mRegSize    = numBits;
+    mNumStates  = 1ULL << mRegSize;
+    
+    // Every qubit starts at its own position in the state index
+    mQubitMap.resize(mRegSize);
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+        mQubitMap[q] = q;
     
+    // Large registers start with only the first state stored, small ones allocate every state up front.
+    // The value of each bit is read straight from the state index so this is the only allocation
+    mIsSparse   = mRegSize >= QUANTUM_SPARSE_MIN_QUBITS;
+    
+    if(mIsSparse)
+    {
+        mSparse.set(0, 1, 0);
+    }
+    else
+    {
+        mState.allocate(mNumStates, useHugePages);
+        mState.set(0, 1, 0);
+    }
 }
 
 ////////////////////////////////////////////////////
 // Copy constructor                               //
 ////////////////////////////////////////////////////
 
-ofxQuantumRegister::ofxQuantumRegister(const ofxQuantumRegister & old)
+template<typename T>
+ofxQuantumRegisterT<T>::ofxQuantumRegisterT(const ofxQuantumRegisterT & old)
 {
     // Set the size of the register
     mRegSize    = old.mRegSize;
-    mNumStates  = pow(2, mRegSize);
+    old.flushCircuit();
     
-    mState      = new Complex[mNumStates];
+    mNumStates  = old.mNumStates;
+    mQuantumSim = old.mQuantumSim;
+    mThreadPool = old.mThreadPool;
+    mCircuit    = NULL;
+    mIsSparse   = old.mIsSparse;
+    mStorage    = old.mStorage;
+    mMaxFill    = old.mMaxFill;
+    mHugePages  = old.mHugePages;
+    mQubitMap   = old.mQubitMap;
     
     // Copy states from old register
-    for (unsigned int i = 0 ; i < mNumStates; i++)
-    {
-        mState[i] = old.mState[i];
-    }
+    mState      = old.mState;
+    mSparse     = old.mSparse;
 }
 
 ////////////////////////////////////////////////////
 // Destructor                                     //
 ////////////////////////////////////////////////////
 
-ofxQuantumRegister::~ofxQuantumRegister()
+template<typename T>
+ofxQuantumRegisterT<T>::~ofxQuantumRegisterT()
 {
-    // If states have been allocated then delete them
-    if ( mState ) {
-        delete [] mState;
-    }
+    // Unlink any circuit recording into this register, states are released by the state buffer
+    if(mCircuit != NULL)
+        mCircuit->detach();
 }
 
 ////////////////////////////////////////////////////
 // Get the probability of a state                 //
 ////////////////////////////////////////////////////
-Complex ofxQuantumRegister::getProb(unsigned long long int state) const
+template<typename T>
+Complex ofxQuantumRegisterT<T>::getProb(unsigned long long int state) const
 {
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
     // Throw an error if outside of number of states
     if (state >= mNumStates)
     {
@@ -103,7 +138,7 @@ Complex ofxQuantumRegister::getProb(unsigned long long int state) const
     // Otherwise return state
     else
     {
-        return(mState[state]);
+        return mIsSparse ? mSparse.get(storedIndex(state)) : mState.get(storedIndex(state));
     }
 }
 
@@ -113,106 +148,343 @@ Complex ofxQuantumRegister::getProb(unsigned long long int state) const
 // equal to one.
 ////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::norm()
+template<typename T>
+void ofxQuantumRegisterT<T>::norm()
 {
-    double b = 0;
-    double f, g;
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
     
-    // Calculate the total size of the register
-    for (unsigned long long int i = 0; i < pow(2, mRegSize) ; i++)
+    if(mIsSparse)
     {
-        b += pow(mState[i].getReal(), 2) + pow(mState[i].getImag(), 2);
+        mSparse.scale(pow(mSparse.sumSquares(), -.5));
+        return;
     }
     
+    T * re = mState.real();
+    T * im = mState.imag();
+    
+    // Calculate the total size of the register
+    double b = sumChunks(mNumStates, [=](size_t begin, size_t end)
+    {
+        return ofxQuantumKernels::sumSquares(re + begin, im + begin, end - begin);
+    });
+    
     b = pow(b, -.5);
     
     // Set the new states from the register
-    for (unsigned long long int i = 0; i < pow(2, mRegSize) ; i++) {
-        f = mState[i].getReal() * b;
-        g = mState[i].getImag() * b;
-        mState[i].set(f, g);
-    }
+    forEachChunk(mNumStates, [=](size_t begin, size_t end)
+    {
+        ofxQuantumKernels::scale(re + begin, im + begin, end - begin, b);
+    });
 }
 
 ////////////////////////////////////////////////////////////////////////
 // Returns the size of the register.
 ////////////////////////////////////////////////////////////////////////
 
-int ofxQuantumRegister::size() const
+template<typename T>
+int ofxQuantumRegisterT<T>::size() const
 {
     return mRegSize;
 }
 
 ////////////////////////////////////////////////////////////////////////
-// Measure the bit, this forces it into one of the states
+// Measure the bit, this forces it into one of the states. The chance of
+// each value is the sum of |a|^2 over the states with the bit at that
+// value (the Born rule). Both sums come from one strided reduction over
+// the amplitude pairs of the bit, then a single write pass scales the
+// surviving half and zeroes the other.
 ////////////////////////////////////////////////////////////////////////
-int ofxQuantumRegister::measureBit(unsigned long long int bitIndx)
+template<typename T>
+int ofxQuantumRegisterT<T>::measureBit(unsigned long long int bitIndx)
 {
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    if(bitIndx >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return -1;
+    }
+    
     // Get a randon number from the quantum simulator
-    float quantumRandomNum = mQuantumSim->getRandom();
+    double quantumRandomNum = mQuantumSim->getRandom();
+    
+    const unsigned long long int mask = bitMask(bitIndx);
+    
+    T * re = mState.real();
+    T * im = mState.imag();
+    
+    // Chance of a zero state and of a one state
+    double prob[2] = { 0.0, 0.0 };
+    
+    if(mIsSparse)
+    {
+        const unsigned long long int * keys = mSparse.keys();
+        const T *                      sRe  = mSparse.real();
+        const T *                      sIm  = mSparse.imag();
+        
+        for(size_t s = 0; s < mSparse.capacity(); s++)
+        {
+            if(keys[s] != QUANTUM_SPARSE_EMPTY)
+                prob[(keys[s] & mask) != 0] += (double)sRe[s] * sRe[s] + (double)sIm[s] * sIm[s];
+        }
+    }
+    else
+    {
+        sumChunks(mNumStates / 2, 2, [=](size_t begin, size_t end, double * partials)
+        {
+            ofxQuantumKernels::sumSquaresPairs(re, im, mask, begin, end, partials[0], partials[1]);
+        }, prob);
+    }
+    
+    // A register with no amplitude left has nothing to collapse onto
+    if(prob[0] + prob[1] <= 0.0)
+    {
+        printf("ERROR! register has zero norm, nothing to measure\n");
+        return -1;
+    }
+    
+    // Check our probabilities against the random number, an outcome with no chance is never picked
+    int result = (prob[0] / (prob[0] + prob[1]) >= quantumRandomNum) ? 0 : 1;
+    
+    if(prob[result] <= 0.0)
+        result = 1 - result;
+    
+    // Collapse onto the result and normalise the remaining states in the same pass
+    const double factor = 1.0 / sqrt(prob[result]);
+    
+    if(mIsSparse)
+    {
+        mSparse.collapse(mask, result ? mask : 0, factor);
+    }
+    else
+    {
+        forEachChunk(mNumStates / 2, [=](size_t begin, size_t end)
+        {
+            ofxQuantumKernels::collapsePairs(re, im, mask, begin, end, result, factor);
+        });
+    }
+    
+    // Return the number we measured
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Chance of a bit being 1, the same sums measureBit makes
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+double ofxQuantumRegisterT<T>::getBitProb( unsigned long long int bitIndx )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    if(bitIndx >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return 0.0;
+    }
     
-    // Chance of a zero state
-    float zeroState = 0.0;
+    const unsigned long long int mask = bitMask(bitIndx);
     
-    // Chance of a one state
-    float oneState  = 0.0;
+    // Chance of a zero state and of a one state
+    double prob[2] = { 0.0, 0.0 };
     
-    // now loop through all our bit states and add the probabilites
-    for(int i = 0; i < pow(2,mRegSize);i++)
+    if(mIsSparse)
+    {
+        const unsigned long long int * keys = mSparse.keys();
+        const T *                      sRe  = mSparse.real();
+        const T *                      sIm  = mSparse.imag();
+        
+        for(size_t s = 0; s < mSparse.capacity(); s++)
+        {
+            if(keys[s] != QUANTUM_SPARSE_EMPTY)
+                prob[(keys[s] & mask) != 0] += (double)sRe[s] * sRe[s] + (double)sIm[s] * sIm[s];
+        }
+    }
+    else
     {
-        if(mBits[i][bitIndx] == 0)
+        const T * re = mState.real();
+        const T * im = mState.imag();
+        
+        sumChunks(mNumStates / 2, 2, [=](size_t begin, size_t end, double * partials)
         {
-            zeroState += mState[i].length();
-        }else if(mBits[i][bitIndx] == 1)
+            ofxQuantumKernels::sumSquaresPairs(re, im, mask, begin, end, partials[0], partials[1]);
+        }, prob);
+    }
+    
+    if(prob[0] + prob[1] <= 0.0)
+    {
+        printf("ERROR! register has zero norm, nothing to measure\n");
+        return 0.0;
+    }
+    
+    return prob[1] / (prob[0] + prob[1]);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure several bits at once. Bit q of qubitMask selects qubit q and
+// bit q of the result holds the value measured for it. The chance of
+// every combination of values is gathered in one pass, one combination
+// is picked, then one pass collapses and normalises the register.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+unsigned long long int ofxQuantumRegisterT<T>::measureBits( unsigned long long int qubitMask )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    std::vector<unsigned long long int> qubits;
+    for(unsigned long long int q = 0; q < mRegSize && q < 64; q++)
+    {
+        if((qubitMask >> q) & 1)
+            qubits.push_back(q);
+    }
+    
+    if(qubits.size() != (size_t)__builtin_popcountll(qubitMask))
+    {
+        printf("ERROR! qubit mask selects bits outside the register\n");
+        return 0;
+    }
+    
+    unsigned long long int result = 0;
+    
+    // A single bit uses the pair kernels, and too many bits would need a huge table so they are measured one at a time
+    if(qubits.size() <= 1 || qubits.size() > QUANTUM_MAX_JOINT_MEASURE)
+    {
+        for(size_t j = 0; j < qubits.size(); j++)
         {
-            oneState  += mState[i].length();
+            if(measureBit(qubits[j]) == 1)
+                result |= 1ULL << qubits[j];
         }
+        return result;
     }
     
-    // Normalse the probabilities
-    float length = zeroState + oneState;
-    zeroState /= length;
-    oneState  /= length;
-  
-    int result = -1;
+    // Offset of each combination of values from the start of its group, qubits[0] is the most significant local bit
+    const size_t           k          = qubits.size();
+    const size_t           numOutcome = (size_t)1 << k;
+    unsigned long long int fixedMask  = 0;
+    std::vector<size_t>    offsets(numOutcome, 0);
     
-    // Check our probabilities against the random number
-    if(zeroState >= quantumRandomNum )
+    for(size_t j = 0; j < k; j++)
     {
-        for(int i = 0; i < pow(2,mRegSize);i++)
+        fixedMask |= bitMask(qubits[j]);
+        
+        for(size_t l = 0; l < numOutcome; l++)
         {
-            if(mBits[i][bitIndx] != 0)
-                mState[i] = Complex(0,0);
+            if((l >> (k - 1 - j)) & 1)
+                offsets[l] |= bitMask(qubits[j]);
         }
+    }
+    
+    T * re = mState.real();
+    T * im = mState.imag();
+    
+    std::vector<double> prob(numOutcome, 0.0);
+    
+    if(mIsSparse)
+    {
+        const unsigned long long int * keys = mSparse.keys();
+        const T *                      sRe  = mSparse.real();
+        const T *                      sIm  = mSparse.imag();
         
-        result = 0;
+        for(size_t s = 0; s < mSparse.capacity(); s++)
+        {
+            if(keys[s] == QUANTUM_SPARSE_EMPTY)
+                continue;
+            
+            size_t l = 0;
+            for(size_t j = 0; j < k; j++)
+                l = (l << 1) | ((keys[s] & bitMask(qubits[j])) != 0);
+            
+            prob[l] += (double)sRe[s] * sRe[s] + (double)sIm[s] * sIm[s];
+        }
     }
     else
     {
-        for(int i = 0; i < pow(2,mRegSize);i++)
+        sumChunks(mNumStates >> k, numOutcome, [&, re, im](size_t begin, size_t end, double * partials)
         {
-            if(mBits[i][bitIndx] != 1)
-                mState[i] = Complex(0,0);
-        }
+            for(size_t g = begin; g < end; g++)
+            {
+                const size_t base = ofxQuantumKernels::insertZeroBits(g, fixedMask);
+            
+                for(size_t l = 0; l < numOutcome; l++)
+                {
+                    const size_t i = base + offsets[l];
+                    partials[l] += (double)re[i] * re[i] + (double)im[i] * im[i];
+                }
+            }
+        }, &prob[0]);
+    }
+    
+    // Pick a combination with the random number from the quantum simulator
+    double total = 0.0;
+    for(size_t l = 0; l < numOutcome; l++)
+        total += prob[l];
+    
+    if(total <= 0.0)
+    {
+        printf("ERROR! register has zero norm, nothing to measure\n");
+        return 0;
+    }
+    
+    const double target  = mQuantumSim->getRandom() * total;
+    size_t       outcome = numOutcome;
+    double       running = 0.0;
+    
+    for(size_t l = 0; l < numOutcome; l++)
+    {
+        if(prob[l] <= 0.0)
+            continue;
         
-        result = 1;
+        running += prob[l];
+        outcome  = l;
+        
+        if(running > target)
+            break;
     }
     
-    float total = 0.0;
-    // Normalise remaining bits
-    for(int i = 0; i < pow(2,mRegSize); i++)
+    const double factor = 1.0 / sqrt(prob[outcome]);
+    
+    // Collapse onto the outcome and normalise in one pass
+    if(mIsSparse)
     {
-        std::complex<double> mycomplex (mState[i].getReal(), mState[i].getImag());
-
-        total += std::norm(mycomplex);
+        mSparse.collapse(fixedMask, offsets[outcome], factor);
+    }
+    else
+    {
+        forEachChunk(mNumStates >> k, [&, re, im](size_t begin, size_t end)
+        {
+            for(size_t g = begin; g < end; g++)
+            {
+                const size_t base = ofxQuantumKernels::insertZeroBits(g, fixedMask);
+            
+                for(size_t l = 0; l < numOutcome; l++)
+                {
+                    const size_t i = base + offsets[l];
+                
+                    if(l == outcome)
+                    {
+                        re[i] = (T)(re[i] * factor);
+                        im[i] = (T)(im[i] * factor);
+                    }
+                    else
+                    {
+                        re[i] = 0.0;
+                        im[i] = 0.0;
+                    }
+                }
+            }
+        });
     }
-    total = sqrt(total);
-    for(int i = 0; i < pow(2,mRegSize); i++)
+    
+    for(size_t j = 0; j < k; j++)
     {
-        mState[i] = Complex(mState[i].getReal() / total, mState[i].getImag() / total);
+        if((outcome >> (k - 1 - j)) & 1)
+            result |= 1ULL << qubits[j];
     }
     
-    // Return the number we measured
     return result;
 }
 
@@ -223,12 +495,16 @@ int ofxQuantumRegister::measureBit(unsigned long long int bitIndx)
 // 0.
 ////////////////////////////////////////////////////////////////////////
 
-unsigned long long int ofxQuantumRegister::decimalMeasure()
+template<typename T>
+unsigned long long int ofxQuantumRegisterT<T>::decimalMeasure()
 {
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
     int done = 0;
     
-    // Final decimal result of our measurement, -1 is an error, we did not measure anything
-    int decVal = -1;
+    // Final decimal result of our measurement, all ones (-1) is an error, we did not measure anything
+    unsigned long long int decVal = ~0ULL;
     
     // Variable to hold states
     double a, b;
@@ -237,41 +513,195 @@ unsigned long long int ofxQuantumRegister::decimalMeasure()
     double rand1 = mQuantumSim->getRandom();
     a = b = 0;
     
-    // Loop through the possible states and check if amplitude lies within the random number from
-    // The quantum simulator
-    for (unsigned long long int i = 0 ; i < pow(2, mRegSize)  ;i++) {
-        if (!done ){
-            b += pow(mState[i].getReal(), 2) + pow(mState[i].getImag(), 2);
+    // A sparse register only walks its stored states, the measured one is all that is left afterwards
+    if(mIsSparse)
+    {
+        const unsigned long long int * keys = mSparse.keys();
+        const T *                      sRe  = mSparse.real();
+        const T *                      sIm  = mSparse.imag();
+        
+        for(size_t s = 0; s < mSparse.capacity() && !done; s++)
+        {
+            if(keys[s] == QUANTUM_SPARSE_EMPTY)
+                continue;
+            
+            const double p = (double)sRe[s] * sRe[s] + (double)sIm[s] * sIm[s];
+            b += p;
             if (b > rand1 && rand1 > a) {
-                //We have just measured the i state.
-                for (unsigned long long int j = 0; j < pow(2, mRegSize) ; j++) {
-                    mState[j].set(0,0);
-                }
-                mState[i].set(1,0);
-                decVal = i;
+                decVal = keys[s];
                 done = 1;
             }
-            a += pow(mState[i].getReal(), 2) + pow(mState[i].getImag(), 2);
+            a += p;
+        }
+        
+        if(done)
+        {
+            mSparse.clear();
+            mSparse.set(decVal, 1, 0);
+            decVal = logicalIndex(decVal);
+        }
+        return decVal;
+    }
+    
+    const T * re = mState.real();
+    const T * im = mState.imag();
+    
+    // Loop through the possible states and check if amplitude lies within the random number from
+    // The quantum simulator
+    for (unsigned long long int i = 0 ; i < mNumStates && !done ;i++) {
+        const double p = (double)re[i] * re[i] + (double)im[i] * im[i];
+        b += p;
+        if (b > rand1 && rand1 > a) {
+            //We have just measured the i state.
+            mState.zero();
+            mState.set(i, 1, 0);
+            decVal = logicalIndex(i);
+            done = 1;
         }
+        a += p;
     }
+    
+    // Only one state is left, a large automatic register can go back to sparse
+    if(done && mStorage == STORAGE_AUTO && mRegSize >= QUANTUM_SPARSE_MIN_QUBITS)
+        makeSparse();
+    
     return decVal;
 }
 
+////////////////////////////////////////////////////////////////////////
+// Draw a number of measurement outcomes without collapsing the state.
+// The sampling table is built once, then the shots are split into
+// blocks that each draw from their own generator, seeded from the
+// quantum simulator, so large shot counts are drawn in parallel.
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+std::vector<unsigned long long int> ofxQuantumRegisterT<T>::sample( unsigned long long int shots, ofxQuantumSampler::Method method )
+{
+    if(mQuantumSim == NULL)
+    {
+        printf("ERROR! register is not linked to a quantum simulator\n");
+        return std::vector<unsigned long long int>();
+    }
+    
+    return sample(shots, mQuantumSim->getRandomInt(), method);
+}
+
+template<typename T>
+std::vector<unsigned long long int> ofxQuantumRegisterT<T>::sample( unsigned long long int shots, unsigned long long int seed, ofxQuantumSampler::Method method )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    std::vector<unsigned long long int> outcomes;
+    
+    // A sparse register samples over its slots, free slots have no chance and each drawn slot is mapped to its state
+    const unsigned long long int * slotKeys = mIsSparse ? mSparse.keys()     : NULL;
+    const size_t                   numSlots = mIsSparse ? mSparse.capacity() : mNumStates;
+    
+    if(method == ofxQuantumSampler::SAMPLE_AUTO)
+        method = ofxQuantumSampler::chooseMethod(numSlots, shots);
+    
+    ofxQuantumSampler sampler;
+    
+    if(mIsSparse)
+        sampler.build(mSparse.real(), mSparse.imag(), numSlots, method);
+    else
+        sampler.build(mState.real(), mState.imag(), mNumStates, method, getActiveThreadPool(mNumStates));
+    
+    outcomes.resize(shots);
+    
+    const size_t                 grain  = 4096;
+    ofxQuantumThreadPool *       pool   = getActiveThreadPool(shots);
+    
+    std::function<void (size_t, size_t)> drawShots = [&](size_t begin, size_t end)
+    {
+        // Each block of shots has its own stream so the result does not depend on the number of threads
+        ofxQuantumRandom    generator(seed, begin / grain);
+        std::vector<double> uniforms(2 * (end - begin));
+        
+        generator.fill(&uniforms[0], uniforms.size());
+        
+        for(size_t i = begin; i < end; i++)
+        {
+            const size_t drawn = sampler.draw(uniforms[2 * (i - begin)], uniforms[2 * (i - begin) + 1]);
+            outcomes[i] = slotKeys != NULL ? slotKeys[drawn] : drawn;
+        }
+    };
+    
+    if(pool != NULL)
+        pool->parallelFor(0, shots, grain, drawShots);
+    else
+        ofxQuantumThreadPool::serialFor(0, shots, grain, drawShots);
+    
+    // Outcomes are drawn as stored indices
+    if(isPermuted())
+    {
+        for(size_t i = 0; i < outcomes.size(); i++)
+            outcomes[i] = logicalIndex(outcomes[i]);
+    }
+    
+    return outcomes;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Histogram of outcomes over a number of shots, the state is unchanged
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+std::map<unsigned long long int, unsigned long long int> ofxQuantumRegisterT<T>::sampleCounts( unsigned long long int shots, ofxQuantumSampler::Method method )
+{
+    std::vector<unsigned long long int>                      outcomes = sample(shots, method);
+    std::map<unsigned long long int, unsigned long long int> counts;
+    
+    for(size_t i = 0; i < outcomes.size(); i++)
+        counts[outcomes[i]]++;
+    
+    return counts;
+}
+
 ////////////////////////////////////////////////////////////////////////
 // For debugging, output information about the register.
 ////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::printInfo() 
+template<typename T>
+void ofxQuantumRegisterT<T>::printInfo() 
 {
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    // A sparse register only prints the states it stores, in index order
+    if(mIsSparse)
+    {
+        std::map<unsigned long long int, Complex> stored;
+        
+        for(size_t s = 0; s < mSparse.capacity(); s++)
+        {
+            if(mSparse.keys()[s] != QUANTUM_SPARSE_EMPTY)
+                stored[logicalIndex(mSparse.keys()[s])] = Complex(mSparse.real()[s], mSparse.imag()[s]);
+        }
+        
+        for(typename std::map<unsigned long long int, Complex>::iterator it = stored.begin(); it != stored.end(); ++it)
+        {
+            for(unsigned long long int j = 0; j < mRegSize;j++)
+                cout << ((it->first >> (mRegSize - 1 - j)) & 1);
+            
+            cout << " State " << it->first << " has probability amplitude "
+            << it->second.getReal() << " + i" << it->second.getImag()
+            << endl;
+        }
+        return;
+    }
+    
     // Loop through and print out information about the bits
-    for (unsigned long long int i = 0 ; i < pow(2, mRegSize) ; i++)
+    for (unsigned long long int i = 0 ; i < mNumStates ; i++)
     {
         
-        for(int j = 0; j < mRegSize;j++)
-            cout << mBits[i][j];
+        for(unsigned long long int j = 0; j < mRegSize;j++)
+            cout << ((i >> (mRegSize - 1 - j)) & 1);
         
         cout << " State " << i << " has probability amplitude "
-        << mState[i].getReal() << " + i" << mState[i].getImag()
+        << mState.real()[storedIndex(i)] << " + i" << mState.imag()[storedIndex(i)]
         << endl;
         
     }
@@ -281,223 +711,607 @@ void ofxQuantumRegister::printInfo()
 // Set the states to those given in the new_state array.
 ////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::setState(Complex *new_state) {
+template<typename T>
+void ofxQuantumRegisterT<T>::setState(Complex *new_state) {
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    // Every amplitude is replaced, so the qubits go back to their own positions without moving anything
+    resetQubitLayout(false);
+    
+    if(mIsSparse)
+    {
+        mSparse.clear();
+        
+        for (unsigned long long int i = 0 ; i < mNumStates ; i++)
+        {
+            if(new_state[i].getReal() != 0.0 || new_state[i].getImag() != 0.0)
+                mSparse.set(i, new_state[i].getReal(), new_state[i].getImag());
+        }
+        
+        updateStorage();
+        return;
+    }
     
     // Set the state
-    for (unsigned long long int i = 0 ; i < pow(2, mRegSize) ; i++)
+    unsigned long long int numNonZero = 0;
+    
+    for (unsigned long long int i = 0 ; i < mNumStates ; i++)
+    {
+        mState.set(i, new_state[i]);
+        
+        if(new_state[i].getReal() != 0.0 || new_state[i].getImag() != 0.0)
+            numNonZero++;
+    }
+    
+    // A large automatic register goes sparse when the new state leaves it well under the fill limit
+    if(mStorage == STORAGE_AUTO && mRegSize >= QUANTUM_SPARSE_MIN_QUBITS && numNonZero <= mMaxFill * mNumStates / 4)
+        makeSparse();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Set only the listed states, the rest of the register is cleared
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::setStates( const std::vector<unsigned long long int> & indices, const std::vector<Complex> & amplitudes )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    if(indices.size() != amplitudes.size())
+    {
+        printf("ERROR! %zu state indices given for %zu amplitudes\n", indices.size(), amplitudes.size());
+        return;
+    }
+    
+    resetQubitLayout(false);
+    
+    if(mIsSparse)
+        mSparse.clear(indices.size());
+    else
+        mState.zero();
+    
+    for(size_t i = 0; i < indices.size(); i++)
     {
-        mState[i].set(new_state[i].getReal(), new_state[i].getImag());
+        if(indices[i] >= mNumStates)
+        {
+            printf("ERROR! state indx %llu out of range, max indx: %llu\n", indices[i], mNumStates - 1);
+            continue;
+        }
+        
+        if(mIsSparse)
+            mSparse.set(indices[i], amplitudes[i].getReal(), amplitudes[i].getImag());
+        else
+            mState.set(indices[i], amplitudes[i]);
     }
+    
+    // Same switching rules as setState
+    if(mIsSparse)
+        updateStorage();
+    else if(mStorage == STORAGE_AUTO && mRegSize >= QUANTUM_SPARSE_MIN_QUBITS && indices.size() <= mMaxFill * mNumStates / 4)
+        makeSparse();
 }
 
 
+
 ////////////////////////////////////////////////////////////////////////
 // Set the State to an equal superposition of the integers 0 -> number -1
 ////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::setAverage(unsigned long long int number)
+template<typename T>
+void ofxQuantumRegisterT<T>::setAverage(unsigned long long int number)
 {
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    resetQubitLayout();
+    
     // If number is too big then print error message
-    if (number >= pow(2, mRegSize))
+    if (number >= mNumStates)
     {
         cout << "Error, initializing past end of array in qureg::SetAverage.\n";
     }
+    // A sparse register only stores the states in the superposition
+    else if(mIsSparse)
+    {
+        double prob = pow(number, -.5);
+        
+        mSparse.clear(number + 1);
+        for (unsigned long long int i = 0 ; i <= number ; i++) {
+            mSparse.set(i, prob, 0);
+        }
+        
+        updateStorage();
+    }
     // Otherwise set the probability
     else
     {
         double prob = pow(number, -.5);
         for (unsigned long long int i = 0 ; i <= number ; i++) {
-            mState[i].set(prob, 0);
+            mState.set(i, prob, 0);
         }
     }
 }
 
 
-/////////////////////////////////////////////////////////////////////////////
-// Kron matrix expansion, used to create identiy matrix for gate operations
-/////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply a 2x2 unitary to a single qubit in place. Qubit 0 is the most significant bit of the
+// state index, so the amplitudes the gate mixes are the pairs (i, i + stride) where stride is
+// 2 ^ (mRegSize - 1 - bit). Each pair is read and written once, O(2^n) with no extra memory,
+// by the vector kernel the cpu supports.
+// The matrix is given in row major order: { u00, u01, u10, u11 }
+////////////////////////////////////////////////////////////////////////////////////////////
 
-cv::Mat ofxQuantumRegister::kron(cv::Mat& A, cv::Mat& B)
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGate( unsigned long long int bit, const Complex matrix[4] )
 {
-    CV_Assert(A.channels() == 1 && B.channels() == 1);
-    
-    cv::Mat1d Ad, Bd;
-    A.convertTo(Ad, CV_64F);
-    B.convertTo(Bd, CV_64F);
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
     
-    // Expand matrix
-    cv::Mat1d Kd(Ad.rows * Bd.rows, Ad.cols * Bd.cols, 0.0);
-    for (int ra = 0; ra < Ad.rows; ++ra)
+    if(bit < mRegSize && mIsSparse)
+    {
+        mSparse.applyGate(bitMask(bit), 0, 0, ofxQuantumKernels::makeMatrix<double>(matrix));
+        updateStorage();
+    }
+    else if(bit < mRegSize)
     {
-        for (int ca = 0; ca < Ad.cols; ++ca)
+        T *                            re     = mState.real();
+        T *                            im     = mState.imag();
+        const size_t                   stride = bitMask(bit);
+        const ofxQuantumGateMatrixT<T> m      = ofxQuantumKernels::makeMatrix<T>(matrix);
+        
+        // Every pair is independent so the pairs can be split between threads
+        forEachChunk(mNumStates / 2, [=, &m](size_t begin, size_t end)
         {
-            Kd(cv::Range(ra*Bd.rows, (ra + 1)*Bd.rows), cv::Range(ca*Bd.cols, (ca + 1)*Bd.cols)) = Bd.mul(Ad(ra, ca));
-        }
+            ofxQuantumKernels::applyGate(re, im, stride, begin, end, m);
+        });
+    }else {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
     }
-    cv::Mat K;
-    Kd.convertTo(K, A.type());
-    
-    return K;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-// Apply pauli-X gate to register: https://en.wikipedia.org/wiki/Quantum_gate#Pauli-X_gate
+// Masks of the control bits and of the values they must hold. Bit j of controlValues is the
+// value required of controls[j]. Prints an error and returns false when a qubit is out of
+// range or used twice.
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::applyGateX(unsigned long long int bit)
+template<typename T>
+bool ofxQuantumRegisterT<T>::controlMasks( const std::vector<unsigned long long int> & controls,
+                                           unsigned long long int target,
+                                           unsigned long long int controlValues,
+                                           unsigned long long int & controlMask,
+                                           unsigned long long int & controlBits ) const
 {
-    if(bit < mRegSize)
+    if(target >= mRegSize)
     {
-        int sz = pow(2,mRegSize);
-        
-        cv::Mat identity = (cv::Mat_<double>(2,2) << 1, 0, 0, 1);
-        
-        cv::Mat pauliX   = (cv::Mat_<double>(2,2) << 0, 1, 1, 0);
-        
-        cv::Mat result;
-        
-        if(bit == 0)
-        {
-            result = pauliX;
-        }else
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return false;
+    }
+    
+    controlMask = 0;
+    controlBits = 0;
+    
+    for(size_t j = 0; j < controls.size(); j++)
+    {
+        if(controls[j] >= mRegSize || ((controlMask | bitMask(target)) & bitMask(controls[j])) != 0)
         {
-            result = identity;
+            printf("ERROR! invalid control bit %llu for target %llu\n", controls[j], target);
+            return false;
         }
         
-        for(int i = 1; i < mRegSize; i++)
+        controlMask |= bitMask(controls[j]);
+        
+        if((controlValues >> j) & 1)
+            controlBits |= bitMask(controls[j]);
+    }
+    
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Visit the amplitude pairs of the target qubit on the states where every control qubit holds
+// its required value. Rather than testing each of the 2^n states we enumerate the 2^(n-c-1)
+// free indices and spread their bits around the fixed control and target positions, so each
+// pair is visited exactly once. Pairs come in runs that are contiguous in both halves, fn
+// gets one run at a time.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+template<typename Fn>
+bool ofxQuantumRegisterT<T>::forEachControlledRun( const std::vector<unsigned long long int> & controls,
+                                                   unsigned long long int target,
+                                                   unsigned long long int controlValues,
+                                                   const Fn & fn )
+{
+    unsigned long long int controlMask;
+    unsigned long long int controlBits;
+    
+    if(!controlMasks(controls, target, controlValues, controlMask, controlBits))
+        return false;
+    
+    const unsigned long long int fixedMask  = controlMask | bitMask(target);
+    const unsigned long long int targetMask = bitMask(target);
+    const unsigned long long int numPairs   = mNumStates >> (controls.size() + 1);
+    
+    // The free bits below the lowest fixed bit are contiguous in the index, so the pairs come in runs of this length
+    const unsigned long long int runLength  = fixedMask & (~fixedMask + 1);
+    
+    // Runs are independent so they can be split between threads
+    forEachChunk(numPairs / runLength, [&](size_t begin, size_t end)
+    {
+        for(unsigned long long int run = begin; run < end; run++)
         {
-            if( i == bit)
-            {
-                result = kron( result, pauliX );
-            }else
-            {
-                result = kron( result, identity );
-            }
+            // Insert a zero at every fixed bit position then set the control values
+            const unsigned long long int i0 = ofxQuantumKernels::insertZeroBits(run * runLength, fixedMask) | controlBits;
+            
+            fn(i0, i0 | targetMask, runLength);
         }
+    });
+    
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply a 2x2 unitary to the target qubit, but only on the states where every control qubit
+// holds its required value. Bit j of controlValues is the value required of controls[j], by
+// default every control must be 1.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyControlledGate( const std::vector<unsigned long long int> & controls,
+                                              unsigned long long int target,
+                                              const Complex matrix[4],
+                                              unsigned long long int controlValues )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    if(mIsSparse)
+    {
+        unsigned long long int controlMask;
+        unsigned long long int controlBits;
         
-        applyToStates(&result);
-        
-        
-    }else {
-        printf("ERROR! bit indx out of range, max indx: %i\n", mRegSize);
+        if(controlMasks(controls, target, controlValues, controlMask, controlBits))
+        {
+            mSparse.applyGate(bitMask(target), controlMask, controlBits, ofxQuantumKernels::makeMatrix<double>(matrix));
+            updateStorage();
+        }
+        return;
     }
+    
+    const ofxQuantumGateMatrixT<T> m = ofxQuantumKernels::makeMatrix<T>(matrix);
+    
+    T * re = mState.real();
+    T * im = mState.imag();
+    
+    forEachControlledRun(controls, target, controlValues, [=, &m](size_t i0, size_t i1, size_t count)
+    {
+        ofxQuantumKernels::applyPairs(re, im, i0, i1, count, m);
+    });
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-// Apply pauli-Y gate to register: https://en.wikipedia.org/wiki/Quantum_gate#Pauli-Y_gate
+// Permutation gates swap the two amplitudes of every pair, with controls only on the states
+// that match them. There is no arithmetic, CNOT and Toffoli are pure memory moves.
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::applyGateY( unsigned long long int bit )
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateClass( const ofxQuantumPermutationGate &,
+                                             const std::vector<unsigned long long int> & controls,
+                                             unsigned long long int target,
+                                             unsigned long long int controlValues,
+                                             ofxQuantumPermutationClass )
 {
-    if(bit < mRegSize)
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    // A sparse register flips the target bit of the stored states that match the controls
+    if(mIsSparse)
     {
-        int sz = pow(2,mRegSize);
+        unsigned long long int controlMask;
+        unsigned long long int controlBits;
         
-        cv::Mat identityReal = (cv::Mat_<double>(2,2) << 1, 0, 0, 1);
-        cv::Mat identityImag = (cv::Mat_<double>(2,2) << 1, 0, 0, 1);
-        
-        cv::Mat pauliYreal   = (cv::Mat_<double>(2,2) << 0, 0, 0, 0);
-        cv::Mat pauliYimag   = (cv::Mat_<double>(2,2) << 0, -1, 1, 0);
+        if(controlMasks(controls, target, controlValues, controlMask, controlBits))
+            mSparse.applyPermutation(bitMask(target), controlMask, controlBits);
+        return;
+    }
+    
+    T * re = mState.real();
+    T * im = mState.imag();
+    
+    if(controls.empty())
+    {
+        if(target >= mRegSize)
+        {
+            printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+            return;
+        }
         
-        cv::Mat resultReal;
-        cv::Mat resultImag;
+        const size_t stride = bitMask(target);
         
-        if(bit == 0)
+        forEachChunk(mNumStates / 2, [=](size_t begin, size_t end)
         {
-            resultReal = pauliYreal;
-            resultImag = pauliYimag;
-        }else
+            ofxQuantumKernels::applyPermutation(re, im, stride, begin, end);
+        });
+    }
+    else
+    {
+        forEachControlledRun(controls, target, controlValues, [=](size_t i0, size_t i1, size_t count)
         {
-            resultReal = identityReal;
-            resultImag = identityImag;
-        }
+            ofxQuantumKernels::swapPairs(re, im, i0, i1, count);
+        });
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Diagonal gates multiply each amplitude by the phase for its value of the target qubit.
+// Without controls this is one pass over the states in index order, with controls only the
+// matching states are visited. Phases of exactly 1 are skipped.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateClass( const ofxQuantumDiagonalGate & gate,
+                                             const std::vector<unsigned long long int> & controls,
+                                             unsigned long long int target,
+                                             unsigned long long int controlValues,
+                                             ofxQuantumDiagonalClass )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    // A sparse register multiplies its stored states in place, nothing is added or removed
+    if(mIsSparse)
+    {
+        unsigned long long int controlMask;
+        unsigned long long int controlBits;
         
-        for(int i = 1; i < mRegSize; i++)
+        if(controlMasks(controls, target, controlValues, controlMask, controlBits))
+            mSparse.applyDiagonal(bitMask(target), controlMask, controlBits,
+                                  gate.phase0Re, gate.phase0Im, gate.phase1Re, gate.phase1Im);
+        return;
+    }
+    
+    T *                          re = mState.real();
+    T *                          im = mState.imag();
+    const ofxQuantumDiagonalGate d  = gate;
+    
+    if(controls.empty())
+    {
+        if(target >= mRegSize)
         {
-            if( i == bit)
-            {
-                resultReal = kron( resultReal, pauliYreal );
-                resultImag = kron( resultImag, pauliYimag );
-            }else
-            {
-                resultReal = kron( resultReal, identityReal );
-                resultImag = kron( resultImag, identityImag );
-            }
+            printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+            return;
         }
         
-        Complex *newStates = new Complex[ (int)pow(2,mRegSize) ];
+        const size_t mask = bitMask(target);
         
-        for(int i = 0; i < pow(2, mRegSize); i++)
+        forEachChunk(mNumStates, [=](size_t begin, size_t end)
         {
-            newStates[i] = Complex(0,0);
-            
-            for(int j = 0; j < pow(2, mRegSize); j++)
-            {
-                Complex result = Complex(mState[j].getReal(), mState[j].getImag());
-                
-                result.mult(resultImag.at<double>(i,j));
-                
-                newStates[i] = newStates[i] + result;
-                
-            }
-            
-        }
+            ofxQuantumKernels::applyDiagonal(re, im, mask, begin, end, d.phase0Re, d.phase0Im, d.phase1Re, d.phase1Im);
+        });
+    }
+    else
+    {
+        const bool skip0 = d.phase0Re == 1.0 && d.phase0Im == 0.0;
+        const bool skip1 = d.phase1Re == 1.0 && d.phase1Im == 0.0;
         
-        mState = newStates;
-      
+        forEachControlledRun(controls, target, controlValues, [=](size_t i0, size_t i1, size_t count)
+        {
+            if(!skip0)
+                ofxQuantumKernels::multiplyPhase(re + i0, im + i0, count, d.phase0Re, d.phase0Im);
+            if(!skip1)
+                ofxQuantumKernels::multiplyPhase(re + i1, im + i1, count, d.phase1Re, d.phase1Im);
+        });
     }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Dense gates go through the general pair kernel
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateClass( const ofxQuantumDenseGate & gate,
+                                             const std::vector<unsigned long long int> & controls,
+                                             unsigned long long int target,
+                                             unsigned long long int controlValues,
+                                             ofxQuantumDenseClass )
+{
+    Complex matrix[4];
+    gate.getMatrix(matrix);
     
-    
+    if(controls.empty())
+        applyGate(target, matrix);
+    else
+        applyControlledGate(controls, target, matrix, controlValues);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////
-// Apply pauli-Z gate to register: https://en.wikipedia.org/wiki/Quantum_gate#Pauli-Z_gate
+// Apply a dense 2^k x 2^k unitary to k qubits. The matrix is row major and qubits[0] is the
+// most significant bit of the local index, the same order the register uses for its own
+// qubits. The register is split into 2^(n-k) groups of 2^k amplitudes that the matrix mixes,
+// each group is gathered, multiplied and written back in place.
 ////////////////////////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::applyGateZ( unsigned long long int bit )
+template<typename T>
+void ofxQuantumRegisterT<T>::applyMultiQubitGate( const std::vector<unsigned long long int> & qubits, const Complex * matrix )
 {
-    if(bit < mRegSize)
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    const size_t k = qubits.size();
+    
+    if(k == 0 || k > mRegSize)
     {
-        int sz = pow(2,mRegSize);
-        
-        cv::Mat identity = (cv::Mat_<double>(2,2) << 1, 0, 0, 1);
-        
-        cv::Mat pauliZ   = (cv::Mat_<double>(2,2) << 1, 0, 0, -1);
+        printf("ERROR! invalid number of qubits %zu for a register of %llu\n", k, mRegSize);
+        return;
+    }
+    
+    // A single qubit goes through the pair kernel
+    if(k == 1)
+    {
+        applyGate(qubits[0], matrix);
+        return;
+    }
+    
+    // Offset of each local index from the start of its group
+    const size_t          dim       = 1 << k;
+    unsigned long long int fixedMask = 0;
+    std::vector<size_t>   offsets(dim, 0);
+    
+    for(size_t j = 0; j < k; j++)
+    {
+        if(qubits[j] >= mRegSize || (fixedMask & bitMask(qubits[j])) != 0)
+        {
+            printf("ERROR! invalid qubit %llu in multi qubit gate\n", qubits[j]);
+            return;
+        }
         
-        cv::Mat result;
+        fixedMask |= bitMask(qubits[j]);
         
-        if(bit == 0)
-        {
-            result = pauliZ;
-        }else
+        for(size_t l = 0; l < dim; l++)
         {
-            result = identity;
+            if((l >> (k - 1 - j)) & 1)
+                offsets[l] |= bitMask(qubits[j]);
         }
+    }
+    
+    std::vector<double> mRe(dim * dim), mIm(dim * dim);
+    for(size_t i = 0; i < dim * dim; i++)
+    {
+        mRe[i] = matrix[i].getReal();
+        mIm[i] = matrix[i].getImag();
+    }
+    
+    if(mIsSparse)
+    {
+        mSparse.applyMultiQubitGate(fixedMask, offsets, mRe, mIm);
+        updateStorage();
+        return;
+    }
+    
+    T * re = mState.real();
+    T * im = mState.imag();
+    
+    forEachChunk(mNumStates >> k, [&, re, im](size_t begin, size_t end)
+    {
+        std::vector<double> vRe(dim), vIm(dim);
         
-        for(int i = 1; i < mRegSize; i++)
+        for(size_t g = begin; g < end; g++)
         {
-            if( i == bit)
+            const size_t base = ofxQuantumKernels::insertZeroBits(g, fixedMask);
+            
+            for(size_t l = 0; l < dim; l++)
             {
-                result = kron( result, pauliZ );
-            }else
+                vRe[l] = re[base + offsets[l]];
+                vIm[l] = im[base + offsets[l]];
+            }
+            
+            for(size_t r = 0; r < dim; r++)
             {
-                result = kron( result, identity );
+                const double * rowRe = &mRe[r * dim];
+                const double * rowIm = &mIm[r * dim];
+                double         sumRe = 0.0;
+                double         sumIm = 0.0;
+                
+                for(size_t c = 0; c < dim; c++)
+                {
+                    sumRe += rowRe[c] * vRe[c] - rowIm[c] * vIm[c];
+                    sumIm += rowRe[c] * vIm[c] + rowIm[c] * vRe[c];
+                }
+                
+                re[base + offsets[r]] = (T)sumRe;
+                im[base + offsets[r]] = (T)sumIm;
             }
         }
-        
-        applyToStates(&result);
-        
-        
-    }else {
-        printf("ERROR! bit indx out of range, max indx: %i\n", mRegSize);
-    }
+    });
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply pauli-X gate to register: https://en.wikipedia.org/wiki/Quantum_gate#Pauli-X_gate
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateX(unsigned long long int bit)
+{
+    apply(ofxQuantumGateX(), bit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply pauli-Y gate to register: https://en.wikipedia.org/wiki/Quantum_gate#Pauli-Y_gate
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateY( unsigned long long int bit )
+{
+    apply(ofxQuantumGateY(), bit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply pauli-Z gate to register: https://en.wikipedia.org/wiki/Quantum_gate#Pauli-Z_gate
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateZ( unsigned long long int bit )
+{
+    apply(ofxQuantumGateZ(), bit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply the S and T phase gates: https://en.wikipedia.org/wiki/Quantum_gate#Phase_shift_gates
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateS( unsigned long long int bit )
+{
+    apply(ofxQuantumGateS(), bit);
+}
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateT( unsigned long long int bit )
+{
+    apply(ofxQuantumGateT(), bit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply a phase shift of theta to the 1 state of a qubit
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGatePhase( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGatePhase(theta), bit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply rotations about the axes of the bloch sphere: https://en.wikipedia.org/wiki/Quantum_logic_gate#Rotation_operator_gates
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateRx( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRx(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateRy( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRy(theta), bit);
+}
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateRz( unsigned long long int bit, double theta )
+{
+    apply(ofxQuantumGateRz(theta), bit);
 }
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////
 // Apply cnot gate to register: https://en.wikipedia.org/wiki/Quantum_gate#Controlled_gates
+// This version is classically controlled, the control is a value rather than a qubit
 ////////////////////////////////////////////////////////////////////////////////////////////
-void ofxQuantumRegister::applyGateCNOT(     unsigned long long int bit, int controlBitValue )
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateCNOT(     unsigned long long int bit, int controlBitValue )
 {
     if(controlBitValue == 1)
     {
@@ -507,9 +1321,11 @@ void ofxQuantumRegister::applyGateCNOT(     unsigned long long int bit, int cont
 
 /////////////////////////////////////////////////////////////////////////////////////////////////
 // Apply toffoli gate to register: https://en.wikipedia.org/wiki/Toffoli_gate
+// This version is classically controlled, the controls are values rather than qubits
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::applyGateToff( unsigned long long int bit, int controlBitVal1, int controlBitVal2 )
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateToff( unsigned long long int bit, int controlBitVal1, int controlBitVal2 )
 {
     if(controlBitVal1 == 1 && controlBitVal2 == 1)
     {
@@ -517,98 +1333,1073 @@ void ofxQuantumRegister::applyGateToff( unsigned long long int bit, int controlB
     }
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////
+// Apply cnot gate controlled by another qubit in the register, this entangles the two qubits
+////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit )
+{
+    applyControlled(ofxQuantumGateX(), std::vector<unsigned long long int>(1, controlBit), bit);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Apply toffoli gate controlled by two other qubits in the register
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateToffoli( unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit )
+{
+    std::vector<unsigned long long int> controls;
+    controls.push_back(controlBit1);
+    controls.push_back(controlBit2);
+    
+    applyControlled(ofxQuantumGateX(), controls, bit);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////
+// Apply a phase shift controlled by another qubit, this is symmetric in the two qubits
+/////////////////////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta )
+{
+    applyControlled(ofxQuantumGatePhase(theta), std::vector<unsigned long long int>(1, controlBit), bit);
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////
 // Apply hadamard gate to register: https://en.wikipedia.org/wiki/Quantum_gate#Hadamard_gate
 /////////////////////////////////////////////////////////////////////////////////////////////////
 
-void ofxQuantumRegister::applyGateHad(unsigned long long int bit)
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateHad(unsigned long long int bit)
 {
-    if(bit < mRegSize)
-    {
-        int sz = pow(2,mRegSize);
-        float invSqrt = 1.0 / sqrt(2);
-        
-        cv::Mat identity = (cv::Mat_<double>(2,2) << 1, 0, 0, 1);
-        
-        cv::Mat hadamard = (cv::Mat_<double>(2,2) << 1.0, 1.0, 1.0 , -1.0 );
-        
-        
-        cv::Mat result;
-        
-        if(bit == 0)
-        {
-            result = hadamard;
-        }else
-        {
-            result = identity;
-        }
-        
-        for(int i = 1; i < mRegSize; i++)
-        {
-            if( i == bit)
-            {
-                result = kron( result, hadamard );
-            }else
-            {
-                result = kron( result, identity );
-            }
-        }
-        
-        applyToStates(&result);
-        
-        for(int i = 0; i < pow(2,mRegSize); i++)
-        {
-            mState[i] = Complex(mState[i].getReal() * invSqrt, mState[i].getImag() * invSqrt);
-        }
-        
-        
-    }else {
-        printf("ERROR! bit indx out of range, max indx: %i\n", mRegSize);
-    }
+    apply(ofxQuantumGateHad(), bit);
 }
 
 ////////////////////////////
 // Apply Matrix to states
 ///////////////////////////
-void ofxQuantumRegister::applyToStates(cv::Mat *result)
+template<typename T>
+void ofxQuantumRegisterT<T>::applyToStates(cv::Mat *result)
 {
-    Complex *newStates= new Complex[ (int)pow(2,mRegSize) ];
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    // The matrix touches every state so it needs the dense buffer, in state order
+    makeDense();
+    resetQubitLayout();
+    
+    if(mIsSparse)
+        return;
+    
+    ofxQuantumStateBufferT<T> newStates(mNumStates);
     
-    for(int i = 0; i < pow(2, mRegSize); i++)
+    for(unsigned long long int i = 0; i < mNumStates; i++)
     {
-        float resultReal = 0.0;
-        float resultImag = 0.0;
+        double resultReal = 0.0;
+        double resultImag = 0.0;
         
-        for(int j = 0; j < pow(2, mRegSize); j++)
+        for(unsigned long long int j = 0; j < mNumStates; j++)
         {
-            resultReal += mState[j].getReal() * result->at<double>(i,j);
-            resultImag += mState[j].getImag() * result->at<double>(i,j);
+            resultReal += mState.real()[j] * result->at<double>(i,j);
+            resultImag += mState.imag()[j] * result->at<double>(i,j);
         }
         
-        newStates[i].set(resultReal, resultImag);
+        newStates.set(i, resultReal, resultImag);
         
     }
     
-    mState = newStates;
+    mState.swap(newStates);
 }
 
 
-/////////////////////////////////////////////////
-// Get number of states
-/////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////////
+// Swap and reorder qubits by relabelling them, the amplitudes stay where
+// they are and every later index goes through the new labels
+/////////////////////////////////////////////////////////////////////////////
 
-unsigned long long int ofxQuantumRegister::getNumStates()
+template<typename T>
+void ofxQuantumRegisterT<T>::applyGateSwap( unsigned long long int bit1, unsigned long long int bit2 )
 {
-    return pow(2, mRegSize);
+    // Apply any gates still waiting in a circuit first, they use the old labels
+    flushCircuit();
+    
+    if(bit1 >= mRegSize || bit2 >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return;
+    }
+    
+    std::swap(mQubitMap[bit1], mQubitMap[bit2]);
 }
 
-/////////////////////////////////////////////////
-// Get specified state
-/////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumRegisterT<T>::permuteQubits( const std::vector<unsigned long long int> & order )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    std::vector<bool> used(mRegSize, false);
+    
+    for(size_t q = 0; q < order.size(); q++)
+    {
+        if(order[q] >= mRegSize || used[order[q]])
+        {
+            printf("ERROR! qubit order is not a permutation of the %llu qubits\n", mRegSize);
+            return;
+        }
+        used[order[q]] = true;
+    }
+    
+    if(order.size() != mRegSize)
+    {
+        printf("ERROR! qubit order has %zu entries for %llu qubits\n", order.size(), mRegSize);
+        return;
+    }
+    
+    std::vector<unsigned long long int> map(mRegSize);
+    
+    for(size_t q = 0; q < order.size(); q++)
+        map[q] = mQubitMap[order[q]];
+    
+    mQubitMap.swap(map);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Move the amplitudes to a new layout, one exchange of stored bits at a
+// time until every qubit is at its position
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+std::vector<unsigned long long int> ofxQuantumRegisterT<T>::getQubitLayout() const
+{
+    return mQubitMap;
+}
 
-Complex  ofxQuantumRegister::getState(int stateIndx)
+template<typename T>
+void ofxQuantumRegisterT<T>::setQubitLayout( const std::vector<unsigned long long int> & layout )
 {
-    return mState[stateIndx];
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
     
+    std::vector<bool> used(mRegSize, false);
+    
+    for(size_t q = 0; q < layout.size(); q++)
+    {
+        if(layout[q] >= mRegSize || used[layout[q]])
+        {
+            printf("ERROR! qubit layout is not a permutation of the %llu positions\n", mRegSize);
+            return;
+        }
+        used[layout[q]] = true;
+    }
+    
+    if(layout.size() != mRegSize)
+    {
+        printf("ERROR! qubit layout has %zu entries for %llu qubits\n", layout.size(), mRegSize);
+        return;
+    }
+    
+    // Qubit stored at each position
+    std::vector<unsigned long long int> qubitAt(mRegSize);
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+        qubitAt[mQubitMap[q]] = q;
+    
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        if(mQubitMap[q] == layout[q])
+            continue;
+        
+        // Exchange with the qubit sitting where q belongs
+        const unsigned long long int other = qubitAt[layout[q]];
+        
+        swapStoredBits(mQubitMap[q], layout[q]);
+        
+        qubitAt[mQubitMap[q]] = other;
+        qubitAt[layout[q]]    = q;
+        mQubitMap[other]      = mQubitMap[q];
+        mQubitMap[q]          = layout[q];
+    }
+}
+
+/////////////////////////////////////////////////
+// Get number of states
+/////////////////////////////////////////////////
+
+template<typename T>
+unsigned long long int ofxQuantumRegisterT<T>::getNumStates()
+{
+    return mNumStates;
+}
+
+/////////////////////////////////////////////////
+// Get specified state
+/////////////////////////////////////////////////
+
+template<typename T>
+Complex  ofxQuantumRegisterT<T>::getState(int stateIndx)
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    return mIsSparse ? mSparse.get(storedIndex(stateIndx)) : mState.get(storedIndex(stateIndx));
+    
+}
+
+/////////////////////////////////////////////////
+// Use a specific thread pool for this register
+/////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::setThreadPool( ofxQuantumThreadPool * threadPool )
+{
+    mThreadPool = threadPool;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Pick how the amplitudes are stored
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::setStorage( Storage storage, double maxFill )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    mStorage = storage;
+    mMaxFill = maxFill;
+    
+    if(storage == STORAGE_DENSE)
+        makeDense();
+    else if(storage == STORAGE_SPARSE)
+        makeSparse();
+    else if(!mIsSparse && mRegSize >= QUANTUM_SPARSE_MIN_QUBITS && getNumNonZero() <= mMaxFill * mNumStates / 4)
+        makeSparse();
+    else
+        updateStorage();
+}
+
+template<typename T>
+typename ofxQuantumRegisterT<T>::Storage ofxQuantumRegisterT<T>::getStorage() const
+{
+    return mStorage;
+}
+
+template<typename T>
+bool ofxQuantumRegisterT<T>::isSparse() const
+{
+    return mIsSparse;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Move the dense buffer into a file or back into memory. A sparse register
+// only remembers the path, the file is made when it goes dense
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumRegisterT<T>::setBackingFile( const std::string & path )
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    if(!mIsSparse)
+    {
+        if(path.empty() && mRegSize > QUANTUM_MAX_DENSE_QUBITS)
+        {
+            printf("ERROR! a register of %llu qubits is too large to store densely in memory\n", mRegSize);
+            return false;
+        }
+        
+        ofxQuantumStateBufferT<T> moved;
+        
+        if(path.empty())
+            moved.allocate(mNumStates, mHugePages);
+        else if(!moved.allocateFile(path, mNumStates))
+            return false;
+        
+        memcpy(moved.real(), mState.real(), mNumStates * sizeof(T));
+        memcpy(moved.imag(), mState.imag(), mNumStates * sizeof(T));
+        
+        mState.swap(moved);
+    }
+    
+    mBackingFile = path;
+    
+    return true;
+}
+
+template<typename T>
+bool ofxQuantumRegisterT<T>::isFileBacked() const
+{
+    return !mBackingFile.empty();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Count the non zero amplitudes
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+unsigned long long int ofxQuantumRegisterT<T>::getNumNonZero()
+{
+    // Apply any gates still waiting in a circuit first
+    flushCircuit();
+    
+    if(mIsSparse)
+        return mSparse.size();
+    
+    const T * re = mState.real();
+    const T * im = mState.imag();
+    
+    const double count = sumChunks(mNumStates, [=](size_t begin, size_t end)
+    {
+        size_t nonZero = 0;
+        for(size_t i = begin; i < end; i++)
+            nonZero += (re[i] != 0 || im[i] != 0);
+        return (double)nonZero;
+    });
+    
+    return (unsigned long long int)count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Save the state as a snapshot. A dense register writes its two planes
+// straight from the buffer, a sparse one gathers its stored states into
+// index order first so a partial restore can find a range by bisection
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumRegisterT<T>::save( const std::string & path )
+{
+    // Apply any gates still waiting in a circuit first, snapshots are always in state order
+    flushCircuit();
+    resetQubitLayout();
+    
+    if(!mIsSparse)
+        return ofxQuantumSnapshot::write(path, (unsigned int)mRegSize, sizeof(T), ofxQuantumSnapshot::LAYOUT_DENSE,
+                                         mNumStates, NULL, mState.real(), mState.imag());
+    
+    std::vector<std::pair<unsigned long long int, size_t> > order;
+    order.reserve(mSparse.size());
+    
+    for(size_t s = 0; s < mSparse.capacity(); s++)
+    {
+        if(mSparse.keys()[s] != QUANTUM_SPARSE_EMPTY)
+            order.push_back(std::make_pair(mSparse.keys()[s], s));
+    }
+    
+    std::sort(order.begin(), order.end());
+    
+    std::vector<unsigned long long int> indices(order.size());
+    std::vector<T>                      re(order.size());
+    std::vector<T>                      im(order.size());
+    
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        indices[i] = order[i].first;
+        re[i]      = mSparse.real()[order[i].second];
+        im[i]      = mSparse.imag()[order[i].second];
+    }
+    
+    return ofxQuantumSnapshot::write(path, (unsigned int)mRegSize, sizeof(T), ofxQuantumSnapshot::LAYOUT_SPARSE,
+                                     order.size(), indices.data(), re.data(), im.data());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Copy count real numbers of a snapshot plane into a register plane
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+static void copyPlane( T * dst, const char * src, size_t count, unsigned int precision )
+{
+    if(precision == sizeof(T))
+    {
+        memcpy(dst, src, count * sizeof(T));
+    }
+    else if(precision == sizeof(float))
+    {
+        const float * f = (const float *)src;
+        for(size_t i = 0; i < count; i++)
+            dst[i] = (T)f[i];
+    }
+    else
+    {
+        const double * d = (const double *)src;
+        for(size_t i = 0; i < count; i++)
+            dst[i] = (T)d[i];
+    }
+}
+
+// Read real number i of a mapped plane
+static double planeValue( const char * plane, size_t i, unsigned int precision )
+{
+    return precision == sizeof(float) ? ((const float *)plane)[i] : ((const double *)plane)[i];
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Load a snapshot. A dense snapshot of this precision becomes the buffer
+// itself through a private mapping, anything else is read through a read
+// only mapping and converted
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumRegisterT<T>::load( const std::string & path )
+{
+    // Gates waiting in a circuit belong to the state being replaced, apply them so the circuit stays consistent
+    flushCircuit();
+    
+    ofxQuantumSnapshot::Header header;
+    
+    const int fd = ofxQuantumSnapshot::open(path, header);
+    
+    if(fd < 0)
+        return false;
+    
+    const bool   dense = header.layout == ofxQuantumSnapshot::LAYOUT_DENSE;
+    const size_t count = (size_t)header.count;
+    bool         ok    = true;
+    
+    if(dense && header.numQubits > getMaxDenseQubits())
+    {
+        printf("ERROR! a register of %u qubits is too large to store densely\n", header.numQubits);
+        close(fd);
+        return false;
+    }
+    
+    // Build the new state on the side so a failed load leaves the register as it was
+    ofxQuantumStateBufferT<T>   loadedState;
+    ofxQuantumSparseStateT<T>   loadedSparse;
+    ofxQuantumSnapshot::Mapping indexMap, realMap, imagMap;
+    
+    if(dense && header.precision == sizeof(T) && mBackingFile.empty())
+    {
+        ok = loadedState.mapFile(fd, header.realOffset, header.imagOffset, count);
+    }
+    else
+    {
+        ok = ofxQuantumSnapshot::map(fd, header.realOffset, count * header.precision, realMap) &&
+             ofxQuantumSnapshot::map(fd, header.imagOffset, count * header.precision, imagMap);
+        
+        if(ok && dense)
+        {
+            if(mBackingFile.empty())
+                loadedState.allocate(count, mHugePages);
+            else
+                ok = loadedState.allocateFile(mBackingFile, count);
+        }
+        
+        if(ok && dense)
+        {
+            copyPlane(loadedState.real(), realMap.data, count, header.precision);
+            copyPlane(loadedState.imag(), imagMap.data, count, header.precision);
+        }
+        else if(ok && ofxQuantumSnapshot::map(fd, header.indexOffset, count * sizeof(unsigned long long int), indexMap))
+        {
+            const unsigned long long int * indices = (const unsigned long long int *)indexMap.data;
+            
+            loadedSparse.clear(count);
+            
+            for(size_t i = 0; i < count; i++)
+                loadedSparse.set(indices[i], planeValue(realMap.data, i, header.precision), planeValue(imagMap.data, i, header.precision));
+        }
+        else
+        {
+            ok = false;
+        }
+        
+        ofxQuantumSnapshot::unmap(indexMap);
+        ofxQuantumSnapshot::unmap(realMap);
+        ofxQuantumSnapshot::unmap(imagMap);
+    }
+    
+    // The mapping keeps the file alive on its own
+    close(fd);
+    
+    if(!ok)
+    {
+        printf("ERROR! unable to load snapshot %s\n", path.c_str());
+        return false;
+    }
+    
+    mState.swap(loadedState);
+    mSparse.swap(loadedSparse);
+    
+    mRegSize   = header.numQubits;
+    mNumStates = 1ULL << mRegSize;
+    mIsSparse  = !dense;
+    
+    mQubitMap.resize(mRegSize);
+    resetQubitLayout(false);
+    
+    if(mIsSparse && mStorage == STORAGE_DENSE)
+        makeDense();
+    else
+        updateStorage();
+    
+    return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Restore a range of states. A dense snapshot maps only the pages of the
+// range, a sparse one finds the range in its sorted index plane
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumRegisterT<T>::loadRange( const std::string & path, unsigned long long int first, unsigned long long int count )
+{
+    // Apply any gates still waiting in a circuit first, the range is a run of states in order
+    flushCircuit();
+    resetQubitLayout();
+    
+    if(first > mNumStates || count > mNumStates - first)
+    {
+        printf("ERROR! states %llu to %llu are out of range, max indx: %llu\n", first, first + count - 1, mNumStates - 1);
+        return false;
+    }
+    
+    ofxQuantumSnapshot::Header header;
+    
+    const int fd = ofxQuantumSnapshot::open(path, header);
+    
+    if(fd < 0)
+        return false;
+    
+    if(header.numQubits != mRegSize)
+    {
+        printf("ERROR! snapshot %s holds %u qubits, the register has %llu\n", path.c_str(), header.numQubits, mRegSize);
+        close(fd);
+        return false;
+    }
+    
+    const unsigned int precision = header.precision;
+    
+    // Position of the range in the snapshot planes
+    size_t begin = (size_t)first;
+    size_t end   = (size_t)(first + count);
+    
+    ofxQuantumSnapshot::Mapping indexMap, realMap, imagMap;
+    const unsigned long long int * indices = NULL;
+    
+    bool ok = true;
+    
+    if(header.layout == ofxQuantumSnapshot::LAYOUT_SPARSE)
+    {
+        ok = ofxQuantumSnapshot::map(fd, header.indexOffset, header.count * sizeof(unsigned long long int), indexMap);
+        
+        if(ok)
+        {
+            const unsigned long long int * all = (const unsigned long long int *)indexMap.data;
+            
+            begin   = std::lower_bound(all, all + header.count, first)         - all;
+            end     = std::lower_bound(all, all + header.count, first + count) - all;
+            indices = all;
+        }
+    }
+    
+    ok = ok && ofxQuantumSnapshot::map(fd, header.realOffset + begin * precision, (end - begin) * precision, realMap);
+    ok = ok && ofxQuantumSnapshot::map(fd, header.imagOffset + begin * precision, (end - begin) * precision, imagMap);
+    
+    close(fd);
+    
+    if(ok)
+    {
+        if(mIsSparse)
+        {
+            // Keep the stored states outside the range and add the non zero ones from the snapshot
+            ofxQuantumSparseStateT<T> merged;
+            merged.clear(mSparse.size());
+            
+            for(size_t s = 0; s < mSparse.capacity(); s++)
+            {
+                const unsigned long long int key = mSparse.keys()[s];
+                
+                if(key != QUANTUM_SPARSE_EMPTY && (key < first || key >= first + count))
+                    merged.set(key, mSparse.real()[s], mSparse.imag()[s]);
+            }
+            
+            for(size_t i = 0; i < end - begin; i++)
+            {
+                const double re = planeValue(realMap.data, i, precision);
+                const double im = planeValue(imagMap.data, i, precision);
+                
+                if(re != 0 || im != 0)
+                    merged.set(indices != NULL ? indices[begin + i] : first + i, re, im);
+            }
+            
+            mSparse.swap(merged);
+            updateStorage();
+        }
+        else if(indices == NULL)
+        {
+            copyPlane(mState.real() + first, realMap.data, (size_t)count, precision);
+            copyPlane(mState.imag() + first, imagMap.data, (size_t)count, precision);
+        }
+        else
+        {
+            memset(mState.real() + first, 0, count * sizeof(T));
+            memset(mState.imag() + first, 0, count * sizeof(T));
+            
+            for(size_t i = 0; i < end - begin; i++)
+                mState.set(indices[begin + i], planeValue(realMap.data, i, precision), planeValue(imagMap.data, i, precision));
+        }
+    }
+    
+    ofxQuantumSnapshot::unmap(indexMap);
+    ofxQuantumSnapshot::unmap(realMap);
+    ofxQuantumSnapshot::unmap(imagMap);
+    
+    if(!ok)
+        printf("ERROR! unable to load states from snapshot %s\n", path.c_str());
+    
+    return ok;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Largest register that can be held densely, in memory or in a file
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+unsigned long long int ofxQuantumRegisterT<T>::getMaxDenseQubits() const
+{
+    return mBackingFile.empty() ? QUANTUM_MAX_DENSE_QUBITS : QUANTUM_MAX_FILE_QUBITS;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Pick the chunk size of a pass. A cache tile holds 2^tileQubits states
+// of both planes, a pass with its full set of pass qubits fills it
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumRegisterT<T>::getPassLayout( unsigned long long int & chunkQubits, unsigned long long int & passQubits ) const
+{
+    if(mIsSparse)
+        return false;
+    
+    if(isFileBacked())
+    {
+        chunkQubits = QUANTUM_FILE_CHUNK_QUBITS;
+        passQubits  = QUANTUM_FILE_PASS_QUBITS;
+        return true;
+    }
+    
+    unsigned long long int tileQubits = 0;
+    while(((size_t)2 << tileQubits) * 2 * sizeof(T) <= QUANTUM_CACHE_TILE_BYTES)
+        tileQubits++;
+    
+    // A state within a few tiles of the cache gains nothing from blocking
+    if(mRegSize <= tileQubits + 2)
+        return false;
+    
+    chunkQubits = tileQubits - QUANTUM_CACHE_PASS_QUBITS;
+    passQubits  = QUANTUM_CACHE_PASS_QUBITS;
+    return true;
+}
+
+template<typename T>
+std::vector<unsigned long long int> ofxQuantumRegisterT<T>::getPassLocalQubits( const std::vector<unsigned long long int> & qubits,
+                                                                               unsigned long long int chunkQubits ) const
+{
+    const unsigned long long int firstLow = mRegSize - std::min(chunkQubits, mRegSize);
+    
+    // Stored positions above the chunk
+    std::vector<unsigned long long int> passPositions;
+    
+    for(size_t k = 0; k < qubits.size(); k++)
+    {
+        if(mQubitMap[qubits[k]] < firstLow)
+            passPositions.push_back(mQubitMap[qubits[k]]);
+    }
+    
+    std::sort(passPositions.begin(), passPositions.end());
+    passPositions.erase(std::unique(passPositions.begin(), passPositions.end()), passPositions.end());
+    
+    std::vector<unsigned long long int> local(mRegSize, 0);
+    
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        const unsigned long long int position = mQubitMap[q];
+        
+        if(position >= firstLow)
+            local[q] = passPositions.size() + position - firstLow;
+        else
+            local[q] = std::lower_bound(passPositions.begin(), passPositions.end(), position) - passPositions.begin();
+    }
+    
+    return local;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Apply a group of gates in one sweep over the state. Qubits from firstLow
+// on sit inside a chunk, the other qubits the gates touch are the pass
+// qubits. Each tile is the 2^h chunks that differ only in the h pass
+// qubits. Every gate only mixes amplitudes inside a tile, so the tiles can
+// be done in any order and each chunk is read and written exactly once.
+// A file is worked through one tile at a time, the chunks of a tile
+// advance together so it is read as 2^h sequential streams
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::applyPass( const std::vector<unsigned long long int> & qubits, unsigned long long int chunkQubits,
+                                        const std::function<void (ofxQuantumRegisterT & tile)> & fn )
+{
+    if(mIsSparse)
+    {
+        printf("ERROR! only a dense register can be worked through in passes\n");
+        return;
+    }
+    
+    const unsigned long long int chunkSize = std::min(chunkQubits, mRegSize);
+    const unsigned long long int firstLow  = mRegSize - chunkSize;
+    
+    // Chunk index bit of each pass qubit, the most significant first
+    std::vector<unsigned long long int> passBits;
+    unsigned long long int              passMask = 0;
+    
+    for(size_t k = 0; k < qubits.size(); k++)
+    {
+        if(mQubitMap[qubits[k]] < firstLow)
+            passMask |= 1ULL << (firstLow - 1 - mQubitMap[qubits[k]]);
+    }
+    
+    for(unsigned long long int f = passMask; f != 0; f &= f - 1)
+        passBits.insert(passBits.begin(), f & (~f + 1));
+    
+    const size_t                 numPass     = passBits.size();
+    const size_t                 chunkStates = (size_t)1 << chunkSize;
+    const size_t                 tileChunks  = (size_t)1 << numPass;
+    const unsigned long long int numTiles    = 1ULL << (firstLow - numPass);
+    
+    // First chunk of every part of a tile, the pass qubit values set in turn
+    auto tileChunkList = [&](unsigned long long int t, std::vector<unsigned long long int> & list)
+    {
+        const unsigned long long int base = ofxQuantumKernels::insertZeroBits(t, passMask);
+        
+        for(size_t a = 0; a < tileChunks; a++)
+        {
+            unsigned long long int c = base;
+            for(size_t k = 0; k < numPass; k++)
+            {
+                if((a >> (numPass - 1 - k)) & 1)
+                    c |= passBits[k];
+            }
+            list[a] = c;
+        }
+    };
+    
+    // Work through tiles [begin, end) with a tile register of their own
+    auto runTiles = [&](size_t begin, size_t end)
+    {
+        ofxQuantumRegisterT<T> tile(numPass + chunkSize, mQuantumSim);
+        tile.setThreadPool(mThreadPool);
+        tile.setStorage(STORAGE_DENSE);
+        
+        std::vector<unsigned long long int> chunks(tileChunks), nextChunks(tileChunks);
+        
+        tileChunkList(begin, chunks);
+        
+        for(size_t t = begin; t < end; t++)
+        {
+            // Start reading the next tile of a file while this one is worked on
+            if(t + 1 < end)
+            {
+                tileChunkList(t + 1, nextChunks);
+                for(size_t a = 0; a < tileChunks; a++)
+                    mState.willNeed(nextChunks[a] * chunkStates, chunkStates);
+            }
+            
+            for(size_t a = 0; a < tileChunks; a++)
+            {
+                memcpy(tile.mState.real() + a * chunkStates, mState.real() + chunks[a] * chunkStates, chunkStates * sizeof(T));
+                memcpy(tile.mState.imag() + a * chunkStates, mState.imag() + chunks[a] * chunkStates, chunkStates * sizeof(T));
+            }
+            
+            fn(tile);
+            
+            // Write the tile back, the pages are not needed again this pass
+            for(size_t a = 0; a < tileChunks; a++)
+            {
+                memcpy(mState.real() + chunks[a] * chunkStates, tile.mState.real() + a * chunkStates, chunkStates * sizeof(T));
+                memcpy(mState.imag() + chunks[a] * chunkStates, tile.mState.imag() + a * chunkStates, chunkStates * sizeof(T));
+                mState.dontNeed(chunks[a] * chunkStates, chunkStates);
+            }
+            
+            chunks.swap(nextChunks);
+        }
+    };
+    
+    ofxQuantumThreadPool * pool = mState.usesFile() ? NULL : getActiveThreadPool(mNumStates);
+    
+    // Each task sets up a tile register, so hand out the tiles in a few dozen large runs
+    if(pool != NULL)
+        pool->parallelFor(0, numTiles, std::max<size_t>(1, numTiles / 64), runTiles);
+    else
+        runTiles(0, numTiles);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Scatter the stored states into a dense buffer, registers too large to
+// hold densely stay sparse
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::makeDense()
+{
+    if(!mIsSparse)
+        return;
+    
+    if(mRegSize > getMaxDenseQubits())
+    {
+        printf("ERROR! a register of %llu qubits is too large to store densely\n", mRegSize);
+        return;
+    }
+    
+    if(mBackingFile.empty())
+        mState.allocate(mNumStates, mHugePages);
+    else if(!mState.allocateFile(mBackingFile, mNumStates))
+        return;
+    
+    for(size_t s = 0; s < mSparse.capacity(); s++)
+    {
+        if(mSparse.keys()[s] != QUANTUM_SPARSE_EMPTY)
+            mState.set(mSparse.keys()[s], mSparse.real()[s], mSparse.imag()[s]);
+    }
+    
+    mSparse.clear();
+    mIsSparse = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Gather the non zero states of the dense buffer and release it
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::makeSparse()
+{
+    if(mIsSparse)
+        return;
+    
+    const T * re = mState.real();
+    const T * im = mState.imag();
+    
+    mSparse.clear();
+    
+    for(unsigned long long int i = 0; i < mNumStates; i++)
+    {
+        if(re[i] != 0 || im[i] != 0)
+            mSparse.set(i, re[i], im[i]);
+    }
+    
+    mState.release();
+    mIsSparse = true;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// A sparse automatic register goes dense once it stores too many states.
+// Going back is only checked when the state is reset or measured, that
+// is when the count of non zero states is known without an extra pass.
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::updateStorage()
+{
+    if(mIsSparse && mStorage == STORAGE_AUTO && mRegSize <= getMaxDenseQubits() && mSparse.size() > mMaxFill * mNumStates)
+        makeDense();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Thread pool to run loops on, small registers stay on the calling thread
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+ofxQuantumThreadPool * ofxQuantumRegisterT<T>::getActiveThreadPool( size_t work ) const
+{
+    if(work < QUANTUM_PARALLEL_THRESHOLD)
+        return NULL;
+    
+    if(mThreadPool != NULL)
+        return mThreadPool;
+    
+    if(mQuantumSim != NULL)
+        return &mQuantumSim->getThreadPool();
+    
+    return NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Translate state indices through the qubit layout. Bit q of a state index,
+// counted from the most significant, is stored at bit mQubitMap[q]
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumRegisterT<T>::isPermuted() const
+{
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        if(mQubitMap[q] != q)
+            return true;
+    }
+    return false;
+}
+
+template<typename T>
+unsigned long long int ofxQuantumRegisterT<T>::storedIndex( unsigned long long int stateIndx ) const
+{
+    unsigned long long int stored = 0;
+    
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        if((stateIndx >> (mRegSize - 1 - q)) & 1)
+            stored |= bitMask(q);
+    }
+    
+    // Bits above the register are kept so out of range indices stay out of range
+    return stored | (stateIndx & ~(mNumStates - 1));
+}
+
+template<typename T>
+unsigned long long int ofxQuantumRegisterT<T>::logicalIndex( unsigned long long int storedIndx ) const
+{
+    unsigned long long int stateIndx = 0;
+    
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        if(storedIndx & bitMask(q))
+            stateIndx |= 1ULL << (mRegSize - 1 - q);
+    }
+    
+    return stateIndx;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Put every qubit back at its own position. Without moving the amplitudes
+// this is only right when the whole state is about to be replaced
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::resetQubitLayout( bool moveAmplitudes )
+{
+    if(!isPermuted())
+        return;
+    
+    std::vector<unsigned long long int> identity(mRegSize);
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+        identity[q] = q;
+    
+    if(moveAmplitudes)
+        setQubitLayout(identity);
+    else
+        mQubitMap.swap(identity);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Exchange two bits of the stored index, the amplitudes where the bits
+// differ trade places. The free bits below the lower one come in runs
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::swapStoredBits( unsigned long long int pos1, unsigned long long int pos2 )
+{
+    if(pos1 == pos2)
+        return;
+    
+    const unsigned long long int mask1 = 1ULL << (mRegSize - 1 - pos1);
+    const unsigned long long int mask2 = 1ULL << (mRegSize - 1 - pos2);
+    
+    if(mIsSparse)
+    {
+        ofxQuantumSparseStateT<T> moved;
+        moved.clear(mSparse.size());
+        
+        for(size_t s = 0; s < mSparse.capacity(); s++)
+        {
+            unsigned long long int key = mSparse.keys()[s];
+            
+            if(key == QUANTUM_SPARSE_EMPTY)
+                continue;
+            
+            if(((key & mask1) != 0) != ((key & mask2) != 0))
+                key ^= mask1 | mask2;
+            
+            moved.set(key, mSparse.real()[s], mSparse.imag()[s]);
+        }
+        
+        mSparse.swap(moved);
+        return;
+    }
+    
+    T *                          re        = mState.real();
+    T *                          im        = mState.imag();
+    const unsigned long long int fixedMask = mask1 | mask2;
+    const unsigned long long int runLength = fixedMask & (~fixedMask + 1);
+    
+    forEachChunk((mNumStates >> 2) / runLength, [=](size_t begin, size_t end)
+    {
+        for(unsigned long long int run = begin; run < end; run++)
+        {
+            const unsigned long long int base = ofxQuantumKernels::insertZeroBits(run * runLength, fixedMask);
+            
+            ofxQuantumKernels::swapPairs(re, im, base | mask1, base | mask2, runLength);
+        }
+    });
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Run fn over chunks of [0, count), in parallel when there is a pool
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::forEachChunk( size_t count, const std::function<void (size_t, size_t)> & fn ) const
+{
+    ofxQuantumThreadPool * pool = getActiveThreadPool(mNumStates);
+    
+    if(pool != NULL)
+        pool->parallelFor(0, count, QUANTUM_PARALLEL_GRAIN, fn);
+    else
+        ofxQuantumThreadPool::serialFor(0, count, QUANTUM_PARALLEL_GRAIN, fn);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Sum fn over chunks of [0, count), the order of additions is always the
+// same so the serial and parallel results match exactly
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+double ofxQuantumRegisterT<T>::sumChunks( size_t count, const std::function<double (size_t, size_t)> & fn ) const
+{
+    ofxQuantumThreadPool * pool = getActiveThreadPool(mNumStates);
+    
+    if(pool != NULL)
+        return pool->parallelSum(0, count, QUANTUM_PARALLEL_GRAIN, fn);
+    else
+        return ofxQuantumThreadPool::serialSum(0, count, QUANTUM_PARALLEL_GRAIN, fn);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Apply the gates recorded by a linked circuit before the state is used
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::flushCircuit() const
+{
+    if(mCircuit != NULL)
+        mCircuit->flush();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Sum several values over chunks of [0, count) in a fixed order
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumRegisterT<T>::sumChunks( size_t count, size_t numValues, const std::function<void (size_t, size_t, double *)> & fn, double * totals ) const
+{
+    ofxQuantumThreadPool * pool = getActiveThreadPool(mNumStates);
+    
+    if(pool != NULL)
+        pool->parallelSum(0, count, QUANTUM_PARALLEL_GRAIN, numValues, fn, totals);
+    else
+        ofxQuantumThreadPool::serialSum(0, count, QUANTUM_PARALLEL_GRAIN, numValues, fn, totals);
 }
 
+// Single and double precision registers
+template class ofxQuantumRegisterT<float>;
+template class ofxQuantumRegisterT<double>;
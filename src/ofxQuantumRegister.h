@@ -8,6 +8,19 @@
 //  ofxQuantumRegister is a class that describes a quantum register, which is a set of a quantum bits that can have
 //  quantum gate functions applied to it. This code is based on work done by Matthew Hayward https://quantum-algorithms.herokuapp.com/
 //
+//  The amplitude type is picked at compile time. ofxQuantumRegister is the double precision register, ofxQuantumRegisterT<float>
+//  uses half the memory, so it holds one more qubit in the same ram, and fits twice as many amplitudes in each vector register.
+//  Probabilities and norms are summed in double for both.
+//
+//  Large registers start out sparse, only the non zero amplitudes are stored and gates cost time in proportion to their
+//  number, so reversible circuits can run on far more qubits than fit in memory densely. Once more than a fraction of the
+//  states are non zero the register switches to the dense buffer, and goes back to sparse when a measurement or a new
+//  state leaves it sparse again. setStorage fixes one representation instead.
+//
+//  Qubits are logical labels. The register keeps the position in the state index of each qubit, so a swap or a reordering
+//  of the qubits only changes the labels and moves no amplitudes. Gates, measurements and state indices all go through
+//  the labels, the amplitudes are only moved when a circuit finds that regrouping the qubits saves passes over the state,
+//  or when the whole state is read or written in order.
 //
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -19,33 +32,93 @@
 #include <math.h>
 #include <stdlib.h>
 #include <time.h>
+#include <vector>
+#include <map>
+#include <string>
 #include "Complex.h"
+#include "ofxQuantumStateBuffer.h"
+#include "ofxQuantumSparseState.h"
+#include "ofxQuantumKernels.h"
+#include "ofxQuantumGates.h"
+#include "ofxQuantumThreadPool.h"
+#include "ofxQuantumSampler.h"
 #include "ofxQuantum.h"
 #include "ofxCv.h"
 
 
+// Largest number of bits measureBits gathers joint probabilities for, more are measured one at a time
+#define QUANTUM_MAX_JOINT_MEASURE 16
+
+// Registers with at least this many qubits start out sparse, smaller ones are always dense
+#define QUANTUM_SPARSE_MIN_QUBITS 16
+
+// Largest register that is ever switched to dense, 2^32 double amplitudes take 64 GB
+#define QUANTUM_MAX_DENSE_QUBITS  32
+
+// Largest register that is kept densely in a backing file, 2^40 double amplitudes take 16 TB of disk
+#define QUANTUM_MAX_FILE_QUBITS   40
+
+// A file backed register is streamed in chunks of 2^this states, one long sequential run of each plane
+#define QUANTUM_FILE_CHUNK_QUBITS 18
+
+// Most qubits above the chunk that one streaming pass gathers together, a pass holds 2^(18 + 4) states in memory
+#define QUANTUM_FILE_PASS_QUBITS  4
+
+// Working set of one cache blocked pass over an in memory register, about the size of a per core L2 cache
+#define QUANTUM_CACHE_TILE_BYTES  (512 * 1024)
+
+// Most high qubits one cache blocked pass brings into the tile, the rest of the tile is the low qubits
+#define QUANTUM_CACHE_PASS_QUBITS 3
+
+// Largest register, the state index has to fit in 64 bits
+#define QUANTUM_MAX_QUBITS        63
+
+// A sparse register switches to dense once more than this fraction of its states are stored
+#define QUANTUM_SPARSE_MAX_FILL   (1.0 / 16)
+
 // Forward declarations
 class ofxQuantum;
 class ofxQuantumBit;
+template<typename T> class ofxQuantumCircuitT;
+template<typename T> class ofxQuantumDistributedRegisterT;
+class ofxQuantumStatePublisher;
 
-class ofxQuantumRegister
+template<typename T>
+class ofxQuantumRegisterT
 {
 public:
     
+    // How the amplitudes are stored
+    enum Storage
+    {
+        STORAGE_AUTO = 0,       // Sparse or dense, picked from the number of non zero states
+        STORAGE_DENSE,          // Every amplitude in ofxQuantumStateBuffer
+        STORAGE_SPARSE          // Only non zero amplitudes, in ofxQuantumSparseState
+    };
+    
     //////////////////////////////////////////////////////////////////////////////////////////
     // Public Functions
     //////////////////////////////////////////////////////////////////////////////////////////
     
     // Constructors.  Size is the number of bits in of our register
     // Quantum register must have a reference to an ofxQuantum object in order to measure the quantum state of a bit
-    ofxQuantumRegister();
-    ofxQuantumRegister(unsigned long long int size, ofxQuantum *quantumSim);
-    ofxQuantumRegister(const ofxQuantumRegister &);
-    ~ofxQuantumRegister();
+    // For large registers useHugePages asks the os to back the amplitudes with huge pages to reduce tlb misses
+    ofxQuantumRegisterT();
+    ofxQuantumRegisterT(unsigned long long int size, ofxQuantum *quantumSim, bool useHugePages = false);
+    ofxQuantumRegisterT(const ofxQuantumRegisterT &);
+    ~ofxQuantumRegisterT();
     
     // Measures our quantum register, and returns the decimal and interpretation of the bit string measured.
     unsigned long long int decimalMeasure();
     
+    // Draw outcomes as if the register was measured shots times, without collapsing it. The sampling table is built once
+    // and each draw is O(log N) with a prefix sum or O(1) with an alias table, by default the cheaper one is picked
+    std::vector<unsigned long long int>                      sample(       unsigned long long int shots, ofxQuantumSampler::Method method = ofxQuantumSampler::SAMPLE_AUTO );
+    std::map<unsigned long long int, unsigned long long int> sampleCounts( unsigned long long int shots, ofxQuantumSampler::Method method = ofxQuantumSampler::SAMPLE_AUTO );
+    
+    // Draw outcomes from a given seed instead of one taken from the quantum simulator, the same seed gives the same outcomes
+    std::vector<unsigned long long int>                      sample(       unsigned long long int shots, unsigned long long int seed, ofxQuantumSampler::Method method = ofxQuantumSampler::SAMPLE_AUTO );
+    
     // Prints out all the information about this quantum register
     // When verbose != 0 we return every value, when verbose = 0 we return only probability amplitudes which differ from 0.
     // WARNING, in the case of larger register sizes this can print an incredibly large amount of information!
@@ -54,6 +127,9 @@ public:
     // Set state of the qubits using the arrays of complex amplitudes.
     void setState(Complex *new_state);
     
+    // Set the state to the listed amplitudes, every other state is 0. Works for registers too large to pass every state
+    void setStates( const std::vector<unsigned long long int> & indices, const std::vector<Complex> & amplitudes );
+    
     // Set the state to an equal superposition of all possible states between 0 and number inclusive.
     void setAverage(unsigned long long int number);
     
@@ -66,16 +142,82 @@ public:
     //Return the size of the register.
     int size() const;
     
-    // Measure the bit at a given indx
+    // Measure the bit at a given indx, returns -1 if the indx is out of range or every amplitude is zero
     int measureBit(unsigned long long int bitIndx);
     
+    // Measure several bits together, bit q of qubitMask selects qubit q and bit q of the result is the value measured
+    unsigned long long int measureBits( unsigned long long int qubitMask );
+    
+    // Chance of measuring 1 on a bit, without collapsing the register
+    double getBitProb( unsigned long long int bitIndx );
+    
+    // Apply an arbitrary 2x2 unitary, given in row major order, to a single qubit in place
+    void applyGate( unsigned long long int bit, const Complex matrix[4] );
+    
+    // Apply a gate type from ofxQuantumGates.h. The kernel is chosen at compile time from the class of the gate, permutations
+    // only swap amplitudes, diagonal gates multiply by a phase in one pass and only dense gates use the 2x2 pair kernel
+    template<typename Gate>
+    void apply( const Gate & gate, unsigned long long int bit )
+    {
+        applyGateClass(gate, std::vector<unsigned long long int>(), bit, ~0ULL, typename Gate::GateClass());
+    }
+    
+    // Apply a gate type to the target qubit when all control qubits hold their required values, see applyControlledGate
+    template<typename Gate>
+    void applyControlled( const Gate & gate,
+                          const std::vector<unsigned long long int> & controls,
+                          unsigned long long int target,
+                          unsigned long long int controlValues = ~0ULL )
+    {
+        applyGateClass(gate, controls, target, controlValues, typename Gate::GateClass());
+    }
+    
     // Apply gates to register, see https://en.wikipedia.org/wiki/Quantum_gate for more info
     void applyGateX(    unsigned long long int bit );
     void applyGateY(    unsigned long long int bit );
     void applyGateZ(    unsigned long long int bit );
+    void applyGateS(    unsigned long long int bit );
+    void applyGateT(    unsigned long long int bit );
     void applyGateHad(  unsigned long long int bit );
+    
+    // Phase shift diag(1, e^(i theta)) and rotations by theta about the x, y and z axes
+    void applyGatePhase( unsigned long long int bit, double theta );
+    void applyGateRx(    unsigned long long int bit, double theta );
+    void applyGateRy(    unsigned long long int bit, double theta );
+    void applyGateRz(    unsigned long long int bit, double theta );
+    // applyGateCNOT and applyGateToff are classically controlled, they take the value of the control rather than a qubit
     void applyGateCNOT( unsigned long long int bit, int controlBitVal );
     void applyGateToff( unsigned long long int bit, int controlBitVal1, int controlBitVal2 );
+    
+    // Apply a 2x2 unitary to the target qubit when all control qubits hold their required values.
+    // Bit j of controlValues is the value required of controls[j], by default every control must be 1
+    void applyControlledGate( const std::vector<unsigned long long int> & controls,
+                              unsigned long long int target,
+                              const Complex matrix[4],
+                              unsigned long long int controlValues = ~0ULL );
+    
+    // Apply a dense 2^k x 2^k unitary, given in row major order, to k qubits. qubits[0] is the most significant local bit
+    void applyMultiQubitGate( const std::vector<unsigned long long int> & qubits, const Complex * matrix );
+    
+    // Quantum controlled versions of cnot and toffoli, the controls are qubit indices in this register
+    void applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit );
+    void applyGateToffoli(       unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit );
+    
+    // Phase shift of the target controlled by another qubit, only the state where both are 1 changes
+    void applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta );
+    
+    // Exchange two qubits. Only the labels change, no amplitudes are moved
+    void applyGateSwap( unsigned long long int bit1, unsigned long long int bit2 );
+    
+    // Reorder the qubits, qubit i afterwards is the qubit order[i] before. Only the labels change
+    void permuteQubits( const std::vector<unsigned long long int> & order );
+    
+    // Position of each qubit in the stored state index, 0 is the most significant bit. setQubitLayout moves the amplitudes
+    // so that qubit q is stored at position layout[q], one sweep over the state for every pair of positions exchanged
+    std::vector<unsigned long long int> getQubitLayout() const;
+    void                                setQubitLayout( const std::vector<unsigned long long int> & layout );
+    
+    // Multiply the states by a dense 2^n x 2^n matrix, only practical for very small registers
     void applyToStates( cv::Mat *result );
     
     // Get the number of states in the register
@@ -84,26 +226,142 @@ public:
     // Get the complex number represenation of a state
     Complex   getState(int stateIndx);
     
+    // Run this register's loops on a specific thread pool, by default the pool of the linked ofxQuantum is used
+    void setThreadPool( ofxQuantumThreadPool * threadPool );
+    
+    // Pick how the amplitudes are stored. With STORAGE_AUTO a sparse register goes dense once more than maxFill of its
+    // states are stored, and a dense one goes sparse when it is reset or measured down to well under that
+    void    setStorage( Storage storage, double maxFill = QUANTUM_SPARSE_MAX_FILL );
+    Storage getStorage() const;
+    bool    isSparse() const;
+    
+    // Number of amplitudes stored by a sparse register, or the number of non zero amplitudes of a dense one
+    unsigned long long int getNumNonZero();
+    
+    // Keep the dense amplitudes in a memory mapped file at path instead of memory, for registers too large for ram, up to
+    // QUANTUM_MAX_FILE_QUBITS. The file is removed as soon as it is mapped. Gates recorded in an ofxQuantumCircuit are
+    // applied in streaming passes that each read and write the file once, see applyPass. An empty path goes back to memory
+    bool setBackingFile( const std::string & path );
+    bool isFileBacked() const;
+    
+    // Write the state to a binary snapshot, see ofxQuantumSnapshot.h for the format. Dense registers write their planes
+    // as they are, sparse ones write only their stored states
+    bool save( const std::string & path );
+    
+    // Replace the register, including its size, with a snapshot. A dense snapshot of the same precision is mapped copy on
+    // write instead of being read, so loading takes no time, pages come from the file as they are first used and gates
+    // never write back to it. Other snapshots are read and converted
+    bool load( const std::string & path );
+    
+    // Restore states [first, first + count) from a snapshot of a register of the same size, every other state is kept.
+    // Only the pages holding the range are read
+    bool loadRange( const std::string & path, unsigned long long int first, unsigned long long int count );
+    
 private:
     
+    // Circuits record gates into a register and flush them before the state is used
+    friend class ofxQuantumCircuitT<T>;
+    
+    // A distributed register keeps its slice in a register whose amplitudes live in shared memory
+    friend class ofxQuantumDistributedRegisterT<T>;
+    
+    // Publishers copy the stored amplitudes straight into shared memory
+    friend class ofxQuantumStatePublisher;
     
     //////////////////////////////////////////////////////////////////////////////////////////
     // Private Functions
     //////////////////////////////////////////////////////////////////////////////////////////
     
-    // Expands matrices
-    cv::Mat kron( cv::Mat & A, cv::Mat & B);
+    // Apply the gates waiting in a linked circuit
+    void flushCircuit() const;
+    
+    // Kernel for each class of gate, picked by overload on the GateClass tag
+    void applyGateClass( const ofxQuantumPermutationGate & gate, const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumPermutationClass );
+    void applyGateClass( const ofxQuantumDiagonalGate & gate,    const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumDiagonalClass );
+    void applyGateClass( const ofxQuantumDenseGate & gate,       const std::vector<unsigned long long int> & controls,
+                         unsigned long long int target, unsigned long long int controlValues, ofxQuantumDenseClass );
+    
+    // Call fn(i0, i1, runLength) for every run of target pairs whose controls hold their values, false if the qubits are invalid
+    template<typename Fn>
+    bool forEachControlledRun( const std::vector<unsigned long long int> & controls, unsigned long long int target,
+                               unsigned long long int controlValues, const Fn & fn );
+    
+    // Masks of the control bits and the values they must hold, false if the qubits are invalid
+    bool controlMasks( const std::vector<unsigned long long int> & controls, unsigned long long int target,
+                       unsigned long long int controlValues, unsigned long long int & controlMask, unsigned long long int & controlBits ) const;
+    
+    // How gates should be grouped into passes over the state. Returns false when each gate may as well sweep the state on
+    // its own, a sparse register or a dense one that fits in cache. Otherwise the state is cut into chunks of
+    // 2^chunkQubits states and one pass can bring up to passQubits qubits above the chunk into its tiles. A file backed
+    // register uses large chunks that stream well from disk, an in memory one uses tiles of about QUANTUM_CACHE_TILE_BYTES
+    bool getPassLayout( unsigned long long int & chunkQubits, unsigned long long int & passQubits ) const;
+    
+    // Qubit of the tile register that each qubit of the register maps to in a pass over the given qubits. The pass qubits,
+    // those above the chunk, come first in increasing order, followed by the chunk qubits in order
+    std::vector<unsigned long long int> getPassLocalQubits( const std::vector<unsigned long long int> & qubits,
+                                                            unsigned long long int chunkQubits ) const;
+    
+    // Apply a group of gates in one pass over the state. The chunks that differ only in the pass qubits are gathered into
+    // a small tile register, which swaps those qubits down next to the chunk qubits, fn applies every gate of the group to
+    // the tile and the tile is written back, so each amplitude is read and written once however many gates there are.
+    // In memory registers run the tiles in parallel, fn has to be safe to call from several threads at once
+    void applyPass( const std::vector<unsigned long long int> & qubits, unsigned long long int chunkQubits,
+                    const std::function<void (ofxQuantumRegisterT & tile)> & fn );
+    
+    // Largest register the dense buffer can hold, more when it is backed by a file
+    unsigned long long int getMaxDenseQubits() const;
+    
+    // Move the amplitudes between the sparse and dense representations
+    void makeDense();
+    void makeSparse();
+    
+    // Switch representation when the number of stored states has crossed the fill limits
+    void updateStorage();
+    
+    // Mask of the stored state index bit that holds a qubit, the bit of its position in the layout
+    unsigned long long int bitMask( unsigned long long int bit ) const { return 1ULL << (mRegSize - 1 - mQubitMap[bit]); }
+    
+    // Convert between the state index the caller sees and the index the amplitude is stored at
+    bool                   isPermuted() const;
+    unsigned long long int storedIndex(  unsigned long long int stateIndx ) const;
+    unsigned long long int logicalIndex( unsigned long long int storedIndx ) const;
+    
+    // Put every qubit back at its own position before the whole state is read or written in order. When the whole state
+    // is about to be replaced the labels are reset without moving any amplitudes
+    void resetQubitLayout( bool moveAmplitudes = true );
+    
+    // Exchange the amplitudes of two stored index bits
+    void swapStoredBits( unsigned long long int pos1, unsigned long long int pos2 );
+    
+    // Split loops over the amplitudes between threads, or run them serially for small registers
+    ofxQuantumThreadPool * getActiveThreadPool( size_t work ) const;
+    void                   forEachChunk( size_t count, const std::function<void (size_t, size_t)> & fn ) const;
+    double                 sumChunks(    size_t count, const std::function<double (size_t, size_t)> & fn ) const;
+    void                   sumChunks(    size_t count, size_t numValues, const std::function<void (size_t, size_t, double *)> & fn, double * totals ) const;
     
     //////////////////////////////////////////////////////////////////////////////////////////
     // Private Variables
     //////////////////////////////////////////////////////////////////////////////////////////
     
-    Complex    *           mState;       // Complex number states in our register
-    ofxQuantum *           mQuantumSim;  // Reference to quantum simulator
-    unsigned long long int mRegSize;     // Size of the register
-    unsigned long long int mNumStates;   // Number of states in this register, equals 2 ^ mRegSize
-    short       **         mBits;        // Binary representation of each state
+    ofxQuantumStateBufferT<T> mState;       // Complex number states in our register, stored as separate real and imaginary planes
+    ofxQuantumSparseStateT<T> mSparse;      // Non zero states when the register is sparse
+    bool                      mIsSparse;    // Which of mState and mSparse holds the amplitudes
+    Storage                   mStorage;     // Requested representation
+    double                    mMaxFill;     // Fraction of stored states above which an automatic register goes dense
+    bool                      mHugePages;   // Back the dense buffer with huge pages
+    std::string               mBackingFile; // File the dense buffer is mapped from, empty for memory
+    std::vector<unsigned long long int> mQubitMap; // Position in the stored state index of each qubit
+    ofxQuantum *              mQuantumSim;  // Reference to quantum simulator
+    ofxQuantumThreadPool *    mThreadPool;  // Thread pool to use instead of the simulator's, can be NULL
+    ofxQuantumCircuitT<T> *   mCircuit;     // Circuit recording gates for this register, can be NULL
+    unsigned long long int    mRegSize;     // Size of the register
+    unsigned long long int    mNumStates;   // Number of states in this register, equals 2 ^ mRegSize
     
 };
 
+// Double precision register, the default
+typedef ofxQuantumRegisterT<double> ofxQuantumRegister;
+
 #endif
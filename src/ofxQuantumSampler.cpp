@@ -0,0 +1,216 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSampler.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumSampler.h"
+#include "ofxQuantumThreadPool.h"
+#include "ofxQuantumKernels.h"
+
+#include <algorithm>
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+ofxQuantumSampler::ofxQuantumSampler()
+{
+    mMethod      = SAMPLE_PREFIX_SUM;
+    mLastNonZero = 0;
+    mTotal       = 0.0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// The alias table needs an extra O(N) pass to build but saves a log N
+// binary search on every draw, so it pays off once the number of shots
+// times log N is larger than the number of states
+////////////////////////////////////////////////////////////////////////
+ofxQuantumSampler::Method ofxQuantumSampler::chooseMethod( size_t numStates, size_t numShots )
+{
+    size_t logStates = 1;
+    while(((size_t)1 << logStates) < numStates)
+        logStates++;
+
+    return numShots * logStates > numStates ? SAMPLE_ALIAS : SAMPLE_PREFIX_SUM;
+}
+
+////////////////////////////////////////////////////
+// Build the table                                //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSampler::build( const T * real, const T * imag, size_t numStates, Method method, ofxQuantumThreadPool * pool )
+{
+    mTable.clear();
+    mAlias.clear();
+    mTotal       = 0.0;
+    mLastNonZero = 0;
+
+    if(method == SAMPLE_AUTO)
+        method = SAMPLE_PREFIX_SUM;
+
+    mMethod = method;
+
+    if(numStates == 0)
+        return;
+
+    // The last non zero outcome is used by both tables
+    for(size_t i = numStates; i > 0; i--)
+    {
+        if(real[i - 1] != 0 || imag[i - 1] != 0)
+        {
+            mLastNonZero = i - 1;
+            break;
+        }
+    }
+
+    if(method == SAMPLE_ALIAS)
+        buildAlias(real, imag, numStates);
+    else
+        buildPrefixSum(real, imag, numStates, pool);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Cumulative probabilities. Each chunk sums its own probabilities, the
+// chunk totals are scanned in order, then each chunk fills in its part
+// of the table starting from its offset. The chunking is fixed so the
+// table is the same with or without threads.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSampler::buildPrefixSum( const T * real, const T * imag, size_t numStates, ofxQuantumThreadPool * pool )
+{
+    mTable.resize(numStates);
+
+    const size_t        grain     = QUANTUM_PARALLEL_GRAIN;
+    const size_t        numChunks = (numStates + grain - 1) / grain;
+    std::vector<double> offsets(numChunks + 1, 0.0);
+
+    std::function<void (size_t, size_t)> sumChunk = [&](size_t begin, size_t end)
+    {
+        offsets[begin / grain + 1] = ofxQuantumKernels::sumSquares(real + begin, imag + begin, end - begin);
+    };
+
+    std::function<void (size_t, size_t)> fillChunk = [&](size_t begin, size_t end)
+    {
+        double total = offsets[begin / grain];
+        for(size_t i = begin; i < end; i++)
+        {
+            total += (double)real[i] * real[i] + (double)imag[i] * imag[i];
+            mTable[i] = total;
+        }
+    };
+
+    if(pool != NULL)
+        pool->parallelFor(0, numStates, grain, sumChunk);
+    else
+        ofxQuantumThreadPool::serialFor(0, numStates, grain, sumChunk);
+
+    for(size_t c = 0; c < numChunks; c++)
+        offsets[c + 1] += offsets[c];
+
+    if(pool != NULL)
+        pool->parallelFor(0, numStates, grain, fillChunk);
+    else
+        ofxQuantumThreadPool::serialFor(0, numStates, grain, fillChunk);
+
+    mTotal = mTable[numStates - 1];
+}
+
+////////////////////////////////////////////////////////////////////////
+// Walker alias table built with Vose's method. Every slot holds the
+// probability of keeping its own outcome and the outcome to use
+// otherwise, so a draw is one slot lookup and one comparison.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSampler::buildAlias( const T * real, const T * imag, size_t numStates )
+{
+    mTable.resize(numStates);
+    mAlias.resize(numStates);
+
+    mTotal = ofxQuantumKernels::sumSquares(real, imag, numStates);
+
+    if(mTotal <= 0.0)
+        return;
+
+    const double scale = (double)numStates / mTotal;
+
+    std::vector<size_t> small, large;
+
+    for(size_t i = 0; i < numStates; i++)
+    {
+        mTable[i] = ((double)real[i] * real[i] + (double)imag[i] * imag[i]) * scale;
+        mAlias[i] = i;
+
+        if(mTable[i] < 1.0)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+
+    while(!small.empty() && !large.empty())
+    {
+        const size_t s = small.back(); small.pop_back();
+        const size_t l = large.back();
+
+        // The small slot is topped up by the large outcome
+        mAlias[s]  = l;
+        mTable[l] -= 1.0 - mTable[s];
+
+        if(mTable[l] < 1.0)
+        {
+            large.pop_back();
+            small.push_back(l);
+        }
+    }
+
+    // Anything left over is 1 up to rounding error
+    for(size_t i = 0; i < large.size(); i++) mTable[large[i]] = 1.0;
+    for(size_t i = 0; i < small.size(); i++) mTable[small[i]] = 1.0;
+}
+
+////////////////////////////////////////////////////
+// Draw an outcome                                //
+////////////////////////////////////////////////////
+size_t ofxQuantumSampler::draw( double u1, double u2 ) const
+{
+    if(mTable.empty())
+        return 0;
+
+    if(mMethod == SAMPLE_ALIAS)
+    {
+        size_t slot = (size_t)(u1 * mTable.size());
+        if(slot >= mTable.size())
+            slot = mTable.size() - 1;
+
+        return u2 < mTable[slot] ? slot : mAlias[slot];
+    }
+
+    // First state whose cumulative probability is past the target
+    const double target = u1 * mTotal;
+    size_t       indx   = std::upper_bound(mTable.begin(), mTable.end(), target) - mTable.begin();
+
+    return indx > mLastNonZero ? mLastNonZero : indx;
+}
+
+////////////////////////////////////////////////////
+// Accessors                                      //
+////////////////////////////////////////////////////
+ofxQuantumSampler::Method ofxQuantumSampler::getMethod() const
+{
+    return mMethod;
+}
+
+size_t ofxQuantumSampler::size() const
+{
+    return mTable.size();
+}
+
+double ofxQuantumSampler::getTotal() const
+{
+    return mTotal;
+}
+
+// Tables for single and double precision registers
+template void ofxQuantumSampler::build<float>(  const float *,  const float *,  size_t, Method, ofxQuantumThreadPool * );
+template void ofxQuantumSampler::build<double>( const double *, const double *, size_t, Method, ofxQuantumThreadPool * );
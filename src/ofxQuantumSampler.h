@@ -0,0 +1,82 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSampler.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumSampler draws measurement outcomes from the probabilities of a quantum register without collapsing it. The
+//  table is built once, then every draw is either a binary search over the cumulative probabilities, O(log N), or a lookup
+//  in a Walker alias table, O(1). The alias table costs more to build so it is only worth it for a large number of shots.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMSAMPLER_H
+#define OFXQUANTUMSAMPLER_H
+
+// Includes
+#include <stddef.h>
+#include <vector>
+
+// Forward declarations
+class ofxQuantumThreadPool;
+
+class ofxQuantumSampler
+{
+public:
+
+    // How the table is built
+    enum Method
+    {
+        SAMPLE_AUTO = 0,        // Pick based on the number of shots
+        SAMPLE_PREFIX_SUM,      // Cumulative probabilities and binary search
+        SAMPLE_ALIAS            // Walker alias table
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor
+    ofxQuantumSampler();
+
+    // Build the table from single or double precision amplitude planes, the probabilities do not have to be normalised.
+    // The prefix sum is built in parallel on pool when it is not NULL
+    template<typename T>
+    void build( const T * real, const T * imag, size_t numStates, Method method, ofxQuantumThreadPool * pool = NULL );
+
+    // Pick a method for a number of shots
+    static Method chooseMethod( size_t numStates, size_t numShots );
+
+    // Draw an outcome from two uniform numbers in [0, 1), the prefix sum only uses u1
+    size_t draw( double u1, double u2 ) const;
+
+    // Method used to build the table
+    Method getMethod() const;
+
+    // Number of outcomes
+    size_t size() const;
+
+    // Sum of the probabilities the table was built from
+    double getTotal() const;
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    template<typename T> void buildPrefixSum( const T * real, const T * imag, size_t numStates, ofxQuantumThreadPool * pool );
+    template<typename T> void buildAlias(     const T * real, const T * imag, size_t numStates );
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    Method              mMethod;        // Table type
+    std::vector<double> mTable;         // Cumulative probabilities, or alias acceptance probabilities
+    std::vector<size_t> mAlias;         // Alias outcome for each slot
+    size_t              mLastNonZero;   // Last outcome with a non zero probability, guards against rounding at the top
+    double              mTotal;         // Sum of all probabilities
+};
+
+#endif
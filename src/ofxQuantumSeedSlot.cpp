@@ -0,0 +1,106 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSeedSlot.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumSeedSlot.h"
+
+#include <chrono>
+#include <thread>
+
+// Microseconds on a clock that never goes backwards
+static unsigned long long int nowMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+ofxQuantumSeedSlot::ofxQuantumSeedSlot()
+{
+    mSequence    = 0;
+    mSeed        = 0;
+    mTimeMicros  = 0;
+    mStartMicros = nowMicros();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Publish a seed. The sequence is made odd with a compare and swap so
+// two writers can never be inside at once, the data is written, then
+// the sequence is released as the next even number.
+////////////////////////////////////////////////////////////////////////
+void ofxQuantumSeedSlot::publish( unsigned long long int seed )
+{
+    unsigned long long int sequence = mSequence.load(std::memory_order_relaxed);
+    
+    while((sequence & 1) || !mSequence.compare_exchange_weak(sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed))
+    {
+        // Another writer is part way through, writes are rare so just give it the cpu
+        if(sequence & 1)
+        {
+            std::this_thread::yield();
+            sequence = mSequence.load(std::memory_order_relaxed);
+        }
+    }
+    
+    std::atomic_thread_fence(std::memory_order_release);
+    
+    mSeed.store(seed, std::memory_order_relaxed);
+    mTimeMicros.store(nowMicros() - mStartMicros, std::memory_order_relaxed);
+    
+    mSequence.store(sequence + 2, std::memory_order_release);
+}
+
+////////////////////////////////////////////////////
+// Read a consistent copy of the slot             //
+////////////////////////////////////////////////////
+void ofxQuantumSeedSlot::read( unsigned long long int & seed, unsigned long long int & generation, unsigned long long int & timeMicros ) const
+{
+    while(true)
+    {
+        const unsigned long long int before = mSequence.load(std::memory_order_acquire);
+        
+        if(before & 1)
+            continue;
+        
+        seed       = mSeed.load(std::memory_order_relaxed);
+        timeMicros = mTimeMicros.load(std::memory_order_relaxed);
+        
+        std::atomic_thread_fence(std::memory_order_acquire);
+        
+        if(mSequence.load(std::memory_order_relaxed) == before)
+        {
+            generation = before / 2;
+            return;
+        }
+    }
+}
+
+void ofxQuantumSeedSlot::read( unsigned long long int & seed, unsigned long long int & generation ) const
+{
+    unsigned long long int timeMicros;
+    read(seed, generation, timeMicros);
+}
+
+////////////////////////////////////////////////////
+// Latest seed                                    //
+////////////////////////////////////////////////////
+unsigned long long int ofxQuantumSeedSlot::getSeed() const
+{
+    unsigned long long int seed, generation;
+    read(seed, generation);
+    
+    return seed;
+}
+
+////////////////////////////////////////////////////
+// Current generation                             //
+////////////////////////////////////////////////////
+unsigned long long int ofxQuantumSeedSlot::getGeneration() const
+{
+    return mSequence.load(std::memory_order_acquire) / 2;
+}
@@ -0,0 +1,56 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSeedSlot.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumSeedSlot hands the latest seed from the Quantum Seed Processing Unit (QSPU) over to the threads that use it.
+//  It is a sequence lock: a writer makes the sequence number odd, writes the seed and the time it arrived, then makes it
+//  even again. Readers never block or take a lock, they copy the slot and retry if the sequence moved while they read.
+//  Half the sequence number is a generation that consumers can compare against to see if there is a new seed.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMSEEDSLOT_H
+#define OFXQUANTUMSEEDSLOT_H
+
+// Includes
+#include <atomic>
+
+class ofxQuantumSeedSlot
+{
+public:
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    // Constructor, the slot starts at generation 0 with a seed of 0
+    ofxQuantumSeedSlot();
+    
+    // Store a new seed and move to the next generation. Several threads can publish, they take turns
+    void publish( unsigned long long int seed );
+    
+    // Copy out a consistent seed, its generation and the time it was published in microseconds since the slot was made
+    void read( unsigned long long int & seed, unsigned long long int & generation, unsigned long long int & timeMicros ) const;
+    void read( unsigned long long int & seed, unsigned long long int & generation ) const;
+    
+    // Latest seed
+    unsigned long long int getSeed() const;
+    
+    // Number of seeds published so far, a single atomic load that is cheap enough to check before every random number
+    unsigned long long int getGeneration() const;
+    
+private:
+    
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+    
+    std::atomic<unsigned long long int> mSequence;      // Odd while a write is in progress, generation * 2 otherwise
+    std::atomic<unsigned long long int> mSeed;          // Seed of the current generation
+    std::atomic<unsigned long long int> mTimeMicros;    // When the current generation was published
+    unsigned long long int              mStartMicros;   // Clock at construction, times are relative to it
+};
+
+#endif
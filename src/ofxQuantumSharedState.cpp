@@ -0,0 +1,374 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSharedState.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumSharedState.h"
+#include "ofxQuantumRegister.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <new>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Alignment of the header and of every plane in the segment
+#define QUANTUM_SHARED_ALIGNMENT 4096
+
+////////////////////////////////////////////////////
+// Round a byte count up to a multiple of align   //
+////////////////////////////////////////////////////
+static uint64_t roundUp( uint64_t bytes, uint64_t align )
+{
+    return (bytes + align - 1) / align * align;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Segment layout, the header then each slot. A slot is three planes of
+// doubles, each starting on an aligned offset
+////////////////////////////////////////////////////////////////////////
+
+static uint64_t planeBytes( unsigned int numQubits )
+{
+    return roundUp((1ULL << numQubits) * sizeof(double), QUANTUM_SHARED_ALIGNMENT);
+}
+
+uint64_t ofxQuantumSharedState::slotOffset( unsigned int numQubits, int slot )
+{
+    return roundUp(sizeof(Header), QUANTUM_SHARED_ALIGNMENT) + (uint64_t)slot * 3 * planeBytes(numQubits);
+}
+
+size_t ofxQuantumSharedState::segmentBytes( unsigned int numQubits )
+{
+    return (size_t)slotOffset(numQubits, QUANTUM_SHARED_NUM_SLOTS);
+}
+
+////////////////////////////////////////////////////
+// Publisher                                      //
+////////////////////////////////////////////////////
+
+ofxQuantumStatePublisher::ofxQuantumStatePublisher()
+{
+    mHeader   = NULL;
+    mNumBytes = 0;
+}
+
+ofxQuantumStatePublisher::~ofxQuantumStatePublisher()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Create the segment. It is sized without writing it so both slots
+// start as zeros, and nothing is current until the first publish
+////////////////////////////////////////////////////////////////////////
+
+bool ofxQuantumStatePublisher::open( const std::string & name, unsigned int numQubits )
+{
+    close();
+
+    if(numQubits > QUANTUM_SHARED_MAX_QUBITS)
+    {
+        printf("ERROR! shared state is limited to %d qubits\n", QUANTUM_SHARED_MAX_QUBITS);
+        return false;
+    }
+
+    // Replace any segment left behind by a publisher that did not close
+    shm_unlink(name.c_str());
+
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+
+    if(fd < 0)
+    {
+        printf("ERROR! unable to create shared state %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+
+    const size_t numBytes = ofxQuantumSharedState::segmentBytes(numQubits);
+    void *       block    = MAP_FAILED;
+
+    if(ftruncate(fd, (off_t)numBytes) == 0)
+        block = mmap(NULL, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    if(block == MAP_FAILED)
+    {
+        printf("ERROR! unable to map shared state %s: %s\n", name.c_str(), strerror(errno));
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    ofxQuantumSharedState::Header * header = new (block) ofxQuantumSharedState::Header();
+
+    header->numQubits = numQubits;
+    header->numStates = 1ULL << numQubits;
+    header->generation.store(0);
+    header->current.store(0);
+
+    for(int s = 0; s < QUANTUM_SHARED_NUM_SLOTS; s++)
+    {
+        header->slotOffset[s] = ofxQuantumSharedState::slotOffset(numQubits, s);
+        header->sequence[s].store(0);
+        header->frameGeneration[s] = 0;
+        header->frameValue[s]      = -1;
+    }
+
+    // The tag goes last, a viewer opening the segment early sees no tag rather than a half written header
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, QUANTUM_SHARED_MAGIC, 8);
+
+    mHeader   = header;
+    mNumBytes = numBytes;
+    mName     = name;
+
+    return true;
+}
+
+void ofxQuantumStatePublisher::close()
+{
+    if(mHeader != NULL)
+    {
+        munmap(mHeader, mNumBytes);
+        shm_unlink(mName.c_str());
+    }
+
+    mHeader   = NULL;
+    mNumBytes = 0;
+    mName.clear();
+}
+
+bool ofxQuantumStatePublisher::isOpen() const
+{
+    return mHeader != NULL;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Write a frame into the slot that is not current. Its sequence count
+// is odd while the planes are written, then the slot becomes current
+// and the generation moves on. Amplitudes are written in state order,
+// so the qubit layout of the register is undone on the way.
+////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+unsigned long long int ofxQuantumStatePublisher::publish( ofxQuantumRegisterT<T> & reg, long long int value )
+{
+    if(mHeader == NULL || (uint64_t)reg.size() != mHeader->numQubits)
+    {
+        printf("ERROR! register does not match the shared state\n");
+        return 0;
+    }
+
+    // Apply any gates still waiting in a circuit first
+    reg.flushCircuit();
+
+    const int      slot      = 1 - (int)mHeader->current.load(std::memory_order_relaxed);
+    const uint64_t numStates = mHeader->numStates;
+    const uint64_t sequence  = mHeader->sequence[slot].load(std::memory_order_relaxed);
+
+    char *   base = (char *)mHeader + mHeader->slotOffset[slot];
+    double * re   = (double *)base;
+    double * im   = (double *)(base + planeBytes(mHeader->numQubits));
+    double * prob = (double *)(base + 2 * planeBytes(mHeader->numQubits));
+
+    mHeader->sequence[slot].store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    if(reg.mIsSparse)
+    {
+        memset(re, 0, numStates * sizeof(double));
+        memset(im, 0, numStates * sizeof(double));
+
+        const unsigned long long int * keys = reg.mSparse.keys();
+        const T *                      sRe  = reg.mSparse.real();
+        const T *                      sIm  = reg.mSparse.imag();
+
+        for(size_t s = 0; s < reg.mSparse.capacity(); s++)
+        {
+            if(keys[s] != QUANTUM_SPARSE_EMPTY)
+            {
+                const unsigned long long int indx = reg.logicalIndex(keys[s]);
+
+                re[indx] = sRe[s];
+                im[indx] = sIm[s];
+            }
+        }
+    }
+    else
+    {
+        const T *  sRe      = reg.mState.real();
+        const T *  sIm      = reg.mState.imag();
+        const bool permuted = reg.isPermuted();
+
+        for(uint64_t i = 0; i < numStates; i++)
+        {
+            const uint64_t s = permuted ? reg.storedIndex(i) : i;
+
+            re[i] = sRe[s];
+            im[i] = sIm[s];
+        }
+    }
+
+    for(uint64_t i = 0; i < numStates; i++)
+        prob[i] = re[i] * re[i] + im[i] * im[i];
+
+    const uint64_t generation = mHeader->generation.load(std::memory_order_relaxed) + 1;
+
+    mHeader->frameGeneration[slot] = generation;
+    mHeader->frameValue[slot]      = value;
+
+    mHeader->sequence[slot].store(sequence + 2, std::memory_order_release);
+    mHeader->current.store(slot, std::memory_order_release);
+    mHeader->generation.store(generation, std::memory_order_release);
+
+    return generation;
+}
+
+////////////////////////////////////////////////////
+// Viewer                                         //
+////////////////////////////////////////////////////
+
+ofxQuantumStateViewer::ofxQuantumStateViewer()
+{
+    mHeader   = NULL;
+    mNumBytes = 0;
+}
+
+ofxQuantumStateViewer::~ofxQuantumStateViewer()
+{
+    close();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Read the header first to learn the size, then map the whole segment
+////////////////////////////////////////////////////////////////////////
+
+bool ofxQuantumStateViewer::open( const std::string & name )
+{
+    close();
+
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+
+    if(fd < 0)
+    {
+        printf("ERROR! unable to open shared state %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+
+    ofxQuantumSharedState::Header header;
+    bool                          ok = pread(fd, &header, sizeof(header), 0) == (ssize_t)sizeof(header) &&
+                                       memcmp(header.magic, QUANTUM_SHARED_MAGIC, 8) == 0 &&
+                                       header.numQubits <= QUANTUM_SHARED_MAX_QUBITS;
+
+    if(!ok)
+    {
+        printf("ERROR! %s is not an ofxQuantum shared state\n", name.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    // Touching pages past the end of a short segment would raise SIGBUS, so check its size before mapping it
+    const size_t numBytes = ofxQuantumSharedState::segmentBytes(header.numQubits);
+    struct stat  info;
+
+    if(fstat(fd, &info) != 0 || (unsigned long long int)info.st_size < numBytes)
+    {
+        printf("ERROR! shared state %s is smaller than its header says\n", name.c_str());
+        ::close(fd);
+        return false;
+    }
+
+    void * block = mmap(NULL, numBytes, PROT_READ, MAP_SHARED, fd, 0);
+
+    ::close(fd);
+
+    if(block == MAP_FAILED)
+    {
+        printf("ERROR! unable to map shared state %s: %s\n", name.c_str(), strerror(errno));
+        return false;
+    }
+
+    mHeader   = (const ofxQuantumSharedState::Header *)block;
+    mNumBytes = numBytes;
+
+    return true;
+}
+
+void ofxQuantumStateViewer::close()
+{
+    if(mHeader != NULL)
+        munmap((void *)mHeader, mNumBytes);
+
+    mHeader   = NULL;
+    mNumBytes = 0;
+}
+
+bool ofxQuantumStateViewer::isOpen() const
+{
+    return mHeader != NULL;
+}
+
+unsigned int ofxQuantumStateViewer::getNumQubits() const
+{
+    return mHeader != NULL ? mHeader->numQubits : 0;
+}
+
+unsigned long long int ofxQuantumStateViewer::getGeneration() const
+{
+    return mHeader != NULL ? mHeader->generation.load(std::memory_order_acquire) : 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Take the current slot unless the publisher has already started
+// writing it again, in which case the other slot is now current
+////////////////////////////////////////////////////////////////////////
+
+bool ofxQuantumStateViewer::acquire( Frame & frame ) const
+{
+    if(mHeader == NULL || mHeader->generation.load(std::memory_order_acquire) == 0)
+        return false;
+
+    for(;;)
+    {
+        const int      slot     = (int)mHeader->current.load(std::memory_order_acquire);
+        const uint64_t sequence = mHeader->sequence[slot].load(std::memory_order_acquire);
+
+        if(sequence & 1)
+            continue;
+
+        const char * base = (const char *)mHeader + mHeader->slotOffset[slot];
+
+        frame.real       = (const double *)base;
+        frame.imag       = (const double *)(base + planeBytes(mHeader->numQubits));
+        frame.prob       = (const double *)(base + 2 * planeBytes(mHeader->numQubits));
+        frame.numStates  = mHeader->numStates;
+        frame.generation = mHeader->frameGeneration[slot];
+        frame.value      = mHeader->frameValue[slot];
+        frame.slot       = slot;
+        frame.sequence   = sequence;
+
+        // The generation and value are only good if the slot was not reused while they were read
+        if(isCurrent(frame))
+            return true;
+    }
+}
+
+bool ofxQuantumStateViewer::isCurrent( const Frame & frame ) const
+{
+    if(mHeader == NULL)
+        return false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    return mHeader->sequence[frame.slot].load(std::memory_order_relaxed) == frame.sequence;
+}
+
+// Registers that can be published
+template unsigned long long int ofxQuantumStatePublisher::publish<float>(  ofxQuantumRegisterT<float>  & reg, long long int value );
+template unsigned long long int ofxQuantumStatePublisher::publish<double>( ofxQuantumRegisterT<double> & reg, long long int value );
@@ -0,0 +1,181 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSharedState.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumSharedState lets another process watch a register without slowing the simulation down. A publisher creates a
+//  named POSIX shared memory segment and copies the register into it whenever publish is called. Viewers in other
+//  processes map the segment read only and use the amplitudes and probabilities in place, without copying them, each at
+//  its own frame rate.
+//
+//  The register itself stays in the publishing process and is copied into the segment on every publish. Keeping the live
+//  amplitudes in shared memory would let viewers skip that copy, but they would then see gates half applied, and the
+//  register could no longer go sparse, be stored in a file or change its qubit layout. One copy per published frame is
+//  cheap next to the gates applied between frames, so this is a deliberate departure from sharing the register directly.
+//
+//  The segment holds a header and two frame slots. publish writes into the slot viewers are not pointed at, then makes it
+//  the current slot and bumps the generation, so a viewer normally sees a complete frame while the next one is being
+//  written. Each slot has a sequence count that is odd while it is written. A viewer notes the count when it takes a frame
+//  and checks it again when it is done with it, if the publisher has got around to the same slot again in between the
+//  frame was overwritten and should be taken again.
+//
+//  Offset 0             Header
+//  slotOffset[s]        numStates real parts, numStates imaginary parts, numStates probabilities, all double
+//
+//  Simulating process:
+//  ofxQuantumStatePublisher publisher;
+//  publisher.open("/ofxQuantumState", quantumReg->size());
+//  publisher.publish(*quantumReg, quantumReg->measureBit(0));
+//
+//  Rendering process:
+//  ofxQuantumStateViewer viewer;
+//  ofxQuantumStateViewer::Frame frame;
+//  if(viewer.open("/ofxQuantumState") && viewer.acquire(frame))
+//      drawProbabilities(frame.prob, frame.numStates);
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMSHAREDSTATE_H
+#define OFXQUANTUMSHAREDSTATE_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+// Forward declarations
+template<typename T> class ofxQuantumRegisterT;
+
+// Eight byte tag at the start of every segment
+#define QUANTUM_SHARED_MAGIC      "OFXQSHM1"
+
+// Largest register that can be published, every frame holds each state
+#define QUANTUM_SHARED_MAX_QUBITS 24
+
+// Number of frame slots, one being read while the other is written
+#define QUANTUM_SHARED_NUM_SLOTS  2
+
+class ofxQuantumSharedState
+{
+public:
+
+    // Start of the segment
+    struct Header
+    {
+        char                  magic[8];                              // QUANTUM_SHARED_MAGIC, not null terminated
+        uint32_t              numQubits;                             // Qubits in the published register
+        uint32_t              reserved0;
+        uint64_t              numStates;                             // States in each frame, 2 ^ numQubits
+        uint64_t              slotOffset[QUANTUM_SHARED_NUM_SLOTS];  // Offset of each frame slot
+        std::atomic<uint64_t> generation;                            // Frames published so far
+        std::atomic<uint32_t> current;                               // Slot holding the newest complete frame
+        uint32_t              reserved1;
+        std::atomic<uint64_t> sequence[QUANTUM_SHARED_NUM_SLOTS];    // Odd while a slot is being written
+        uint64_t              frameGeneration[QUANTUM_SHARED_NUM_SLOTS]; // Generation of the frame in each slot
+        int64_t               frameValue[QUANTUM_SHARED_NUM_SLOTS];  // Value published with each frame
+    };
+
+    // The header is shared between processes, which only works when its atomics need no lock
+    static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+                  "shared state needs lock free 32 and 64 bit atomics");
+
+    // Bytes of the whole segment for a register of numQubits
+    static size_t segmentBytes( unsigned int numQubits );
+
+    // Offset of a frame slot
+    static uint64_t slotOffset( unsigned int numQubits, int slot );
+};
+
+class ofxQuantumStatePublisher
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantumStatePublisher();
+    ~ofxQuantumStatePublisher();
+
+    // Create the segment for a register of numQubits. name is a POSIX shared memory name such as "/ofxQuantumState", any
+    // segment already using it is replaced. The name is removed again by close
+    bool open( const std::string & name, unsigned int numQubits );
+    void close();
+
+    bool isOpen() const;
+
+    // Copy the amplitudes and probabilities of a register, in state order, into the free slot and make it the newest
+    // frame. value is handed to viewers with the frame, for example the last measurement. Returns the new generation,
+    // or 0 if the register does not match the segment
+    template<typename T>
+    unsigned long long int publish( ofxQuantumRegisterT<T> & reg, long long int value = -1 );
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantumSharedState::Header * mHeader;    // Start of the mapped segment
+    size_t                          mNumBytes;  // Size of the mapping
+    std::string                     mName;      // Shared memory name, removed on close
+};
+
+class ofxQuantumStateViewer
+{
+public:
+
+    // A frame seen in place in the segment, valid until the viewer is closed. The publisher may reuse the slot while it
+    // is being read, check isCurrent afterwards to know the values read were all from this frame
+    struct Frame
+    {
+        Frame() : real(NULL), imag(NULL), prob(NULL), numStates(0), generation(0), value(-1), slot(0), sequence(0) {}
+
+        const double *         real;        // Real part of each amplitude
+        const double *         imag;        // Imaginary part of each amplitude
+        const double *         prob;        // Chance of measuring each state
+        unsigned long long int numStates;   // Number of states
+        unsigned long long int generation;  // Frames the publisher had published when this one was
+        long long int          value;       // Value published with the frame
+        int                    slot;        // Slot of the frame
+        uint64_t               sequence;    // Sequence count of the slot when the frame was taken
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantumStateViewer();
+    ~ofxQuantumStateViewer();
+
+    // Map a segment made by an ofxQuantumStatePublisher, read only
+    bool open( const std::string & name );
+    void close();
+
+    bool isOpen() const;
+
+    // Number of qubits of the published register
+    unsigned int getNumQubits() const;
+
+    // Frames published so far, a viewer can skip a redraw while it has not changed
+    unsigned long long int getGeneration() const;
+
+    // Point frame at the newest complete frame. Returns false if nothing has been published yet
+    bool acquire( Frame & frame ) const;
+
+    // Whether the slot of a frame still holds it, so everything read from it since acquire was consistent
+    bool isCurrent( const Frame & frame ) const;
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    const ofxQuantumSharedState::Header * mHeader;    // Start of the mapped segment
+    size_t                                mNumBytes;  // Size of the mapping
+};
+
+#endif
@@ -0,0 +1,281 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSnapshot.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumSnapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// Largest single write, some systems fail writes of 2 GB or more
+#define QUANTUM_SNAPSHOT_MAX_WRITE (1 << 30)
+
+////////////////////////////////////////////////////
+// Write bytes at an offset, retrying short writes //
+////////////////////////////////////////////////////
+static bool writeAll( int fd, const void * data, size_t bytes, unsigned long long int offset )
+{
+    const char * p = (const char *)data;
+
+    while(bytes > 0)
+    {
+        const size_t  chunk   = bytes < QUANTUM_SNAPSHOT_MAX_WRITE ? bytes : QUANTUM_SNAPSHOT_MAX_WRITE;
+        const ssize_t written = pwrite(fd, p, chunk, (off_t)offset);
+
+        if(written < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        p      += written;
+        bytes  -= written;
+        offset += written;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////
+// Round an offset up to the file alignment       //
+////////////////////////////////////////////////////
+unsigned long long int ofxQuantumSnapshot::align( unsigned long long int offset )
+{
+    return (offset + QUANTUM_SNAPSHOT_ALIGNMENT - 1) / QUANTUM_SNAPSHOT_ALIGNMENT * QUANTUM_SNAPSHOT_ALIGNMENT;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Write a snapshot to a temporary file beside path and rename it over
+// path once every plane is down. A register mapped from the old file
+// keeps its own pages, the old inode lives on until it is unmapped
+////////////////////////////////////////////////////////////////////////
+bool ofxQuantumSnapshot::write( const std::string & path, unsigned int numQubits, unsigned int precision, Layout layout,
+                                unsigned long long int count, const unsigned long long int * indices, const void * real, const void * imag )
+{
+    if(precision != 4 && precision != 8)
+    {
+        printf("ERROR! snapshots hold 4 or 8 byte amplitudes, not %u\n", precision);
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, QUANTUM_SNAPSHOT_MAGIC, 8);
+
+    header.version     = QUANTUM_SNAPSHOT_VERSION;
+    header.headerBytes = QUANTUM_SNAPSHOT_ALIGNMENT;
+    header.byteOrder   = QUANTUM_SNAPSHOT_BYTE_ORDER;
+    header.numQubits   = numQubits;
+    header.precision   = precision;
+    header.layout      = layout;
+    header.count       = count;
+
+    unsigned long long int offset = QUANTUM_SNAPSHOT_ALIGNMENT;
+
+    if(layout == LAYOUT_SPARSE)
+    {
+        header.indexOffset = offset;
+        offset = align(offset + count * sizeof(unsigned long long int));
+    }
+
+    header.realOffset = offset;
+    header.imagOffset = align(offset + count * precision);
+
+    const unsigned long long int fileBytes = header.imagOffset + count * precision;
+    const std::string            tempPath  = path + ".tmp";
+
+    int fd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if(fd < 0)
+    {
+        printf("ERROR! unable to create snapshot %s: %s\n", tempPath.c_str(), strerror(errno));
+        return false;
+    }
+
+    // Size the file first, the gaps between planes read back as zero
+    bool ok = ftruncate(fd, (off_t)fileBytes) == 0;
+
+    ok = ok && writeAll(fd, &header, sizeof(header), 0);
+
+    if(layout == LAYOUT_SPARSE && count > 0)
+        ok = ok && writeAll(fd, indices, count * sizeof(unsigned long long int), header.indexOffset);
+
+    if(count > 0)
+    {
+        ok = ok && writeAll(fd, real, count * precision, header.realOffset);
+        ok = ok && writeAll(fd, imag, count * precision, header.imagOffset);
+    }
+
+    if(!ok)
+    {
+        printf("ERROR! unable to write snapshot %s: %s\n", tempPath.c_str(), strerror(errno));
+        close(fd);
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    close(fd);
+
+    if(rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        printf("ERROR! unable to rename snapshot to %s: %s\n", path.c_str(), strerror(errno));
+        unlink(tempPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Whether count values of bytesEach starting at offset end inside the
+// file, worked out without overflowing on a corrupt header
+////////////////////////////////////////////////////////////////////////
+static bool planeFits( unsigned long long int offset, unsigned long long int count, unsigned long long int bytesEach,
+                       unsigned long long int fileBytes )
+{
+    return offset <= fileBytes && count <= (fileBytes - offset) / bytesEach;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Read the index plane of a sparse snapshot a block at a time and check
+// every index is a state of the register and comes after the last one,
+// the readers write amplitudes at these indices without checking them
+////////////////////////////////////////////////////////////////////////
+static bool indicesValid( int fd, const ofxQuantumSnapshot::Header & header )
+{
+    const size_t                        blockCount = 8192;
+    std::vector<unsigned long long int> block(blockCount);
+    const unsigned long long int        numStates  = 1ULL << header.numQubits;
+    unsigned long long int              previous   = 0;
+
+    for(unsigned long long int first = 0; first < header.count; first += blockCount)
+    {
+        const size_t  num   = (size_t)std::min(header.count - first, (unsigned long long int)blockCount);
+        const size_t  bytes = num * sizeof(unsigned long long int);
+        const off_t   at    = (off_t)(header.indexOffset + first * sizeof(unsigned long long int));
+
+        if(pread(fd, &block[0], bytes, at) != (ssize_t)bytes)
+            return false;
+
+        for(size_t i = 0; i < num; i++)
+        {
+            if(block[i] >= numStates || (first + i > 0 && block[i] <= previous))
+                return false;
+
+            previous = block[i];
+        }
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////
+// Open a snapshot and check the header           //
+////////////////////////////////////////////////////
+int ofxQuantumSnapshot::open( const std::string & path, Header & header )
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+
+    if(fd < 0)
+    {
+        printf("ERROR! unable to open snapshot %s: %s\n", path.c_str(), strerror(errno));
+        return -1;
+    }
+
+    const char * problem = NULL;
+
+    if(pread(fd, &header, sizeof(header), 0) != (ssize_t)sizeof(header))
+        problem = "file is too short";
+    else if(memcmp(header.magic, QUANTUM_SNAPSHOT_MAGIC, 8) != 0)
+        problem = "not a quantum snapshot";
+    else if(header.byteOrder != QUANTUM_SNAPSHOT_BYTE_ORDER)
+        problem = "written with a different byte order";
+    else if(header.version > QUANTUM_SNAPSHOT_VERSION)
+        problem = "written by a newer version";
+    else if(header.precision != 4 && header.precision != 8)
+        problem = "unknown precision";
+    else if(header.layout != LAYOUT_DENSE && header.layout != LAYOUT_SPARSE)
+        problem = "unknown layout";
+    else if(header.numQubits > 63 || header.count > (1ULL << header.numQubits) ||
+            (header.layout == LAYOUT_DENSE && header.count != (1ULL << header.numQubits)))
+        problem = "number of states does not match the qubits";
+    else if(header.realOffset % QUANTUM_SNAPSHOT_ALIGNMENT != 0 || header.imagOffset % QUANTUM_SNAPSHOT_ALIGNMENT != 0 ||
+            (header.layout == LAYOUT_SPARSE && header.indexOffset % QUANTUM_SNAPSHOT_ALIGNMENT != 0))
+        problem = "planes are not aligned";
+
+    if(problem == NULL)
+    {
+        const off_t fileBytes = lseek(fd, 0, SEEK_END);
+
+        if(fileBytes < 0 ||
+           !planeFits(header.realOffset, header.count, header.precision, fileBytes) ||
+           !planeFits(header.imagOffset, header.count, header.precision, fileBytes) ||
+           (header.layout == LAYOUT_SPARSE && !planeFits(header.indexOffset, header.count, sizeof(unsigned long long int), fileBytes)))
+            problem = "file is truncated";
+    }
+
+    if(problem == NULL && header.layout == LAYOUT_SPARSE && !indicesValid(fd, header))
+        problem = "state indices are out of range or out of order";
+
+    if(problem != NULL)
+    {
+        printf("ERROR! snapshot %s: %s\n", path.c_str(), problem);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Map a byte range read only. mmap offsets must be page aligned so the
+// mapping starts at the page holding offset and data points into it
+////////////////////////////////////////////////////////////////////////
+bool ofxQuantumSnapshot::map( int fd, unsigned long long int offset, size_t bytes, Mapping & mapping )
+{
+    const unsigned long long int pageSize = (unsigned long long int)sysconf(_SC_PAGESIZE);
+    const unsigned long long int start    = offset / pageSize * pageSize;
+
+    mapping.base   = NULL;
+    mapping.length = (size_t)(offset - start) + bytes;
+    mapping.data   = NULL;
+
+    if(bytes == 0)
+        return true;
+
+    void * block = mmap(NULL, mapping.length, PROT_READ, MAP_PRIVATE, fd, (off_t)start);
+
+    if(block == MAP_FAILED)
+    {
+        printf("ERROR! unable to map snapshot: %s\n", strerror(errno));
+        mapping.length = 0;
+        return false;
+    }
+
+    mapping.base = block;
+    mapping.data = (char *)block + (offset - start);
+
+    return true;
+}
+
+void ofxQuantumSnapshot::unmap( Mapping & mapping )
+{
+    if(mapping.base != NULL)
+        munmap(mapping.base, mapping.length);
+
+    mapping.base   = NULL;
+    mapping.length = 0;
+    mapping.data   = NULL;
+}
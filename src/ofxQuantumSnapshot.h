@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSnapshot.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumSnapshot is the binary file format registers are saved to and loaded from. A snapshot is a header padded to
+//  QUANTUM_SNAPSHOT_ALIGNMENT bytes followed by the raw amplitude planes exactly as they are held in memory, the real plane
+//  then the imaginary plane, each starting on an aligned offset. A sparse register also stores a plane of state indices in
+//  front of them. The alignment is a multiple of every common page size, so a dense plane can be mapped straight into a
+//  register with mmap instead of being read, see ofxQuantumRegister::load.
+//
+//  The header records the version, the number of qubits, the precision and the layout. Readers reject a newer version or
+//  a byte order other than their own, and a newer writer only ever adds fields in the reserved space.
+//
+//  Offset 0        header, QUANTUM_SNAPSHOT_ALIGNMENT bytes
+//  indexOffset     sparse only, count unsigned 64 bit state indices in increasing order
+//  realOffset      count real parts, 4 or 8 bytes each
+//  imagOffset      count imaginary parts
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMSNAPSHOT_H
+#define OFXQUANTUMSNAPSHOT_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Eight byte tag at the start of every snapshot
+#define QUANTUM_SNAPSHOT_MAGIC      "OFXQSNAP"
+
+// Current version of the format
+#define QUANTUM_SNAPSHOT_VERSION    1
+
+// Alignment of the header and every plane in the file, 64 KB covers 4 KB, 16 KB and 64 KB pages
+#define QUANTUM_SNAPSHOT_ALIGNMENT  65536
+
+// Written as a native 64 bit value so a reader can tell the byte order of the file
+#define QUANTUM_SNAPSHOT_BYTE_ORDER 0x0102030405060708ULL
+
+class ofxQuantumSnapshot
+{
+public:
+
+    // How the amplitudes are stored
+    enum Layout
+    {
+        LAYOUT_DENSE = 0,       // Every amplitude, in state order
+        LAYOUT_SPARSE           // Only the stored amplitudes, with an index plane
+    };
+
+    // Start of the file, the rest of the first QUANTUM_SNAPSHOT_ALIGNMENT bytes are zero
+    struct Header
+    {
+        char     magic[8];      // QUANTUM_SNAPSHOT_MAGIC, not null terminated
+        uint32_t version;       // QUANTUM_SNAPSHOT_VERSION of the writer
+        uint32_t headerBytes;   // Bytes before the first plane
+        uint64_t byteOrder;     // QUANTUM_SNAPSHOT_BYTE_ORDER as written
+        uint32_t numQubits;     // Qubits in the register
+        uint32_t precision;     // Bytes in each real number, 4 for float and 8 for double
+        uint32_t layout;        // Layout
+        uint32_t reserved0;
+        uint64_t count;         // Amplitudes stored, 2 ^ numQubits when dense
+        uint64_t indexOffset;   // Offset of the index plane, 0 when dense
+        uint64_t realOffset;    // Offset of the real plane
+        uint64_t imagOffset;    // Offset of the imaginary plane
+        uint64_t reserved[8];
+    };
+
+    // A read only view of part of a snapshot
+    struct Mapping
+    {
+        Mapping() : base(NULL), length(0), data(NULL) {}
+
+        void * base;            // Start of the mapped pages
+        size_t length;          // Bytes mapped
+        char * data;            // First byte asked for, inside the mapped pages
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Write a snapshot. real and imag hold count values of precision bytes, indices holds count state indices for the
+    // sparse layout and is ignored for the dense one. The file is written beside path and renamed over it at the end, so
+    // a failed save leaves any previous snapshot, and registers mapped from it, untouched
+    static bool write( const std::string & path, unsigned int numQubits, unsigned int precision, Layout layout,
+                       unsigned long long int count, const unsigned long long int * indices, const void * real, const void * imag );
+
+    // Open a snapshot and check its header, the plane sizes and the index plane of a sparse one. Returns the file
+    // descriptor or -1 after printing the problem
+    static int  open( const std::string & path, Header & header );
+
+    // Map bytes [offset, offset + bytes) of an open snapshot read only, the range does not have to be page aligned
+    static bool map( int fd, unsigned long long int offset, size_t bytes, Mapping & mapping );
+    static void unmap( Mapping & mapping );
+
+    // Offset of the next aligned boundary
+    static unsigned long long int align( unsigned long long int offset );
+};
+
+#endif
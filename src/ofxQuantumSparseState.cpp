@@ -0,0 +1,350 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSparseState.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumSparseState.h"
+
+#include <limits>
+
+// Mix the bits of a state index so neighbouring states spread over the table
+static inline size_t hashIndex( unsigned long long int indx )
+{
+    indx ^= indx >> 33;
+    indx *= 0xFF51AFD7ED558CCDULL;
+    indx ^= indx >> 33;
+
+    return (size_t)indx;
+}
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+template<typename T>
+ofxQuantumSparseStateT<T>::ofxQuantumSparseStateT()
+{
+    clear();
+}
+
+////////////////////////////////////////////////////////////////////////
+// Empty the table. It is sized so numEntries fill at most half of it,
+// linear probing stays short at that load.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::clear( size_t numEntries )
+{
+    size_t capacity = QUANTUM_SPARSE_MIN_CAPACITY;
+    while(capacity < numEntries * 2)
+        capacity *= 2;
+
+    mKeys.assign(capacity, QUANTUM_SPARSE_EMPTY);
+    mReal.assign(capacity, 0);
+    mImag.assign(capacity, 0);
+    mSize = 0;
+}
+
+////////////////////////////////////////////////////
+// Probe for a state                              //
+////////////////////////////////////////////////////
+template<typename T>
+size_t ofxQuantumSparseStateT<T>::findSlot( unsigned long long int indx ) const
+{
+    const size_t mask = mKeys.size() - 1;
+    size_t       slot = hashIndex(indx) & mask;
+
+    while(mKeys[slot] != indx && mKeys[slot] != QUANTUM_SPARSE_EMPTY)
+        slot = (slot + 1) & mask;
+
+    return slot;
+}
+
+////////////////////////////////////////////////////
+// Get an amplitude                               //
+////////////////////////////////////////////////////
+template<typename T>
+Complex ofxQuantumSparseStateT<T>::get( unsigned long long int indx ) const
+{
+    const size_t slot = findSlot(indx);
+
+    return Complex(mReal[slot], mImag[slot]);
+}
+
+template<typename T>
+bool ofxQuantumSparseStateT<T>::find( unsigned long long int indx, double & real, double & imag ) const
+{
+    const size_t slot = findSlot(indx);
+
+    real = mReal[slot];
+    imag = mImag[slot];
+
+    return mKeys[slot] != QUANTUM_SPARSE_EMPTY;
+}
+
+////////////////////////////////////////////////////
+// Set an amplitude                               //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::set( unsigned long long int indx, double real, double imag )
+{
+    size_t slot = findSlot(indx);
+
+    if(mKeys[slot] == QUANTUM_SPARSE_EMPTY)
+    {
+        if((mSize + 1) * 2 > mKeys.size())
+        {
+            grow();
+            slot = findSlot(indx);
+        }
+
+        mKeys[slot] = indx;
+        mSize++;
+    }
+
+    mReal[slot] = (T)real;
+    mImag[slot] = (T)imag;
+}
+
+template<typename T>
+void ofxQuantumSparseStateT<T>::setIfNonZero( unsigned long long int indx, double real, double imag )
+{
+    if(real * real + imag * imag > pruneThreshold())
+        set(indx, real, imag);
+}
+
+////////////////////////////////////////////////////
+// Grow the table                                 //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::grow()
+{
+    ofxQuantumSparseStateT<T> bigger;
+    bigger.clear(mKeys.size());
+
+    for(size_t s = 0; s < mKeys.size(); s++)
+    {
+        if(mKeys[s] != QUANTUM_SPARSE_EMPTY)
+            bigger.set(mKeys[s], mReal[s], mImag[s]);
+    }
+
+    swap(bigger);
+}
+
+////////////////////////////////////////////////////
+// Swap with another table                        //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::swap( ofxQuantumSparseStateT & other )
+{
+    mKeys.swap(other.mKeys);
+    mReal.swap(other.mReal);
+    mImag.swap(other.mImag);
+    std::swap(mSize, other.mSize);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Amplitudes smaller than a few units of rounding error are what is
+// left when two paths cancel, keeping them would fill the table up.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+double ofxQuantumSparseStateT<T>::pruneThreshold()
+{
+    const double epsilon = 4.0 * std::numeric_limits<T>::epsilon();
+
+    return epsilon * epsilon;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Apply a 2x2 matrix. Each pair of states is visited once, from its 0
+// state, or from its 1 state when the 0 state is not stored. The result
+// goes into a new table so nothing has to be deleted in place.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::applyGate( unsigned long long int mask, unsigned long long int controlMask, unsigned long long int controlBits,
+                                           const ofxQuantumGateMatrix & m )
+{
+    ofxQuantumSparseStateT<T> result;
+    result.clear(mSize * 2);
+
+    for(size_t s = 0; s < mKeys.size(); s++)
+    {
+        const unsigned long long int indx = mKeys[s];
+
+        if(indx == QUANTUM_SPARSE_EMPTY)
+            continue;
+
+        if((indx & controlMask) != controlBits)
+        {
+            result.set(indx, mReal[s], mImag[s]);
+            continue;
+        }
+
+        double a0r = 0, a0i = 0, a1r = 0, a1i = 0;
+
+        if(indx & mask)
+        {
+            if(find(indx & ~mask, a0r, a0i))
+                continue;
+
+            a1r = mReal[s];
+            a1i = mImag[s];
+        }
+        else
+        {
+            a0r = mReal[s];
+            a0i = mImag[s];
+            find(indx | mask, a1r, a1i);
+        }
+
+        result.setIfNonZero(indx & ~mask, m.re[0] * a0r - m.im[0] * a0i + m.re[1] * a1r - m.im[1] * a1i,
+                                          m.re[0] * a0i + m.im[0] * a0r + m.re[1] * a1i + m.im[1] * a1r);
+        result.setIfNonZero(indx |  mask, m.re[2] * a0r - m.im[2] * a0i + m.re[3] * a1r - m.im[3] * a1i,
+                                          m.re[2] * a0i + m.im[2] * a0r + m.re[3] * a1i + m.im[3] * a1r);
+    }
+
+    swap(result);
+}
+
+////////////////////////////////////////////////////
+// Flip the target bit of the matching states     //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::applyPermutation( unsigned long long int mask, unsigned long long int controlMask, unsigned long long int controlBits )
+{
+    ofxQuantumSparseStateT<T> result;
+    result.clear(mSize);
+
+    for(size_t s = 0; s < mKeys.size(); s++)
+    {
+        const unsigned long long int indx = mKeys[s];
+
+        if(indx == QUANTUM_SPARSE_EMPTY)
+            continue;
+
+        result.set((indx & controlMask) == controlBits ? indx ^ mask : indx, mReal[s], mImag[s]);
+    }
+
+    swap(result);
+}
+
+////////////////////////////////////////////////////
+// Multiply the matching states by their phase    //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::applyDiagonal( unsigned long long int mask, unsigned long long int controlMask, unsigned long long int controlBits,
+                                               double phase0Re, double phase0Im, double phase1Re, double phase1Im )
+{
+    for(size_t s = 0; s < mKeys.size(); s++)
+    {
+        const unsigned long long int indx = mKeys[s];
+
+        if(indx == QUANTUM_SPARSE_EMPTY || (indx & controlMask) != controlBits)
+            continue;
+
+        const double pr = (indx & mask) ? phase1Re : phase0Re;
+        const double pi = (indx & mask) ? phase1Im : phase0Im;
+        const double ar = mReal[s];
+        const double ai = mImag[s];
+
+        mReal[s] = (T)(pr * ar - pi * ai);
+        mImag[s] = (T)(pr * ai + pi * ar);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Apply a dense matrix to groups of 2^k states. A group is handled from
+// the first of its states that is stored, every other member skips it.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::applyMultiQubitGate( unsigned long long int fixedMask, const std::vector<size_t> & offsets,
+                                                     const std::vector<double> & matrixRe, const std::vector<double> & matrixIm )
+{
+    const size_t dim = offsets.size();
+
+    ofxQuantumSparseStateT<T> result;
+    result.clear(mSize * 2);
+
+    std::vector<double> vRe(dim), vIm(dim);
+
+    for(size_t s = 0; s < mKeys.size(); s++)
+    {
+        const unsigned long long int indx = mKeys[s];
+
+        if(indx == QUANTUM_SPARSE_EMPTY)
+            continue;
+
+        const unsigned long long int base   = indx & ~fixedMask;
+        size_t                       leader = dim;
+
+        for(size_t l = 0; l < dim; l++)
+        {
+            if(find(base | offsets[l], vRe[l], vIm[l]) && leader == dim)
+                leader = l;
+        }
+
+        if((base | offsets[leader]) != indx)
+            continue;
+
+        for(size_t r = 0; r < dim; r++)
+        {
+            const double * rowRe = &matrixRe[r * dim];
+            const double * rowIm = &matrixIm[r * dim];
+            double         sumRe = 0.0;
+            double         sumIm = 0.0;
+
+            for(size_t c = 0; c < dim; c++)
+            {
+                sumRe += rowRe[c] * vRe[c] - rowIm[c] * vIm[c];
+                sumIm += rowRe[c] * vIm[c] + rowIm[c] * vRe[c];
+            }
+
+            result.setIfNonZero(base | offsets[r], sumRe, sumIm);
+        }
+    }
+
+    swap(result);
+}
+
+////////////////////////////////////////////////////
+// Sum of squares over the slot planes            //
+////////////////////////////////////////////////////
+template<typename T>
+double ofxQuantumSparseStateT<T>::sumSquares() const
+{
+    return ofxQuantumKernels::sumSquares(&mReal[0], &mImag[0], mKeys.size());
+}
+
+////////////////////////////////////////////////////
+// Scale the slot planes                          //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::scale( double factor )
+{
+    ofxQuantumKernels::scale(&mReal[0], &mImag[0], mKeys.size(), factor);
+}
+
+////////////////////////////////////////////////////
+// Keep the states that match a pattern           //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumSparseStateT<T>::collapse( unsigned long long int mask, unsigned long long int pattern, double factor )
+{
+    ofxQuantumSparseStateT<T> result;
+    result.clear(mSize);
+
+    for(size_t s = 0; s < mKeys.size(); s++)
+    {
+        const unsigned long long int indx = mKeys[s];
+
+        if(indx != QUANTUM_SPARSE_EMPTY && (indx & mask) == pattern)
+            result.set(indx, mReal[s] * factor, mImag[s] * factor);
+    }
+
+    swap(result);
+}
+
+// Sparse states for single and double precision registers
+template class ofxQuantumSparseStateT<float>;
+template class ofxQuantumSparseStateT<double>;
@@ -0,0 +1,117 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumSparseState.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumSparseState holds only the non zero amplitudes of a quantum register, in an open addressing hash table from
+//  state index to amplitude. Circuits made mostly of X, CNOT and Toffoli gates, or with only a few Hadamards, touch a handful
+//  of states, so gates here cost time in proportion to the number of stored amplitudes rather than 2^n. Like the dense
+//  buffer the amplitudes are kept in separate real and imaginary planes, free slots hold 0 so whole planes can be summed,
+//  scaled and sampled without looking at the keys.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMSPARSESTATE_H
+#define OFXQUANTUMSPARSESTATE_H
+
+// Includes
+#include <stddef.h>
+#include <vector>
+#include "Complex.h"
+#include "ofxQuantumKernels.h"
+
+// Key of a free slot, registers have at most 63 qubits so no state index reaches it
+#define QUANTUM_SPARSE_EMPTY        (~0ULL)
+
+// Smallest table, always a power of two
+#define QUANTUM_SPARSE_MIN_CAPACITY 16
+
+template<typename T>
+class ofxQuantumSparseStateT
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, an empty table
+    ofxQuantumSparseStateT();
+
+    // Remove every amplitude, keeping room for numEntries without growing
+    void clear( size_t numEntries = 0 );
+
+    // Amplitude of a state, 0 when it is not stored
+    Complex get( unsigned long long int indx ) const;
+
+    // Look up a state, false when it is not stored
+    bool    find( unsigned long long int indx, double & real, double & imag ) const;
+
+    // Store an amplitude, replacing any previous value
+    void    set( unsigned long long int indx, double real, double imag );
+
+    // Swap contents with another table
+    void    swap( ofxQuantumSparseStateT & other );
+
+    // Number of stored amplitudes and number of slots
+    size_t  size()     const { return mSize; }
+    size_t  capacity() const { return mKeys.size(); }
+
+    // Slot planes, a slot is free when its key is QUANTUM_SPARSE_EMPTY and its amplitude is then 0
+    const unsigned long long int * keys() const { return &mKeys[0]; }
+    const T *                      real() const { return &mReal[0]; }
+    const T *                      imag() const { return &mImag[0]; }
+
+    // Gates only change the states where (indx & controlMask) == controlBits, amplitudes that cancel down to rounding
+    // noise are dropped from the table. mask is the index bit of the target qubit
+    void applyGate(           unsigned long long int mask, unsigned long long int controlMask, unsigned long long int controlBits,
+                              const ofxQuantumGateMatrix & m );
+    void applyPermutation(    unsigned long long int mask, unsigned long long int controlMask, unsigned long long int controlBits );
+    void applyDiagonal(       unsigned long long int mask, unsigned long long int controlMask, unsigned long long int controlBits,
+                              double phase0Re, double phase0Im, double phase1Re, double phase1Im );
+
+    // Dense 2^k x 2^k matrix over the qubits in fixedMask, offsets[l] is the index bits of local state l
+    void applyMultiQubitGate( unsigned long long int fixedMask, const std::vector<size_t> & offsets,
+                              const std::vector<double> & matrixRe, const std::vector<double> & matrixIm );
+
+    // Sum of |a|^2 over every stored amplitude
+    double sumSquares() const;
+
+    // Multiply every amplitude by a real factor
+    void   scale( double factor );
+
+    // Keep the states where (indx & mask) == pattern, multiplied by factor, and drop the rest
+    void   collapse( unsigned long long int mask, unsigned long long int pattern, double factor );
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Slot holding indx, or the free slot where it would go
+    size_t findSlot( unsigned long long int indx ) const;
+
+    // Store an amplitude unless it is rounding noise
+    void   setIfNonZero( unsigned long long int indx, double real, double imag );
+
+    // Double the number of slots and reinsert everything
+    void   grow();
+
+    // |a|^2 at or below this is treated as zero
+    static double pruneThreshold();
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    std::vector<unsigned long long int> mKeys;      // State index in each slot
+    std::vector<T>                      mReal;      // Real part in each slot
+    std::vector<T>                      mImag;      // Imaginary part in each slot
+    size_t                              mSize;      // Slots in use, kept at most half of the capacity
+};
+
+typedef ofxQuantumSparseStateT<double> ofxQuantumSparseState;
+
+#endif
@@ -0,0 +1,850 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumStabilizerRegister.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumStabilizerRegister.h"
+#include "ofxQuantumRegister.h"
+#include "ofxQuantum.h"
+
+#include <iostream>
+
+using namespace std;
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+
+ofxQuantumStabilizerRegister::ofxQuantumStabilizerRegister( unsigned long long int size, ofxQuantum *quantumSim )
+{
+    mQuantumSim     = quantumSim;
+    mRegSize        = size;
+    mNumWords       = (size_t)((size + 63) / 64);
+    mConvertToDense = false;
+    mRegister       = NULL;
+
+    // 2n rows and a scratch row, each an X plane then a Z plane
+    mTable.assign((2 * mRegSize + 1) * 2 * mNumWords, 0);
+    mPhase.assign(2 * mRegSize + 1, 0);
+
+    // |0...0> is stabilized by Z on every qubit, the destabilizers are X on every qubit
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+    {
+        row(q)[q >> 6]                          |= bitOf(q);
+        row(mRegSize + q)[mNumWords + (q >> 6)] |= bitOf(q);
+    }
+}
+
+////////////////////////////////////////////////////
+// Copy constructor                               //
+////////////////////////////////////////////////////
+
+ofxQuantumStabilizerRegister::ofxQuantumStabilizerRegister( const ofxQuantumStabilizerRegister & old )
+{
+    mQuantumSim     = old.mQuantumSim;
+    mRegSize        = old.mRegSize;
+    mNumWords       = old.mNumWords;
+    mTable          = old.mTable;
+    mPhase          = old.mPhase;
+    mConvertToDense = old.mConvertToDense;
+    mRegister       = old.mRegister != NULL ? new ofxQuantumRegister(*old.mRegister) : NULL;
+}
+
+////////////////////////////////////////////////////
+// Assignment, the converted register is copied   //
+////////////////////////////////////////////////////
+
+ofxQuantumStabilizerRegister & ofxQuantumStabilizerRegister::operator=( const ofxQuantumStabilizerRegister & old )
+{
+    if(this == &old)
+        return *this;
+
+    ofxQuantumRegister * reg = old.mRegister != NULL ? new ofxQuantumRegister(*old.mRegister) : NULL;
+
+    delete mRegister;
+
+    mQuantumSim     = old.mQuantumSim;
+    mRegSize        = old.mRegSize;
+    mNumWords       = old.mNumWords;
+    mTable          = old.mTable;
+    mPhase          = old.mPhase;
+    mConvertToDense = old.mConvertToDense;
+    mRegister       = reg;
+
+    return *this;
+}
+
+////////////////////////////////////////////////////
+// Destructor                                     //
+////////////////////////////////////////////////////
+
+ofxQuantumStabilizerRegister::~ofxQuantumStabilizerRegister()
+{
+    delete mRegister;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Multiply row i into row h. The product of two Pauli strings is the
+// XOR of their bits, times a power of i from every qubit where the two
+// anticommute. Those powers are counted mod 4 for 64 qubits at a time
+// in two bit planes, cnt1 and cnt2, so the phase costs a few logic
+// operations per word and two popcounts per row.
+////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumStabilizerRegister::rowMultiply( size_t h, size_t i )
+{
+    uint64_t *       xh = row(h);
+    uint64_t *       zh = xh + mNumWords;
+    const uint64_t * xi = row(i);
+    const uint64_t * zi = xi + mNumWords;
+
+    uint64_t cnt1 = 0;
+    uint64_t cnt2 = 0;
+
+    for(size_t w = 0; w < mNumWords; w++)
+    {
+        const uint64_t x1   = xi[w];
+        const uint64_t z1   = zi[w];
+        const uint64_t x2   = xh[w];
+        const uint64_t z2   = zh[w];
+        const uint64_t x    = x1 ^ x2;
+        const uint64_t z    = z1 ^ z2;
+        const uint64_t x1z2 = x1 & z2;
+        const uint64_t anti = (x2 & z1) ^ x1z2;
+
+        cnt2 ^= (cnt1 ^ x ^ z ^ x1z2) & anti;
+        cnt1 ^= anti;
+
+        xh[w] = x;
+        zh[w] = z;
+    }
+
+    const int power = __builtin_popcountll(cnt1) + 2 * __builtin_popcountll(cnt2);
+
+    mPhase[h] = (uint8_t)((mPhase[h] + mPhase[i] + power) & 3);
+}
+
+////////////////////////////////////////////////////
+// Row copy, clear and swap                       //
+////////////////////////////////////////////////////
+
+void ofxQuantumStabilizerRegister::rowCopy( size_t h, size_t i )
+{
+    std::copy(row(i), row(i) + 2 * mNumWords, row(h));
+    mPhase[h] = mPhase[i];
+}
+
+void ofxQuantumStabilizerRegister::rowClear( size_t h )
+{
+    std::fill(row(h), row(h) + 2 * mNumWords, 0);
+    mPhase[h] = 0;
+}
+
+void ofxQuantumStabilizerRegister::rowSwap( size_t h, size_t i )
+{
+    std::swap_ranges(row(h), row(h) + 2 * mNumWords, row(i));
+    std::swap(mPhase[h], mPhase[i]);
+}
+
+////////////////////////////////////////////////////
+// Check a qubit index                            //
+////////////////////////////////////////////////////
+
+bool ofxQuantumStabilizerRegister::checkBit( unsigned long long int bit ) const
+{
+    if(bit >= mRegSize)
+    {
+        printf("ERROR! bit indx out of range, max indx: %llu\n", mRegSize);
+        return false;
+    }
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure a single qubit. When a stabilizer anticommutes with Z on the
+// qubit the outcome is random and that stabilizer is replaced by +/-Z,
+// otherwise the outcome is fixed and is read off the product of the
+// stabilizers that build Z.
+////////////////////////////////////////////////////////////////////////
+
+int ofxQuantumStabilizerRegister::measureBit( unsigned long long int bitIndx )
+{
+    if(mRegister != NULL)
+        return mRegister->measureBit(bitIndx);
+
+    if(!checkBit(bitIndx))
+        return -1;
+
+    const size_t   n    = (size_t)mRegSize;
+    const size_t   w    = (size_t)(bitIndx >> 6);
+    const uint64_t mask = bitOf(bitIndx);
+
+    // First stabilizer with an X or Y on the qubit
+    size_t p = n;
+    while(p < 2 * n && (row(p)[w] & mask) == 0)
+        p++;
+
+    if(p < 2 * n)
+    {
+        const int result = (mQuantumSim->getRandom() < 0.5) ? 0 : 1;
+
+        for(size_t i = 0; i < 2 * n; i++)
+        {
+            if(i != p && (row(i)[w] & mask) != 0)
+                rowMultiply(i, p);
+        }
+
+        rowCopy(p - n, p);
+        rowClear(p);
+        row(p)[mNumWords + w] |= mask;
+        mPhase[p] = (uint8_t)(2 * result);
+
+        return result;
+    }
+
+    // Deterministic, the destabilizers with an X on the qubit pick the stabilizers whose product is Z
+    const size_t scratch = 2 * n;
+    rowClear(scratch);
+
+    for(size_t i = 0; i < n; i++)
+    {
+        if((row(i)[w] & mask) != 0)
+            rowMultiply(scratch, i + n);
+    }
+
+    return mPhase[scratch] >> 1;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure several bits, one after another
+////////////////////////////////////////////////////////////////////////
+
+unsigned long long int ofxQuantumStabilizerRegister::measureBits( unsigned long long int qubitMask )
+{
+    if(mRegister != NULL)
+        return mRegister->measureBits(qubitMask);
+
+    if(mRegSize < 64 && (qubitMask >> mRegSize) != 0)
+    {
+        printf("ERROR! qubit mask selects bits outside the register\n");
+        return 0;
+    }
+
+    unsigned long long int result = 0;
+
+    for(unsigned long long int q = 0; q < mRegSize && q < 64; q++)
+    {
+        if(((qubitMask >> q) & 1) && measureBit(q) == 1)
+            result |= 1ULL << q;
+    }
+
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Measure every qubit, qubit 0 ends up in the most significant bit the
+// same way the state index of ofxQuantumRegister is laid out
+////////////////////////////////////////////////////////////////////////
+
+unsigned long long int ofxQuantumStabilizerRegister::decimalMeasure()
+{
+    if(mRegister != NULL)
+        return mRegister->decimalMeasure();
+
+    if(mRegSize > 64)
+    {
+        printf("ERROR! a register of %llu qubits does not fit in a decimal value\n", mRegSize);
+        return ~0ULL;
+    }
+
+    unsigned long long int decVal = 0;
+
+    for(unsigned long long int q = 0; q < mRegSize; q++)
+        decVal = (decVal << 1) | (unsigned long long int)measureBit(q);
+
+    return decVal;
+}
+
+////////////////////////////////////////////////////
+// Get number of qubits in register               //
+////////////////////////////////////////////////////
+
+int ofxQuantumStabilizerRegister::size() const
+{
+    return (int)mRegSize;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Print the stabilizer generators as Pauli strings with their sign
+// WARNING, large registers print n lines of n characters
+////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumStabilizerRegister::printInfo()
+{
+    if(mRegister != NULL)
+    {
+        mRegister->printInfo();
+        return;
+    }
+
+    for(size_t i = mRegSize; i < 2 * mRegSize; i++)
+    {
+        const uint64_t * x = row(i);
+        const uint64_t * z = x + mNumWords;
+
+        string pauli(1, mPhase[i] == 0 ? '+' : '-');
+
+        for(unsigned long long int q = 0; q < mRegSize; q++)
+        {
+            const bool hasX = (x[q >> 6] & bitOf(q)) != 0;
+            const bool hasZ = (z[q >> 6] & bitOf(q)) != 0;
+
+            pauli += hasX ? (hasZ ? 'Y' : 'X') : (hasZ ? 'Z' : 'I');
+        }
+
+        cout << pauli << endl;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Pauli gates only change signs: X flips every row with a Z or Y on the qubit, Z every row
+// with an X or Y, Y every row with an X or a Z
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumStabilizerRegister::applyCliffordX( unsigned long long int bit )
+{
+    const size_t   w    = (size_t)(bit >> 6);
+    const uint64_t mask = bitOf(bit);
+
+    for(size_t i = 0; i < 2 * mRegSize; i++)
+    {
+        if(row(i)[mNumWords + w] & mask)
+            mPhase[i] ^= 2;
+    }
+}
+
+void ofxQuantumStabilizerRegister::applyCliffordZ( unsigned long long int bit )
+{
+    const size_t   w    = (size_t)(bit >> 6);
+    const uint64_t mask = bitOf(bit);
+
+    for(size_t i = 0; i < 2 * mRegSize; i++)
+    {
+        if(row(i)[w] & mask)
+            mPhase[i] ^= 2;
+    }
+}
+
+void ofxQuantumStabilizerRegister::applyGateX( unsigned long long int bit )
+{
+    if(mRegister != NULL)
+        mRegister->applyGateX(bit);
+    else if(checkBit(bit))
+        applyCliffordX(bit);
+}
+
+void ofxQuantumStabilizerRegister::applyGateY( unsigned long long int bit )
+{
+    if(mRegister != NULL)
+    {
+        mRegister->applyGateY(bit);
+    }
+    else if(checkBit(bit))
+    {
+        applyCliffordX(bit);
+        applyCliffordZ(bit);
+    }
+}
+
+void ofxQuantumStabilizerRegister::applyGateZ( unsigned long long int bit )
+{
+    if(mRegister != NULL)
+        mRegister->applyGateZ(bit);
+    else if(checkBit(bit))
+        applyCliffordZ(bit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// S maps X to Y and Y to -X, the Z bit picks up the X bit
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumStabilizerRegister::applyGateS( unsigned long long int bit )
+{
+    if(mRegister != NULL)
+    {
+        mRegister->applyGateS(bit);
+        return;
+    }
+
+    if(!checkBit(bit))
+        return;
+
+    const size_t   w    = (size_t)(bit >> 6);
+    const uint64_t mask = bitOf(bit);
+
+    for(size_t i = 0; i < 2 * mRegSize; i++)
+    {
+        uint64_t &     x  = row(i)[w];
+        uint64_t &     z  = row(i)[mNumWords + w];
+        const uint64_t xb = x & mask;
+
+        if(xb & z)
+            mPhase[i] ^= 2;
+
+        z ^= xb;
+    }
+}
+
+// The inverse of S maps X to -Y and Y to X
+void ofxQuantumStabilizerRegister::applyGateSdg( unsigned long long int bit )
+{
+    const size_t   w    = (size_t)(bit >> 6);
+    const uint64_t mask = bitOf(bit);
+
+    for(size_t i = 0; i < 2 * mRegSize; i++)
+    {
+        uint64_t &     x  = row(i)[w];
+        uint64_t &     z  = row(i)[mNumWords + w];
+        const uint64_t xb = x & mask;
+
+        if(xb & ~z)
+            mPhase[i] ^= 2;
+
+        z ^= xb;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// The hadamard swaps X and Z, and Y picks up a sign
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumStabilizerRegister::applyGateHad( unsigned long long int bit )
+{
+    if(mRegister != NULL)
+    {
+        mRegister->applyGateHad(bit);
+        return;
+    }
+
+    if(!checkBit(bit))
+        return;
+
+    const size_t   w    = (size_t)(bit >> 6);
+    const uint64_t mask = bitOf(bit);
+
+    for(size_t i = 0; i < 2 * mRegSize; i++)
+    {
+        uint64_t &     x    = row(i)[w];
+        uint64_t &     z    = row(i)[mNumWords + w];
+        const uint64_t xb   = x & mask;
+        const uint64_t zb   = z & mask;
+
+        if(xb & zb)
+            mPhase[i] ^= 2;
+
+        x ^= xb ^ zb;
+        z ^= xb ^ zb;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// CNOT copies the X of the control onto the target and the Z of the target back onto the
+// control
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumStabilizerRegister::applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit )
+{
+    if(mRegister != NULL)
+    {
+        mRegister->applyGateControlledNot(controlBit, bit);
+        return;
+    }
+
+    if(!checkBit(controlBit) || !checkBit(bit))
+        return;
+
+    if(controlBit == bit)
+    {
+        printf("ERROR! invalid control bit %llu for target %llu\n", controlBit, bit);
+        return;
+    }
+
+    const size_t   wc = (size_t)(controlBit >> 6);
+    const size_t   wt = (size_t)(bit >> 6);
+    const uint64_t mc = bitOf(controlBit);
+    const uint64_t mt = bitOf(bit);
+
+    for(size_t i = 0; i < 2 * mRegSize; i++)
+    {
+        uint64_t * x = row(i);
+        uint64_t * z = x + mNumWords;
+
+        const bool xc = (x[wc] & mc) != 0;
+        const bool zc = (z[wc] & mc) != 0;
+        const bool xt = (x[wt] & mt) != 0;
+        const bool zt = (z[wt] & mt) != 0;
+
+        if(xc && zt && (xt == zc))
+            mPhase[i] ^= 2;
+
+        if(xc)
+            x[wt] ^= mt;
+        if(zt)
+            z[wc] ^= mc;
+    }
+}
+
+void ofxQuantumStabilizerRegister::applyGateCZ( unsigned long long int controlBit, unsigned long long int bit )
+{
+    applyGateHad(bit);
+    applyGateControlledNot(controlBit, bit);
+    applyGateHad(bit);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Quarter turn rotations are Clifford, the phase gate by PI / 2 is S, by PI is Z and by
+// 3 PI / 2 is the inverse of S. Rz differs from the phase gate only by a global phase, Rx and
+// Ry are Rz turned onto the x and y axes.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+int ofxQuantumStabilizerRegister::quarterTurns( double theta )
+{
+    const double turns = theta / (M_PI / 2);
+    const double whole = floor(turns + 0.5);
+
+    if(fabs(turns - whole) > 1e-9)
+        return -1;
+
+    return (int)(((long long int)whole % 4 + 4) % 4);
+}
+
+void ofxQuantumStabilizerRegister::applyQuarterPhase( unsigned long long int bit, int turns )
+{
+    if(turns == 1)
+        applyGateS(bit);
+    else if(turns == 2)
+        applyCliffordZ(bit);
+    else if(turns == 3)
+        applyGateSdg(bit);
+}
+
+void ofxQuantumStabilizerRegister::applyGatePhase( unsigned long long int bit, double theta )
+{
+    const int turns = quarterTurns(theta);
+
+    if(mRegister == NULL && turns >= 0)
+    {
+        if(checkBit(bit))
+            applyQuarterPhase(bit, turns);
+    }
+    else if(nonClifford("the phase gate"))
+    {
+        mRegister->applyGatePhase(bit, theta);
+    }
+}
+
+void ofxQuantumStabilizerRegister::applyGateRz( unsigned long long int bit, double theta )
+{
+    const int turns = quarterTurns(theta);
+
+    if(mRegister == NULL && turns >= 0)
+    {
+        if(checkBit(bit))
+            applyQuarterPhase(bit, turns);
+    }
+    else if(nonClifford("Rz"))
+    {
+        mRegister->applyGateRz(bit, theta);
+    }
+}
+
+void ofxQuantumStabilizerRegister::applyGateRx( unsigned long long int bit, double theta )
+{
+    const int turns = quarterTurns(theta);
+
+    if(mRegister == NULL && turns >= 0)
+    {
+        if(checkBit(bit))
+        {
+            applyGateHad(bit);
+            applyQuarterPhase(bit, turns);
+            applyGateHad(bit);
+        }
+    }
+    else if(nonClifford("Rx"))
+    {
+        mRegister->applyGateRx(bit, theta);
+    }
+}
+
+void ofxQuantumStabilizerRegister::applyGateRy( unsigned long long int bit, double theta )
+{
+    const int turns = quarterTurns(theta);
+
+    if(mRegister == NULL && turns >= 0)
+    {
+        if(checkBit(bit))
+        {
+            applyGateSdg(bit);
+            applyGateHad(bit);
+            applyQuarterPhase(bit, turns);
+            applyGateHad(bit);
+            applyGateS(bit);
+        }
+    }
+    else if(nonClifford("Ry"))
+    {
+        mRegister->applyGateRy(bit, theta);
+    }
+}
+
+// Only the controlled Z, a turn of PI, is Clifford
+void ofxQuantumStabilizerRegister::applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta )
+{
+    const int turns = quarterTurns(theta);
+
+    if(mRegister == NULL && (turns == 0 || turns == 2))
+    {
+        // Checked here as well, a zero turn changes nothing but the qubits must still be valid
+        if(!checkBit(controlBit) || !checkBit(bit))
+            return;
+
+        if(controlBit == bit)
+        {
+            printf("ERROR! invalid control bit %llu for target %llu\n", controlBit, bit);
+            return;
+        }
+
+        if(turns == 2)
+            applyGateCZ(controlBit, bit);
+    }
+    else if(nonClifford("the controlled phase gate"))
+    {
+        mRegister->applyGateControlledPhase(controlBit, bit, theta);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Gates the tableau cannot follow
+////////////////////////////////////////////////////////////////////////////////////////////
+
+void ofxQuantumStabilizerRegister::applyGateT( unsigned long long int bit )
+{
+    if(nonClifford("T"))
+        mRegister->applyGateT(bit);
+}
+
+void ofxQuantumStabilizerRegister::applyGateToffoli( unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit )
+{
+    if(nonClifford("Toffoli"))
+        mRegister->applyGateToffoli(controlBit1, controlBit2, bit);
+}
+
+void ofxQuantumStabilizerRegister::applyGate( unsigned long long int bit, const Complex matrix[4] )
+{
+    if(nonClifford("an arbitrary matrix"))
+        mRegister->applyGate(bit, matrix);
+}
+
+void ofxQuantumStabilizerRegister::applyControlledGate( const std::vector<unsigned long long int> & controls,
+                                                        unsigned long long int target,
+                                                        const Complex matrix[4],
+                                                        unsigned long long int controlValues )
+{
+    if(nonClifford("an arbitrary controlled matrix"))
+        mRegister->applyControlledGate(controls, target, matrix, controlValues);
+}
+
+void ofxQuantumStabilizerRegister::applyMultiQubitGate( const std::vector<unsigned long long int> & qubits, const Complex * matrix )
+{
+    if(nonClifford("an arbitrary multi qubit matrix"))
+        mRegister->applyMultiQubitGate(qubits, matrix);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Convert or refuse a non Clifford gate
+////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ofxQuantumStabilizerRegister::nonClifford( const char * gateName )
+{
+    if(mRegister != NULL)
+        return true;
+
+    if(!mConvertToDense)
+    {
+        printf("ERROR! %s is not a Clifford gate, call setConvertToDense(true) to simulate it on an ofxQuantumRegister\n", gateName);
+        return false;
+    }
+
+    return convertToDense();
+}
+
+void ofxQuantumStabilizerRegister::setConvertToDense( bool convert )
+{
+    mConvertToDense = convert;
+}
+
+bool ofxQuantumStabilizerRegister::getConvertToDense() const
+{
+    return mConvertToDense;
+}
+
+ofxQuantumRegisterT<double> * ofxQuantumStabilizerRegister::getRegister()
+{
+    return mRegister;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Gaussian elimination over the stabilizer rows. The rows with an X or Y end up first, in
+// echelon form on their X bits, followed by the rows of only Zs in echelon form on their Z
+// bits. The destabilizers are combined the opposite way so each still anticommutes with only
+// its own stabilizer.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+size_t ofxQuantumStabilizerRegister::gaussianEliminate()
+{
+    const size_t n        = (size_t)mRegSize;
+    size_t       i        = n;
+    size_t       numXRows = 0;
+
+    for(int plane = 0; plane < 2; plane++)
+    {
+        const size_t offset = plane == 0 ? 0 : mNumWords;
+
+        for(unsigned long long int q = 0; q < mRegSize; q++)
+        {
+            const size_t   w    = offset + (size_t)(q >> 6);
+            const uint64_t mask = bitOf(q);
+
+            size_t k = i;
+            while(k < 2 * n && (row(k)[w] & mask) == 0)
+                k++;
+
+            if(k == 2 * n)
+                continue;
+
+            rowSwap(i, k);
+            rowSwap(i - n, k - n);
+
+            for(size_t k2 = i + 1; k2 < 2 * n; k2++)
+            {
+                if(row(k2)[w] & mask)
+                {
+                    rowMultiply(k2, i);
+                    rowMultiply(i - n, k2 - n);
+                }
+            }
+            i++;
+        }
+
+        if(plane == 0)
+            numXRows = i - n;
+    }
+
+    return numXRows;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////
+// Expand the tableau into amplitudes. A stabilizer state is an equal superposition of 2^g
+// basis states, g being the number of stabilizers with an X or Y. After elimination the Z
+// only stabilizers fix one basis state with a non zero amplitude, the others are reached by
+// multiplying it by every product of the X stabilizers, taken in gray code order so each step
+// is one row multiply. The phase of each amplitude is the phase of the product acting on
+// |0...0>, where every Y adds a factor of i.
+////////////////////////////////////////////////////////////////////////////////////////////
+
+bool ofxQuantumStabilizerRegister::convertToDense()
+{
+    if(mRegister != NULL)
+        return true;
+
+    if(mRegSize > QUANTUM_MAX_QUBITS)
+    {
+        printf("ERROR! a stabilizer register of %llu qubits is too large to convert, the limit is %d\n", mRegSize, QUANTUM_MAX_QUBITS);
+        return false;
+    }
+
+    const size_t n = (size_t)mRegSize;
+    const size_t g = gaussianEliminate();
+
+    if(g > QUANTUM_STABILIZER_MAX_EXPAND_QUBITS)
+    {
+        printf("ERROR! the state has 2^%zu non zero amplitudes, too many to convert\n", g);
+        return false;
+    }
+
+    // Seed basis state, each Z only stabilizer, from the bottom up, sets its lowest qubit so it has eigenvalue +1
+    const size_t scratch = 2 * n;
+    rowClear(scratch);
+
+    uint64_t * seedX = row(scratch);
+
+    for(size_t i = 2 * n; i-- > n + g; )
+    {
+        const uint64_t * z      = row(i) + mNumWords;
+        int              parity = mPhase[i] >> 1;
+        size_t           lowest = n;
+
+        for(size_t w = 0; w < mNumWords; w++)
+        {
+            parity ^= __builtin_popcountll(z[w] & seedX[w]) & 1;
+
+            if(lowest == n && z[w] != 0)
+                lowest = w * 64 + (size_t)__builtin_ctzll(z[w]);
+        }
+
+        if(parity)
+            seedX[lowest >> 6] ^= bitOf(lowest);
+    }
+
+    const size_t                        numStates = (size_t)1 << g;
+    const double                        magnitude = pow(2.0, -0.5 * (double)g);
+    std::vector<unsigned long long int> indices(numStates);
+    std::vector<Complex>                amplitudes(numStates);
+
+    for(size_t t = 0; t < numStates; t++)
+    {
+        if(t > 0)
+        {
+            // Gray code, the bit that changes between t - 1 and t picks the stabilizer
+            rowMultiply(scratch, n + (size_t)__builtin_ctzll(t));
+        }
+
+        const uint64_t * x     = row(scratch);
+        const uint64_t * z     = x + mNumWords;
+        int              power = mPhase[scratch];
+
+        unsigned long long int indx = 0;
+
+        for(unsigned long long int q = 0; q < mRegSize; q++)
+        {
+            const bool hasX = (x[q >> 6] & bitOf(q)) != 0;
+
+            if(hasX)
+            {
+                indx |= 1ULL << (mRegSize - 1 - q);
+
+                if(z[q >> 6] & bitOf(q))
+                    power++;
+            }
+        }
+
+        static const double re[4] = { 1, 0, -1,  0 };
+        static const double im[4] = { 0, 1,  0, -1 };
+
+        indices[t]    = indx;
+        amplitudes[t] = Complex(re[power & 3] * magnitude, im[power & 3] * magnitude);
+    }
+
+    mRegister = new ofxQuantumRegister(mRegSize, mQuantumSim);
+    mRegister->setStates(indices, amplitudes);
+
+    // The tableau is no longer used
+    std::vector<uint64_t>().swap(mTable);
+    std::vector<uint8_t>().swap(mPhase);
+
+    return true;
+}
@@ -0,0 +1,163 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumStabilizerRegister.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumStabilizerRegister simulates circuits made only of Clifford gates (H, S, X, Y, Z, CNOT and CZ) with the
+//  stabilizer tableau of Aaronson and Gottesman, https://arxiv.org/abs/quant-ph/0406196. Instead of 2^n amplitudes it keeps
+//  2n Pauli strings that the state is an eigenvector of, so gates cost O(n), measurements O(n^2) and thousands of qubits fit
+//  in a few megabytes. Each row is packed 64 qubits to a word, an X plane then a Z plane, and rows are multiplied a whole
+//  word at a time with the phase counted from the bits of each word.
+//
+//  The gate and measurement functions match ofxQuantumRegister. A gate that is not Clifford (T, Toffoli, rotations other
+//  than quarter turns, arbitrary matrices) cannot be tracked by the tableau. By default it is refused with an error, after
+//  setConvertToDense(true) the tableau is expanded into an ofxQuantumRegister instead and every later call goes to it.
+//
+//  ofxQuantumStabilizerRegister reg( 1000, &quantumSim );
+//  reg.applyGateHad(0);
+//  for(int q = 1; q < 1000; q++) reg.applyGateControlledNot(0, q);
+//  reg.measureBit(999);
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMSTABILIZERREGISTER_H
+#define OFXQUANTUMSTABILIZERREGISTER_H
+
+// Includes
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "Complex.h"
+
+// A tableau is only expanded into a register when the state has at most 2^this non zero amplitudes
+#define QUANTUM_STABILIZER_MAX_EXPAND_QUBITS 24
+
+// Forward declarations
+class ofxQuantum;
+template<typename T> class ofxQuantumRegisterT;
+
+class ofxQuantumStabilizerRegister
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructors, the register starts in the state |0...0>
+    ofxQuantumStabilizerRegister( unsigned long long int size, ofxQuantum *quantumSim );
+    ofxQuantumStabilizerRegister( const ofxQuantumStabilizerRegister & );
+
+    // Assignment, copies the tableau and any register it was converted to
+    ofxQuantumStabilizerRegister & operator=( const ofxQuantumStabilizerRegister & );
+
+    // Destructor
+    ~ofxQuantumStabilizerRegister();
+
+    // Measure a single qubit, collapsing the register
+    int measureBit( unsigned long long int bitIndx );
+
+    // Measure the qubits selected by qubitMask, bit q selects qubit q and holds its value in the result
+    unsigned long long int measureBits( unsigned long long int qubitMask );
+
+    // Measure every qubit and return the state as a number, qubit 0 is the most significant bit. Registers of at most 64 qubits
+    unsigned long long int decimalMeasure();
+
+    // Number of qubits
+    int size() const;
+
+    // Print the stabilizer generators, or the amplitudes once converted
+    void printInfo();
+
+    // Clifford gates
+    void applyGateX(   unsigned long long int bit );
+    void applyGateY(   unsigned long long int bit );
+    void applyGateZ(   unsigned long long int bit );
+    void applyGateS(   unsigned long long int bit );
+    void applyGateHad( unsigned long long int bit );
+    void applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit );
+
+    // Clifford when theta is a multiple of PI / 2, or of PI for the controlled phase
+    void applyGatePhase( unsigned long long int bit, double theta );
+    void applyGateRx(    unsigned long long int bit, double theta );
+    void applyGateRy(    unsigned long long int bit, double theta );
+    void applyGateRz(    unsigned long long int bit, double theta );
+    void applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta );
+
+    // Never Clifford, these need setConvertToDense(true)
+    void applyGateT( unsigned long long int bit );
+    void applyGateToffoli( unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit );
+    void applyGate( unsigned long long int bit, const Complex matrix[4] );
+    void applyControlledGate( const std::vector<unsigned long long int> & controls,
+                              unsigned long long int target,
+                              const Complex matrix[4],
+                              unsigned long long int controlValues = ~0ULL );
+    void applyMultiQubitGate( const std::vector<unsigned long long int> & qubits, const Complex * matrix );
+
+    // Expand into an ofxQuantumRegister on the first non Clifford gate instead of refusing it
+    void setConvertToDense( bool convert );
+    bool getConvertToDense() const;
+
+    // Expand into an ofxQuantumRegister now, false if the register is too large. Converting cannot be undone
+    bool convertToDense();
+
+    // The register the tableau was expanded into, NULL while the tableau is in use
+    ofxQuantumRegisterT<double> * getRegister();
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Words of a row, the X plane starts at row(i) and the Z plane at row(i) + mNumWords
+    uint64_t *       row( size_t i )       { return &mTable[i * 2 * mNumWords]; }
+    const uint64_t * row( size_t i ) const { return &mTable[i * 2 * mNumWords]; }
+
+    // Bit of a qubit inside its word
+    static uint64_t bitOf( unsigned long long int bit ) { return 1ULL << (bit & 63); }
+
+    // Row h becomes row i times row h, the phase is tracked mod 4
+    void rowMultiply( size_t h, size_t i );
+
+    // Copy row i over row h, clear row h
+    void rowCopy(  size_t h, size_t i );
+    void rowClear( size_t h );
+    void rowSwap(  size_t h, size_t i );
+
+    // Check a qubit index, printing an error when it is out of range
+    bool checkBit( unsigned long long int bit ) const;
+
+    // Tableau updates without the checks and forwarding of the public gates
+    void applyCliffordX( unsigned long long int bit );
+    void applyCliffordZ( unsigned long long int bit );
+    void applyGateSdg(   unsigned long long int bit );
+    void applyGateCZ(    unsigned long long int controlBit, unsigned long long int bit );
+
+    // Apply diag(1, i^quarterTurns), quarterTurns mod 4
+    void applyQuarterPhase( unsigned long long int bit, int quarterTurns );
+
+    // Number of quarter turns in theta, -1 when it is not a multiple of PI / 2
+    static int quarterTurns( double theta );
+
+    // Convert before a non Clifford gate, or print an error. True when the gate can go to the register
+    bool nonClifford( const char * gateName );
+
+    // Put the stabilizer rows into reduced form, returns the number of rows with an X or Y
+    size_t gaussianEliminate();
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantum *                  mQuantumSim;      // Quantum simulator the random numbers come from
+    unsigned long long int        mRegSize;         // Number of qubits
+    size_t                        mNumWords;        // 64 bit words in each plane of a row
+    std::vector<uint64_t>         mTable;           // Rows 0..n-1 destabilizers, n..2n-1 stabilizers, 2n scratch
+    std::vector<uint8_t>          mPhase;           // Phase of each row as a power of i, 0 or 2 for every row but the scratch
+    bool                          mConvertToDense;  // Expand on the first non Clifford gate
+    ofxQuantumRegisterT<double> * mRegister;        // Register the tableau was expanded into
+};
+
+#endif
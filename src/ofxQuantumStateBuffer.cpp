@@ -0,0 +1,400 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumStateBuffer.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumStateBuffer.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// Size of a huge page on x86 and arm64 linux
+#define QUANTUM_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+// Buffers at least this big are mapped directly, the os hands back zeroed pages on first touch so construction
+// does not have to write the whole buffer
+#define QUANTUM_MAP_THRESHOLD  (1024 * 1024)
+
+////////////////////////////////////////////////////
+// Round a byte count up to a multiple of align   //
+////////////////////////////////////////////////////
+static size_t roundUp( size_t bytes, size_t align )
+{
+    return (bytes + align - 1) / align * align;
+}
+
+////////////////////////////////////////////////////
+// Default constructor                            //
+////////////////////////////////////////////////////
+template<typename T>
+ofxQuantumStateBufferT<T>::ofxQuantumStateBufferT()
+{
+    mReal       = NULL;
+    mImag       = NULL;
+    mNumStates  = 0;
+    mNumBytes   = 0;
+    mHugePages  = false;
+    mMapped     = false;
+    mFileBacked = false;
+}
+
+////////////////////////////////////////////////////
+// Constructor that allocates the buffer          //
+////////////////////////////////////////////////////
+template<typename T>
+ofxQuantumStateBufferT<T>::ofxQuantumStateBufferT( size_t numStates, bool useHugePages )
+{
+    mReal       = NULL;
+    mImag       = NULL;
+    mNumStates  = 0;
+    mNumBytes   = 0;
+    mHugePages  = false;
+    mMapped     = false;
+    mFileBacked = false;
+
+    allocate(numStates, useHugePages);
+}
+
+////////////////////////////////////////////////////
+// Copy constructor                               //
+////////////////////////////////////////////////////
+template<typename T>
+ofxQuantumStateBufferT<T>::ofxQuantumStateBufferT( const ofxQuantumStateBufferT & old )
+{
+    mReal       = NULL;
+    mImag       = NULL;
+    mNumStates  = 0;
+    mNumBytes   = 0;
+    mHugePages  = false;
+    mMapped     = false;
+    mFileBacked = false;
+
+    *this = old;
+}
+
+////////////////////////////////////////////////////
+// Destructor                                     //
+////////////////////////////////////////////////////
+template<typename T>
+ofxQuantumStateBufferT<T>::~ofxQuantumStateBufferT()
+{
+    release();
+}
+
+////////////////////////////////////////////////////
+// Assignment, copies both amplitude planes       //
+////////////////////////////////////////////////////
+template<typename T>
+ofxQuantumStateBufferT<T> & ofxQuantumStateBufferT<T>::operator = ( const ofxQuantumStateBufferT & old )
+{
+    if( &old != this )
+    {
+        allocate(old.mNumStates, old.mHugePages);
+
+        if(mNumStates > 0)
+        {
+            memcpy(mReal, old.mReal, mNumStates * sizeof(T));
+            memcpy(mImag, old.mImag, mNumStates * sizeof(T));
+        }
+    }
+
+    return *this;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Allocate both planes in a single block. The imaginary plane starts
+// on the next aligned boundary after the real plane. Huge page and large
+// buffers come from mmap, which also hands back zeroed memory.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumStateBufferT<T>::allocate( size_t numStates, bool useHugePages )
+{
+    release();
+
+    if(numStates == 0)
+        return;
+
+    const size_t planeBytes = roundUp(numStates * sizeof(T), QUANTUM_STATE_ALIGNMENT);
+    void *       block      = NULL;
+
+    if(useHugePages)
+    {
+        const size_t numBytes = roundUp(2 * planeBytes, QUANTUM_HUGE_PAGE_SIZE);
+
+#ifdef MAP_HUGETLB
+        // Ask for explicitly reserved huge pages first
+        block = mmap(NULL, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(block == MAP_FAILED)
+            block = NULL;
+#endif
+
+        // Otherwise fall back to normal pages with a transparent huge page hint
+        if(block == NULL)
+        {
+            block = mmap(NULL, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+            if(block == MAP_FAILED)
+                block = NULL;
+#ifdef MADV_HUGEPAGE
+            else
+                madvise(block, numBytes, MADV_HUGEPAGE);
+#endif
+        }
+
+        if(block != NULL)
+        {
+            mNumBytes  = numBytes;
+            mHugePages = true;
+            mMapped    = true;
+        }
+        else
+        {
+            printf("Unable to map huge pages for quantum state, using normal allocation\n");
+        }
+    }
+
+    if(block == NULL && 2 * planeBytes >= QUANTUM_MAP_THRESHOLD)
+    {
+        block = mmap(NULL, 2 * planeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, -1, 0);
+        
+        if(block == MAP_FAILED)
+        {
+            block = NULL;
+        }
+        else
+        {
+            mNumBytes = 2 * planeBytes;
+            mMapped   = true;
+        }
+    }
+
+    if(block == NULL)
+    {
+        mNumBytes = 2 * planeBytes;
+
+        if(posix_memalign(&block, QUANTUM_STATE_ALIGNMENT, mNumBytes) != 0)
+        {
+            mNumBytes = 0;
+            throw std::bad_alloc();
+        }
+
+        memset(block, 0, mNumBytes);
+    }
+
+    mReal      = (T *)block;
+    mImag      = (T *)((char *)block + planeBytes);
+    mNumStates = numStates;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Map both planes of a file in one private mapping, along with any
+// padding between them. Nothing is read until the amplitudes are touched.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+bool ofxQuantumStateBufferT<T>::mapFile( int fd, unsigned long long int realOffset, unsigned long long int imagOffset, size_t numStates )
+{
+    release();
+
+    if(numStates == 0)
+        return true;
+
+    if(imagOffset < realOffset + numStates * sizeof(T) || realOffset % sysconf(_SC_PAGESIZE) != 0)
+    {
+        printf("ERROR! amplitude planes in the file overlap or are not page aligned\n");
+        return false;
+    }
+
+    const size_t numBytes = (size_t)(imagOffset - realOffset) + numStates * sizeof(T);
+    void *       block    = mmap(NULL, numBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)realOffset);
+
+    if(block == MAP_FAILED)
+    {
+        printf("ERROR! unable to map amplitudes from file\n");
+        return false;
+    }
+
+    mReal      = (T *)block;
+    mImag      = (T *)((char *)block + (imagOffset - realOffset));
+    mNumStates = numStates;
+    mNumBytes  = numBytes;
+    mMapped    = true;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Allocate both planes in a shared mapping of a new file. ftruncate
+// leaves the file sparse, so unwritten pages read as zero and take no
+// disk space. The name is unlinked straight away, the blocks are freed
+// when the mapping goes, even if the program does not exit cleanly.
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+bool ofxQuantumStateBufferT<T>::allocateFile( const std::string & path, size_t numStates )
+{
+    release();
+
+    if(numStates == 0)
+        return true;
+
+    const size_t planeBytes = roundUp(numStates * sizeof(T), QUANTUM_STATE_ALIGNMENT);
+    const size_t numBytes   = 2 * planeBytes;
+
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if(fd < 0)
+    {
+        printf("ERROR! unable to create state file %s: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    void * block = MAP_FAILED;
+
+    if(ftruncate(fd, (off_t)numBytes) == 0)
+        block = mmap(NULL, numBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if(block == MAP_FAILED)
+        printf("ERROR! unable to map state file %s: %s\n", path.c_str(), strerror(errno));
+
+    close(fd);
+    unlink(path.c_str());
+
+    if(block == MAP_FAILED)
+        return false;
+
+    // Gates stream through the planes in order, ask for deep readahead
+    madvise(block, numBytes, MADV_SEQUENTIAL);
+
+    mReal       = (T *)block;
+    mImag       = (T *)((char *)block + planeBytes);
+    mNumStates  = numStates;
+    mNumBytes   = numBytes;
+    mMapped     = true;
+    mFileBacked = true;
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+// Paging hints for a range of amplitudes in both planes, widened to
+// whole pages as madvise needs
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+static void adviseRange( const T * plane, size_t first, size_t count, int advice )
+{
+    const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t begin    = (size_t)(plane + first) / pageSize * pageSize;
+    const size_t end      = (size_t)(plane + first + count);
+
+    if(count > 0)
+        madvise((void *)begin, end - begin, advice);
+}
+
+template<typename T>
+void ofxQuantumStateBufferT<T>::willNeed( size_t first, size_t count ) const
+{
+    if(!mFileBacked)
+        return;
+
+    adviseRange(mReal, first, count, MADV_WILLNEED);
+    adviseRange(mImag, first, count, MADV_WILLNEED);
+}
+
+template<typename T>
+void ofxQuantumStateBufferT<T>::dontNeed( size_t first, size_t count ) const
+{
+    if(!mFileBacked)
+        return;
+
+    // On a shared file mapping this only drops the page table entries, dirty pages stay in the page cache until they are
+    // written back, so nothing is lost and the pages can be reclaimed first
+    adviseRange(mReal, first, count, MADV_DONTNEED);
+    adviseRange(mImag, first, count, MADV_DONTNEED);
+}
+
+////////////////////////////////////////////////////////////////////////
+// Use a mapping made by the caller for both planes, laid out the same
+// way allocate lays out its block
+////////////////////////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumStateBufferT<T>::adopt( void * block, size_t numBytes, size_t numStates )
+{
+    release();
+
+    if(block == NULL || numStates == 0)
+        return;
+
+    mReal      = (T *)block;
+    mImag      = (T *)((char *)block + roundUp(numStates * sizeof(T), QUANTUM_STATE_ALIGNMENT));
+    mNumStates = numStates;
+    mNumBytes  = numBytes;
+    mMapped    = true;
+}
+
+template<typename T>
+size_t ofxQuantumStateBufferT<T>::mappedBytes( size_t numStates )
+{
+    return 2 * roundUp(numStates * sizeof(T), QUANTUM_STATE_ALIGNMENT);
+}
+
+////////////////////////////////////////////////////
+// Free the allocation                            //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumStateBufferT<T>::release()
+{
+    if(mReal != NULL)
+    {
+        if(mMapped)
+            munmap(mReal, mNumBytes);
+        else
+            free(mReal);
+    }
+
+    mReal       = NULL;
+    mImag       = NULL;
+    mNumStates  = 0;
+    mNumBytes   = 0;
+    mHugePages  = false;
+    mMapped     = false;
+    mFileBacked = false;
+}
+
+////////////////////////////////////////////////////
+// Zero all amplitudes                            //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumStateBufferT<T>::zero()
+{
+    if(mNumStates > 0)
+    {
+        memset(mReal, 0, mNumStates * sizeof(T));
+        memset(mImag, 0, mNumStates * sizeof(T));
+    }
+}
+
+////////////////////////////////////////////////////
+// Swap two buffers                               //
+////////////////////////////////////////////////////
+template<typename T>
+void ofxQuantumStateBufferT<T>::swap( ofxQuantumStateBufferT & other )
+{
+    T *      real      = mReal;      mReal      = other.mReal;      other.mReal      = real;
+    T *      imag      = mImag;      mImag      = other.mImag;      other.mImag      = imag;
+    size_t   numStates = mNumStates; mNumStates = other.mNumStates; other.mNumStates = numStates;
+    size_t   numBytes  = mNumBytes;  mNumBytes  = other.mNumBytes;  other.mNumBytes  = numBytes;
+    bool     huge      = mHugePages; mHugePages = other.mHugePages; other.mHugePages = huge;
+    bool     mapped    = mMapped;    mMapped    = other.mMapped;    other.mMapped    = mapped;
+    bool     file      = mFileBacked; mFileBacked = other.mFileBacked; other.mFileBacked = file;
+}
+
+// Buffers for single and double precision registers
+template class ofxQuantumStateBufferT<float>;
+template class ofxQuantumStateBufferT<double>;
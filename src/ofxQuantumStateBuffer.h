@@ -0,0 +1,115 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumStateBuffer.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumStateBuffer holds the probability amplitudes of a quantum register. The real and imaginary parts are stored in
+//  two separate planes (structure of arrays) so that the gate kernels can load whole vector registers of either part at once.
+//  Both planes live in one 64 byte aligned allocation, which can optionally be backed by huge pages for very large registers.
+//  The amplitude type is a template parameter, float buffers are compiled alongside the default double ones.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMSTATEBUFFER_H
+#define OFXQUANTUMSTATEBUFFER_H
+
+// Includes
+#include <stddef.h>
+#include <string>
+#include "Complex.h"
+
+// Alignment of each amplitude plane in bytes, one cache line and one AVX-512 register
+#define QUANTUM_STATE_ALIGNMENT 64
+
+template<typename T>
+class ofxQuantumStateBufferT
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructors, the buffer is zero initialised
+    ofxQuantumStateBufferT();
+    ofxQuantumStateBufferT( size_t numStates, bool useHugePages = false );
+    ofxQuantumStateBufferT( const ofxQuantumStateBufferT & );
+    ~ofxQuantumStateBufferT();
+
+    ofxQuantumStateBufferT & operator = ( const ofxQuantumStateBufferT & );
+
+    // Allocate room for numStates amplitudes, any previous contents are released
+    void allocate( size_t numStates, bool useHugePages = false );
+
+    // Map numStates amplitudes of an open file copy on write, the real plane at realOffset and the imaginary plane at
+    // imagOffset, both page aligned. Pages are read from the file on first touch and writes stay private to the buffer
+    bool mapFile( int fd, unsigned long long int realOffset, unsigned long long int imagOffset, size_t numStates );
+
+    // Allocate room for numStates amplitudes in a file shared mapping instead of memory, for states larger than ram. The
+    // file is created at path, sized without writing it so it starts as zeros, and removed again once it is mapped so it
+    // never outlives the buffer. The os pages the amplitudes in and out, reading ahead for sequential passes
+    bool allocateFile( const std::string & path, size_t numStates );
+
+    // Hint that amplitudes [first, first + count) of both planes are needed soon, or are finished with for now. Only
+    // file backed buffers act on it
+    void willNeed( size_t first, size_t count ) const;
+    void dontNeed( size_t first, size_t count ) const;
+
+    // Take over a mapping of at least mappedBytes(numStates) bytes made elsewhere, for example a shared memory segment,
+    // and use it for both planes. The buffer unmaps it when released
+    void adopt( void * block, size_t numBytes, size_t numStates );
+
+    // Bytes needed to hold both planes of numStates amplitudes in one block, as laid out by allocate and adopt
+    static size_t mappedBytes( size_t numStates );
+
+    // Free the memory held by the buffer
+    void release();
+
+    // Set every amplitude to 0 + i0
+    void zero();
+
+    // Swap contents with another buffer without copying amplitudes
+    void swap( ofxQuantumStateBufferT & other );
+
+    // Access a single amplitude
+    Complex get( size_t indx ) const                         { return Complex( mReal[indx], mImag[indx] ); }
+    void    set( size_t indx, const Complex & c )            { set(indx, c.getReal(), c.getImag()); }
+    void    set( size_t indx, double real, double imag )     { mReal[indx] = (T)real;     mImag[indx] = (T)imag;     }
+
+    // Raw access to the amplitude planes for the kernels
+    T       * real()       { return mReal; }
+    T       * imag()       { return mImag; }
+    const T * real() const { return mReal; }
+    const T * imag() const { return mImag; }
+
+    // Number of amplitudes held
+    size_t size() const { return mNumStates; }
+
+    // Total number of bytes allocated for both planes
+    size_t getNumBytes() const { return mNumBytes; }
+
+    // Whether the buffer was allocated with a huge page request
+    bool usesHugePages() const { return mHugePages; }
+
+    // Whether the amplitudes live in a file
+    bool usesFile() const { return mFileBacked; }
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    T *      mReal;          // Real plane, also the start of the allocation
+    T *      mImag;          // Imaginary plane
+    size_t   mNumStates;     // Number of amplitudes
+    size_t   mNumBytes;      // Size of the allocation
+    bool     mHugePages;     // Allocated with a huge page request
+    bool     mMapped;        // Allocated with mmap rather than posix_memalign
+    bool     mFileBacked;    // Mapped from a file by allocateFile
+};
+
+typedef ofxQuantumStateBufferT<double> ofxQuantumStateBuffer;
+
+#endif
@@ -0,0 +1,292 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumThreadPool.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumThreadPool.h"
+
+#include <algorithm>
+
+// Set on pool workers and on a caller while it takes chunks, a loop started from inside another loop runs serially
+// rather than waiting on a pool that is busy with the outer loop
+static thread_local bool sInsideWorker = false;
+
+////////////////////////////////////////////////////
+// Number of chunks in a range                    //
+////////////////////////////////////////////////////
+static size_t numChunks( size_t begin, size_t end, size_t grain )
+{
+    return end > begin ? (end - begin + grain - 1) / grain : 0;
+}
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+ofxQuantumThreadPool::ofxQuantumThreadPool( int numThreads )
+{
+    mJob         = NULL;
+    mJobBegin    = 0;
+    mJobEnd      = 0;
+    mJobGrain    = 1;
+    mNextChunk   = 0;
+    mBusyWorkers = 0;
+    mGeneration  = 0;
+    mStopping    = false;
+    mNumThreads  = 1;
+
+    setNumThreads(numThreads);
+}
+
+////////////////////////////////////////////////////
+// Destructor                                     //
+////////////////////////////////////////////////////
+ofxQuantumThreadPool::~ofxQuantumThreadPool()
+{
+    stopWorkers();
+}
+
+////////////////////////////////////////////////////
+// Set the number of threads                      //
+////////////////////////////////////////////////////
+void ofxQuantumThreadPool::setNumThreads( int numThreads )
+{
+    std::lock_guard<std::mutex> submitLock(mSubmitMutex);
+
+    if(numThreads <= 0)
+        numThreads = std::thread::hardware_concurrency();
+    if(numThreads <= 0)
+        numThreads = 1;
+
+    // Workers are started the next time a loop runs
+    stopWorkers();
+    mNumThreads = numThreads;
+}
+
+////////////////////////////////////////////////////
+// Get the number of threads                      //
+////////////////////////////////////////////////////
+int ofxQuantumThreadPool::getNumThreads() const
+{
+    return mNumThreads;
+}
+
+////////////////////////////////////////////////////
+// Start the worker threads                       //
+////////////////////////////////////////////////////
+void ofxQuantumThreadPool::startWorkers()
+{
+    mStopping = false;
+
+    for(int i = 1; i < mNumThreads; i++)
+        mWorkers.push_back(std::thread(&ofxQuantumThreadPool::workerLoop, this));
+}
+
+////////////////////////////////////////////////////
+// Stop and join the worker threads               //
+////////////////////////////////////////////////////
+void ofxQuantumThreadPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWakeCondition.notify_all();
+
+    for(size_t i = 0; i < mWorkers.size(); i++)
+        mWorkers[i].join();
+
+    mWorkers.clear();
+}
+
+////////////////////////////////////////////////////
+// Worker thread, waits for jobs and runs them    //
+////////////////////////////////////////////////////
+void ofxQuantumThreadPool::workerLoop()
+{
+    sInsideWorker = true;
+
+    unsigned long long int seenGeneration = 0;
+
+    while(true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeCondition.wait(lock, [&]{ return mStopping || mGeneration != seenGeneration; });
+
+            if(mStopping)
+                return;
+
+            seenGeneration = mGeneration;
+        }
+
+        runChunks();
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mBusyWorkers--;
+        }
+        mDoneCondition.notify_one();
+    }
+}
+
+////////////////////////////////////////////////////
+// Run chunks of the current job                  //
+////////////////////////////////////////////////////
+void ofxQuantumThreadPool::runChunks()
+{
+    const size_t count = numChunks(mJobBegin, mJobEnd, mJobGrain);
+
+    for(size_t chunk = mNextChunk++; chunk < count; chunk = mNextChunk++)
+    {
+        const size_t chunkBegin = mJobBegin + chunk * mJobGrain;
+        const size_t chunkEnd   = chunkBegin + mJobGrain < mJobEnd ? chunkBegin + mJobGrain : mJobEnd;
+
+        (*mJob)(chunkBegin, chunkEnd);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////
+// Run a loop across the pool. The calling thread takes chunks as well,
+// and returns once every chunk has been processed.
+////////////////////////////////////////////////////////////////////////
+void ofxQuantumThreadPool::parallelFor( size_t begin, size_t end, size_t grain, const std::function<void (size_t, size_t)> & fn )
+{
+    if(grain == 0)
+        grain = 1;
+
+    if(mNumThreads <= 1 || sInsideWorker || numChunks(begin, end, grain) <= 1)
+    {
+        serialFor(begin, end, grain, fn);
+        return;
+    }
+
+    std::lock_guard<std::mutex> submitLock(mSubmitMutex);
+
+    if(mWorkers.empty())
+        startWorkers();
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mJob         = &fn;
+        mJobBegin    = begin;
+        mJobEnd      = end;
+        mJobGrain    = grain;
+        mNextChunk   = 0;
+        mBusyWorkers = (int)mWorkers.size();
+        mGeneration++;
+    }
+    mWakeCondition.notify_all();
+
+    // Chunks run here start their inner loops serially, the same as on a worker
+    sInsideWorker = true;
+    runChunks();
+    sInsideWorker = false;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [&]{ return mBusyWorkers == 0; });
+    mJob = NULL;
+}
+
+////////////////////////////////////////////////////
+// Parallel sum with a fixed order of additions   //
+////////////////////////////////////////////////////
+double ofxQuantumThreadPool::parallelSum( size_t begin, size_t end, size_t grain, const std::function<double (size_t, size_t)> & fn )
+{
+    if(grain == 0)
+        grain = 1;
+
+    std::vector<double> partials(numChunks(begin, end, grain), 0.0);
+
+    parallelFor(begin, end, grain, [&](size_t chunkBegin, size_t chunkEnd)
+    {
+        partials[(chunkBegin - begin) / grain] = fn(chunkBegin, chunkEnd);
+    });
+
+    double total = 0.0;
+    for(size_t i = 0; i < partials.size(); i++)
+        total += partials[i];
+
+    return total;
+}
+
+////////////////////////////////////////////////////
+// Parallel sum of several values                 //
+////////////////////////////////////////////////////
+void ofxQuantumThreadPool::parallelSum( size_t begin, size_t end, size_t grain, size_t numValues,
+                                        const std::function<void (size_t, size_t, double *)> & fn, double * totals )
+{
+    if(grain == 0)
+        grain = 1;
+
+    std::vector<double> partials(numChunks(begin, end, grain) * numValues, 0.0);
+
+    parallelFor(begin, end, grain, [&](size_t chunkBegin, size_t chunkEnd)
+    {
+        fn(chunkBegin, chunkEnd, &partials[(chunkBegin - begin) / grain * numValues]);
+    });
+
+    for(size_t v = 0; v < numValues; v++)
+        totals[v] = 0.0;
+
+    for(size_t i = 0; i < partials.size(); i += numValues)
+    {
+        for(size_t v = 0; v < numValues; v++)
+            totals[v] += partials[i + v];
+    }
+}
+
+////////////////////////////////////////////////////
+// Serial loop over the same chunks               //
+////////////////////////////////////////////////////
+void ofxQuantumThreadPool::serialFor( size_t begin, size_t end, size_t grain, const std::function<void (size_t, size_t)> & fn )
+{
+    if(grain == 0)
+        grain = 1;
+
+    for(size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grain)
+        fn(chunkBegin, chunkBegin + grain < end ? chunkBegin + grain : end);
+}
+
+////////////////////////////////////////////////////
+// Serial sum over the same chunks in order       //
+////////////////////////////////////////////////////
+double ofxQuantumThreadPool::serialSum( size_t begin, size_t end, size_t grain, const std::function<double (size_t, size_t)> & fn )
+{
+    if(grain == 0)
+        grain = 1;
+
+    double total = 0.0;
+
+    for(size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grain)
+        total += fn(chunkBegin, chunkBegin + grain < end ? chunkBegin + grain : end);
+
+    return total;
+}
+
+////////////////////////////////////////////////////
+// Serial sum of several values                   //
+////////////////////////////////////////////////////
+void ofxQuantumThreadPool::serialSum( size_t begin, size_t end, size_t grain, size_t numValues,
+                                      const std::function<void (size_t, size_t, double *)> & fn, double * totals )
+{
+    if(grain == 0)
+        grain = 1;
+
+    std::vector<double> partials(numValues);
+
+    for(size_t v = 0; v < numValues; v++)
+        totals[v] = 0.0;
+
+    for(size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grain)
+    {
+        std::fill(partials.begin(), partials.end(), 0.0);
+
+        fn(chunkBegin, chunkBegin + grain < end ? chunkBegin + grain : end, &partials[0]);
+
+        for(size_t v = 0; v < numValues; v++)
+            totals[v] += partials[v];
+    }
+}
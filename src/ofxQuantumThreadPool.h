@@ -0,0 +1,104 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumThreadPool.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumThreadPool is a persistent set of worker threads used to split loops over the amplitudes of a quantum register
+//  across cpu cores. Work is cut into chunks of a fixed size that does not depend on the number of threads, and sums are
+//  added up chunk by chunk in order, so the results are bit identical whether the loop runs on one thread or many.
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMTHREADPOOL_H
+#define OFXQUANTUMTHREADPOOL_H
+
+// Includes
+#include <stddef.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Registers with fewer states than this always run on the calling thread
+#define QUANTUM_PARALLEL_THRESHOLD (1 << 16)
+
+// Number of amplitudes (or amplitude pairs) handed to a thread at a time
+#define QUANTUM_PARALLEL_GRAIN     (1 << 14)
+
+class ofxQuantumThreadPool
+{
+public:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, numThreads includes the calling thread. 0 uses one thread per hardware core
+    ofxQuantumThreadPool( int numThreads = 0 );
+
+    // Destructor, stops and joins the workers
+    ~ofxQuantumThreadPool();
+
+    // Change the number of threads, 1 makes every loop run serially on the calling thread
+    void setNumThreads( int numThreads );
+    int  getNumThreads() const;
+
+    // Call fn(chunkBegin, chunkEnd) for every chunk of [begin, end), spread across the threads
+    void   parallelFor( size_t begin, size_t end, size_t grain, const std::function<void (size_t, size_t)> & fn );
+
+    // Sum fn(chunkBegin, chunkEnd) over every chunk of [begin, end). The partial sums are added in chunk order
+    double parallelSum( size_t begin, size_t end, size_t grain, const std::function<double (size_t, size_t)> & fn );
+
+    // Sum several values at once. fn(chunkBegin, chunkEnd, partials) adds into numValues zeroed partials for its chunk,
+    // the partials of every chunk are then added into totals in chunk order
+    void   parallelSum( size_t begin, size_t end, size_t grain, size_t numValues,
+                        const std::function<void (size_t, size_t, double *)> & fn, double * totals );
+
+    // Same chunking and order as the parallel versions, run on the calling thread. Used when there is no pool
+    static void   serialFor( size_t begin, size_t end, size_t grain, const std::function<void (size_t, size_t)> & fn );
+    static double serialSum( size_t begin, size_t end, size_t grain, const std::function<double (size_t, size_t)> & fn );
+    static void   serialSum( size_t begin, size_t end, size_t grain, size_t numValues,
+                             const std::function<void (size_t, size_t, double *)> & fn, double * totals );
+
+private:
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Start and stop the worker threads
+    void startWorkers();
+    void stopWorkers();
+
+    // Loop run by every worker
+    void workerLoop();
+
+    // Take chunks of the current job until there are none left
+    void runChunks();
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    std::vector<std::thread>                     mWorkers;        // Worker threads, one less than mNumThreads
+    int                                          mNumThreads;     // Threads used for each loop including the caller
+
+    std::mutex                                   mSubmitMutex;    // Only one loop runs on the pool at a time
+    std::mutex                                   mMutex;          // Guards the job state below
+    std::condition_variable                      mWakeCondition;  // Signals workers that a job is ready
+    std::condition_variable                      mDoneCondition;  // Signals the caller that the workers are done
+
+    const std::function<void (size_t, size_t)> * mJob;            // Current loop body
+    size_t                                       mJobBegin;       // Current loop range
+    size_t                                       mJobEnd;
+    size_t                                       mJobGrain;
+    std::atomic<size_t>                          mNextChunk;      // Next chunk to hand out
+    int                                          mBusyWorkers;    // Workers still running the current job
+    unsigned long long int                       mGeneration;     // Incremented for every job
+    bool                                         mStopping;       // Tells workers to exit
+};
+
+#endif
@@ -0,0 +1,561 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumTrajectories.cpp
+//
+//  Created by Jayson Haebich, 2016 www.jaysonh.com
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include "ofxQuantumTrajectories.h"
+#include "ofxQuantum.h"
+
+#include <math.h>
+
+////////////////////////////////////////////////////
+// Constructor                                    //
+////////////////////////////////////////////////////
+
+template<typename T>
+ofxQuantumTrajectoriesT<T>::ofxQuantumTrajectoriesT( unsigned long long int size, ofxQuantum *quantumSim, const ofxQuantumNoiseModel & noise )
+    : mSerialPool(1)
+{
+    mQuantumSim = quantumSim;
+    mRegSize    = size;
+    mNoise      = noise;
+}
+
+////////////////////////////////////////////////////
+// Noise model                                    //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::setNoiseModel( const ofxQuantumNoiseModel & noise )
+{
+    mNoise = noise;
+}
+
+template<typename T>
+const ofxQuantumNoiseModel & ofxQuantumTrajectoriesT<T>::getNoiseModel() const
+{
+    return mNoise;
+}
+
+////////////////////////////////////////////////////
+// Record single qubit gates                      //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGate( unsigned long long int bit, const Complex matrix[4] )
+{
+    record(ofxQuantumNoiseModel::GATE_MATRIX, bit, 0.0, matrix);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateX( unsigned long long int bit )
+{
+    record(ofxQuantumNoiseModel::GATE_X, bit);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateY( unsigned long long int bit )
+{
+    record(ofxQuantumNoiseModel::GATE_Y, bit);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateZ( unsigned long long int bit )
+{
+    record(ofxQuantumNoiseModel::GATE_Z, bit);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateS( unsigned long long int bit )
+{
+    record(ofxQuantumNoiseModel::GATE_S, bit);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateT( unsigned long long int bit )
+{
+    record(ofxQuantumNoiseModel::GATE_T, bit);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateHad( unsigned long long int bit )
+{
+    record(ofxQuantumNoiseModel::GATE_HAD, bit);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGatePhase( unsigned long long int bit, double theta )
+{
+    record(ofxQuantumNoiseModel::GATE_PHASE, bit, theta);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateRx( unsigned long long int bit, double theta )
+{
+    record(ofxQuantumNoiseModel::GATE_RX, bit, theta);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateRy( unsigned long long int bit, double theta )
+{
+    record(ofxQuantumNoiseModel::GATE_RY, bit, theta);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateRz( unsigned long long int bit, double theta )
+{
+    record(ofxQuantumNoiseModel::GATE_RZ, bit, theta);
+}
+
+////////////////////////////////////////////////////
+// Record controlled gates                        //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyControlledGate( const std::vector<unsigned long long int> & controls,
+                                                      unsigned long long int target,
+                                                      const Complex matrix[4],
+                                                      unsigned long long int controlValues )
+{
+    if(!checkBit(target))
+        return;
+
+    for(size_t i = 0; i < controls.size(); i++)
+    {
+        if(!checkBit(controls[i]))
+            return;
+
+        if(controls[i] == target)
+        {
+            printf("ERROR! control qubit %llu is also the target\n", target);
+            return;
+        }
+    }
+
+    Operation op;
+    op.type          = ofxQuantumNoiseModel::GATE_CONTROLLED;
+    op.controls      = controls;
+    op.target        = target;
+    op.controlValues = controlValues;
+    op.theta         = 0.0;
+
+    for(int i = 0; i < 4; i++)
+        op.matrix[i] = Amplitude(matrix[i].getReal(), matrix[i].getImag());
+
+    mOperations.push_back(op);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateControlledNot( unsigned long long int controlBit, unsigned long long int bit )
+{
+    if(!checkBit(controlBit) || !checkBit(bit))
+        return;
+
+    if(controlBit == bit)
+    {
+        printf("ERROR! control qubit %llu is also the target\n", bit);
+        return;
+    }
+
+    record(ofxQuantumNoiseModel::GATE_CNOT, bit);
+    mOperations.back().controls.push_back(controlBit);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateToffoli( unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit )
+{
+    if(!checkBit(controlBit1) || !checkBit(controlBit2) || !checkBit(bit))
+        return;
+
+    if(controlBit1 == bit || controlBit2 == bit || controlBit1 == controlBit2)
+    {
+        printf("ERROR! toffoli qubits must all be different\n");
+        return;
+    }
+
+    record(ofxQuantumNoiseModel::GATE_TOFFOLI, bit);
+    mOperations.back().controls.push_back(controlBit1);
+    mOperations.back().controls.push_back(controlBit2);
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta )
+{
+    if(!checkBit(controlBit) || !checkBit(bit))
+        return;
+
+    if(controlBit == bit)
+    {
+        printf("ERROR! control qubit %llu is also the target\n", bit);
+        return;
+    }
+
+    record(ofxQuantumNoiseModel::GATE_CONTROLLED_PHASE, bit, theta);
+    mOperations.back().controls.push_back(controlBit);
+}
+
+////////////////////////////////////////////////////
+// Recorded gates and observables                 //
+////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::clearGates()
+{
+    mOperations.clear();
+}
+
+template<typename T>
+size_t ofxQuantumTrajectoriesT<T>::getNumGates() const
+{
+    return mOperations.size();
+}
+
+template<typename T>
+size_t ofxQuantumTrajectoriesT<T>::addObservable( const Observable & observable )
+{
+    mObservables.push_back(observable);
+    return mObservables.size() - 1;
+}
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::clearObservables()
+{
+    mObservables.clear();
+}
+
+template<typename T>
+int ofxQuantumTrajectoriesT<T>::size() const
+{
+    return (int)mRegSize;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Run the trajectories, each on its own register and random stream, then
+// add up their results in trajectory order
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+ofxQuantumTrajectoryResult ofxQuantumTrajectoriesT<T>::run( unsigned long long int numTrajectories, unsigned long long int shotsPerTrajectory )
+{
+    if(mQuantumSim == NULL)
+    {
+        printf("ERROR! trajectories are not linked to a quantum simulator\n");
+        return ofxQuantumTrajectoryResult();
+    }
+
+    return run(numTrajectories, shotsPerTrajectory, mQuantumSim->getRandomInt());
+}
+
+template<typename T>
+ofxQuantumTrajectoryResult ofxQuantumTrajectoriesT<T>::run( unsigned long long int numTrajectories, unsigned long long int shotsPerTrajectory, unsigned long long int seed )
+{
+    ofxQuantumTrajectoryResult result;
+    result.numTrajectories = 0;
+    result.seed            = seed;
+
+    if(mQuantumSim == NULL)
+    {
+        printf("ERROR! trajectories are not linked to a quantum simulator\n");
+        return result;
+    }
+
+    if(numTrajectories == 0)
+    {
+        printf("ERROR! at least one trajectory is needed\n");
+        return result;
+    }
+
+    std::vector<Trajectory> trajectories(numTrajectories);
+
+    // One trajectory per task, a trajectory is far more work than the cost of handing it out
+    mQuantumSim->getThreadPool().parallelFor(0, numTrajectories, 1, [&](size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+            runTrajectory(i, seed, shotsPerTrajectory, trajectories[i]);
+    });
+
+    // Add up in order so the sums do not depend on which thread ran which trajectory
+    const size_t numObservables = mObservables.size();
+
+    result.numTrajectories = numTrajectories;
+    result.qubitProbs.assign(mRegSize, 0.0);
+    result.observableMeans.assign(numObservables, 0.0);
+    result.observableErrors.assign(numObservables, 0.0);
+
+    for(size_t i = 0; i < trajectories.size(); i++)
+    {
+        const Trajectory & trajectory = trajectories[i];
+
+        for(size_t q = 0; q < mRegSize; q++)
+            result.qubitProbs[q] += trajectory.qubitProbs[q];
+
+        for(size_t k = 0; k < numObservables; k++)
+            result.observableMeans[k] += trajectory.observables[k];
+
+        std::map<unsigned long long int, unsigned long long int>::const_iterator it;
+
+        for(it = trajectory.counts.begin(); it != trajectory.counts.end(); ++it)
+            result.counts[it->first] += it->second;
+    }
+
+    for(size_t q = 0; q < mRegSize; q++)
+        result.qubitProbs[q] /= (double)numTrajectories;
+
+    for(size_t k = 0; k < numObservables; k++)
+    {
+        result.observableMeans[k] /= (double)numTrajectories;
+
+        if(numTrajectories < 2)
+            continue;
+
+        // Sample variance about the mean, a second pass keeps it accurate when the spread is small
+        double variance = 0.0;
+
+        for(size_t i = 0; i < trajectories.size(); i++)
+        {
+            const double diff = trajectories[i].observables[k] - result.observableMeans[k];
+            variance += diff * diff;
+        }
+
+        variance /= (double)(numTrajectories - 1);
+
+        result.observableErrors[k] = sqrt(variance / (double)numTrajectories);
+    }
+
+    return result;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Check a qubit index                                                          //
+//////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+bool ofxQuantumTrajectoriesT<T>::checkBit( unsigned long long int bit ) const
+{
+    if(bit >= mRegSize)
+    {
+        printf("ERROR! qubit %llu is outside the register of %llu qubits\n", bit, mRegSize);
+        return false;
+    }
+
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Record a gate without controls                                               //
+//////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::record( ofxQuantumNoiseModel::GateType type, unsigned long long int bit, double theta, const Complex * matrix )
+{
+    if(!checkBit(bit))
+        return;
+
+    Operation op;
+    op.type          = type;
+    op.target        = bit;
+    op.controlValues = ~0ULL;
+    op.theta         = theta;
+
+    if(matrix != NULL)
+    {
+        for(int i = 0; i < 4; i++)
+            op.matrix[i] = Amplitude(matrix[i].getReal(), matrix[i].getImag());
+    }
+
+    mOperations.push_back(op);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Run a single trajectory. The register runs serially as the threads are
+// already busy with other trajectories, and every random number comes from
+// the stream of this trajectory so it can be repeated on its own
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::runTrajectory( unsigned long long int index, unsigned long long int seed, unsigned long long int shots, Trajectory & out )
+{
+    ofxQuantumRandom       random(seed, index);
+    ofxQuantumRegisterT<T> reg(mRegSize, mQuantumSim);
+
+    reg.setThreadPool(&mSerialPool);
+
+    for(size_t i = 0; i < mOperations.size(); i++)
+    {
+        const Operation & op = mOperations[i];
+
+        applyOperation(reg, op);
+
+        // Noise of the gate type and of each qubit, on the controls as well as the target
+        const std::vector<ofxQuantumNoiseChannel> & gateNoise = mNoise.getGateNoise(op.type);
+
+        for(size_t c = 0; c <= op.controls.size(); c++)
+        {
+            const unsigned long long int bit = c < op.controls.size() ? op.controls[c] : op.target;
+
+            applyChannels(reg, bit, gateNoise, random);
+            applyChannels(reg, bit, mNoise.getQubitNoise(bit), random);
+        }
+    }
+
+    out.qubitProbs.resize(mRegSize);
+
+    for(size_t q = 0; q < mRegSize; q++)
+        out.qubitProbs[q] = reg.getBitProb(q);
+
+    out.observables.resize(mObservables.size());
+
+    for(size_t k = 0; k < mObservables.size(); k++)
+        out.observables[k] = mObservables[k](reg);
+
+    if(shots == 0)
+        return;
+
+    // Readout errors flip each measured bit on its own, looked up once per trajectory
+    std::vector<double> flip0(mRegSize), flip1(mRegSize);
+    bool                hasReadout = false;
+
+    for(size_t q = 0; q < mRegSize; q++)
+    {
+        flip0[q]   = mNoise.getReadoutError(q, 0);
+        flip1[q]   = mNoise.getReadoutError(q, 1);
+        hasReadout = hasReadout || flip0[q] > 0.0 || flip1[q] > 0.0;
+    }
+
+    std::vector<unsigned long long int> outcomes = reg.sample(shots, random.nextInt());
+
+    for(size_t s = 0; s < outcomes.size(); s++)
+    {
+        unsigned long long int outcome = outcomes[s];
+
+        if(hasReadout)
+        {
+            for(size_t q = 0; q < mRegSize; q++)
+            {
+                const unsigned long long int mask = 1ULL << (mRegSize - 1 - q);
+                const double                 prob = (outcome & mask) ? flip1[q] : flip0[q];
+
+                if(prob > 0.0 && random.nextDouble() < prob)
+                    outcome ^= mask;
+            }
+        }
+
+        out.counts[outcome]++;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////
+// Apply a recorded gate                                                        //
+//////////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyOperation( ofxQuantumRegisterT<T> & reg, const Operation & op ) const
+{
+    Complex matrix[4];
+
+    for(int i = 0; i < 4; i++)
+        matrix[i].set(op.matrix[i].real(), op.matrix[i].imag());
+
+    switch(op.type)
+    {
+        case ofxQuantumNoiseModel::GATE_X:                reg.applyGateX(op.target);                                          break;
+        case ofxQuantumNoiseModel::GATE_Y:                reg.applyGateY(op.target);                                          break;
+        case ofxQuantumNoiseModel::GATE_Z:                reg.applyGateZ(op.target);                                          break;
+        case ofxQuantumNoiseModel::GATE_S:                reg.applyGateS(op.target);                                          break;
+        case ofxQuantumNoiseModel::GATE_T:                reg.applyGateT(op.target);                                          break;
+        case ofxQuantumNoiseModel::GATE_HAD:              reg.applyGateHad(op.target);                                        break;
+        case ofxQuantumNoiseModel::GATE_PHASE:            reg.applyGatePhase(op.target, op.theta);                            break;
+        case ofxQuantumNoiseModel::GATE_RX:               reg.applyGateRx(op.target, op.theta);                               break;
+        case ofxQuantumNoiseModel::GATE_RY:               reg.applyGateRy(op.target, op.theta);                               break;
+        case ofxQuantumNoiseModel::GATE_RZ:               reg.applyGateRz(op.target, op.theta);                               break;
+        case ofxQuantumNoiseModel::GATE_MATRIX:           reg.applyGate(op.target, matrix);                                   break;
+        case ofxQuantumNoiseModel::GATE_CNOT:             reg.applyGateControlledNot(op.controls[0], op.target);              break;
+        case ofxQuantumNoiseModel::GATE_TOFFOLI:          reg.applyGateToffoli(op.controls[0], op.controls[1], op.target);    break;
+        case ofxQuantumNoiseModel::GATE_CONTROLLED_PHASE: reg.applyGateControlledPhase(op.controls[0], op.target, op.theta);  break;
+        case ofxQuantumNoiseModel::GATE_CONTROLLED:       reg.applyControlledGate(op.controls, op.target, matrix, op.controlValues); break;
+        default:                                                                                                              break;
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Draw the errors of a list of channels on one qubit. Depolarizing and
+// dephasing pick a Pauli with a fixed chance. Amplitude damping is not a
+// mixture of unitaries, a jump to |0> happens with chance gamma times the
+// chance the qubit is 1, otherwise the |1> part shrinks, both are followed
+// by a renormalisation
+/////////////////////////////////////////////////////////////////////////////
+
+template<typename T>
+void ofxQuantumTrajectoriesT<T>::applyChannels( ofxQuantumRegisterT<T> & reg, unsigned long long int bit,
+                                                const std::vector<ofxQuantumNoiseChannel> & channels, ofxQuantumRandom & random ) const
+{
+    for(size_t i = 0; i < channels.size(); i++)
+    {
+        const double p = channels[i].probability;
+
+        if(p <= 0.0)
+            continue;
+
+        switch(channels[i].type)
+        {
+            case ofxQuantumNoiseChannel::NOISE_DEPOLARIZING:
+            {
+                if(random.nextDouble() >= p)
+                    break;
+
+                const unsigned long long int pauli = random.nextInt() % 3;
+
+                if(pauli == 0)      reg.applyGateX(bit);
+                else if(pauli == 1) reg.applyGateY(bit);
+                else                reg.applyGateZ(bit);
+
+                break;
+            }
+
+            case ofxQuantumNoiseChannel::NOISE_DEPHASING:
+            {
+                if(random.nextDouble() < p)
+                    reg.applyGateZ(bit);
+
+                break;
+            }
+
+            case ofxQuantumNoiseChannel::NOISE_AMPLITUDE_DAMPING:
+            {
+                const double probOne = reg.getBitProb(bit);
+
+                // Nothing to damp, and the no jump operator would leave the state as it is
+                if(probOne <= 0.0)
+                    break;
+
+                Complex kraus[4];
+
+                if(random.nextDouble() < p * probOne)
+                {
+                    kraus[0].set(0.0, 0.0);     kraus[1].set(sqrt(p), 0.0);
+                    kraus[2].set(0.0, 0.0);     kraus[3].set(0.0, 0.0);
+                }
+                else
+                {
+                    kraus[0].set(1.0, 0.0);     kraus[1].set(0.0, 0.0);
+                    kraus[2].set(0.0, 0.0);     kraus[3].set(sqrt(1.0 - p), 0.0);
+                }
+
+                reg.applyGate(bit, kraus);
+                reg.norm();
+
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+}
+
+// Single and double precision trajectories
+template class ofxQuantumTrajectoriesT<float>;
+template class ofxQuantumTrajectoriesT<double>;
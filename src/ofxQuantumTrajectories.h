@@ -0,0 +1,168 @@
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+//
+//  ofxQuantumTrajectories.h
+//
+//  Created by Jayson Haebich, 2016, www.jaysonh.com
+//
+//  ofxQuantumTrajectories runs a circuit under an ofxQuantumNoiseModel by Monte Carlo wavefunction trajectories. Every
+//  trajectory starts from |0...0> in its own register, replays the recorded gates and after each gate draws which error, if
+//  any, the noise channels apply. Averaged over many trajectories the results match the density matrix of the noisy
+//  circuit while each trajectory only needs a state vector.
+//
+//  Trajectories are independent so they are spread over the simulator's threads, one trajectory per task with its own
+//  register and its own random stream numbered by the trajectory. Results are added up in trajectory order, so a run with the
+//  same seed gives the same numbers on any number of threads.
+//
+//  ofxQuantumTrajectories noisy( 5, &quantumSim, noise );
+//  noisy.applyGateHad(0);
+//  for(int q = 1; q < 5; q++) noisy.applyGateControlledNot(q - 1, q);
+//  ofxQuantumTrajectoryResult result = noisy.run(1000, 10);
+//
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifndef OFXQUANTUMTRAJECTORIES_H
+#define OFXQUANTUMTRAJECTORIES_H
+
+// Includes
+#include <vector>
+#include <map>
+#include <functional>
+#include <complex>
+#include "Complex.h"
+#include "ofxQuantumNoiseModel.h"
+#include "ofxQuantumThreadPool.h"
+
+// Forward declarations
+class ofxQuantum;
+class ofxQuantumRandom;
+template<typename T> class ofxQuantumRegisterT;
+
+// Averages over the trajectories of a run
+struct ofxQuantumTrajectoryResult
+{
+    unsigned long long int                                   numTrajectories;
+    unsigned long long int                                   seed;               // Seed the run was made with, pass it to run again to repeat it
+    std::vector<double>                                      qubitProbs;         // Mean chance of measuring 1 on each qubit, before readout errors
+    std::vector<double>                                      observableMeans;    // Mean of each observable
+    std::vector<double>                                      observableErrors;   // Standard error of each mean
+    std::map<unsigned long long int, unsigned long long int> counts;             // Histogram of the measured states, with readout errors
+};
+
+template<typename T>
+class ofxQuantumTrajectoriesT
+{
+public:
+
+    // Value measured on the final state of a trajectory
+    typedef std::function<double (ofxQuantumRegisterT<T> &)> Observable;
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Public Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Constructor, the noise model is copied
+    ofxQuantumTrajectoriesT( unsigned long long int size, ofxQuantum *quantumSim, const ofxQuantumNoiseModel & noise );
+
+    // Replace the noise model, the recorded gates are kept
+    void                         setNoiseModel( const ofxQuantumNoiseModel & noise );
+    const ofxQuantumNoiseModel & getNoiseModel() const;
+
+    // Record gates, nothing is applied until run
+    void applyGate(      unsigned long long int bit, const Complex matrix[4] );
+    void applyGateX(     unsigned long long int bit );
+    void applyGateY(     unsigned long long int bit );
+    void applyGateZ(     unsigned long long int bit );
+    void applyGateS(     unsigned long long int bit );
+    void applyGateT(     unsigned long long int bit );
+    void applyGateHad(   unsigned long long int bit );
+    void applyGatePhase( unsigned long long int bit, double theta );
+    void applyGateRx(    unsigned long long int bit, double theta );
+    void applyGateRy(    unsigned long long int bit, double theta );
+    void applyGateRz(    unsigned long long int bit, double theta );
+
+    void applyControlledGate(      const std::vector<unsigned long long int> & controls,
+                                   unsigned long long int target,
+                                   const Complex matrix[4],
+                                   unsigned long long int controlValues = ~0ULL );
+    void applyGateControlledNot(   unsigned long long int controlBit, unsigned long long int bit );
+    void applyGateToffoli(         unsigned long long int controlBit1, unsigned long long int controlBit2, unsigned long long int bit );
+    void applyGateControlledPhase( unsigned long long int controlBit, unsigned long long int bit, double theta );
+
+    // Forget the recorded gates
+    void clearGates();
+
+    // Number of recorded gates
+    size_t getNumGates() const;
+
+    // Add a value to average over the final state of every trajectory, returns its index in the results.
+    // The observable gets the trajectory's register and must not keep it, it is called from several threads at once
+    size_t addObservable( const Observable & observable );
+    void   clearObservables();
+
+    // Run numTrajectories trajectories and draw shotsPerTrajectory measurements from the final state of each. Without a
+    // seed one is taken from the quantum simulator
+    ofxQuantumTrajectoryResult run( unsigned long long int numTrajectories, unsigned long long int shotsPerTrajectory );
+    ofxQuantumTrajectoryResult run( unsigned long long int numTrajectories, unsigned long long int shotsPerTrajectory, unsigned long long int seed );
+
+    // Number of qubits
+    int size() const;
+
+private:
+
+    typedef std::complex<double> Amplitude;
+
+    // A recorded gate
+    struct Operation
+    {
+        ofxQuantumNoiseModel::GateType      type;
+        std::vector<unsigned long long int> controls;
+        unsigned long long int              target;
+        unsigned long long int              controlValues;
+        double                              theta;
+        Amplitude                           matrix[4];      // Only used by GATE_MATRIX and GATE_CONTROLLED
+    };
+
+    // Outcome of a single trajectory, kept until every trajectory has finished so they can be added up in order
+    struct Trajectory
+    {
+        std::vector<double>                                      qubitProbs;
+        std::vector<double>                                      observables;
+        std::map<unsigned long long int, unsigned long long int> counts;
+    };
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Functions
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    // Check a qubit index, printing an error when it is out of range
+    bool checkBit( unsigned long long int bit ) const;
+
+    // Record a gate without controls
+    void record( ofxQuantumNoiseModel::GateType type, unsigned long long int bit, double theta = 0.0, const Complex * matrix = NULL );
+
+    // Run one trajectory
+    void runTrajectory( unsigned long long int index, unsigned long long int seed, unsigned long long int shots, Trajectory & out );
+
+    // Apply a recorded gate to a register
+    void applyOperation( ofxQuantumRegisterT<T> & reg, const Operation & op ) const;
+
+    // Draw and apply the errors of a list of channels on one qubit
+    void applyChannels( ofxQuantumRegisterT<T> & reg, unsigned long long int bit,
+                        const std::vector<ofxQuantumNoiseChannel> & channels, ofxQuantumRandom & random ) const;
+
+    //////////////////////////////////////////////////////////////////////////////////////////
+    // Private Variables
+    //////////////////////////////////////////////////////////////////////////////////////////
+
+    ofxQuantum *            mQuantumSim;        // Quantum simulator the seeds and the threads come from
+    unsigned long long int  mRegSize;           // Number of qubits
+    ofxQuantumNoiseModel    mNoise;             // Channels and readout errors
+    std::vector<Operation>  mOperations;        // Recorded gates in order
+    std::vector<Observable> mObservables;       // Values averaged over the trajectories
+    ofxQuantumThreadPool    mSerialPool;        // Single thread pool for the trajectory registers, the threads run trajectories
+};
+
+// Double precision trajectories, the default
+typedef ofxQuantumTrajectoriesT<double> ofxQuantumTrajectories;
+
+#endif